@@ -33,6 +33,8 @@
 #include <alsa/asoundlib.h>
 #include "faust/audio/audio.h"
 #include "faust/dsp/dsp.h"
+#include "faust/dsp/dsp-tools.h"
+#include "faust/dsp/dsp-monitor.h"
 
 /**
 DEFAULT ALSA PARAMETERS CONTROLLED BY ENVIRONMENT VARIABLES
@@ -43,6 +45,14 @@ Some default parameters of Faust's ALSA applications are controlled by the follo
     FAUST2ALSA_FREQUENCY= 44100
     FAUST2ALSA_BUFFER   = 512
     FAUST2ALSA_PERIODS  = 2
+    FAUST2ALSA_MMAP     = 0
+
+With FAUST2ALSA_MMAP=1 (or the '--mmap' option) the samples are converted directly between the
+mmaped DMA areas of the device and the DSP channels, without intermediate card buffers.
+The period size and number of periods are the nearest ones accepted by the device.
+Software PCMs can be used on a machine without sound hardware, for instance :
+
+    FAUST2ALSA_DEVICE=null FAUST2ALSA_MMAP=1 ./foo
 */
 
 // handle 32/64 bits int size issues
@@ -70,6 +80,9 @@ Some default parameters of Faust's ALSA applications are controlled by the follo
 #define check_error_msg(err,msg) if (err) { fprintf(stderr, "%s:%d, %s : %s(%d)\n", __FILE__, __LINE__, msg, snd_strerror(err), err); exit(1); }
 #define display_error_msg(err,msg) if (err) { fprintf(stderr, "%s:%d, %s : %s(%d)\n", __FILE__, __LINE__, msg, snd_strerror(err), err); }
 
+// maximum number of card or software channels of a stream
+#define MAX_ALSA_CHANNELS 256
+
 /**
  * Used to set the priority and scheduling of the audi#include <sys/types.h>
        #include <pwd.h>
@@ -112,6 +125,7 @@ struct AudioParam
 	unsigned int	fFrequency;
 	unsigned int	fBuffering;
 	unsigned int	fPeriods;
+	bool			fMmap;
 
 	unsigned int	fSoftInputs;
 	unsigned int	fSoftOutputs;
@@ -121,6 +135,7 @@ struct AudioParam
 		fFrequency(44100),
 		fBuffering(512),
 		fPeriods(2),
+		fMmap(false),
 		fSoftInputs(2),
 		fSoftOutputs(2)
 	{}
@@ -129,10 +144,90 @@ struct AudioParam
 	AudioParam&	frequency(int f)		{ fFrequency = f; 		return *this; }
 	AudioParam&	buffering(int fpb)		{ fBuffering = fpb; 	return *this; }
 	AudioParam&	periods(int p)			{ fPeriods = p; 		return *this; }
+	AudioParam&	mmap(bool m)			{ fMmap = m; 			return *this; }
 	AudioParam&	inputs(int n)			{ fSoftInputs = n; 		return *this; }
 	AudioParam&	outputs(int n)			{ fSoftOutputs = n; 	return *this; }
 };
 
+/**
+ * Xruns (overruns or underruns) and suspends of a stream
+ */
+struct XRunStats
+{
+	unsigned int	fXRuns;
+	unsigned int	fSuspends;
+	unsigned int	fErrors;		// unrecoverable errors
+
+	XRunStats() : fXRuns(0), fSuspends(0), fErrors(0) {}
+};
+
+/**
+ * Sample conversions between the channels of a mmaped area and the DSP channels
+ */
+template <class SAMPLE>
+struct AreaConverter
+{
+	typedef typename SAMPLE::type type;
+
+	static char* address(const snd_pcm_channel_area_t& area, snd_pcm_uframes_t offset)
+	{
+		return (char*)area.addr + (area.first + offset * area.step) / 8;
+	}
+
+	// the channels are interleaved in a single area, as the kernels expect them
+	static bool interleaved(const snd_pcm_channel_area_t* areas, int chans)
+	{
+		for (int c = 0; c < chans; c++) {
+			if (areas[c].addr != areas[0].addr
+				|| areas[c].step != chans * sizeof(type) * 8
+				|| areas[c].first != areas[0].first + c * sizeof(type) * 8) return false;
+		}
+		return true;
+	}
+
+	static void read(const snd_pcm_channel_area_t* areas, snd_pcm_uframes_t offset, float** channels, int pos, int chans, int frames)
+	{
+		assert(chans <= MAX_ALSA_CHANNELS);
+		float* outs[MAX_ALSA_CHANNELS];
+		for (int c = 0; c < chans; c++) outs[c] = channels[c] + pos;
+		if (interleaved(areas, chans)) {
+			deinterleaveSamples<SAMPLE>((const type*)address(areas[0], offset), outs, chans, frames);
+		} else {
+			for (int c = 0; c < chans; c++) {
+				if (areas[c].step == sizeof(type) * 8) {
+					deinterleaveSamples<SAMPLE>((const type*)address(areas[c], offset), &outs[c], 1, frames);
+				} else {
+					const char* in = address(areas[c], offset);
+					for (int f = 0; f < frames; f++, in += areas[c].step / 8) {
+						outs[c][f] = SAMPLE::template load<float>(*(const type*)in);
+					}
+				}
+			}
+		}
+	}
+
+	static void write(float** channels, int pos, const snd_pcm_channel_area_t* areas, snd_pcm_uframes_t offset, int chans, int frames)
+	{
+		assert(chans <= MAX_ALSA_CHANNELS);
+		float* ins[MAX_ALSA_CHANNELS];
+		for (int c = 0; c < chans; c++) ins[c] = channels[c] + pos;
+		if (interleaved(areas, chans)) {
+			interleaveSamples<SAMPLE>(ins, (type*)address(areas[0], offset), chans, frames);
+		} else {
+			for (int c = 0; c < chans; c++) {
+				if (areas[c].step == sizeof(type) * 8) {
+					interleaveSamples<SAMPLE>(&ins[c], (type*)address(areas[c], offset), 1, frames);
+				} else {
+					char* out = address(areas[c], offset);
+					for (int f = 0; f < frames; f++, out += areas[c].step / 8) {
+						SAMPLE::template store<float>(*(type*)out, ins[c][f]);
+					}
+				}
+			}
+		}
+	}
+};
+
 /**
  * An ALSA audio interface
  */
@@ -145,7 +240,10 @@ struct AudioInterface : public AudioParam
 	snd_pcm_hw_params_t* 	fOutputParams;
 
 	snd_pcm_format_t 		fSampleFormat;
-	snd_pcm_access_t 		fSampleAccess;
+	snd_pcm_access_t 		fInputAccess;		// access mode of each stream, mmap
+	snd_pcm_access_t 		fOutputAccess;		// may be available for only one of them
+	bool					fInputMmap;
+	bool					fOutputMmap;
 
 	unsigned int			fCardInputs;
 	unsigned int			fCardOutputs;
@@ -155,17 +253,20 @@ struct AudioInterface : public AudioParam
 
 	bool					fDuplexMode;
 
+	XRunStats				fInputXRuns;
+	XRunStats				fOutputXRuns;
+
 	// interleaved mode audiocard buffers
 	void*		fInputCardBuffer;
 	void*		fOutputCardBuffer;
 
 	// non interleaved mode audiocard buffers
-	void*		fInputCardChannels[256];
-	void*		fOutputCardChannels[256];
+	void*		fInputCardChannels[MAX_ALSA_CHANNELS];
+	void*		fOutputCardChannels[MAX_ALSA_CHANNELS];
 
 	// non interleaved mod, floating point software buffers
-	float*		fInputSoftChannels[256];
-	float*		fOutputSoftChannels[256];
+	float*		fInputSoftChannels[MAX_ALSA_CHANNELS];
+	float*		fOutputSoftChannels[MAX_ALSA_CHANNELS];
 
 	const char*	cardName()				{ return fCardName;  	}
  	int			frequency()				{ return fFrequency; 	}
@@ -176,6 +277,10 @@ struct AudioInterface : public AudioParam
 	float**		outputSoftChannels()	{ return fOutputSoftChannels;	}
 
 	bool		duplexMode()			{ return fDuplexMode; }
+	bool		mmapMode()				{ return fOutputMmap && (!fDuplexMode || fInputMmap); }
+
+	const XRunStats&	inputXRuns()	{ return fInputXRuns; }
+	const XRunStats&	outputXRuns()	{ return fOutputXRuns; }
 
 	AudioInterface(const AudioParam& ap = AudioParam()) : AudioParam(ap)
 	{
@@ -184,6 +289,8 @@ struct AudioInterface : public AudioParam
 		fOutputDevice 			= 0;
 		fInputParams			= 0;
 		fOutputParams			= 0;
+		fInputMmap				= false;
+		fOutputMmap				= false;
 	}
 
 	/**
@@ -198,14 +305,18 @@ struct AudioInterface : public AudioParam
 
 		// setup output device parameters
 		err = snd_pcm_hw_params_malloc(&fOutputParams); check_error(err)
-		setAudioParams(fOutputDevice, fOutputParams);
+		setAudioParams(fOutputDevice, fOutputParams, fOutputMmap, fOutputAccess);
 
 		fCardOutputs = fSoftOutputs;
 		snd_pcm_hw_params_set_channels_near(fOutputDevice, fOutputParams, &fCardOutputs);
+		if (fCardOutputs > MAX_ALSA_CHANNELS) check_error_msg(-EINVAL, "too many output channels");
 		err = snd_pcm_hw_params(fOutputDevice, fOutputParams ); check_error(err);
+		getAudioParams(fOutputParams);
 
-		// allocate alsa output buffers
-		if (fSampleAccess == SND_PCM_ACCESS_RW_INTERLEAVED) {
+		// allocate alsa output buffers (none in mmap mode)
+		if (fOutputMmap) {
+			setSoftParams(fOutputDevice);
+		} else if (fOutputAccess == SND_PCM_ACCESS_RW_INTERLEAVED) {
 			fOutputCardBuffer = calloc(interleavedBufferSize(fOutputParams), 1);
 		} else {
 			for (unsigned int i = 0; i < fCardOutputs; i++) {
@@ -234,13 +345,23 @@ struct AudioInterface : public AudioParam
 			// we have and need an input device
 			// set the number of physical inputs close to what we need
 			err = snd_pcm_hw_params_malloc	( &fInputParams ); 	check_error(err);
-			setAudioParams(fInputDevice, fInputParams);
+			setAudioParams(fInputDevice, fInputParams, fInputMmap, fInputAccess);
 			fCardInputs = fSoftInputs;
 			snd_pcm_hw_params_set_channels_near(fInputDevice, fInputParams, &fCardInputs);
+			if (fCardInputs > MAX_ALSA_CHANNELS) check_error_msg(-EINVAL, "too many input channels");
 			err = snd_pcm_hw_params (fInputDevice,  fInputParams );	 	check_error(err);
 
-			// allocation of alsa buffers
-			if (fSampleAccess == SND_PCM_ACCESS_RW_INTERLEAVED) {
+			// both streams have to use the same period size
+			snd_pcm_uframes_t psize; snd_pcm_hw_params_get_period_size(fInputParams, &psize, NULL);
+			if (psize != fBuffering) check_error_msg(-EINVAL, "input and output period sizes differ");
+			// and are started together when possible
+			err = snd_pcm_link(fInputDevice, fOutputDevice);
+			display_error_msg(err, "input and output streams are not linked");
+
+			// allocation of alsa buffers (none in mmap mode)
+			if (fInputMmap) {
+				setSoftParams(fInputDevice);
+			} else if (fInputAccess == SND_PCM_ACCESS_RW_INTERLEAVED) {
 				fInputCardBuffer = calloc(interleavedBufferSize(fInputParams), 1);
 			} else {
 				for (unsigned int i = 0; i < fCardInputs; i++) {
@@ -253,8 +374,9 @@ struct AudioInterface : public AudioParam
 
 		// allocation of floating point buffers needed by the dsp code
 
-		fChanInputs = max(fSoftInputs, fCardInputs);		assert (fChanInputs < 256);
-		fChanOutputs = max(fSoftOutputs, fCardOutputs);		assert (fChanOutputs < 256);
+		fChanInputs = max(fSoftInputs, fCardInputs);
+		fChanOutputs = max(fSoftOutputs, fCardOutputs);
+		if (fChanInputs > MAX_ALSA_CHANNELS || fChanOutputs > MAX_ALSA_CHANNELS) check_error_msg(-EINVAL, "too many channels");
 
 		for (unsigned int i = 0; i < fChanInputs; i++) {
 			fInputSoftChannels[i] = (float*) calloc (fBuffering, sizeof(float));
@@ -271,7 +393,8 @@ struct AudioInterface : public AudioParam
 		}
 	}
 
-	void setAudioParams(snd_pcm_t* stream, snd_pcm_hw_params_t* params)
+	// mmap and access are the mode chosen for the stream
+	void setAudioParams(snd_pcm_t* stream, snd_pcm_hw_params_t* params, bool& mmap, snd_pcm_access_t& access)
 	{
 		int	err;
 
@@ -279,33 +402,152 @@ struct AudioInterface : public AudioParam
 		err = snd_pcm_hw_params_any(stream, params);
 		check_error_msg(err, "unable to init parameters")
 
-		// set alsa access mode (and fSampleAccess field) either to non interleaved or interleaved
+		// set alsa access mode either to non interleaved or interleaved,
+		// mmaped if possible in mmap mode
 
-		err = snd_pcm_hw_params_set_access(stream, params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
-		if (err) {
-			err = snd_pcm_hw_params_set_access (stream, params, SND_PCM_ACCESS_RW_INTERLEAVED );
-			check_error_msg(err, "unable to set access mode neither to non-interleaved or to interleaved");
+		mmap = fMmap;
+		if (mmap) {
+			err = snd_pcm_hw_params_set_access(stream, params, SND_PCM_ACCESS_MMAP_NONINTERLEAVED );
+			if (err) {
+				err = snd_pcm_hw_params_set_access (stream, params, SND_PCM_ACCESS_MMAP_INTERLEAVED );
+			}
+			display_error_msg(err, "mmap access not available, using read/write access");
+			mmap = (err == 0);
 		}
-		snd_pcm_hw_params_get_access(params, &fSampleAccess);
+		if (!mmap) {
+			err = snd_pcm_hw_params_set_access(stream, params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
+			if (err) {
+				err = snd_pcm_hw_params_set_access (stream, params, SND_PCM_ACCESS_RW_INTERLEAVED );
+				check_error_msg(err, "unable to set access mode neither to non-interleaved or to interleaved");
+			}
+		}
+		snd_pcm_hw_params_get_access(params, &access);
 
-		// search for 32-bits or 16-bits format
+		// search for 32-bits, 16-bits or packed 24-bits format
 		err = snd_pcm_hw_params_set_format (stream, params, SND_PCM_FORMAT_S32);
 		if (err) {
 			err = snd_pcm_hw_params_set_format (stream, params, SND_PCM_FORMAT_S16);
-		 	check_error_msg(err, "unable to set format to either 32-bits or 16-bits");
+			if (err) {
+				err = snd_pcm_hw_params_set_format (stream, params, SND_PCM_FORMAT_S24_3LE);
+			}
+		 	check_error_msg(err, "unable to set format to either 32-bits, 16-bits or 24-bits");
 		}
 		snd_pcm_hw_params_get_format(params, &fSampleFormat);
 		// set sample frequency
 		snd_pcm_hw_params_set_rate_near (stream, params, &fFrequency, 0);
 
-		// set period and period size (buffering)
-		err = snd_pcm_hw_params_set_period_size(stream, params, fBuffering, 0);
+		// set period size (buffering) and number of periods, the nearest values accepted by the device are used
+		snd_pcm_uframes_t psize = fBuffering;
+		int dir = 0;
+		err = snd_pcm_hw_params_set_period_size_near(stream, params, &psize, &dir);
 		check_error_msg(err, "period size not available");
 
-		err = snd_pcm_hw_params_set_periods(stream, params, fPeriods, 0);
+		unsigned int periods = fPeriods;
+		err = snd_pcm_hw_params_set_periods_near(stream, params, &periods, 0);
 		check_error_msg(err, "number of periods not available");
 	}
 
+	// keep the period size and number of periods actually chosen by the device
+	void getAudioParams(snd_pcm_hw_params_t* params)
+	{
+		snd_pcm_uframes_t psize; snd_pcm_hw_params_get_period_size(params, &psize, NULL);
+		unsigned int periods; snd_pcm_hw_params_get_periods(params, &periods, NULL);
+		if (psize != fBuffering || periods != fPeriods) display_error_msg(-EINVAL, "requested period size or number of periods not available, using the nearest values");
+		fBuffering = psize;
+		fPeriods = periods;
+	}
+
+	// wake up every period, streams are explicitly started in mmap mode
+	void setSoftParams(snd_pcm_t* stream)
+	{
+		snd_pcm_sw_params_t* params;
+		snd_pcm_sw_params_alloca(&params);
+		int err = snd_pcm_sw_params_current(stream, params);		check_error(err);
+		err = snd_pcm_sw_params_set_avail_min(stream, params, fBuffering);	check_error(err);
+		err = snd_pcm_sw_params(stream, params);					check_error(err);
+	}
+
+	/**
+	 * Recover from an xrun or a suspend, return false on unrecoverable errors
+	 */
+	bool recover(snd_pcm_t* stream, int err, XRunStats& stats)
+	{
+		if (err == -EPIPE) {
+			stats.fXRuns++;
+		} else if (err == -ESTRPIPE) {
+			stats.fSuspends++;
+		}
+		if (snd_pcm_recover(stream, err, 1) < 0) {
+			stats.fErrors++;
+			return false;
+		}
+		return true;
+	}
+
+	// wait until 'frames' frames are available, starts the stream when needed
+	snd_pcm_sframes_t waitAvailable(snd_pcm_t* stream, snd_pcm_uframes_t frames, XRunStats& stats)
+	{
+		for (;;) {
+			snd_pcm_sframes_t avail = snd_pcm_avail_update(stream);
+			if (avail < 0) {
+				if (!recover(stream, avail, stats)) return avail;
+			} else if (snd_pcm_uframes_t(avail) >= frames) {
+				return avail;
+			} else if (snd_pcm_state(stream) == SND_PCM_STATE_PREPARED) {
+				// capture stream or full playback buffer
+				int err = snd_pcm_start(stream);
+				if (err < 0 && !recover(stream, err, stats)) return err;
+			} else {
+				int err = snd_pcm_wait(stream, 1000);
+				if (err < 0 && !recover(stream, err, stats)) return err;
+			}
+		}
+	}
+
+	template <class SAMPLE>
+	void mmapRead(snd_pcm_t* stream, float** channels, int chans)
+	{
+		snd_pcm_uframes_t done = 0;
+		while (done < fBuffering) {
+			if (waitAvailable(stream, fBuffering - done, fInputXRuns) < 0) return;
+			const snd_pcm_channel_area_t* areas;
+			snd_pcm_uframes_t offset, frames = fBuffering - done;
+			int err = snd_pcm_mmap_begin(stream, &areas, &offset, &frames);
+			if (err < 0) {
+				if (!recover(stream, err, fInputXRuns)) return;
+				continue;
+			}
+			AreaConverter<SAMPLE>::read(areas, offset, channels, done, chans, frames);
+			snd_pcm_sframes_t res = snd_pcm_mmap_commit(stream, offset, frames);
+			if (res < 0 || snd_pcm_uframes_t(res) != frames) {
+				if (!recover(stream, (res < 0) ? res : -EPIPE, fInputXRuns)) return;
+			}
+			done += frames;
+		}
+	}
+
+	template <class SAMPLE>
+	void mmapWrite(snd_pcm_t* stream, float** channels, int chans)
+	{
+		snd_pcm_uframes_t done = 0;
+		while (done < fBuffering) {
+			if (waitAvailable(stream, fBuffering - done, fOutputXRuns) < 0) return;
+			const snd_pcm_channel_area_t* areas;
+			snd_pcm_uframes_t offset, frames = fBuffering - done;
+			int err = snd_pcm_mmap_begin(stream, &areas, &offset, &frames);
+			if (err < 0) {
+				if (!recover(stream, err, fOutputXRuns)) return;
+				continue;
+			}
+			AreaConverter<SAMPLE>::write(channels, done, areas, offset, chans, frames);
+			snd_pcm_sframes_t res = snd_pcm_mmap_commit(stream, offset, frames);
+			if (res < 0 || snd_pcm_uframes_t(res) != frames) {
+				if (!recover(stream, (res < 0) ? res : -EPIPE, fOutputXRuns)) return;
+			}
+			done += frames;
+		}
+	}
+
 	ssize_t interleavedBufferSize (snd_pcm_hw_params_t* params)
 	{
 		_snd_pcm_format 	format;  	snd_pcm_hw_params_get_format(params, &format);
@@ -332,67 +574,55 @@ struct AudioInterface : public AudioParam
 	 */
 	void read()
 	{
-        if (fSampleAccess == SND_PCM_ACCESS_RW_INTERLEAVED) {
+		if (fInputMmap) {
+
+			if (fSampleFormat == SND_PCM_FORMAT_S16) {
+				mmapRead<int16_sample>(fInputDevice, fInputSoftChannels, fCardInputs);
+			} else if (fSampleFormat == SND_PCM_FORMAT_S32) {
+				mmapRead<int32_sample>(fInputDevice, fInputSoftChannels, fCardInputs);
+			} else if (fSampleFormat == SND_PCM_FORMAT_S24_3LE) {
+				mmapRead<int24_sample>(fInputDevice, fInputSoftChannels, fCardInputs);
+			} else {
+				printf("unrecognized input sample format : %u\n", fSampleFormat);
+				exit(1);
+			}
+
+		} else if (fInputAccess == SND_PCM_ACCESS_RW_INTERLEAVED) {
 
 			int count = snd_pcm_readi(fInputDevice, fInputCardBuffer, fBuffering);
 			if (count < 0) {
-				 //display_error_msg(count, "reading samples");
-				 snd_pcm_prepare(fInputDevice);
-				 //check_error_msg(err, "preparing input stream");
+				recover(fInputDevice, count, fInputXRuns);
 			}
 
 			if (fSampleFormat == SND_PCM_FORMAT_S16) {
-
-				short* buffer16b = (short*)fInputCardBuffer;
-				for (unsigned int s = 0; s < fBuffering; s++) {
-					for (unsigned int c = 0; c < fCardInputs; c++) {
-						fInputSoftChannels[c][s] = float(buffer16b[c + s*fCardInputs])*(1.0/float(SHRT_MAX));
-					}
-				}
-
+				deinterleaveSamples<int16_sample>((short*)fInputCardBuffer, fInputSoftChannels, fCardInputs, fBuffering);
 			} else if (fSampleFormat == SND_PCM_FORMAT_S32) {
-
-				int32* buffer32b = (int32*)fInputCardBuffer;
-				for (unsigned int s = 0; s < fBuffering; s++) {
-					for (unsigned int c = 0; c < fCardInputs; c++) {
-						fInputSoftChannels[c][s] = float(buffer32b[c + s*fCardInputs])*(1.0/float(INT_MAX));
-					}
-				}
+				deinterleaveSamples<int32_sample>((int32*)fInputCardBuffer, fInputSoftChannels, fCardInputs, fBuffering);
+			} else if (fSampleFormat == SND_PCM_FORMAT_S24_3LE) {
+				deinterleaveSamples<int24_sample>((int24_t*)fInputCardBuffer, fInputSoftChannels, fCardInputs, fBuffering);
 			} else {
-
 				printf("unrecognized input sample format : %u\n", fSampleFormat);
 				exit(1);
 			}
 
-		} else if (fSampleAccess == SND_PCM_ACCESS_RW_NONINTERLEAVED) {
+		} else if (fInputAccess == SND_PCM_ACCESS_RW_NONINTERLEAVED) {
 
 			int count = snd_pcm_readn(fInputDevice, fInputCardChannels, fBuffering);
 			if (count < 0) {
-				 //display_error_msg(count, "reading samples");
-				 snd_pcm_prepare(fInputDevice);
-				 //check_error_msg(err, "preparing input stream");
+				recover(fInputDevice, count, fInputXRuns);
 			}
 
-			if (fSampleFormat == SND_PCM_FORMAT_S16) {
-
-				for (unsigned int c = 0; c < fCardInputs; c++) {
-					short* chan16b = (short*)fInputCardChannels[c];
-					for (unsigned int s = 0; s < fBuffering; s++) {
-						fInputSoftChannels[c][s] = float(chan16b[s])*(1.0/float(SHRT_MAX));
-					}
-				}
-
-			} else if (fSampleFormat == SND_PCM_FORMAT_S32) {
-
-				for (unsigned int c = 0; c < fCardInputs; c++) {
-					int32* chan32b = (int32*)fInputCardChannels[c];
-					for (unsigned int s = 0; s < fBuffering; s++) {
-						fInputSoftChannels[c][s] = float(chan32b[s])*(1.0/float(INT_MAX));
-					}
+			for (unsigned int c = 0; c < fCardInputs; c++) {
+				if (fSampleFormat == SND_PCM_FORMAT_S16) {
+					deinterleaveSamples<int16_sample>((short*)fInputCardChannels[c], &fInputSoftChannels[c], 1, fBuffering);
+				} else if (fSampleFormat == SND_PCM_FORMAT_S32) {
+					deinterleaveSamples<int32_sample>((int32*)fInputCardChannels[c], &fInputSoftChannels[c], 1, fBuffering);
+				} else if (fSampleFormat == SND_PCM_FORMAT_S24_3LE) {
+					deinterleaveSamples<int24_sample>((int24_t*)fInputCardChannels[c], &fInputSoftChannels[c], 1, fBuffering);
+				} else {
+					printf("unrecognized input sample format : %u\n", fSampleFormat);
+					exit(1);
 				}
-			} else {
-				printf("unrecognized input sample format : %u\n", fSampleFormat);
-				exit(1);
 			}
 
 		} else {
@@ -408,76 +638,56 @@ struct AudioInterface : public AudioParam
 	{
 		recovery :
 
-		if (fSampleAccess == SND_PCM_ACCESS_RW_INTERLEAVED) {
+		if (fOutputMmap) {
 
 			if (fSampleFormat == SND_PCM_FORMAT_S16) {
+				mmapWrite<int16_sample>(fOutputDevice, fOutputSoftChannels, fCardOutputs);
+			} else if (fSampleFormat == SND_PCM_FORMAT_S32) {
+				mmapWrite<int32_sample>(fOutputDevice, fOutputSoftChannels, fCardOutputs);
+			} else if (fSampleFormat == SND_PCM_FORMAT_S24_3LE) {
+				mmapWrite<int24_sample>(fOutputDevice, fOutputSoftChannels, fCardOutputs);
+			} else {
+				printf("unrecognized output sample format : %u\n", fSampleFormat);
+				exit(1);
+			}
 
-				short* buffer16b = (short*)fOutputCardBuffer;
-				for (unsigned int f = 0; f < fBuffering; f++) {
-					for (unsigned int c = 0; c < fCardOutputs; c++) {
-						float x = fOutputSoftChannels[c][f];
-						buffer16b[c + f*fCardOutputs] = short( max(min(x,1.0f),-1.0f) * float(SHRT_MAX) ) ;
-					}
-				}
-
-			} else if (fSampleFormat == SND_PCM_FORMAT_S32)  {
+		} else if (fOutputAccess == SND_PCM_ACCESS_RW_INTERLEAVED) {
 
-				int32* buffer32b = (int32*)fOutputCardBuffer;
-				for (unsigned int f = 0; f < fBuffering; f++) {
-					for (unsigned int c = 0; c < fCardOutputs; c++) {
-						float x = fOutputSoftChannels[c][f];
-						buffer32b[c + f*fCardOutputs] = int( max(min(x,1.0f),-1.0f) * float(INT_MAX) ) ;
-					}
-				}
+			if (fSampleFormat == SND_PCM_FORMAT_S16) {
+				interleaveSamples<int16_sample>(fOutputSoftChannels, (short*)fOutputCardBuffer, fCardOutputs, fBuffering);
+			} else if (fSampleFormat == SND_PCM_FORMAT_S32) {
+				interleaveSamples<int32_sample>(fOutputSoftChannels, (int32*)fOutputCardBuffer, fCardOutputs, fBuffering);
+			} else if (fSampleFormat == SND_PCM_FORMAT_S24_3LE) {
+				interleaveSamples<int24_sample>(fOutputSoftChannels, (int24_t*)fOutputCardBuffer, fCardOutputs, fBuffering);
 			} else {
-
 				printf("unrecognized output sample format : %u\n", fSampleFormat);
 				exit(1);
 			}
 
 			int count = snd_pcm_writei(fOutputDevice, fOutputCardBuffer, fBuffering);
 			if (count<0) {
-				//display_error_msg(count, "w3");
-				snd_pcm_prepare(fOutputDevice);
-				//check_error_msg(err, "preparing output stream");
-				goto recovery;
+				if (recover(fOutputDevice, count, fOutputXRuns)) goto recovery;
 			}
 
 
-		} else if (fSampleAccess == SND_PCM_ACCESS_RW_NONINTERLEAVED) {
-
-			if (fSampleFormat == SND_PCM_FORMAT_S16) {
-
-				for (unsigned int c = 0; c < fCardOutputs; c++) {
-					short* chan16b = (short*) fOutputCardChannels[c];
-					for (unsigned int f = 0; f < fBuffering; f++) {
-						float x = fOutputSoftChannels[c][f];
-						chan16b[f] = short( max(min(x,1.0f),-1.0f) * float(SHRT_MAX) ) ;
-					}
-				}
-
-			} else if (fSampleFormat == SND_PCM_FORMAT_S32) {
+		} else if (fOutputAccess == SND_PCM_ACCESS_RW_NONINTERLEAVED) {
 
-				for (unsigned int c = 0; c < fCardOutputs; c++) {
-					int32* chan32b = (int32*) fOutputCardChannels[c];
-					for (unsigned int f = 0; f < fBuffering; f++) {
-						float x = fOutputSoftChannels[c][f];
-						chan32b[f] = int( max(min(x,1.0f),-1.0f) * float(INT_MAX) ) ;
-					}
+			for (unsigned int c = 0; c < fCardOutputs; c++) {
+				if (fSampleFormat == SND_PCM_FORMAT_S16) {
+					interleaveSamples<int16_sample>(&fOutputSoftChannels[c], (short*)fOutputCardChannels[c], 1, fBuffering);
+				} else if (fSampleFormat == SND_PCM_FORMAT_S32) {
+					interleaveSamples<int32_sample>(&fOutputSoftChannels[c], (int32*)fOutputCardChannels[c], 1, fBuffering);
+				} else if (fSampleFormat == SND_PCM_FORMAT_S24_3LE) {
+					interleaveSamples<int24_sample>(&fOutputSoftChannels[c], (int24_t*)fOutputCardChannels[c], 1, fBuffering);
+				} else {
+					printf("unrecognized output sample format : %u\n", fSampleFormat);
+					exit(1);
 				}
-
-			} else {
-
-				printf("unrecognized output sample format : %u\n", fSampleFormat);
-				exit(1);
 			}
 
 			int count = snd_pcm_writen(fOutputDevice, fOutputCardChannels, fBuffering);
 			if (count<0) {
-				//display_error_msg(count, "w3");
-				snd_pcm_prepare(fOutputDevice);
-				//check_error_msg(err, "preparing output stream");
-				goto recovery;
+				if (recover(fOutputDevice, count, fOutputXRuns)) goto recovery;
 			}
 
 		} else {
@@ -485,6 +695,12 @@ struct AudioInterface : public AudioParam
 		}
 	}
 
+	const char* accessName()
+	{
+		if (fDuplexMode && fInputMmap != fOutputMmap) return fOutputMmap ? "mmap out/rw in" : "rw out/mmap in";
+		return fOutputMmap ? "mmap" : "rw";
+	}
+
 	/**
 	 *  print short information on the audio device
 	 */
@@ -493,13 +709,16 @@ struct AudioInterface : public AudioParam
 		int						err;
 		snd_ctl_card_info_t*	card_info;
     	snd_ctl_t*				ctl_handle;
-		err = snd_ctl_open (&ctl_handle, fCardName, 0);		check_error(err);
+		const char*				driver = fCardName;		// software PCMs have no control interface
 		snd_ctl_card_info_alloca (&card_info);
-		err = snd_ctl_card_info(ctl_handle, card_info);		check_error(err);
-		printf("%s|%d|%d|%d|%d|%s\n",
-				snd_ctl_card_info_get_driver(card_info),
+		if (snd_ctl_open (&ctl_handle, fCardName, 0) == 0) {
+			err = snd_ctl_card_info(ctl_handle, card_info);		check_error(err);
+			driver = snd_ctl_card_info_get_driver(card_info);
+		}
+		printf("%s|%s|%d|%d|%d|%d|%d|%s\n",
+				driver, accessName(),
 				fCardInputs, fCardOutputs,
-				fFrequency, fBuffering,
+				fFrequency, fBuffering, fPeriods,
 				snd_pcm_format_name((_snd_pcm_format)fSampleFormat));
 	}
 
@@ -513,23 +732,33 @@ struct AudioInterface : public AudioParam
     	snd_ctl_t*				ctl_handle;
 
 		printf("Audio Interface Description :\n");
-		printf("Sampling Frequency : %d, Sample Format : %s, buffering : %d\n",
-				fFrequency, snd_pcm_format_name((_snd_pcm_format)fSampleFormat), fBuffering);
+		printf("Sampling Frequency : %d, Sample Format : %s, buffering : %d, periods : %d, access : %s\n",
+				fFrequency, snd_pcm_format_name((_snd_pcm_format)fSampleFormat), fBuffering, fPeriods, accessName());
 		printf("Software inputs : %2d, Software outputs : %2d\n", fSoftInputs, fSoftOutputs);
 		printf("Hardware inputs : %2d, Hardware outputs : %2d\n", fCardInputs, fCardOutputs);
 		printf("Channel inputs  : %2d, Channel outputs  : %2d\n", fChanInputs, fChanOutputs);
 
 		// affichage des infos de la carte
-		err = snd_ctl_open (&ctl_handle, fCardName, 0);		check_error(err);
-		snd_ctl_card_info_alloca (&card_info);
-		err = snd_ctl_card_info(ctl_handle, card_info);		check_error(err);
-		printCardInfo(card_info);
+		if (snd_ctl_open (&ctl_handle, fCardName, 0) == 0) {
+			snd_ctl_card_info_alloca (&card_info);
+			err = snd_ctl_card_info(ctl_handle, card_info);		check_error(err);
+			printCardInfo(card_info);
+		}
 
 		// affichage des infos liees aux streams d'entree-sortie
 		if (fSoftInputs > 0)	printHWParams(fInputParams);
 		if (fSoftOutputs > 0)	printHWParams(fOutputParams);
 	}
 
+	/**
+	 *  print the xruns statistics
+	 */
+	void xrunsinfo()
+	{
+		printf("Input  xruns : %u, suspends : %u, errors : %u\n", fInputXRuns.fXRuns, fInputXRuns.fSuspends, fInputXRuns.fErrors);
+		printf("Output xruns : %u, suspends : %u, errors : %u\n", fOutputXRuns.fXRuns, fOutputXRuns.fSuspends, fOutputXRuns.fErrors);
+	}
+
 	void printCardInfo(snd_ctl_card_info_t*	ci)
 	{
 		printf("Card info (address : %p)\n", ci);
@@ -630,22 +859,34 @@ class alsaaudio : public audio
 {
 	AudioInterface*	fAudio;
 	dsp* 			fDSP;
+	monitor_dsp*	fMonitor;		// the DSP when it is instrumented
+	unsigned int	fXRuns;
 	pthread_t 		fAudioThread;
 	bool 			fRunning;
 
+	// notify the new xruns to the monitor
+	void checkXRuns()
+	{
+		unsigned int xruns = fAudio->inputXRuns().fXRuns + fAudio->outputXRuns().fXRuns;
+		for (; fXRuns < xruns; fXRuns++) {
+			if (fMonitor) fMonitor->xrun();
+		}
+	}
+
  public:
 
-    alsaaudio(int argc, char *argv[], dsp* DSP) : fDSP(DSP), fRunning(false)
+    alsaaudio(int argc, char *argv[], dsp* DSP) : fDSP(DSP), fMonitor(0), fXRuns(0), fRunning(false)
     {
         fAudio = new AudioInterface(AudioParam().cardName(sopt(argc, argv, "--device", "-d", getDefaultEnv("FAUST2ALSA_DEVICE", "hw:0")))
             .frequency(lopt(argc, argv, "--frequency", "-f", getDefaultEnv("FAUST2ALSA_FREQUENCY", 44100)))
             .buffering(lopt(argc, argv, "--buffer", "-b", getDefaultEnv("FAUST2ALSA_BUFFER", 512)))
             .periods(lopt(argc, argv, "--periods", "-p", getDefaultEnv("FAUST2ALSA_PERIODS", 2)))
+            .mmap(fopt(argc, argv, "--mmap", "-m") || getDefaultEnv("FAUST2ALSA_MMAP", 0))
             .inputs(DSP->getNumInputs())
             .outputs(DSP->getNumOutputs()));
     }
     
-    alsaaudio(int srate, int bsize) : fDSP(0), fRunning(false)
+    alsaaudio(int srate, int bsize) : fDSP(0), fMonitor(0), fXRuns(0), fRunning(false)
     {
         fAudio = new AudioInterface(AudioParam().cardName("hw:0")
                                     .frequency(srate)
@@ -657,6 +898,8 @@ class alsaaudio : public audio
 
 	virtual bool init(const char */*name*/, dsp* DSP)
     {
+        fDSP = DSP;
+        fMonitor = dynamic_cast<monitor_dsp*>(DSP);
         fAudio->inputs(DSP->getNumInputs());
         fAudio->outputs(DSP->getNumOutputs());
 		fAudio->open();
@@ -678,6 +921,7 @@ class alsaaudio : public audio
         if (fRunning) {
             fRunning = false;
             pthread_join(fAudioThread, 0);
+            fAudio->xrunsinfo();
         }
     }
     
@@ -696,12 +940,14 @@ class alsaaudio : public audio
 				fAudio->read();
 				fDSP->compute(fAudio->buffering(), fAudio->inputSoftChannels(), fAudio->outputSoftChannels());
 				fAudio->write();
+				checkXRuns();
 			}
         } else {
             fAudio->write();
 			while (fRunning) {
 				fDSP->compute(fAudio->buffering(), fAudio->inputSoftChannels(), fAudio->outputSoftChannels());
 				fAudio->write();
+				checkXRuns();
 			}
 		}
 	}
@@ -29,8 +29,11 @@
 #include <stdio.h>
 #include <iostream>
 #include <iomanip>
+#include <vector>
+#include <chrono>
 			
 #include "faust/dsp/dsp.h"
+#include "faust/dsp/dsp-monitor.h"
 #include "faust/audio/audio.h"
 
 #define BUFFER_TO_RENDER 10
@@ -50,12 +53,16 @@ class dummyaudio : public audio {
         int fCount;
         bool fIsSample;
 
+        load_monitor* fMonitor;         // callbacks durations, when set
+        std::vector<double> fScenario;  // callbacks loads to replay, in fraction of the period
+        size_t fCallback;
+
     public:
 
         dummyaudio(int sr, int bs, int count = 10, bool sample = false)
-            :fSampleRate(sr), fBufferSize(bs), fCount(count), fIsSample(sample) {}
+            :fSampleRate(sr), fBufferSize(bs), fCount(count), fIsSample(sample), fMonitor(0), fCallback(0) {}
         dummyaudio(int count = 10)
-            :fSampleRate(48000), fBufferSize(512), fCount(count) {}
+            :fSampleRate(48000), fBufferSize(512), fCount(count), fIsSample(false), fMonitor(0), fCallback(0) {}
     
         virtual ~dummyaudio() 
         {
@@ -101,7 +108,20 @@ class dummyaudio : public audio {
 
         void render()
         {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
             fDSP->compute(fBufferSize, fInChannel, fOutChannel);
+            
+            double period = double(fBufferSize) * 1e6 / double(fSampleRate);
+            if (fScenario.size() > 0) {
+                // The callback lasts at least the scenario load
+                double load = fScenario[fCallback++ % fScenario.size()];
+                std::chrono::steady_clock::time_point end = start + std::chrono::microseconds((long long)(load * period));
+                while (std::chrono::steady_clock::now() < end) {}
+            }
+            if (fMonitor) {
+                fMonitor->record(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count(), period);
+            }
+            
             if (fDSP->getNumInputs() > 0) {
                 if (fIsSample) {
                     for (int frame = 0; frame < fBufferSize; frame++) {
@@ -124,6 +144,11 @@ class dummyaudio : public audio {
     
         void setCount(int count) { fCount = count; }
         int getCount() { return fCount; }
+    
+        // Measure the callbacks durations in 'monitor'
+        void setMonitor(load_monitor* monitor) { fMonitor = monitor; }
+        // Replay a timing scenario : callback i lasts at least loads[i % loads.size()] periods
+        void setScenario(const std::vector<double>& loads) { fScenario = loads; fCallback = 0; }
 
         virtual int getBufferSize() { return fBufferSize; }
         virtual int getSampleRate() { return fSampleRate; }
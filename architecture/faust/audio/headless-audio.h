@@ -0,0 +1,324 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __headless_audio__
+#define __headless_audio__
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#include "faust/audio/audio.h"
+#include "faust/dsp/dsp.h"
+#include "faust/dsp/dsp-monitor.h"
+#include "faust/dsp/timed-dsp.h"
+#include "faust/gui/DecoratorUI.h"
+
+/**
+ * Headless driver for load testing: runs several instances of a DSP (clones of the given one)
+ * as fast as possible or at a multiple of real time, without any audio device.
+ *
+ * - inputs are silent, white noise, or read from a raw file (interleaved 32 bits floats, looped)
+ * - with simulated control traffic, the instances are wrapped in 'timed_dsp' and receive
+ *   random dated values for their active widgets through the GUI control bus at each buffer
+ * - the duration of each cycle (all instances computing one buffer) is recorded in a load_monitor,
+ *   the deadline being the buffer duration divided by the speed
+ * - sustainedInstances() searches the number of instances that can be computed before
+ *   the deadline is missed
+ */
+
+class headlessaudio : public audio {
+
+    public:
+
+        enum { kSilence, kNoise, kFile };
+
+    private:
+
+        // Active widgets zones and ranges
+        struct ControlZones : public GenericUI {
+
+            struct control { FAUSTFLOAT* fZone; FAUSTFLOAT fMin; FAUSTFLOAT fMax; };
+            std::vector<control> fControls;
+
+            void add(FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max)
+            {
+                control c = { zone, min, max };
+                fControls.push_back(c);
+            }
+
+            void addButton(const char* label, FAUSTFLOAT* zone) { add(zone, 0, 1); }
+            void addCheckButton(const char* label, FAUSTFLOAT* zone) { add(zone, 0, 1); }
+            void addVerticalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step)
+            {
+                add(zone, min, max);
+            }
+            void addHorizontalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step)
+            {
+                add(zone, min, max);
+            }
+            void addNumEntry(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step)
+            {
+                add(zone, min, max);
+            }
+        };
+
+        dsp* fDSP;                              // the prototype, not computed
+        std::vector<dsp*> fInstances;
+        std::vector<ControlZones*> fZones;
+        std::vector<FAUSTFLOAT**> fOutputs;     // one set of outputs per instance
+        FAUSTFLOAT** fInputs;                   // shared by the instances
+        int fNumInputs;
+        int fNumOutputs;
+        int fRequested;                         // number of instances to allocate at 'init'
+
+        int fSampleRate;
+        int fBufferSize;
+        double fSpeed;                          // multiple of real time, 0 to run as fast as possible
+        int fBuffers;                           // number of buffers rendered by 'start'
+        int fInputMode;
+        std::vector<float> fFile;
+        size_t fFilePos;
+        int fControls;                          // controls per buffer and instance
+        unsigned int fSeed;
+
+        load_monitor fMonitor;
+
+        float random()
+        {
+            fSeed = fSeed * 1103515245 + 12345;
+            return float(fSeed >> 8) / float(1 << 24);
+        }
+
+        void allocate(int instances)
+        {
+            while (int(fInstances.size()) < instances) {
+                dsp* instance = fDSP->clone();
+                ControlZones* zones = new ControlZones();
+                if (fControls > 0) instance = new timed_dsp(instance);
+                instance->init(fSampleRate);
+                instance->buildUserInterface(zones);
+                FAUSTFLOAT** outputs = new FAUSTFLOAT*[fNumOutputs];
+                for (int chan = 0; chan < fNumOutputs; chan++) {
+                    outputs[chan] = new FAUSTFLOAT[fBufferSize];
+                    memset(outputs[chan], 0, sizeof(FAUSTFLOAT) * fBufferSize);
+                }
+                fInstances.push_back(instance);
+                fZones.push_back(zones);
+                fOutputs.push_back(outputs);
+            }
+            while (int(fInstances.size()) > instances) {
+                delete fInstances.back();
+                delete fZones.back();
+                for (int chan = 0; chan < fNumOutputs; chan++) {
+                    delete [] fOutputs.back()[chan];
+                }
+                delete [] fOutputs.back();
+                fInstances.pop_back();
+                fZones.pop_back();
+                fOutputs.pop_back();
+            }
+        }
+
+        void fillInputs()
+        {
+            int chans = fNumInputs;
+            if (fInputMode == kNoise) {
+                for (int chan = 0; chan < chans; chan++) {
+                    for (int frame = 0; frame < fBufferSize; frame++) {
+                        fInputs[chan][frame] = FAUSTFLOAT(random() * 2.f - 1.f);
+                    }
+                }
+            } else if (fInputMode == kFile && fFile.size() >= size_t(chans)) {
+                for (int frame = 0; frame < fBufferSize; frame++) {
+                    if (fFilePos + chans > fFile.size()) fFilePos = 0;
+                    for (int chan = 0; chan < chans; chan++) {
+                        fInputs[chan][frame] = FAUSTFLOAT(fFile[fFilePos++]);
+                    }
+                }
+            }
+        }
+
+        // Random values at random dates, in frames
+        void sendControls(int instance)
+        {
+            std::vector<ControlZones::control>& controls = fZones[instance]->fControls;
+            if (controls.size() == 0) return;
+            ControlGroup group(GUI::controlBus());
+            for (int i = 0; i < fControls; i++) {
+                ControlZones::control& c = controls[size_t(random() * controls.size()) % controls.size()];
+                GUI::controlBus().write(c.fZone, c.fMin + (c.fMax - c.fMin) * random(), double(int(random() * fBufferSize)));
+            }
+        }
+
+        // Compute one buffer with all instances, return the duration in usec
+        double cycle()
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            fillInputs();
+            for (size_t i = 0; i < fInstances.size(); i++) {
+                if (fControls > 0) {
+                    sendControls(int(i));
+                    fInstances[i]->compute(-1, fBufferSize, fInputs, fOutputs[i]);
+                } else {
+                    fInstances[i]->compute(fBufferSize, fInputs, fOutputs[i]);
+                }
+            }
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        double deadline()
+        {
+            return double(fBufferSize) * 1e6 / double(fSampleRate) / ((fSpeed > 0.) ? fSpeed : 1.);
+        }
+
+    public:
+
+        headlessaudio(int sr, int bs, double speed = 0., int instances = 1, int buffers = 1000)
+            :fDSP(0), fInputs(0), fNumInputs(0), fNumOutputs(0), fRequested(instances), fSampleRate(sr), fBufferSize(bs), fSpeed(speed),
+            fBuffers(buffers), fInputMode(kSilence), fFilePos(0), fControls(0), fSeed(1)
+        {}
+
+        // The prototype DSP may already be deleted
+        virtual ~headlessaudio()
+        {
+            if (fDSP) {
+                allocate(0);
+                for (int chan = 0; chan < fNumInputs; chan++) {
+                    delete [] fInputs[chan];
+                }
+                delete [] fInputs;
+            }
+        }
+
+        // To be called before 'init'
+        void setControls(int controls) { fControls = controls; }
+
+        void setSpeed(double speed) { fSpeed = speed; }
+        void setBuffers(int buffers) { fBuffers = buffers; }
+        void setNoise() { fInputMode = kNoise; }
+        bool setInputFile(const char* filename)
+        {
+            FILE* file = fopen(filename, "rb");
+            if (!file) return false;
+            float buffer[4096];
+            size_t n;
+            while ((n = fread(buffer, sizeof(float), 4096, file)) > 0) {
+                fFile.insert(fFile.end(), buffer, buffer + n);
+            }
+            fclose(file);
+            fInputMode = kFile;
+            fFilePos = 0;
+            return true;
+        }
+
+        void setInstances(int instances)
+        {
+            fRequested = instances;
+            if (fDSP) allocate(instances);
+        }
+        int getInstances() { return int(fInstances.size()); }
+
+        load_monitor& getMonitor() { return fMonitor; }
+
+        virtual bool init(const char* name, dsp* dsp)
+        {
+            fDSP = dsp;
+            fDSP->init(fSampleRate);
+            fNumInputs = fDSP->getNumInputs();
+            fNumOutputs = fDSP->getNumOutputs();
+            fInputs = new FAUSTFLOAT*[fNumInputs];
+            for (int chan = 0; chan < fNumInputs; chan++) {
+                fInputs[chan] = new FAUSTFLOAT[fBufferSize];
+                memset(fInputs[chan], 0, sizeof(FAUSTFLOAT) * fBufferSize);
+            }
+            allocate(fRequested);
+            return true;
+        }
+
+        /**
+         * Render 'buffers' cycles, paced at the speed multiple of real time when the speed is not null.
+         */
+        void run(int buffers)
+        {
+            double period = deadline();
+            std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+            for (int i = 0; i < buffers; i++) {
+                fMonitor.record(cycle(), period);
+                if (fSpeed > 0.) {
+                    next += std::chrono::microseconds((long long)period);
+                    std::this_thread::sleep_until(next);
+                }
+            }
+        }
+
+        /**
+         * Search the number of instances that can be computed before the deadline,
+         * for at least 'percentile' % of the 'buffers' cycles (computed as fast as possible,
+         * the deadline being the buffer duration divided by the speed).
+         *
+         * @return the number of instances (at most 'max'), 0 if even one instance misses the deadline
+         */
+        int sustainedInstances(int max, int buffers, double percentile = 99.9, bool verbose = true)
+        {
+            double period = deadline();
+            int low = 0, high = max + 1;    // 'low' instances are sustained, 'high' are not
+            int n = 1;
+            while (low + 1 < high) {
+                allocate(n);
+                fMonitor.reset();
+                for (int i = 0; i < buffers; i++) fMonitor.record(cycle(), period);
+                dsp_load load = fMonitor.getLoad();
+                bool sustained = load.percentile(percentile) <= 1.;
+                if (verbose) {
+                    printf("%d instance(s) : mean load %.1f%%, p%g %.1f%%, max %.1f%% : %s\n",
+                           n, load.fMean * 100., percentile, load.percentile(percentile) * 100., load.fMax * 100., sustained ? "OK" : "missed");
+                }
+                if (sustained) low = n; else high = n;
+                // Double until the deadline is missed, then bisect
+                n = (high > max) ? std::min(low * 2, max) : (low + high) / 2;
+            }
+            allocate(fRequested);
+            return low;
+        }
+
+        virtual bool start()
+        {
+            run(fBuffers);
+            return true;
+        }
+
+        virtual void stop()
+        {}
+
+        virtual int getBufferSize() { return fBufferSize; }
+        virtual int getSampleRate() { return fSampleRate; }
+
+        virtual int getNumInputs() { return fNumInputs; }
+        virtual int getNumOutputs() { return fNumOutputs; }
+
+};
+
+#endif
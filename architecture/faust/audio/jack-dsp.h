@@ -37,6 +37,7 @@
 #include "faust/audio/audio.h"
 #include "faust/dsp/dsp.h"
 #include "faust/dsp/dsp-adapter.h"
+#include "faust/dsp/dsp-monitor.h"
 #include "faust/midi/jack-midi.h"
 
 #if defined(_WIN32) && !defined(__MINGW32__)
@@ -56,6 +57,7 @@ class jackaudio : public audio {
     protected:
 
         dsp*			fDSP;               // FAUST DSP
+        monitor_dsp*    fMonitor;           // FAUST DSP when it is instrumented
         jack_client_t*	fClient;            // JACK client
 
         std::vector<jack_port_t*>	fInputPorts;        // JACK input ports
@@ -92,6 +94,13 @@ class jackaudio : public audio {
             return static_cast<jackaudio*>(arg)->process(nframes);
         }
 
+        static int _jack_xrun(void* arg)
+        {
+            jackaudio* audio = static_cast<jackaudio*>(arg);
+            if (audio->fMonitor) audio->fMonitor->xrun();
+            return 0;
+        }
+
         static int _jack_buffersize(jack_nframes_t nframes, void* arg)
         {
             fprintf(stdout, "The buffer size is now %u/sec\n", nframes);
@@ -197,7 +206,7 @@ class jackaudio : public audio {
     public:
 
         jackaudio(const void* icon_data = 0, size_t icon_size = 0, bool auto_connect = true)
-            : fDSP(0), fClient(0), fShutdown(0), fShutdownArg(0), fAutoConnect(auto_connect)
+            : fDSP(0), fMonitor(0), fClient(0), fShutdown(0), fShutdownArg(0), fAutoConnect(auto_connect)
         {
             if (icon_data) {
                 fIconData = malloc(icon_size);
@@ -256,6 +265,7 @@ class jackaudio : public audio {
 
             jack_set_sample_rate_callback(fClient, _jack_srate, this);
             jack_set_buffer_size_callback(fClient, _jack_buffersize, this);
+            jack_set_xrun_callback(fClient, _jack_xrun, this);
             jack_on_info_shutdown(fClient, _jack_info_shutdown, this);
 
             // Get Physical inputs
@@ -350,6 +360,7 @@ class jackaudio : public audio {
         {
             // Warning: possible memory leak here... 
             fDSP = (sizeof(FAUSTFLOAT) == 8) ? (new dsp_sample_adapter<double, float>(dsp)) : dsp;
+            fMonitor = dynamic_cast<monitor_dsp*>(dsp);
 
             for (int i = 0; i < fDSP->getNumInputs(); i++) {
                 char buf[256];
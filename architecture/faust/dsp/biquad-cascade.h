@@ -0,0 +1,194 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __biquad_cascade__
+#define __biquad_cascade__
+
+#include <algorithm>
+
+/**
+ * Cascade of S second order sections, used by the code generated with the -bq option.
+ *
+ * Stage 0 is the input signal, each stage s (1..S) is computed from the last
+ * three values of the previous stage and the last two values of its own :
+ *
+ *     w[s](n) = gb.(b0.w[s-1](n) + b1.w[s-1](n-1) + b2.w[s-1](n-2)) - ga.(a1.w[s](n-1) + a2.w[s](n-2))
+ *
+ * The gains gb and ga are the factors common to the coefficients in the DSP code : they
+ * are applied to the sums the same way as in the sample by sample code, so that the
+ * rounding errors are the same in single precision.
+ *
+ * Computed sample by sample, each stage has to wait for the previous one. The
+ * block is computed in skewed order instead : at step t, stage s computes the
+ * sample t-s, so the stages of a step are independent and their computations
+ * overlap. The whole block is still computed when compute() returns : no
+ * latency is added. The state is kept in local variables during the block.
+ *
+ * The generated code reads the output sample by sample (start/sample/finish) :
+ * the input block is filtered by chunks of kChunk samples in a fixed buffer,
+ * so that nothing is allocated on the audio thread whatever the block size.
+ */
+template <typename REAL, int S, typename IN = float>
+class biquad_cascade {
+
+    public:
+
+        enum { kChunk = 256 };
+
+    private:
+
+        REAL fCoefs[7*(S+1)];               // gb b0 b1 b2 ga a1 a2 of the stages (stage 0 unused)
+        REAL fState[3*(S+1)];               // last three values of the stages
+        REAL fOutput[kChunk];               // last stage of the current chunk
+        const IN* fInput;                   // block being read
+        int fCount;
+        int fBegin, fEnd;                   // current chunk in the block
+
+        // Filter the next chunk of the block
+        void fill()
+        {
+            fBegin = fEnd;
+            int count = std::min(int(kChunk), fCount - fBegin);
+            compute(count, fInput + fBegin, fOutput);
+            fEnd = fBegin + count;
+        }
+
+        // One step, from the last stage to the first one : stage s reads stage s-1 before it is updated.
+        // With GUARD, only the stages that have a sample of the block to compute are updated.
+        template <bool GUARD>
+        static inline void step(int t, int count, const REAL* c, REAL* w0, REAL* w1, REAL* w2)
+        {
+            for (int s = S; s >= 1; s--) {
+                if (GUARD && (t < s || t - s >= count)) continue;
+                const REAL* k = &c[7*s];
+                REAL w = k[0]*(k[1]*w0[s-1] + k[2]*w1[s-1] + k[3]*w2[s-1]) - k[4]*(k[5]*w0[s] + k[6]*w1[s]);
+                w2[s] = w1[s];
+                w1[s] = w0[s];
+                w0[s] = w;
+            }
+        }
+
+    public:
+
+        biquad_cascade()
+        {
+            init();
+        }
+
+        /**
+         * Set all the coefficients to zero and reset the state.
+         */
+        void init()
+        {
+            std::fill(fCoefs, fCoefs + 7*(S+1), REAL(0));
+            fInput = 0;
+            fCount = fBegin = fEnd = 0;
+            clear();
+        }
+
+        /**
+         * Set the coefficients of stage s (1..S).
+         */
+        void setStage(int s, REAL b0, REAL b1, REAL b2, REAL a1, REAL a2)
+        {
+            setStage(s, REAL(1), b0, b1, b2, REAL(1), a1, a2);
+        }
+
+        /**
+         * Set the coefficients of stage s (1..S) with the gains of the feedforward and feedback sums.
+         */
+        void setStage(int s, REAL gb, REAL b0, REAL b1, REAL b2, REAL ga, REAL a1, REAL a2)
+        {
+            REAL* k = &fCoefs[7*s];
+            k[0] = gb; k[1] = b0; k[2] = b1; k[3] = b2; k[4] = ga; k[5] = a1; k[6] = a2;
+        }
+
+        /**
+         * Reset the state of the stages.
+         */
+        void clear()
+        {
+            std::fill(fState, fState + 3*(S+1), REAL(0));
+        }
+
+        /**
+         * Filter a block of 'count' input samples, the last stage is written in 'output'.
+         */
+        template <typename T>
+        void compute(int count, const T* input, REAL* output)
+        {
+            REAL c[7*(S+1)];
+            REAL w0[S+1], w1[S+1], w2[S+1];
+            std::copy(fCoefs, fCoefs + 7*(S+1), c);
+            for (int s = 0; s <= S; s++) {
+                w0[s] = fState[3*s]; w1[s] = fState[3*s+1]; w2[s] = fState[3*s+2];
+            }
+            REAL* out = output;
+            for (int t = 0; t < count + S; t++) {
+                if (t >= S && t < count) {
+                    step<false>(t, count, c, w0, w1, w2);
+                } else {
+                    step<true>(t, count, c, w0, w1, w2);
+                }
+                if (t < count) {
+                    w2[0] = w1[0];
+                    w1[0] = w0[0];
+                    w0[0] = REAL(input[t]);
+                }
+                if (t >= S) out[t-S] = w0[S];
+            }
+            for (int s = 0; s <= S; s++) {
+                fState[3*s] = w0[s]; fState[3*s+1] = w1[s]; fState[3*s+2] = w2[s];
+            }
+        }
+
+        /**
+         * Start reading a block of 'count' input samples.
+         */
+        void start(int count, const IN* input)
+        {
+            fInput = input;
+            fCount = count;
+            fBegin = fEnd = 0;
+        }
+
+        /**
+         * Last stage for the sample i of the block, i has to increase during the block.
+         */
+        inline REAL sample(int i)
+        {
+            while (i >= fEnd) fill();
+            return fOutput[i - fBegin];
+        }
+
+        /**
+         * Filter the samples of the block that were not read, to keep the state.
+         */
+        void finish()
+        {
+            while (fEnd < fCount) fill();
+        }
+
+};
+
+#endif
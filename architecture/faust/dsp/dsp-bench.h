@@ -249,6 +249,24 @@ class time_bench {
             << std::endl;
         }
     
+        /**
+         * Returns the duration (in usec) not exceeded by 'percentile' % of the fMeasureCount measures.
+         */
+        double getPercentileUsec(double percentile)
+        {
+            assert(fMeasure > fMeasureCount);
+            std::vector<uint64> V(fMeasureCount);
+            
+            for (int i = 0; i < fMeasureCount; i++) {
+                V[i] = fStops[i] - fStarts[i];
+            }
+            
+            sort(V.begin(), V.end());
+            
+            int index = std::min(fMeasureCount - 1, int(double(fMeasureCount) * percentile / 100.));
+            return rdtsc2sec(V[index]) * 1e6;
+        }
+    
         bool isRunning() { return (fMeasure <= (fMeasureCount + fSkip)); }
 
 };
@@ -392,6 +410,14 @@ class measure_dsp : public decorator_dsp {
             fBench->printStats(applname, fBufferSize, fDSP->getNumInputs(), fDSP->getNumOutputs());
         }
     
+        /**
+         * Returns the duration (in usec) not exceeded by 'percentile' % of the compute calls
+         */
+        double getPercentileUsec(double percentile)
+        {
+            return fBench->getPercentileUsec(percentile);
+        }
+    
         bool isRunning() { return fBench->isRunning(); }
     
 };
@@ -28,21 +28,23 @@
 #include <assert.h>
 
 #include "faust/dsp/dsp.h"
+#include "faust/gui/UI.h"
 
 // Combine two DSP in sequence
 
 class dsp_sequencer : public dsp {
     
-    private:
+    protected:
         
         dsp* fDSP1;
         dsp* fDSP2;
         FAUSTFLOAT** fSeqBuffer;
+        int fBufferSize;
          
     public:
         
         dsp_sequencer(dsp* dsp1, dsp* dsp2, int buffer_size = 4096)
-            :fDSP1(dsp1), fDSP2(dsp2)
+            :fDSP1(dsp1), fDSP2(dsp2), fBufferSize(buffer_size)
         {
             assert(fDSP1->getNumOutputs() == fDSP2->getNumInputs());
             fSeqBuffer = new FAUSTFLOAT*[fDSP1->getNumOutputs()];
@@ -114,7 +116,7 @@ class dsp_sequencer : public dsp {
         
         virtual dsp* clone()
         {
-            return new dsp_sequencer(fDSP1->clone(), fDSP2->clone());
+            return new dsp_sequencer(fDSP1->clone(), fDSP2->clone(), fBufferSize);
         }
     
         virtual void metadata(Meta* m)
@@ -135,7 +137,7 @@ class dsp_sequencer : public dsp {
 
 class dsp_parallelizer : public dsp {
     
-    private:
+    protected:
         
         dsp* fDSP1;
         dsp* fDSP2;
@@ -225,7 +227,7 @@ class dsp_parallelizer : public dsp {
             
             FAUSTFLOAT** outputs_dsp2 = (FAUSTFLOAT**)alloca(fDSP2->getNumOutputs() * sizeof(FAUSTFLOAT*));
             for (int chan = 0; chan < fDSP2->getNumOutputs(); chan++) {
-                outputs_dsp2[chan] = inputs[fDSP1->getNumOutputs() + chan];
+                outputs_dsp2[chan] = outputs[fDSP1->getNumOutputs() + chan];
             }
             
             fDSP2->compute(count, inputs_dsp2, outputs_dsp2);
@@ -0,0 +1,402 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __dsp_graph__
+#define __dsp_graph__
+
+#include <string.h>
+#include <assert.h>
+#include <vector>
+
+#include "faust/dsp/dsp.h"
+#include "faust/gui/UI.h"
+
+/**
+ * Node of a combinator expression: a DSP, or two nodes in sequence or in parallel.
+ *
+ * Contrary to dsp_sequencer/dsp_parallelizer which own one set of intermediate
+ * buffers each, the whole expression is compiled by createDSPGraph into a flat
+ * list of compute steps sharing a minimal set of buffers.
+ */
+
+struct dsp_graph_node {
+
+    enum { kDSP, kSequence, kParallel };
+
+    int fType;
+    dsp* fDSP;
+    bool fInPlace;
+    dsp_graph_node* fNode1;
+    dsp_graph_node* fNode2;
+
+    dsp_graph_node(int type, dsp* dsp, bool inplace, dsp_graph_node* node1, dsp_graph_node* node2)
+        :fType(type), fDSP(dsp), fInPlace(inplace), fNode1(node1), fNode2(node2)
+    {}
+
+    virtual ~dsp_graph_node()
+    {
+        delete fDSP;
+        delete fNode1;
+        delete fNode2;
+    }
+
+    int getNumInputs()
+    {
+        switch (fType) {
+            case kDSP: return fDSP->getNumInputs();
+            case kSequence: return fNode1->getNumInputs();
+            default: return fNode1->getNumInputs() + fNode2->getNumInputs();
+        }
+    }
+
+    int getNumOutputs()
+    {
+        switch (fType) {
+            case kDSP: return fDSP->getNumOutputs();
+            case kSequence: return fNode2->getNumOutputs();
+            default: return fNode1->getNumOutputs() + fNode2->getNumOutputs();
+        }
+    }
+
+    dsp_graph_node* clone()
+    {
+        if (fType == kDSP) {
+            return new dsp_graph_node(kDSP, fDSP->clone(), fInPlace, 0, 0);
+        } else {
+            return new dsp_graph_node(fType, 0, false, fNode1->clone(), fNode2->clone());
+        }
+    }
+
+    // Same layout as dsp_sequencer/dsp_parallelizer
+    void buildUserInterface(UI* ui_interface)
+    {
+        if (fType == kDSP) {
+            fDSP->buildUserInterface(ui_interface);
+        } else {
+            ui_interface->openTabBox((fType == kSequence) ? "Sequencer" : "Parallelizer");
+            ui_interface->openVerticalBox("DSP1");
+            fNode1->buildUserInterface(ui_interface);
+            ui_interface->closeBox();
+            ui_interface->openVerticalBox("DSP2");
+            fNode2->buildUserInterface(ui_interface);
+            ui_interface->closeBox();
+            ui_interface->closeBox();
+        }
+    }
+
+    void collectDSPs(std::vector<dsp*>& dsps)
+    {
+        if (fType == kDSP) {
+            dsps.push_back(fDSP);
+        } else {
+            fNode1->collectDSPs(dsps);
+            fNode2->collectDSPs(dsps);
+        }
+    }
+};
+
+/**
+ * Build a graph node from a DSP (the node takes ownership of the DSP).
+ *
+ * @param dsp - the DSP
+ * @param inplace - true if the DSP accepts outputs sharing buffers with its inputs
+ *                  (typically Faust code compiled with '-inpl')
+ */
+static inline dsp_graph_node* graphDSP(dsp* dsp, bool inplace = false)
+{
+    return new dsp_graph_node(dsp_graph_node::kDSP, dsp, inplace, 0, 0);
+}
+
+static inline dsp_graph_node* graphSequence(dsp_graph_node* node1, dsp_graph_node* node2)
+{
+    assert(node1->getNumOutputs() == node2->getNumInputs());
+    return new dsp_graph_node(dsp_graph_node::kSequence, 0, false, node1, node2);
+}
+
+static inline dsp_graph_node* graphParallel(dsp_graph_node* node1, dsp_graph_node* node2)
+{
+    return new dsp_graph_node(dsp_graph_node::kParallel, 0, false, node1, node2);
+}
+
+/**
+ * A combinator expression compiled as a flat list of compute steps.
+ *
+ * Each signal ('wire') of the expression is mapped either on an external input buffer,
+ * on an external output buffer (outputs of the whole graph are directly computed
+ * in place), or on an internal buffer. Internal buffers are allocated with a
+ * liveness analysis along the steps order: a buffer is reused as soon as the
+ * wire it holds has been consumed, and an 'inplace' DSP directly writes its outputs
+ * in the buffers of the inputs it consumes last.
+ */
+
+class dsp_graph : public dsp {
+
+    private:
+
+        enum { kInput, kOutput, kBuffer };
+
+        struct slot {
+            int fKind;
+            int fIndex;
+            slot(int kind = kBuffer, int index = 0):fKind(kind), fIndex(index) {}
+        };
+
+        struct step {
+            dsp* fDSP;
+            bool fInPlace;
+            std::vector<int> fInWires;
+            std::vector<int> fOutWires;
+            FAUSTFLOAT** fInputs;
+            FAUSTFLOAT** fOutputs;
+        };
+
+        dsp_graph_node* fRoot;
+        int fBufferSize;
+        int fNumInputs;
+        int fNumOutputs;
+
+        std::vector<step> fSteps;
+        std::vector<slot> fWires;
+        std::vector<FAUSTFLOAT*> fBuffers;
+        std::vector<FAUSTFLOAT*> fOutScratch;   // Used when the host gives aliased inputs/outputs
+        std::vector<dsp*> fDSPs;
+
+        int newWire(int kind, int index)
+        {
+            fWires.push_back(slot(kind, index));
+            return int(fWires.size()) - 1;
+        }
+
+        std::vector<int> flatten(dsp_graph_node* node, const std::vector<int>& ins)
+        {
+            if (node->fType == dsp_graph_node::kDSP) {
+                step s;
+                s.fDSP = node->fDSP;
+                s.fInPlace = node->fInPlace;
+                s.fInWires = ins;
+                for (int i = 0; i < node->getNumOutputs(); i++) {
+                    s.fOutWires.push_back(newWire(kBuffer, -1));
+                }
+                s.fInputs = new FAUSTFLOAT*[s.fInWires.size() + 1];
+                s.fOutputs = new FAUSTFLOAT*[s.fOutWires.size() + 1];
+                fSteps.push_back(s);
+                return s.fOutWires;
+            } else if (node->fType == dsp_graph_node::kSequence) {
+                return flatten(node->fNode2, flatten(node->fNode1, ins));
+            } else {
+                int n1 = node->fNode1->getNumInputs();
+                std::vector<int> ins1(ins.begin(), ins.begin() + n1);
+                std::vector<int> ins2(ins.begin() + n1, ins.end());
+                std::vector<int> outs = flatten(node->fNode1, ins1);
+                std::vector<int> outs2 = flatten(node->fNode2, ins2);
+                outs.insert(outs.end(), outs2.begin(), outs2.end());
+                return outs;
+            }
+        }
+
+        void allocate()
+        {
+            // Graph inputs
+            std::vector<int> ins;
+            for (int i = 0; i < fNumInputs; i++) {
+                ins.push_back(newWire(kInput, i));
+            }
+
+            // Steps in computation order
+            std::vector<int> outs = flatten(fRoot, ins);
+            for (size_t i = 0; i < outs.size(); i++) {
+                fWires[outs[i]] = slot(kOutput, int(i));
+            }
+
+            // Last step reading each wire
+            std::vector<int> last_use(fWires.size(), -1);
+            for (size_t s = 0; s < fSteps.size(); s++) {
+                for (size_t i = 0; i < fSteps[s].fInWires.size(); i++) {
+                    last_use[fSteps[s].fInWires[i]] = int(s);
+                }
+            }
+
+            // Linear scan allocation of internal buffers
+            std::vector<int> free_list;
+            int num_buffers = 0;
+            for (size_t s = 0; s < fSteps.size(); s++) {
+                step& cur = fSteps[s];
+                std::vector<int> dying;
+                for (size_t i = 0; i < cur.fInWires.size(); i++) {
+                    slot& in = fWires[cur.fInWires[i]];
+                    if (in.fKind == kBuffer && last_use[cur.fInWires[i]] == int(s)) {
+                        dying.push_back(in.fIndex);
+                    }
+                }
+                if (cur.fInPlace) {
+                    free_list.insert(free_list.end(), dying.begin(), dying.end());
+                    dying.clear();
+                }
+                for (size_t i = 0; i < cur.fOutWires.size(); i++) {
+                    slot& out = fWires[cur.fOutWires[i]];
+                    if (out.fKind == kBuffer) {
+                        if (free_list.size() > 0) {
+                            out.fIndex = free_list.back();
+                            free_list.pop_back();
+                        } else {
+                            out.fIndex = num_buffers++;
+                        }
+                    }
+                }
+                free_list.insert(free_list.end(), dying.begin(), dying.end());
+            }
+
+            for (int i = 0; i < num_buffers; i++) {
+                fBuffers.push_back(new FAUSTFLOAT[fBufferSize]);
+            }
+            for (int i = 0; i < fNumOutputs; i++) {
+                fOutScratch.push_back(new FAUSTFLOAT[fBufferSize]);
+            }
+        }
+
+        FAUSTFLOAT* resolve(int wire, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            const slot& s = fWires[wire];
+            switch (s.fKind) {
+                case kInput: return inputs[s.fIndex];
+                case kOutput: return outputs[s.fIndex];
+                default: return fBuffers[s.fIndex];
+            }
+        }
+
+        bool isAliased(FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            for (int i = 0; i < fNumInputs; i++) {
+                for (int j = 0; j < fNumOutputs; j++) {
+                    if (inputs[i] == outputs[j]) return true;
+                }
+            }
+            return false;
+        }
+
+    public:
+
+        /**
+         * Compile a graph expression (the graph takes ownership of the nodes).
+         *
+         * @param root - the graph expression
+         * @param buffer_size - the maximum 'count' given to compute
+         */
+        dsp_graph(dsp_graph_node* root, int buffer_size = 4096)
+            :fRoot(root), fBufferSize(buffer_size)
+        {
+            fNumInputs = fRoot->getNumInputs();
+            fNumOutputs = fRoot->getNumOutputs();
+            fRoot->collectDSPs(fDSPs);
+            allocate();
+        }
+
+        virtual ~dsp_graph()
+        {
+            for (size_t i = 0; i < fSteps.size(); i++) {
+                delete [] fSteps[i].fInputs;
+                delete [] fSteps[i].fOutputs;
+            }
+            for (size_t i = 0; i < fBuffers.size(); i++) {
+                delete [] fBuffers[i];
+            }
+            for (size_t i = 0; i < fOutScratch.size(); i++) {
+                delete [] fOutScratch[i];
+            }
+            delete fRoot;
+        }
+
+        /* Return the number of internal buffers used for intermediate signals */
+        int getNumBuffers() { return int(fBuffers.size()); }
+
+        virtual int getNumInputs() { return fNumInputs; }
+        virtual int getNumOutputs() { return fNumOutputs; }
+
+        virtual void buildUserInterface(UI* ui_interface) { fRoot->buildUserInterface(ui_interface); }
+
+        virtual int getSampleRate() { return fDSPs[0]->getSampleRate(); }
+
+        virtual void init(int samplingRate)
+        {
+            for (size_t i = 0; i < fDSPs.size(); i++) fDSPs[i]->init(samplingRate);
+        }
+
+        virtual void instanceInit(int samplingRate)
+        {
+            for (size_t i = 0; i < fDSPs.size(); i++) fDSPs[i]->instanceInit(samplingRate);
+        }
+
+        virtual void instanceConstants(int samplingRate)
+        {
+            for (size_t i = 0; i < fDSPs.size(); i++) fDSPs[i]->instanceConstants(samplingRate);
+        }
+
+        virtual void instanceResetUserInterface()
+        {
+            for (size_t i = 0; i < fDSPs.size(); i++) fDSPs[i]->instanceResetUserInterface();
+        }
+
+        virtual void instanceClear()
+        {
+            for (size_t i = 0; i < fDSPs.size(); i++) fDSPs[i]->instanceClear();
+        }
+
+        virtual dsp* clone()
+        {
+            return new dsp_graph(fRoot->clone(), fBufferSize);
+        }
+
+        virtual void metadata(Meta* m)
+        {
+            for (size_t i = 0; i < fDSPs.size(); i++) fDSPs[i]->metadata(m);
+        }
+
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            assert(count <= fBufferSize);
+
+            // Graph outputs may be written before all graph inputs are read
+            bool aliased = isAliased(inputs, outputs);
+            FAUSTFLOAT** real_outputs = (aliased) ? &fOutScratch[0] : outputs;
+
+            for (size_t s = 0; s < fSteps.size(); s++) {
+                step& cur = fSteps[s];
+                for (size_t i = 0; i < cur.fInWires.size(); i++) {
+                    cur.fInputs[i] = resolve(cur.fInWires[i], inputs, real_outputs);
+                }
+                for (size_t i = 0; i < cur.fOutWires.size(); i++) {
+                    cur.fOutputs[i] = resolve(cur.fOutWires[i], inputs, real_outputs);
+                }
+                cur.fDSP->compute(count, cur.fInputs, cur.fOutputs);
+            }
+
+            if (aliased) {
+                for (int i = 0; i < fNumOutputs; i++) {
+                    memcpy(outputs[i], fOutScratch[i], sizeof(FAUSTFLOAT) * count);
+                }
+            }
+        }
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) { compute(count, inputs, outputs); }
+};
+
+#endif
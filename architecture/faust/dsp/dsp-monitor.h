@@ -0,0 +1,326 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __dsp_monitor__
+#define __dsp_monitor__
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <sstream>
+#include <string.h>
+
+#include "faust/dsp/dsp.h"
+#include "faust/gui/UI.h"
+#include "faust/gui/DecoratorUI.h"
+
+/**
+ * A snapshot of the DSP load statistics.
+ * The load of a callback is its duration divided by the period (the duration of the buffer).
+ */
+
+struct dsp_load {
+
+    enum { kBinsPerPeriod = 100, kBins = 2 * kBinsPerPeriod + 1 };  // 1% bins up to 200%, the last one for bigger loads
+
+    unsigned long long fCount;      // number of callbacks
+    unsigned long long fMisses;     // callbacks longer than the period
+    unsigned long long fXRuns;      // xruns notified by the driver
+    unsigned long long fDSPXRuns;   // xruns following a deadline miss, the DSP is responsible
+    double fPeriod;                 // last period in usec
+    double fMean;                   // mean load
+    double fMax;                    // worst case load
+    unsigned int fBins[kBins];      // load histogram
+
+    dsp_load() { memset(this, 0, sizeof(dsp_load)); }
+
+    // Load below which 'p' percent of the callbacks are (upper bound of the histogram bin)
+    double percentile(double p) const
+    {
+        unsigned long long total = 0;
+        for (int i = 0; i < kBins; i++) total += fBins[i];
+        if (total == 0) return 0.;
+        unsigned long long target = (unsigned long long)(double(total) * p / 100.);
+        unsigned long long sum = 0;
+        for (int i = 0; i < kBins - 1; i++) {
+            sum += fBins[i];
+            if (sum > target) return double(i + 1) / kBinsPerPeriod;
+        }
+        return fMax;
+    }
+
+    std::string json() const
+    {
+        std::stringstream res;
+        res << "{\"count\": " << fCount << ", \"misses\": " << fMisses
+            << ", \"xruns\": " << fXRuns << ", \"dsp_xruns\": " << fDSPXRuns
+            << ", \"period\": " << fPeriod << ", \"mean\": " << fMean << ", \"max\": " << fMax
+            << ", \"p50\": " << percentile(50.) << ", \"p99\": " << percentile(99.)
+            << ", \"p999\": " << percentile(99.9) << "}";
+        return res.str();
+    }
+
+};
+
+/**
+ * Lock-free DSP load statistics: written by the audio thread (record), xruns may be notified
+ * by any thread (some drivers notify them from another thread), read at any time by any
+ * number of threads (getLoad).
+ */
+
+class load_monitor {
+
+    private:
+
+        std::atomic<unsigned int> fBins[dsp_load::kBins];
+        std::atomic<unsigned long long> fCount;
+        std::atomic<unsigned long long> fMisses;
+        std::atomic<unsigned long long> fXRuns;
+        std::atomic<unsigned long long> fDSPXRuns;
+        std::atomic<double> fPeriod;
+        std::atomic<double> fSum;
+        std::atomic<double> fMax;
+        std::atomic<bool> fReset;   // asked by a reader, done by the audio thread
+        std::atomic<bool> fLastMissed;
+
+        void clear()
+        {
+            for (int i = 0; i < dsp_load::kBins; i++) fBins[i].store(0, std::memory_order_relaxed);
+            fCount.store(0, std::memory_order_relaxed);
+            fMisses.store(0, std::memory_order_relaxed);
+            fXRuns.store(0, std::memory_order_relaxed);
+            fDSPXRuns.store(0, std::memory_order_relaxed);
+            fSum.store(0., std::memory_order_relaxed);
+            fMax.store(0., std::memory_order_relaxed);
+            fLastMissed.store(false, std::memory_order_relaxed);
+        }
+
+        // Single writer: plain read-modify-write sequences are enough
+        template <class T>
+        static void add(std::atomic<T>& counter, T value)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+    public:
+
+        load_monitor():fPeriod(0.), fReset(false)
+        {
+            clear();
+        }
+
+        /**
+         * Record a callback (audio thread).
+         *
+         * @param usec - the callback duration in usec
+         * @param period_usec - the duration of the buffer in usec
+         */
+        void record(double usec, double period_usec)
+        {
+            if (fReset.load(std::memory_order_acquire)) {
+                clear();
+                fReset.store(false, std::memory_order_release);
+            }
+            double load = usec / period_usec;
+            int bin = int(load * dsp_load::kBinsPerPeriod);
+            bin = (bin < 0) ? 0 : ((bin >= dsp_load::kBins) ? dsp_load::kBins - 1 : bin);
+            add(fBins[bin], 1u);
+            fLastMissed.store(load > 1., std::memory_order_relaxed);
+            if (load > 1.) add(fMisses, 1ull);
+            if (load > fMax.load(std::memory_order_relaxed)) fMax.store(load, std::memory_order_relaxed);
+            add(fSum, load);
+            fPeriod.store(period_usec, std::memory_order_relaxed);
+            // Published last, so that a reader never sees more callbacks than recorded loads
+            fCount.store(fCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * Notify an xrun (any thread): it is attributed to the DSP when the last callback missed its deadline.
+         */
+        void xrun()
+        {
+            fXRuns.fetch_add(1, std::memory_order_relaxed);
+            if (fLastMissed.load(std::memory_order_relaxed)) fDSPXRuns.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Ask the audio thread to clear the statistics at the next callback
+        void reset() { fReset.store(true, std::memory_order_release); }
+
+        // Poll the statistics (any thread)
+        void getLoad(dsp_load& load) const
+        {
+            load.fCount = fCount.load(std::memory_order_acquire);
+            load.fMisses = fMisses.load(std::memory_order_relaxed);
+            load.fXRuns = fXRuns.load(std::memory_order_relaxed);
+            load.fDSPXRuns = fDSPXRuns.load(std::memory_order_relaxed);
+            load.fPeriod = fPeriod.load(std::memory_order_relaxed);
+            load.fMean = (load.fCount > 0) ? fSum.load(std::memory_order_relaxed) / double(load.fCount) : 0.;
+            load.fMax = fMax.load(std::memory_order_relaxed);
+            for (int i = 0; i < dsp_load::kBins; i++) {
+                load.fBins[i] = fBins[i].load(std::memory_order_relaxed);
+            }
+        }
+
+        dsp_load getLoad() const
+        {
+            dsp_load load;
+            getLoad(load);
+            return load;
+        }
+
+};
+
+/**
+ * DSP decorator measuring the duration of each 'compute' call, whatever the audio driver.
+ *
+ * With 'ui' set, the statistics are also exposed as bargraphs in a 'Monitor' group added
+ * at the end of the DSP root group
+ * (and so in the JSON description and through the HTTP or OSC interfaces),
+ * updated about twice a second from the audio thread.
+ */
+
+class monitor_dsp : public decorator_dsp {
+
+    protected:
+
+        load_monitor fMonitor;
+        bool fUI;
+        int fSampleRate;
+        int fFrames;        // frames since the last bargraphs update
+        FAUSTFLOAT fMean;
+        FAUSTFLOAT fMax;
+        FAUSTFLOAT fP99;
+        FAUSTFLOAT fMisses;
+
+        // Adds the 'Monitor' group just before the DSP root group is closed, so that the UI keeps a single root
+        struct MonitorUI : public DecoratorUI {
+
+            monitor_dsp* fMonitorDSP;
+            int fDepth;
+            bool fAdded;
+
+            MonitorUI(UI* ui, monitor_dsp* dsp):DecoratorUI(ui), fMonitorDSP(dsp), fDepth(0), fAdded(false) {}
+            virtual ~MonitorUI() { fUI = 0; }   // 'ui' is not owned
+
+            void openTabBox(const char* label) { fDepth++; fUI->openTabBox(label); }
+            void openHorizontalBox(const char* label) { fDepth++; fUI->openHorizontalBox(label); }
+            void openVerticalBox(const char* label) { fDepth++; fUI->openVerticalBox(label); }
+            void closeBox()
+            {
+                if (--fDepth == 0 && !fAdded) {
+                    fMonitorDSP->buildMonitorInterface(fUI);
+                    fAdded = true;
+                }
+                fUI->closeBox();
+            }
+
+        };
+
+        void buildMonitorInterface(UI* ui_interface)
+        {
+            ui_interface->openVerticalBox("Monitor");
+            ui_interface->declare(&fMean, "unit", "%");
+            ui_interface->addHorizontalBargraph("load", &fMean, FAUSTFLOAT(0), FAUSTFLOAT(100));
+            ui_interface->declare(&fP99, "unit", "%");
+            ui_interface->addHorizontalBargraph("p99", &fP99, FAUSTFLOAT(0), FAUSTFLOAT(200));
+            ui_interface->declare(&fMax, "unit", "%");
+            ui_interface->addHorizontalBargraph("max", &fMax, FAUSTFLOAT(0), FAUSTFLOAT(200));
+            ui_interface->addHorizontalBargraph("misses", &fMisses, FAUSTFLOAT(0), FAUSTFLOAT(1000000));
+            ui_interface->closeBox();
+        }
+
+        void updateUI(int count)
+        {
+            fFrames += count;
+            if (fFrames < fSampleRate / 2) return;
+            fFrames = 0;
+            dsp_load load;
+            fMonitor.getLoad(load);
+            fMean = FAUSTFLOAT(load.fMean * 100.);
+            fMax = FAUSTFLOAT(load.fMax * 100.);
+            fP99 = FAUSTFLOAT(load.percentile(99.) * 100.);
+            fMisses = FAUSTFLOAT(load.fMisses);
+        }
+
+    public:
+
+        monitor_dsp(dsp* dsp, bool ui = false)
+            :decorator_dsp(dsp), fUI(ui), fSampleRate(44100), fFrames(0), fMean(0), fMax(0), fP99(0), fMisses(0)
+        {}
+        virtual ~monitor_dsp() {}
+
+        virtual void init(int samplingRate)
+        {
+            fSampleRate = samplingRate;
+            fDSP->init(samplingRate);
+        }
+        virtual void instanceInit(int samplingRate)
+        {
+            fSampleRate = samplingRate;
+            fDSP->instanceInit(samplingRate);
+        }
+
+        virtual void buildUserInterface(UI* ui_interface)
+        {
+            if (fUI) {
+                MonitorUI monitor(ui_interface, this);
+                fDSP->buildUserInterface(&monitor);
+                // DSP without any group
+                if (!monitor.fAdded) buildMonitorInterface(ui_interface);
+            } else {
+                fDSP->buildUserInterface(ui_interface);
+            }
+        }
+
+        virtual monitor_dsp* clone() { return new monitor_dsp(fDSP->clone(), fUI); }
+
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            fDSP->compute(count, inputs, outputs);
+            record(start, count);
+        }
+
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            fDSP->compute(date_usec, count, inputs, outputs);
+            record(start, count);
+        }
+
+        void record(std::chrono::steady_clock::time_point start, int count)
+        {
+            double usec = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            fMonitor.record(usec, double(count) * 1e6 / double(fSampleRate));
+            if (fUI) updateUI(count);
+        }
+
+        // To be called by the driver when an xrun is detected
+        void xrun() { fMonitor.xrun(); }
+
+        load_monitor& getMonitor() { return fMonitor; }
+        dsp_load getLoad() const { return fMonitor.getLoad(); }
+
+};
+
+#endif
@@ -0,0 +1,440 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __dsp_pool__
+#define __dsp_pool__
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+#include <typeinfo>
+
+#include "faust/dsp/dsp.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+/**
+ * An instance hosted by a dsp_instance_pool, with its own input and output buffers.
+ * The host fills the inputs before dsp_instance_pool::compute and reads the outputs after.
+ */
+
+class pooled_dsp {
+
+    friend class dsp_instance_pool;
+
+    private:
+
+        dsp* fDSP;
+        const std::type_info* fType;    // class of the instance, to batch instances sharing static tables
+        FAUSTFLOAT** fInputs;
+        FAUSTFLOAT** fOutputs;
+        int fNumInputs;
+        int fNumOutputs;
+        int fWorker;
+
+        pooled_dsp(dsp* dsp, int buffer_size, int worker)
+            :fDSP(dsp), fType(&typeid(*dsp)), fWorker(worker)
+        {
+            fNumInputs = fDSP->getNumInputs();
+            fNumOutputs = fDSP->getNumOutputs();
+            fInputs = new FAUSTFLOAT*[fNumInputs];
+            for (int chan = 0; chan < fNumInputs; chan++) {
+                fInputs[chan] = new FAUSTFLOAT[buffer_size];
+                memset(fInputs[chan], 0, sizeof(FAUSTFLOAT) * buffer_size);
+            }
+            fOutputs = new FAUSTFLOAT*[fNumOutputs];
+            for (int chan = 0; chan < fNumOutputs; chan++) {
+                fOutputs[chan] = new FAUSTFLOAT[buffer_size];
+                memset(fOutputs[chan], 0, sizeof(FAUSTFLOAT) * buffer_size);
+            }
+        }
+
+        ~pooled_dsp()
+        {
+            for (int chan = 0; chan < fNumInputs; chan++) {
+                delete [] fInputs[chan];
+            }
+            delete [] fInputs;
+            for (int chan = 0; chan < fNumOutputs; chan++) {
+                delete [] fOutputs[chan];
+            }
+            delete [] fOutputs;
+            delete fDSP;
+        }
+
+    public:
+
+        dsp* getDSP() { return fDSP; }
+        FAUSTFLOAT** getInputs() { return fInputs; }
+        FAUSTFLOAT** getOutputs() { return fOutputs; }
+        int getWorker() { return fWorker; }
+
+};
+
+/**
+ * Host side scheduler for many DSP instances in one process.
+ *
+ * - each worker thread is pinned on a core and owns a set of instances that never migrate
+ * - instances are cloned, initialized and given their buffers by their worker thread, so that
+ *   with the default first touch policy (and the per-thread malloc arenas) their memory,
+ *   delay lines included, is allocated on the NUMA node of the core computing them
+ * - new instances go to the least loaded worker, preferably one already hosting instances
+ *   of the same class, and are batched by class in each worker, so that consecutive
+ *   instances reuse the shared static tables from the core caches
+ *
+ * The prototypes given to 'add' have to be initialized with 'init' at the pool sample rate
+ * beforehand: their static tables ('classInit') are shared, the instances are only initialized
+ * with 'instanceInit', so that workers never write the tables concurrently.
+ */
+
+class dsp_instance_pool {
+
+    private:
+
+        struct request {
+            dsp* fPrototype;        // instance to clone, or
+            pooled_dsp* fRemove;    // instance to delete
+            pooled_dsp* fResult;
+            bool fDone;
+        };
+
+        struct worker {
+            dsp_instance_pool* fPool;
+            pthread_t fThread;
+            int fIndex;
+            int fCPU;
+            int fNode;
+            std::vector<pooled_dsp*> fInstances;   // batched by class
+            std::vector<request*> fRequests;       // protected by the pool mutex
+            std::atomic<int> fCount;               // number of instances, read by 'add'
+            unsigned int fCycle;                   // last computed cycle
+        };
+
+        std::vector<worker*> fWorkers;
+        int fSampleRate;
+        int fBufferSize;
+        int fSpinCount;
+        int fPriority;
+
+        std::atomic<bool> fRunning;
+        std::atomic<unsigned int> fCycle;       // incremented by 'compute' to start a cycle
+        std::atomic<int> fCount;                // frames to compute in the current cycle
+        std::atomic<int> fPending;              // workers still computing the current cycle
+        std::atomic<int> fRequests;             // pending add/remove requests
+        std::atomic<int> fSleeping;
+        pthread_mutex_t fMutex;
+        pthread_cond_t fCond;                   // wakes up the workers
+        pthread_cond_t fDoneCond;               // wakes up the threads waiting for a request
+
+        static void relax()
+        {
+        #ifdef __SSE__
+            _mm_pause();
+        #else
+            sched_yield();
+        #endif
+        }
+
+        // NUMA node of a core (0 when unknown)
+        static int cpuNode(int cpu)
+        {
+        #ifdef __linux__
+            char path[128];
+            for (int node = 0; node < 1024; node++) {
+                snprintf(path, 128, "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+                if (access(path, F_OK) == 0) return node;
+            }
+        #endif
+            return 0;
+        }
+
+        void pin(worker* w)
+        {
+        #ifdef __linux__
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(w->fCPU, &cpus);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+        #endif
+            if (fPriority > 0) {
+                struct sched_param param;
+                param.sched_priority = fPriority;
+                pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            }
+        }
+
+        // Add or remove instances, in the worker thread and between cycles (pool mutex locked)
+        void handleRequests(worker* w)
+        {
+            for (size_t i = 0; i < w->fRequests.size(); i++) {
+                request* r = w->fRequests[i];
+                if (r->fPrototype) {
+                    dsp* instance = r->fPrototype->clone();
+                    instance->instanceInit(fSampleRate);
+                    pooled_dsp* pooled = new pooled_dsp(instance, fBufferSize, w->fIndex);
+                    // Insert at the end of the instances of the same class
+                    std::vector<pooled_dsp*>::iterator it = w->fInstances.end();
+                    for (std::vector<pooled_dsp*>::iterator j = w->fInstances.begin(); j != w->fInstances.end(); j++) {
+                        if (*(*j)->fType == *pooled->fType) it = j + 1;
+                    }
+                    w->fInstances.insert(it, pooled);
+                    r->fResult = pooled;
+                } else {
+                    for (std::vector<pooled_dsp*>::iterator j = w->fInstances.begin(); j != w->fInstances.end(); j++) {
+                        if (*j == r->fRemove) {
+                            w->fInstances.erase(j);
+                            break;
+                        }
+                    }
+                    delete r->fRemove;
+                }
+                w->fCount = int(w->fInstances.size());
+                r->fDone = true;
+                fRequests--;
+            }
+            if (w->fRequests.size() > 0) {
+                w->fRequests.clear();
+                pthread_cond_broadcast(&fDoneCond);
+            }
+        }
+
+        void work(worker* w)
+        {
+            AVOIDDENORMALS;
+            pin(w);
+            while (fRunning) {
+                bool found = false;
+                for (int i = 0; i < fSpinCount && !found; i++) {
+                    if (fCycle.load(std::memory_order_acquire) != w->fCycle) {
+                        w->fCycle++;
+                        int count = fCount.load(std::memory_order_relaxed);
+                        for (size_t j = 0; j < w->fInstances.size(); j++) {
+                            pooled_dsp* p = w->fInstances[j];
+                            p->fDSP->compute(count, p->fInputs, p->fOutputs);
+                        }
+                        fPending.fetch_sub(1, std::memory_order_acq_rel);
+                        found = true;
+                    } else if (fRequests.load(std::memory_order_relaxed) > 0) {
+                        pthread_mutex_lock(&fMutex);
+                        handleRequests(w);
+                        pthread_mutex_unlock(&fMutex);
+                        found = true;
+                    } else {
+                        relax();
+                    }
+                }
+                if (found) continue;
+                // Nothing to do : sleep until the next cycle or request
+                pthread_mutex_lock(&fMutex);
+                fSleeping++;
+                if (fRunning && fCycle.load() == w->fCycle && w->fRequests.size() == 0) {
+                    pthread_cond_wait(&fCond, &fMutex);
+                }
+                fSleeping--;
+                handleRequests(w);
+                pthread_mutex_unlock(&fMutex);
+            }
+        }
+
+        static void* workHandler(void* arg)
+        {
+            worker* w = static_cast<worker*>(arg);
+            w->fPool->work(w);
+            return 0;
+        }
+
+        void signal()
+        {
+            if (fSleeping.load() > 0) {
+                pthread_mutex_lock(&fMutex);
+                pthread_cond_broadcast(&fCond);
+                pthread_mutex_unlock(&fMutex);
+            }
+        }
+
+        // Least loaded worker, preferably already hosting the class of 'prototype', then on the least loaded node (pool mutex locked)
+        int place(dsp* prototype)
+        {
+            const std::type_info& type = typeid(*prototype);
+            std::vector<int> nodes;
+            for (size_t i = 0; i < fWorkers.size(); i++) {
+                if (fWorkers[i]->fNode >= int(nodes.size())) nodes.resize(fWorkers[i]->fNode + 1, 0);
+                nodes[fWorkers[i]->fNode] += fWorkers[i]->fCount;
+            }
+            int best = 0;
+            bool best_type = false;
+            for (size_t i = 0; i < fWorkers.size(); i++) {
+                worker* w = fWorkers[i];
+                bool has_type = false;
+                for (size_t j = 0; j < w->fInstances.size() && !has_type; j++) {
+                    has_type = (*w->fInstances[j]->fType == type);
+                }
+                worker* b = fWorkers[best];
+                if (w->fCount < b->fCount
+                    || (w->fCount == b->fCount && has_type && !best_type)
+                    || (w->fCount == b->fCount && has_type == best_type && nodes[w->fNode] < nodes[b->fNode])) {
+                    best = int(i);
+                    best_type = has_type;
+                }
+            }
+            return best;
+        }
+
+        // Post a request to a worker (or to the one chosen by 'place' when negative) and wait for it to be handled
+        void post(int worker_index, request* r)
+        {
+            pthread_mutex_lock(&fMutex);
+            worker* w = fWorkers[(worker_index >= 0 && worker_index < int(fWorkers.size())) ? worker_index : place(r->fPrototype)];
+            w->fRequests.push_back(r);
+            fRequests++;
+            pthread_cond_broadcast(&fCond);
+            while (!r->fDone) {
+                pthread_cond_wait(&fDoneCond, &fMutex);
+            }
+            pthread_mutex_unlock(&fMutex);
+        }
+
+    public:
+
+        /**
+         * Create the pool.
+         *
+         * @param sample_rate - the sample rate of the instances
+         * @param buffer_size - the maximum number of frames computed at each cycle
+         * @param workers - the number of worker threads, if negative one per available core
+         * @param priority - SCHED_FIFO priority of the workers (0 to keep the default policy)
+         * @param spin_count - number of polling iterations before an idle worker goes to sleep
+         */
+        dsp_instance_pool(int sample_rate, int buffer_size, int workers = -1, int priority = 0, int spin_count = 20000)
+            :fSampleRate(sample_rate), fBufferSize(buffer_size), fSpinCount(spin_count), fPriority(priority),
+            fRunning(true), fCycle(0), fCount(0), fPending(0), fRequests(0), fSleeping(0)
+        {
+            pthread_mutex_init(&fMutex, NULL);
+            pthread_cond_init(&fCond, NULL);
+            pthread_cond_init(&fDoneCond, NULL);
+
+            long cores = sysconf(_SC_NPROCESSORS_ONLN);
+            cores = (cores > 0) ? cores : 1;
+            if (workers < 0) workers = int(cores);
+
+            // Workers ordered by node, so that neighbouring workers share the same memory
+            std::vector<int> cpus;
+            for (int node = 0; int(cpus.size()) < cores; node++) {
+                for (int cpu = 0; cpu < cores; cpu++) {
+                    if (cpuNode(cpu) == node) cpus.push_back(cpu);
+                }
+                if (node > 1024) break;
+            }
+            if (cpus.size() == 0) cpus.push_back(0);
+            for (int i = 0; i < workers; i++) {
+                worker* w = new worker();
+                w->fPool = this;
+                w->fIndex = int(fWorkers.size());
+                w->fCPU = cpus[i % cpus.size()];
+                w->fNode = cpuNode(w->fCPU);
+                w->fCount = 0;
+                w->fCycle = 0;
+                if (pthread_create(&w->fThread, NULL, workHandler, w) == 0) {
+                    fWorkers.push_back(w);
+                } else {
+                    delete w;
+                }
+            }
+        }
+
+        virtual ~dsp_instance_pool()
+        {
+            pthread_mutex_lock(&fMutex);
+            fRunning = false;
+            pthread_cond_broadcast(&fCond);
+            pthread_mutex_unlock(&fMutex);
+            for (size_t i = 0; i < fWorkers.size(); i++) {
+                pthread_join(fWorkers[i]->fThread, NULL);
+                for (size_t j = 0; j < fWorkers[i]->fInstances.size(); j++) {
+                    delete fWorkers[i]->fInstances[j];
+                }
+                delete fWorkers[i];
+            }
+            pthread_mutex_destroy(&fMutex);
+            pthread_cond_destroy(&fCond);
+            pthread_cond_destroy(&fDoneCond);
+        }
+
+        /**
+         * Add an instance, cloned from an initialized prototype by the chosen worker (not to be called from 'compute').
+         *
+         * @param prototype - the DSP to clone
+         * @param worker - the worker hosting the instance, or -1 to let the pool choose
+         *
+         * @return the instance or 0 if the pool has no worker
+         */
+        pooled_dsp* add(dsp* prototype, int worker = -1)
+        {
+            if (fWorkers.size() == 0) return 0;
+            request r = { prototype, 0, 0, false };
+            post(worker, &r);
+            return r.fResult;
+        }
+
+        // Delete an instance in its worker thread (not to be called from 'compute')
+        void remove(pooled_dsp* instance)
+        {
+            request r = { 0, instance, 0, false };
+            post(instance->fWorker, &r);
+        }
+
+        /**
+         * Compute one cycle of 'count' frames (at most the buffer size) with all instances,
+         * each worker computing its instances. Returns when all instances are computed.
+         */
+        void compute(int count)
+        {
+            if (fWorkers.size() == 0) return;
+            fCount.store(count, std::memory_order_relaxed);
+            fPending.store(int(fWorkers.size()), std::memory_order_relaxed);
+            // Sequentially consistent: pairs with 'fSleeping++' then 'fCycle.load()' in 'work',
+            // so that either the worker sees the new cycle or 'signal' sees the sleeping worker
+            fCycle.fetch_add(1);
+            signal();
+            while (fPending.load(std::memory_order_acquire) > 0) {
+                relax();
+            }
+        }
+
+        int getNumWorkers() { return int(fWorkers.size()); }
+        int getWorkerCPU(int worker) { return fWorkers[worker]->fCPU; }
+        int getWorkerNode(int worker) { return fWorkers[worker]->fNode; }
+        int getWorkerInstances(int worker) { return fWorkers[worker]->fCount; }
+
+        int getSampleRate() { return fSampleRate; }
+        int getBufferSize() { return fBufferSize; }
+
+};
+
+#endif
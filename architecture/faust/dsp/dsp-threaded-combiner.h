@@ -0,0 +1,445 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __dsp_threaded_combiner__
+#define __dsp_threaded_combiner__
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <atomic>
+#include <vector>
+
+#include "faust/dsp/dsp-combiner.h"
+
+/**
+ * A unit of work executed by a dsp_thread_pool.
+ */
+
+struct dsp_task {
+
+    std::atomic<bool> fDone;
+
+    dsp_task():fDone(true) {}
+    virtual ~dsp_task() {}
+
+    virtual void run() = 0;
+};
+
+/**
+ * Task computing one block of a DSP.
+ */
+
+struct dsp_compute_task : public dsp_task {
+
+    dsp* fDSP;
+    int fCount;
+    FAUSTFLOAT** fInputs;
+    FAUSTFLOAT** fOutputs;
+
+    dsp_compute_task():fDSP(0), fCount(0), fInputs(0), fOutputs(0) {}
+
+    void set(dsp* dsp, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+    {
+        fDSP = dsp;
+        fCount = count;
+        fInputs = inputs;
+        fOutputs = outputs;
+    }
+
+    virtual void run() { fDSP->compute(fCount, fInputs, fOutputs); }
+};
+
+/**
+ * Pool of worker threads shared by all threaded combinators of a DSP graph.
+ *
+ * Tasks are pushed in a bounded lock-free queue (no allocation or lock in the audio path
+ * as long as the workers are busy). A thread waiting for a task helps executing the
+ * pending ones, so that arbitrarily nested sequencer/parallelizer trees are scheduled
+ * on the same pool without deadlock, whatever the number of workers.
+ * Idle workers spin for a while, then sleep until new tasks are pushed.
+ */
+
+class dsp_thread_pool {
+
+    private:
+
+        struct cell {
+            std::atomic<size_t> fSequence;
+            dsp_task* fTask;
+        };
+
+        cell* fCells;
+        size_t fMask;
+        std::atomic<size_t> fEnqueuePos;
+        std::atomic<size_t> fDequeuePos;
+
+        std::vector<pthread_t> fThreads;
+        std::atomic<bool> fRunning;
+        std::atomic<int> fSleeping;
+        pthread_mutex_t fMutex;
+        pthread_cond_t fCond;
+        int fSpinCount;
+        int fPriority;
+
+        static void relax()
+        {
+        #ifdef __SSE__
+            _mm_pause();
+        #else
+            sched_yield();
+        #endif
+        }
+
+        bool push(dsp_task* task)
+        {
+            size_t pos = fEnqueuePos.load(std::memory_order_relaxed);
+            for (;;) {
+                cell* c = &fCells[pos & fMask];
+                size_t seq = c->fSequence.load(std::memory_order_acquire);
+                intptr_t diff = intptr_t(seq) - intptr_t(pos);
+                if (diff == 0) {
+                    if (fEnqueuePos.compare_exchange_weak(pos, pos + 1)) {
+                        c->fTask = task;
+                        c->fSequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false; // Full
+                } else {
+                    pos = fEnqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool pop(dsp_task*& task)
+        {
+            size_t pos = fDequeuePos.load(std::memory_order_relaxed);
+            for (;;) {
+                cell* c = &fCells[pos & fMask];
+                size_t seq = c->fSequence.load(std::memory_order_acquire);
+                intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+                if (diff == 0) {
+                    if (fDequeuePos.compare_exchange_weak(pos, pos + 1)) {
+                        task = c->fTask;
+                        c->fSequence.store(pos + fMask + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false; // Empty
+                } else {
+                    pos = fDequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool isEmpty()
+        {
+            return fEnqueuePos.load() == fDequeuePos.load();
+        }
+
+        static void execute(dsp_task* task)
+        {
+            task->run();
+            task->fDone.store(true, std::memory_order_release);
+        }
+
+        void setRealtimePriority()
+        {
+            if (fPriority > 0) {
+                struct sched_param param;
+                param.sched_priority = fPriority;
+                pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            }
+        }
+
+        void work()
+        {
+            AVOIDDENORMALS;
+            setRealtimePriority();
+            while (fRunning) {
+                dsp_task* task;
+                bool found = false;
+                for (int i = 0; i < fSpinCount && !found; i++) {
+                    if (pop(task)) {
+                        execute(task);
+                        found = true;
+                    } else {
+                        relax();
+                    }
+                }
+                if (found) continue;
+                // Nothing to do : sleep until 'signal'
+                pthread_mutex_lock(&fMutex);
+                fSleeping++;
+                if (fRunning && isEmpty()) {
+                    pthread_cond_wait(&fCond, &fMutex);
+                }
+                fSleeping--;
+                pthread_mutex_unlock(&fMutex);
+            }
+        }
+
+        static void* workHandler(void* arg)
+        {
+            static_cast<dsp_thread_pool*>(arg)->work();
+            return 0;
+        }
+
+        void signal()
+        {
+            if (fSleeping.load() > 0) {
+                pthread_mutex_lock(&fMutex);
+                pthread_cond_signal(&fCond);
+                pthread_mutex_unlock(&fMutex);
+            }
+        }
+
+    public:
+
+        /**
+         * Create the pool.
+         *
+         * @param workers - the number of worker threads (the calling audio thread also executes tasks),
+         *                  if negative, one less than the number of available cores
+         * @param priority - SCHED_FIFO priority of the workers (0 to keep the default policy)
+         * @param spin_count - number of polling iterations before an idle worker goes to sleep
+         * @param queue_size - maximum number of pending tasks (rounded up to a power of two)
+         */
+        dsp_thread_pool(int workers = -1, int priority = 0, int spin_count = 20000, int queue_size = 256)
+            :fEnqueuePos(0), fDequeuePos(0), fRunning(true), fSleeping(0), fSpinCount(spin_count), fPriority(priority)
+        {
+            size_t size = 2;
+            while (size < size_t(queue_size)) size <<= 1;
+            fMask = size - 1;
+            fCells = new cell[size];
+            for (size_t i = 0; i < size; i++) {
+                fCells[i].fSequence.store(i, std::memory_order_relaxed);
+                fCells[i].fTask = 0;
+            }
+
+            pthread_mutex_init(&fMutex, NULL);
+            pthread_cond_init(&fCond, NULL);
+
+            if (workers < 0) {
+                long cores = sysconf(_SC_NPROCESSORS_ONLN);
+                workers = (cores > 1) ? int(cores - 1) : 0;
+            }
+            for (int i = 0; i < workers; i++) {
+                pthread_t thread;
+                if (pthread_create(&thread, NULL, workHandler, this) == 0) {
+                    fThreads.push_back(thread);
+                }
+            }
+        }
+
+        virtual ~dsp_thread_pool()
+        {
+            pthread_mutex_lock(&fMutex);
+            fRunning = false;
+            pthread_cond_broadcast(&fCond);
+            pthread_mutex_unlock(&fMutex);
+            for (size_t i = 0; i < fThreads.size(); i++) {
+                pthread_join(fThreads[i], NULL);
+            }
+            pthread_mutex_destroy(&fMutex);
+            pthread_cond_destroy(&fCond);
+            delete [] fCells;
+        }
+
+        int getNumWorkers() { return int(fThreads.size()); }
+
+        /**
+         * Make a task available to the workers. If there is no worker or the queue
+         * is full, the task is directly executed by the calling thread.
+         */
+        void submit(dsp_task* task)
+        {
+            task->fDone.store(false, std::memory_order_relaxed);
+            if (fThreads.size() > 0 && push(task)) {
+                signal();
+            } else {
+                execute(task);
+            }
+        }
+
+        /**
+         * Wait for a task to be done, executing pending tasks meanwhile.
+         */
+        void wait(dsp_task* task)
+        {
+            while (!task->fDone.load(std::memory_order_acquire)) {
+                dsp_task* pending;
+                if (pop(pending)) {
+                    execute(pending);
+                } else {
+                    relax();
+                }
+            }
+        }
+};
+
+/**
+ * Combine two DSP in parallel, DSP2 being computed by the thread pool while DSP1
+ * is computed by the calling thread.
+ *
+ * Nested threaded combinators sharing the same pool are scheduled together,
+ * so that the independent branches of a whole sequencer/parallelizer tree
+ * are dispatched on the workers.
+ */
+
+class dsp_threaded_parallelizer : public dsp_parallelizer {
+
+    private:
+
+        dsp_thread_pool* fPool;
+        dsp_compute_task fTask2;
+        FAUSTFLOAT** fInputsDSP2;
+        FAUSTFLOAT** fOutputsDSP2;
+
+    public:
+
+        dsp_threaded_parallelizer(dsp* dsp1, dsp* dsp2, dsp_thread_pool* pool)
+            :dsp_parallelizer(dsp1, dsp2), fPool(pool)
+        {
+            fInputsDSP2 = new FAUSTFLOAT*[fDSP2->getNumInputs() + 1];
+            fOutputsDSP2 = new FAUSTFLOAT*[fDSP2->getNumOutputs() + 1];
+        }
+
+        virtual ~dsp_threaded_parallelizer()
+        {
+            delete [] fInputsDSP2;
+            delete [] fOutputsDSP2;
+        }
+
+        virtual dsp* clone()
+        {
+            return new dsp_threaded_parallelizer(fDSP1->clone(), fDSP2->clone(), fPool);
+        }
+
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            // Shift inputs/outputs channels for fDSP2
+            for (int chan = 0; chan < fDSP2->getNumInputs(); chan++) {
+                fInputsDSP2[chan] = inputs[fDSP1->getNumInputs() + chan];
+            }
+            for (int chan = 0; chan < fDSP2->getNumOutputs(); chan++) {
+                fOutputsDSP2[chan] = outputs[fDSP1->getNumOutputs() + chan];
+            }
+
+            fTask2.set(fDSP2, count, fInputsDSP2, fOutputsDSP2);
+            fPool->submit(&fTask2);
+            fDSP1->compute(count, inputs, outputs);
+            fPool->wait(&fTask2);
+        }
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) { compute(count, inputs, outputs); }
+};
+
+/**
+ * Combine two DSP in sequence as a two stages pipeline: DSP1 computes the current block
+ * while DSP2 (on the thread pool) computes the previous one. This adds one block of latency.
+ *
+ * The pipeline assumes a constant block size: when 'count' changes, it is restarted
+ * (the block in flight is dropped and silence is produced for one block).
+ */
+
+class dsp_pipelined_sequencer : public dsp_sequencer {
+
+    private:
+
+        dsp_thread_pool* fPool;
+        dsp_compute_task fTask2;
+        FAUSTFLOAT** fPipeBuffer;   // Block computed by DSP1 during the previous cycle
+        int fPipeCount;             // Size of the block in flight, 0 when the pipeline is empty
+
+        void clearPipeline()
+        {
+            for (int i = 0; i < fDSP1->getNumOutputs(); i++) {
+                memset(fSeqBuffer[i], 0, sizeof(FAUSTFLOAT) * fBufferSize);
+                memset(fPipeBuffer[i], 0, sizeof(FAUSTFLOAT) * fBufferSize);
+            }
+            fPipeCount = 0;
+        }
+
+    public:
+
+        dsp_pipelined_sequencer(dsp* dsp1, dsp* dsp2, dsp_thread_pool* pool, int buffer_size = 4096)
+            :dsp_sequencer(dsp1, dsp2, buffer_size), fPool(pool)
+        {
+            fPipeBuffer = new FAUSTFLOAT*[fDSP1->getNumOutputs()];
+            for (int i = 0; i < fDSP1->getNumOutputs(); i++) {
+                fPipeBuffer[i] = new FAUSTFLOAT[buffer_size];
+            }
+            clearPipeline();
+        }
+
+        virtual ~dsp_pipelined_sequencer()
+        {
+            for (int i = 0; i < fDSP1->getNumOutputs(); i++) {
+                delete [] fPipeBuffer[i];
+            }
+            delete [] fPipeBuffer;
+        }
+
+        virtual void instanceInit(int samplingRate)
+        {
+            dsp_sequencer::instanceInit(samplingRate);
+            clearPipeline();
+        }
+
+        virtual void instanceClear()
+        {
+            dsp_sequencer::instanceClear();
+            clearPipeline();
+        }
+
+        virtual dsp* clone()
+        {
+            return new dsp_pipelined_sequencer(fDSP1->clone(), fDSP2->clone(), fPool, fBufferSize);
+        }
+
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            if (count == fPipeCount) {
+                // DSP2 consumes the previous block while DSP1 produces the current one
+                fTask2.set(fDSP2, count, fPipeBuffer, outputs);
+                fPool->submit(&fTask2);
+                fDSP1->compute(count, inputs, fSeqBuffer);
+                fPool->wait(&fTask2);
+            } else {
+                // (Re)fill the pipeline
+                for (int i = 0; i < fDSP2->getNumOutputs(); i++) {
+                    memset(outputs[i], 0, sizeof(FAUSTFLOAT) * count);
+                }
+                fDSP1->compute(count, inputs, fSeqBuffer);
+            }
+
+            FAUSTFLOAT** tmp = fSeqBuffer;
+            fSeqBuffer = fPipeBuffer;
+            fPipeBuffer = tmp;
+            fPipeCount = count;
+        }
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) { compute(count, inputs, outputs); }
+};
+
+#endif
@@ -24,10 +24,306 @@
 #ifndef __dsp_tools__
 #define __dsp_tools__
 
+#include <algorithm>
+
 #ifndef FAUSTFLOAT
 #define FAUSTFLOAT float
 #endif
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Sample formats handled by the (de)interleaving kernels.
+ * 'load' converts a sample to a real in [-1..1], 'store' converts (and clamps) a real to a sample.
+ */
+
+template <class T>
+struct real_sample {
+    typedef T type;
+    template <class REAL> static inline REAL load(const type& s) { return REAL(s); }
+    template <class REAL> static inline void store(type& s, REAL x) { s = type(x); }
+};
+
+typedef real_sample<float> float_sample;
+
+struct int16_sample {
+    typedef short type;
+    template <class REAL> static inline REAL load(const type& s) { return REAL(s) * REAL(1.0/32767.0); }
+    template <class REAL> static inline void store(type& s, REAL x)
+    {
+        s = short(((x < REAL(-1)) ? REAL(-1) : (x > REAL(1)) ? REAL(1) : x) * REAL(32767.0));
+    }
+};
+
+struct int24_t { unsigned char fBytes[3]; };  // Packed little endian 24 bits
+
+struct int24_sample {
+    typedef int24_t type;
+    template <class REAL> static inline REAL load(const type& s)
+    {
+        int v = int((unsigned int)(s.fBytes[0] << 8) | (unsigned int)(s.fBytes[1] << 16) | ((unsigned int)s.fBytes[2] << 24)) >> 8;
+        return REAL(v) * REAL(1.0/8388607.0);
+    }
+    template <class REAL> static inline void store(type& s, REAL x)
+    {
+        int v = int(((x < REAL(-1)) ? REAL(-1) : (x > REAL(1)) ? REAL(1) : x) * REAL(8388607.0));
+        s.fBytes[0] = (unsigned char)v;
+        s.fBytes[1] = (unsigned char)(v >> 8);
+        s.fBytes[2] = (unsigned char)(v >> 16);
+    }
+};
+
+struct int32_sample {
+    typedef int type;
+    template <class REAL> static inline REAL load(const type& s) { return REAL(s) * REAL(1.0/2147483648.0); }
+    template <class REAL> static inline void store(type& s, REAL x)
+    {
+        // Upper bound is the largest float below 1, so that the scaled value fits in an int
+        s = int(((x < REAL(-1)) ? REAL(-1) : (x > REAL(0.99999994f)) ? REAL(0.99999994f) : x) * REAL(2147483648.0));
+    }
+};
+
+/**
+ * Generic (de)interleaving kernels: the channel loop is unrolled for the usual channel counts
+ * so that the compiler sees constant strides.
+ */
+
+template <class SAMPLE, class REAL>
+struct sample_kernels {
+
+    typedef typename SAMPLE::type type;
+
+    template <int CHANS>
+    static inline void deinterleaveN(const type* in, REAL** outs, int chans, int frames)
+    {
+        const int n = (CHANS > 0) ? CHANS : chans;
+        for (int c = 0; c < n; c++) {
+            REAL* out = outs[c];
+            for (int f = 0; f < frames; f++) {
+                out[f] = SAMPLE::template load<REAL>(in[c + f * n]);
+            }
+        }
+    }
+
+    template <int CHANS>
+    static inline void interleaveN(REAL** ins, type* out, int chans, int frames)
+    {
+        const int n = (CHANS > 0) ? CHANS : chans;
+        for (int c = 0; c < n; c++) {
+            const REAL* in = ins[c];
+            for (int f = 0; f < frames; f++) {
+                SAMPLE::template store<REAL>(out[c + f * n], in[f]);
+            }
+        }
+    }
+
+    static void deinterleave(const type* in, REAL** outs, int chans, int frames)
+    {
+        switch (chans) {
+            case 1: deinterleaveN<1>(in, outs, chans, frames); break;
+            case 2: deinterleaveN<2>(in, outs, chans, frames); break;
+            case 4: deinterleaveN<4>(in, outs, chans, frames); break;
+            case 8: deinterleaveN<8>(in, outs, chans, frames); break;
+            case 16: deinterleaveN<16>(in, outs, chans, frames); break;
+            case 32: deinterleaveN<32>(in, outs, chans, frames); break;
+            case 64: deinterleaveN<64>(in, outs, chans, frames); break;
+            default: deinterleaveN<0>(in, outs, chans, frames); break;
+        }
+    }
+
+    static void interleave(REAL** ins, type* out, int chans, int frames)
+    {
+        switch (chans) {
+            case 1: interleaveN<1>(ins, out, chans, frames); break;
+            case 2: interleaveN<2>(ins, out, chans, frames); break;
+            case 4: interleaveN<4>(ins, out, chans, frames); break;
+            case 8: interleaveN<8>(ins, out, chans, frames); break;
+            case 16: interleaveN<16>(ins, out, chans, frames); break;
+            case 32: interleaveN<32>(ins, out, chans, frames); break;
+            case 64: interleaveN<64>(ins, out, chans, frames); break;
+            default: interleaveN<0>(ins, out, chans, frames); break;
+        }
+    }
+};
+
+#ifdef __SSE2__
+
+/**
+ * SSE2 kernels for float channels: 4 frames x 4 channels tiles are converted and transposed
+ * in registers (stereo uses shuffles). Used for float, 16 and 32 bits integer samples.
+ */
+
+struct sse_float_sample : public float_sample {
+    static inline __m128 load4(const type* p) { return _mm_loadu_ps(p); }
+    static inline void store4(type* p, __m128 x) { _mm_storeu_ps(p, x); }
+};
+
+struct sse_int16_sample : public int16_sample {
+    static inline __m128 load4(const type* p)
+    {
+        __m128i v = _mm_loadl_epi64((const __m128i*)p);
+        v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(float(1.0/32767.0)));
+    }
+    static inline void store4(type* p, __m128 x)
+    {
+        x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.f)), _mm_set1_ps(1.f));
+        __m128i v = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(32767.f)));
+        _mm_storel_epi64((__m128i*)p, _mm_packs_epi32(v, v));
+    }
+};
+
+struct sse_int32_sample : public int32_sample {
+    static inline __m128 load4(const type* p)
+    {
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)p)), _mm_set1_ps(float(1.0/2147483648.0)));
+    }
+    static inline void store4(type* p, __m128 x)
+    {
+        x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.f)), _mm_set1_ps(0.99999994f));
+        _mm_storeu_si128((__m128i*)p, _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(2147483648.f))));
+    }
+};
+
+template <class SAMPLE>
+struct sse_kernels {
+
+    typedef typename SAMPLE::type type;
+
+    template <int CHANS>
+    static inline void deinterleaveN(const type* in, float** outs, int chans, int frames)
+    {
+        const int n = (CHANS > 0) ? CHANS : chans;
+        int f = 0;
+        if (n == 1) {
+            for (; f + 4 <= frames; f += 4) {
+                _mm_storeu_ps(outs[0] + f, SAMPLE::load4(in + f));
+            }
+        } else if (n == 2) {
+            for (; f + 4 <= frames; f += 4) {
+                __m128 a = SAMPLE::load4(in + 2 * f);
+                __m128 b = SAMPLE::load4(in + 2 * f + 4);
+                _mm_storeu_ps(outs[0] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+                _mm_storeu_ps(outs[1] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+            }
+        } else if (n % 4 == 0) {
+            for (; f + 4 <= frames; f += 4) {
+                const type* p = in + f * n;
+                for (int c = 0; c < n; c += 4) {
+                    __m128 r0 = SAMPLE::load4(p + c);
+                    __m128 r1 = SAMPLE::load4(p + n + c);
+                    __m128 r2 = SAMPLE::load4(p + 2 * n + c);
+                    __m128 r3 = SAMPLE::load4(p + 3 * n + c);
+                    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                    _mm_storeu_ps(outs[c] + f, r0);
+                    _mm_storeu_ps(outs[c + 1] + f, r1);
+                    _mm_storeu_ps(outs[c + 2] + f, r2);
+                    _mm_storeu_ps(outs[c + 3] + f, r3);
+                }
+            }
+        }
+        for (const type* p = in + f * n; f < frames; f++, p += n) {
+            for (int c = 0; c < n; c++) {
+                outs[c][f] = SAMPLE::template load<float>(p[c]);
+            }
+        }
+    }
+
+    template <int CHANS>
+    static inline void interleaveN(float** ins, type* out, int chans, int frames)
+    {
+        const int n = (CHANS > 0) ? CHANS : chans;
+        int f = 0;
+        if (n == 1) {
+            for (; f + 4 <= frames; f += 4) {
+                SAMPLE::store4(out + f, _mm_loadu_ps(ins[0] + f));
+            }
+        } else if (n == 2) {
+            for (; f + 4 <= frames; f += 4) {
+                __m128 l = _mm_loadu_ps(ins[0] + f);
+                __m128 r = _mm_loadu_ps(ins[1] + f);
+                SAMPLE::store4(out + 2 * f, _mm_unpacklo_ps(l, r));
+                SAMPLE::store4(out + 2 * f + 4, _mm_unpackhi_ps(l, r));
+            }
+        } else if (n % 4 == 0) {
+            for (; f + 4 <= frames; f += 4) {
+                type* p = out + f * n;
+                for (int c = 0; c < n; c += 4) {
+                    __m128 r0 = _mm_loadu_ps(ins[c] + f);
+                    __m128 r1 = _mm_loadu_ps(ins[c + 1] + f);
+                    __m128 r2 = _mm_loadu_ps(ins[c + 2] + f);
+                    __m128 r3 = _mm_loadu_ps(ins[c + 3] + f);
+                    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                    SAMPLE::store4(p + c, r0);
+                    SAMPLE::store4(p + n + c, r1);
+                    SAMPLE::store4(p + 2 * n + c, r2);
+                    SAMPLE::store4(p + 3 * n + c, r3);
+                }
+            }
+        }
+        for (type* p = out + f * n; f < frames; f++, p += n) {
+            for (int c = 0; c < n; c++) {
+                SAMPLE::template store<float>(p[c], ins[c][f]);
+            }
+        }
+    }
+
+    static void deinterleave(const type* in, float** outs, int chans, int frames)
+    {
+        switch (chans) {
+            case 1: deinterleaveN<1>(in, outs, chans, frames); break;
+            case 2: deinterleaveN<2>(in, outs, chans, frames); break;
+            case 4: deinterleaveN<4>(in, outs, chans, frames); break;
+            case 8: deinterleaveN<8>(in, outs, chans, frames); break;
+            case 16: deinterleaveN<16>(in, outs, chans, frames); break;
+            case 32: deinterleaveN<32>(in, outs, chans, frames); break;
+            case 64: deinterleaveN<64>(in, outs, chans, frames); break;
+            default: deinterleaveN<0>(in, outs, chans, frames); break;
+        }
+    }
+
+    static void interleave(float** ins, type* out, int chans, int frames)
+    {
+        switch (chans) {
+            case 1: interleaveN<1>(ins, out, chans, frames); break;
+            case 2: interleaveN<2>(ins, out, chans, frames); break;
+            case 4: interleaveN<4>(ins, out, chans, frames); break;
+            case 8: interleaveN<8>(ins, out, chans, frames); break;
+            case 16: interleaveN<16>(ins, out, chans, frames); break;
+            case 32: interleaveN<32>(ins, out, chans, frames); break;
+            case 64: interleaveN<64>(ins, out, chans, frames); break;
+            default: interleaveN<0>(ins, out, chans, frames); break;
+        }
+    }
+};
+
+template <> struct sample_kernels<float_sample, float> : public sse_kernels<sse_float_sample> {};
+template <> struct sample_kernels<int16_sample, float> : public sse_kernels<sse_int16_sample> {};
+template <> struct sample_kernels<int32_sample, float> : public sse_kernels<sse_int32_sample> {};
+
+#endif
+
+/**
+ * Deinterleave 'frames' frames of 'chans' channels, converting the samples to REAL.
+ * Usage: deinterleaveSamples<int16_sample>(card_buffer, channels, 2, 512)
+ */
+template <class SAMPLE, class REAL>
+inline void deinterleaveSamples(const typename SAMPLE::type* in, REAL** outs, int chans, int frames)
+{
+    sample_kernels<SAMPLE, REAL>::deinterleave(in, outs, chans, frames);
+}
+
+/**
+ * Interleave 'frames' frames of 'chans' channels, converting (and clamping) REAL to samples.
+ */
+template <class SAMPLE, class REAL>
+inline void interleaveSamples(REAL** ins, typename SAMPLE::type* out, int chans, int frames)
+{
+    sample_kernels<SAMPLE, REAL>::interleave(ins, out, chans, frames);
+}
+
 class Deinterleaver
 {
     
@@ -46,14 +342,14 @@ class Deinterleaver
         {
             fNumFrames = numFrames;
             fNumInputs = numInputs;
-            fNumOutputs = max(numInputs, numOutputs);
+            fNumOutputs = std::max(numInputs, numOutputs);
             
             // allocate interleaved input channel
-            fInput = new FAUSTFLOAT[fNumFrames * fNumInputs];
+            fInput = new FAUSTFLOAT[fNumFrames * fNumInputs]();
             
             // allocate separate output channels
             for (int i = 0; i < fNumOutputs; i++) {
-                fOutputs[i] = new FAUSTFLOAT[fNumFrames];
+                fOutputs[i] = new FAUSTFLOAT[fNumFrames]();
             }
         }
         
@@ -68,17 +364,15 @@ class Deinterleaver
             }
         }
         
+        int numFrames() { return fNumFrames; }
+        
         FAUSTFLOAT* input() { return fInput; }
         
         FAUSTFLOAT** outputs() { return fOutputs; }
         
         void deinterleave()
         {
-            for (int s = 0; s < fNumFrames; s++) {
-                for (int c = 0; c < fNumInputs; c++) {
-                    fOutputs[c][s] = fInput[c + s * fNumInputs];
-                }
-            }
+            deinterleaveSamples<real_sample<FAUSTFLOAT> >(fInput, fOutputs, fNumInputs, fNumFrames);
         }
 };
 
@@ -102,11 +396,11 @@ class Interleaver
             
             // allocate separate input channels
             for (int i = 0; i < fNumChans; i++) {
-                fInputs[i] = new FAUSTFLOAT[fNumFrames];
+                fInputs[i] = new FAUSTFLOAT[fNumFrames]();
             }
             
             // allocate interleaved output channel
-            fOutput = new FAUSTFLOAT[fNumFrames * fNumChans];
+            fOutput = new FAUSTFLOAT[fNumFrames * fNumChans]();
         }
         
         ~Interleaver()
@@ -120,17 +414,15 @@ class Interleaver
             delete [] fOutput;
         }
         
+        int numFrames() { return fNumFrames; }
+        
         FAUSTFLOAT** inputs() { return fInputs; }
         
         FAUSTFLOAT* output() { return fOutput; }
         
         void interleave()
         {
-            for (int s = 0; s < fNumFrames; s++) {
-                for (int c = 0; c < fNumChans; c++) {
-                    fOutput[c + s * fNumChans] = fInputs[c][s];
-                }
-            }
+            interleaveSamples<real_sample<FAUSTFLOAT> >(fInputs, fOutput, fNumChans, fNumFrames);
         }
 };
 
@@ -308,6 +308,7 @@ class FaustPolyEngine {
             int id = fAPIUI.getParamIndex(address);
             if (id >= 0) {
                 fAPIUI.setParamValue(id, value);
+                GUI::notifyZone(fAPIUI.getParamZone(id));
                 // In POLY mode, update all voices
                 GUI::updateAllGuis();
             }
@@ -331,6 +332,7 @@ class FaustPolyEngine {
         void setParamValue(int id, float value)
         {
             fAPIUI.setParamValue(id, value);
+            GUI::notifyZone(fAPIUI.getParamZone(id));
             // In POLY mode, update all voices
             GUI::updateAllGuis();
         }
@@ -0,0 +1,209 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __fft_convolver__
+#define __fft_convolver__
+
+#include <vector>
+#include <complex>
+#include <algorithm>
+#include <math.h>
+
+/**
+ * Zero latency FIR filter, used by the code generated with the -fir option.
+ *
+ * The first 'B' taps (the head) are computed in direct form, the following ones
+ * by uniformly partitioned FFT convolution (overlap-save with 2B points FFTs):
+ * each time a block of B input samples is complete, its spectrum is computed and
+ * the contribution of all the partitions to the next block of output is
+ * accumulated in the frequency domain, so compute() never adds any latency.
+ */
+class fft_convolver {
+
+    private:
+
+        typedef std::complex<double> complex;
+
+        int fBlockSize;                     // B : size of the head and of the partitions
+        int fPartitions;                    // number of partitions after the head
+        int fPos;                           // position in the current input block
+        int fLast;                          // index of the spectrum of the last complete input window
+
+        std::vector<double> fHead;          // the B first taps
+        std::vector<complex> fFilters;      // spectra of the partitions, (B+1) bins each
+        std::vector<complex> fSpectra;      // spectra of the last input windows, circular buffer
+        std::vector<double> fInput;         // previous and current input blocks (2B)
+        std::vector<double> fOutput;        // contribution of the partitions to the current output block (B)
+        std::vector<complex> fAccu;         // output spectrum (B+1 bins)
+        std::vector<complex> fWork;         // 2B points FFT buffer
+        std::vector<complex> fTwiddles;     // exp(-i.pi.k/B)
+        std::vector<int> fReverse;          // bit reversal permutation
+
+        // Product without the inf/nan handling of the std::complex one
+        static inline complex mul(const complex& a, const complex& b)
+        {
+            return complex(a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real());
+        }
+
+        void fft(bool inverse)
+        {
+            int n = 2 * fBlockSize;
+            for (int i = 0; i < n; i++) {
+                if (i < fReverse[i]) std::swap(fWork[i], fWork[fReverse[i]]);
+            }
+            for (int len = 2; len <= n; len *= 2) {
+                int step = n / len;
+                for (int i = 0; i < n; i += len) {
+                    for (int k = 0; k < len/2; k++) {
+                        complex w = (inverse) ? std::conj(fTwiddles[k*step]) : fTwiddles[k*step];
+                        complex u = fWork[i+k];
+                        complex v = mul(fWork[i+k+len/2], w);
+                        fWork[i+k] = u + v;
+                        fWork[i+k+len/2] = u - v;
+                    }
+                }
+            }
+        }
+
+        // Spectrum of the real signal in fWork, (B+1) bins stored in dst
+        void forward(complex* dst)
+        {
+            fft(false);
+            for (int k = 0; k <= fBlockSize; k++) dst[k] = fWork[k];
+        }
+
+        // Real signal of the (B+1) bins spectrum src, in fWork (not normalized)
+        void inverse(const complex* src)
+        {
+            int n = 2 * fBlockSize;
+            fWork[0] = src[0];
+            for (int k = 1; k < fBlockSize; k++) {
+                fWork[k] = src[k];
+                fWork[n-k] = std::conj(src[k]);
+            }
+            fWork[fBlockSize] = src[fBlockSize];
+            fft(true);
+        }
+
+        // Called when the current input block is complete : prepare the output of the next one
+        void nextBlock()
+        {
+            int B = fBlockSize;
+            if (fPartitions > 0) {
+                fLast = (fLast + 1) % fPartitions;
+                for (int i = 0; i < 2*B; i++) fWork[i] = fInput[i];
+                forward(&fSpectra[fLast*(B+1)]);
+
+                // partition p (1..P) is applied to the window completed p-1 blocks ago
+                std::fill(fAccu.begin(), fAccu.end(), complex(0, 0));
+                for (int p = 0; p < fPartitions; p++) {
+                    const complex* x = &fSpectra[((fLast - p + fPartitions) % fPartitions)*(B+1)];
+                    const complex* h = &fFilters[p*(B+1)];
+                    for (int k = 0; k <= B; k++) fAccu[k] += mul(x[k], h[k]);
+                }
+                inverse(&fAccu[0]);
+                for (int i = 0; i < B; i++) fOutput[i] = fWork[B+i].real() / double(2*B);
+            }
+            for (int i = 0; i < B; i++) fInput[i] = fInput[B+i];
+            fPos = 0;
+        }
+
+    public:
+
+        fft_convolver():fBlockSize(0), fPartitions(0), fPos(0), fLast(0)
+        {}
+
+        /**
+         * Set the impulse response : 'taps' coefficients.
+         * The block size is a power of two (chosen from the number of taps when 0).
+         */
+        void init(const double* coefs, int taps, int blocksize = 0)
+        {
+            if (blocksize <= 0) {
+                // balance the direct head (B mult-adds) with the partitions (~ 8*taps/B flops)
+                blocksize = int(sqrt(8.0 * taps));
+            }
+            int B = 16;
+            while (B < blocksize && B < 8192) B *= 2;
+            fBlockSize = B;
+            fPartitions = (taps > B) ? (taps - 1) / B : 0;
+
+            fHead.assign(B, 0.0);
+            for (int i = 0; i < B && i < taps; i++) fHead[i] = coefs[i];
+
+            const double pi = 4.0 * atan(1.0);
+            fTwiddles.resize(B);
+            for (int k = 0; k < B; k++) fTwiddles[k] = std::polar(1.0, -pi * k / B);
+            fReverse.resize(2*B);
+            for (int i = 0, j = 0; i < 2*B; i++) {
+                fReverse[i] = j;
+                int bit = B;
+                while (j & bit) { j ^= bit; bit >>= 1; }
+                j |= bit;
+            }
+            fWork.resize(2*B);
+            fAccu.resize(B+1);
+
+            fFilters.assign(fPartitions*(B+1), complex(0, 0));
+            for (int p = 0; p < fPartitions; p++) {
+                for (int i = 0; i < 2*B; i++) {
+                    int t = (p+1)*B + i;
+                    fWork[i] = (i < B && t < taps) ? coefs[t] : 0.0;
+                }
+                forward(&fFilters[p*(B+1)]);
+            }
+            fSpectra.resize(fPartitions*(B+1));
+            fInput.resize(2*B);
+            fOutput.resize(B);
+            clear();
+        }
+
+        /**
+         * Reset the state of the filter.
+         */
+        void clear()
+        {
+            std::fill(fSpectra.begin(), fSpectra.end(), complex(0, 0));
+            std::fill(fInput.begin(), fInput.end(), 0.0);
+            std::fill(fOutput.begin(), fOutput.end(), 0.0);
+            fPos = 0;
+            fLast = 0;
+        }
+
+        /**
+         * Filter one sample.
+         */
+        inline double compute(double x)
+        {
+            int B = fBlockSize;
+            fInput[B + fPos] = x;
+            const double* in = &fInput[B + fPos];
+            double y = fOutput[fPos];
+            for (int k = 0; k < B; k++) y += fHead[k] * in[-k];
+            if (++fPos == B) nextBlock();
+            return y;
+        }
+
+};
+
+#endif
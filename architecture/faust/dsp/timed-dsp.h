@@ -25,13 +25,14 @@
 #define __timed_dsp__
 
 #include <set>
+#include <algorithm>
+#include <utility>
 #include <float.h>
 #include <assert.h>
 
 #include "faust/dsp/dsp.h" 
 #include "faust/gui/GUI.h" 
 #include "faust/gui/DecoratorUI.h"
-#include "faust/gui/ring-buffer.h"
 
 namespace {
     
@@ -84,9 +85,7 @@ struct ZoneUI : public GenericUI
     
     void insertZone(FAUSTFLOAT* zone) 
     { 
-        if (GUI::gTimedZoneMap.find(zone) != GUI::gTimedZoneMap.end()) {
-            fZoneSet.insert(zone);
-        } 
+        fZoneSet.insert(zone);
     }
     
     // -- active widgets
@@ -127,6 +126,12 @@ struct ZoneUI : public GenericUI
  * Timed signal processor that allows to handle the decorated DSP by 'slices'
  * that is, calling the 'compute' method several times and changing control
  * parameters between slices.
+ *
+ * It is the consumer of the GUI control bus : once per block, all pending changes
+ * coming from the controllers (OSC, HTTP, MIDI) are read, dated ones are applied at
+ * their date (when they concern a zone of the decorated DSP), the others at the
+ * beginning of the block. At most kMaxControls changes are read per block, the
+ * following ones are applied in the next blocks.
  */
 
 class timed_dsp : public decorator_dsp {
@@ -137,6 +142,10 @@ class timed_dsp : public decorator_dsp {
         double fOffsetUsec;     // Compute call offset in usec
         bool fFirstCallback;
         ZoneUI fZoneUI;
+        ControlBus::Control* fControls;         // read controls, allocated once
+        std::pair<double, int>* fOrder;         // (date, index) of the read controls
+        
+        enum { kMaxControls = ControlBus::kGroupSize };
         
         void computeSlice(int offset, int slice, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) 
         {
@@ -160,68 +169,61 @@ class timed_dsp : public decorator_dsp {
             return std::max<double>(0., (double(getSampleRate()) * (usec - fDateUsec)) / 1000000.);
         }
         
-        ztimedmap::iterator getNextControl(DatedControl& res, bool convert_ts)
+        // Read pending controls and sort them by date (the index keeps the arrival order of controls with the same date)
+        int getControls(int count, bool convert_ts)
         {
-            DatedControl date1(DBL_MAX, 0);
-            ztimedmap::iterator it1, it2 = GUI::gTimedZoneMap.end();
-            std::set<FAUSTFLOAT*>::iterator it3;
-              
-            // Find date of next audio slice to compute
-            for (it3 = fZoneUI.fZoneSet.begin(); it3 != fZoneUI.fZoneSet.end(); it3++) {
-                // If value list is not empty, get the date and keep the minimal one
-                it1 = GUI::gTimedZoneMap.find(*it3);
-                if (it1 != GUI::gTimedZoneMap.end()) { // Check if zone still in global GUI::gTimedZoneMap (since MidiUI may have been desallocated)
-                    DatedControl date2;
-                    if (ringbuffer_peek((*it1).second, (char*)&date2, sizeof(DatedControl)) == sizeof(DatedControl) 
-                        && date2.fDate < date1.fDate) {
-                        it2 = it1;
-                        date1 = date2;
-                    }
+            int size = GUI::controlBus().read(fControls, kMaxControls);
+            for (int i = 0; i < size; i++) {
+                double date = fControls[i].fDate;
+                if (date < 0 || fZoneUI.fZoneSet.find(fControls[i].fZone) == fZoneUI.fZoneSet.end()) {
+                    // Not dated, or zone of another DSP : applied at the beginning of the block
+                    date = 0;
+                } else if (convert_ts) {
+                    date = convertUsecToSample(date);
                 }
+                fOrder[i] = std::make_pair(std::min<double>(date, count), i);
             }
-            
-            // If needed, convert date1 in samples from begining of the buffer, possible moving to 0 (if negative)
-            if (convert_ts) {
-                date1.fDate = convertUsecToSample(date1.fDate);
-            }
-                
-            res = date1;
-            return it2;
+            std::sort(fOrder, fOrder + size);
+            return size;
         }
         
         virtual void computeAux(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs, bool convert_ts)
         {
-            int slice, offset = 0;
-            ztimedmap::iterator it;
-            DatedControl next_control;
-             
+            int offset = 0;
+            int size = getControls(count, convert_ts);
+            
             // Do audio computation "slice" by "slice"
-            while ((it = getNextControl(next_control, convert_ts)) != GUI::gTimedZoneMap.end()) {
-                     
+            for (int i = 0; i < size; i++) {
+                
                 // Compute audio slice
-                slice = int(next_control.fDate) - offset;
-                computeSlice(offset, slice, inputs, outputs);
-                offset += slice;
+                int date = int(fOrder[i].first);
+                computeSlice(offset, date - offset, inputs, outputs);
+                offset = std::max(offset, date);
                
                 // Update control
-                ringbuffer_t* control_values = (*it).second;
-                *((*it).first) = next_control.fValue;
-                
-                // Move ringbuffer pointer
-                ringbuffer_read_advance(control_values, sizeof(DatedControl));
+                const ControlBus::Control& control = fControls[fOrder[i].second];
+                *control.fZone = control.fValue;
+                GUI::notifyZone(control.fZone);
             } 
             
             // Compute last audio slice
-            slice = count - offset;
-            computeSlice(offset, slice, inputs, outputs);
+            computeSlice(offset, count - offset, inputs, outputs);
         }
 
     public:
 
         timed_dsp(dsp* dsp):decorator_dsp(dsp), fDateUsec(0), fOffsetUsec(0), fFirstCallback(true)
-        {}
+        {
+            fControls = new ControlBus::Control[ControlBus::kSize];
+            fOrder = new std::pair<double, int>[ControlBus::kSize];
+            GUI::controlBus().attach();
+        }
         virtual ~timed_dsp() 
-        {}
+        {
+            GUI::controlBus().detach();
+            delete [] fControls;
+            delete [] fOrder;
+        }
         
         virtual void init(int samplingRate)
         {
@@ -231,7 +233,7 @@ class timed_dsp : public decorator_dsp {
         virtual void buildUserInterface(UI* ui_interface)   
         { 
             fDSP->buildUserInterface(ui_interface); 
-            // Only keep zones that are in GUI::gTimedZoneMap
+            // Keep the zones of the decorated DSP
             fDSP->buildUserInterface(&fZoneUI);
         }
     
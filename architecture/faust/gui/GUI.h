@@ -28,6 +28,7 @@
 #include <map>
 #include <vector>
 #include <iostream>
+#include <atomic>
 
 #include "faust/gui/UI.h"
 #include "faust/gui/ring-buffer.h"
@@ -39,6 +40,7 @@
  ******************************************************************************/
 
 class uiItem;
+class ControlBus;
 typedef void (*uiCallback)(FAUSTFLOAT val, void* data);
 
 class clist : public std::list<uiItem*>
@@ -46,10 +48,81 @@ class clist : public std::list<uiItem*>
     
     public:
     
+        bool fPolled;   // zone changed without notification (like bargraphs), so checked at each refresh
+    
+        clist():fPolled(false) {}
         virtual ~clist();
         
 };
 
+/**
+ * Log of modified zones shared by all GUIs : writers append the zone, and each GUI
+ * reads the log from its own position. Several threads can write, a reader that is
+ * too late (or that sees an entry being overwritten) has to check all its zones.
+ */
+
+class ZoneChangeLog
+{
+    
+    private:
+    
+        enum { kSize = 4096 };
+    
+        struct Entry {
+            std::atomic<unsigned long long> fSeq;   // position + 1 when written
+            std::atomic<FAUSTFLOAT*> fZone;
+        };
+    
+        Entry fEntries[kSize];
+        std::atomic<unsigned long long> fWrite;
+    
+    public:
+    
+        ZoneChangeLog():fWrite(0)
+        {
+            for (int i = 0; i < kSize; i++) {
+                fEntries[i].fSeq.store(0);
+                fEntries[i].fZone.store(0);
+            }
+        }
+    
+        void push(FAUSTFLOAT* zone)
+        {
+            unsigned long long pos = fWrite.fetch_add(1, std::memory_order_relaxed);
+            Entry& entry = fEntries[pos % kSize];
+            entry.fZone.store(zone, std::memory_order_relaxed);
+            entry.fSeq.store(pos + 1, std::memory_order_release);
+        }
+    
+        unsigned long long position() { return fWrite.load(std::memory_order_acquire); }
+    
+        // Read the zones written from 'pos', returns false if some of them were lost
+        bool read(unsigned long long& pos, std::vector<FAUSTFLOAT*>& zones)
+        {
+            unsigned long long write = position();
+            if (write - pos > kSize) {
+                pos = write;
+                return false;
+            }
+            for (; pos < write; pos++) {
+                Entry& entry = fEntries[pos % kSize];
+                unsigned long long seq = entry.fSeq.load(std::memory_order_acquire);
+                if (seq < pos + 1) {
+                    break;  // still being written, will be read at next refresh
+                }
+                FAUSTFLOAT* zone = entry.fZone.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq != pos + 1 || entry.fSeq.load(std::memory_order_relaxed) != seq) {
+                    pos = write;
+                    return false;
+                }
+                zones.push_back(zone);
+            }
+            return true;
+        }
+    
+};
+
 typedef std::map<FAUSTFLOAT*, clist*> zmap;
 
 typedef std::map<FAUSTFLOAT*, ringbuffer_t*> ztimedmap;
@@ -62,11 +135,31 @@ class GUI : public UI
         static std::list<GUI*>  fGuiList;
         zmap                    fZoneMap;
         bool                    fStopped;
+    
+        // Incremental refresh state
+        unsigned long long          fChangePos;
+        bool                        fChecked;
+        zmap::iterator              fSweep;
+        std::vector<zmap::iterator> fPolledZones;
+        std::vector<FAUSTFLOAT*>    fChangedZones;
+    
+        enum { kSweepSize = 64 };
+    
+        static ZoneChangeLog& changeLog()
+        {
+            static ZoneChangeLog log;
+            return log;
+        }
+    
+        static bool reflectItems(FAUSTFLOAT v, clist* l);
+    
+        void sweepZones();
         
      public:
             
-        GUI() : fStopped(false) 
+        GUI() : fStopped(false), fChangePos(changeLog().position()), fChecked(false)
         {	
+            fSweep = fZoneMap.end();
             fGuiList.push_back(this);
         }
         
@@ -88,10 +181,28 @@ class GUI : public UI
             if (fZoneMap.find(z) == fZoneMap.end()) fZoneMap[z] = new clist();
             fZoneMap[z]->push_back(c);
         }
+    
+        // Items of a registered zone, can be kept by code updating the zone at high rate
+        clist* getZoneItems(FAUSTFLOAT* z)
+        {
+            zmap::iterator it = fZoneMap.find(z);
+            return (it != fZoneMap.end()) ? it->second : 0;
+        }
 
+        // Zones modified since the last refresh, zones changed without notification and a
+        // few other zones (in a round robin way) are checked
         void updateAllZones();
+    
+        // All zones are checked
+        void checkAllZones();
         
         void updateZone(FAUSTFLOAT* z);
+    
+        // To be called by code that directly changes a zone, so that GUIs reflect it
+        static void notifyZone(FAUSTFLOAT* z) { changeLog().push(z); }
+    
+        // Bus used by controllers running in their own thread to send changes to the audio thread
+        static ControlBus& controlBus();
         
         static void updateAllGuis()
         {
@@ -131,11 +242,187 @@ class GUI : public UI
 
         virtual void declare(FAUSTFLOAT* , const char* , const char*) {}
     
-        // Static global for timed zones, shared between all UI that will set timed values
+        // Previously used for timed zones, now replaced by controlBus() and kept for existing architecture files
         static ztimedmap gTimedZoneMap;
 
 };
 
+/**
+ * Control bus from the controller threads (OSC, HTTP, MIDI) to the audio thread : a bounded
+ * queue of (zone, value, date) records, written by several threads without lock or allocation,
+ * and read once per block by a single consumer (see timed_dsp). Records written inside a group
+ * are published together, so that a multi-parameter update is applied in the same block.
+ * When no consumer is attached, or when the bus is full, write() returns false and the
+ * controller has to directly change the zone, as before.
+ */
+
+class ControlBus
+{
+    
+    public:
+    
+        struct Control {
+            FAUSTFLOAT* fZone;
+            FAUSTFLOAT fValue;
+            double fDate;       // in usec or frames depending of the consumer, or -1 for 'as soon as possible'
+        };
+    
+        enum { kSize = 4096, kGroupSize = 256 };
+    
+    private:
+    
+        struct Cell {
+            std::atomic<unsigned long long> fSeq;   // position when free, position + 1 when written
+            Control fControl;
+            int fCount;                             // group size in its first cell
+        };
+    
+        // Controls of a group, only allocating on the controller thread when a group exceeds kGroupSize
+        struct Group {
+            std::vector<Control> fControls;
+            int fDepth;
+            Group():fDepth(0) {}
+        };
+    
+        Cell fCells[kSize];
+        std::atomic<unsigned long long> fWrite;
+        unsigned long long fRead;
+        std::atomic<int> fConsumers;
+        std::atomic<bool> fReading;
+    
+        // Group being written by the current thread
+        static Group& currentGroup()
+        {
+            static thread_local Group group;
+            return group;
+        }
+    
+        void flush(Group& group)
+        {
+            int count = int(group.fControls.size());
+            if (count > 0 && !push(&group.fControls[0], count)) {
+                // Bus full or group larger than the bus : changes are directly applied
+                for (int i = 0; i < count; i++) {
+                    *group.fControls[i].fZone = group.fControls[i].fValue;
+                    GUI::notifyZone(group.fControls[i].fZone);
+                }
+            }
+            group.fControls.clear();
+        }
+    
+    public:
+    
+        ControlBus():fWrite(0), fRead(0), fConsumers(0), fReading(false)
+        {
+            for (int i = 0; i < kSize; i++) {
+                fCells[i].fSeq.store(i);
+            }
+        }
+    
+        // Consumers (audio side)
+        void attach() { fConsumers++; }
+        void detach() { fConsumers--; }
+        bool isActive() { return fConsumers.load(std::memory_order_relaxed) > 0; }
+    
+        // Publish 'count' consecutive records, returns false if the bus is full
+        bool push(const Control* controls, int count)
+        {
+            if (count <= 0 || count > kSize) return false;
+            unsigned long long pos = fWrite.load(std::memory_order_relaxed);
+            for (;;) {
+                // The last cell of the range is free only if all the previous ones are
+                unsigned long long last = pos + count - 1;
+                long long dif = (long long)(fCells[last % kSize].fSeq.load(std::memory_order_acquire) - last);
+                if (dif == 0) {
+                    if (fWrite.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) break;
+                } else if (dif < 0) {
+                    return false;
+                } else {
+                    pos = fWrite.load(std::memory_order_relaxed);
+                }
+            }
+            for (int i = 0; i < count; i++) {
+                Cell& cell = fCells[(pos + i) % kSize];
+                cell.fControl = controls[i];
+                cell.fCount = (i == 0) ? count : 0;
+                cell.fSeq.store(pos + i + 1, std::memory_order_release);
+            }
+            return true;
+        }
+    
+        // Controller side : returns false if the caller has to change the zone itself
+        bool write(FAUSTFLOAT* zone, FAUSTFLOAT value, double date = -1.)
+        {
+            if (!isActive()) return false;
+            Control control = { zone, value, date };
+            Group& group = currentGroup();
+            if (group.fDepth > 0) {
+                group.fControls.push_back(control);
+                return true;
+            } else {
+                return push(&control, 1);
+            }
+        }
+    
+        // Records written by the current thread between beginGroup/endGroup are published together,
+        // a group of more than kSize records is directly applied by the controller thread
+        void beginGroup()
+        {
+            Group& group = currentGroup();
+            if (group.fDepth++ == 0 && group.fControls.capacity() == 0) group.fControls.reserve(kGroupSize);
+        }
+        void endGroup()
+        {
+            Group& group = currentGroup();
+            if (--group.fDepth == 0) flush(group);
+        }
+    
+        // Consumer side : read at most 'max' records, groups are never split (a first group
+        // larger than 'max' is read alone, so 'controls' has to hold kSize records)
+        int read(Control* controls, int max)
+        {
+            bool reading = false;
+            if (!fReading.compare_exchange_strong(reading, true, std::memory_order_acquire)) return 0;
+            int res = 0;
+            for (;;) {
+                Cell& first = fCells[fRead % kSize];
+                if (first.fSeq.load(std::memory_order_acquire) != fRead + 1) break;
+                int count = first.fCount;
+                // Cells of a group are published in order, so the last one tells that the group is complete
+                if ((res > 0 && res + count > max)
+                    || fCells[(fRead + count - 1) % kSize].fSeq.load(std::memory_order_acquire) != fRead + count) break;
+                for (int i = 0; i < count; i++) {
+                    Cell& cell = fCells[(fRead + i) % kSize];
+                    controls[res++] = cell.fControl;
+                    cell.fSeq.store(fRead + i + kSize, std::memory_order_release);
+                }
+                fRead += count;
+            }
+            fReading.store(false, std::memory_order_release);
+            return res;
+        }
+    
+};
+
+/**
+ * Publishes the controls written during its lifetime as a single group
+ */
+
+struct ControlGroup {
+    
+    ControlBus& fBus;
+    
+    ControlGroup(ControlBus& bus):fBus(bus) { fBus.beginGroup(); }
+    ~ControlGroup() { fBus.endGroup(); }
+    
+};
+
+inline ControlBus& GUI::controlBus()
+{
+    static ControlBus bus;
+    return bus;
+}
+
 /**
  * User Interface Item: abstract definition
  */
@@ -211,53 +498,25 @@ struct uiCallbackItem : public uiItem {
 };
 
 /**
- * Base class for timed items
+ * Base class for timed items : dated changes are sent on the control bus, to be
+ * applied at their date by timed_dsp, or directly applied when there is no consumer.
  */
 
-// For precise timestamped control
-struct DatedControl {
-    
-    double fDate;
-    FAUSTFLOAT fValue;
-    
-    DatedControl(double d = 0., FAUSTFLOAT v = FAUSTFLOAT(0)):fDate(d), fValue(v) {}
-    
-};
-
 class uiTimedItem : public uiItem
 {
     
-    protected:
-        
-        bool fDelete;
-        
     public:
         
         uiTimedItem(GUI* ui, FAUSTFLOAT* zone):uiItem(ui, zone)
-        {
-            if (GUI::gTimedZoneMap.find(fZone) == GUI::gTimedZoneMap.end()) {
-                GUI::gTimedZoneMap[fZone] = ringbuffer_create(8192);
-                fDelete = true;
-            } else {
-                fDelete = false;
-            }
-        }
+        {}
         
         virtual ~uiTimedItem()
-        {
-            ztimedmap::iterator it;
-            if (fDelete && ((it = GUI::gTimedZoneMap.find(fZone)) != GUI::gTimedZoneMap.end())) {
-                ringbuffer_free((*it).second);
-                GUI::gTimedZoneMap.erase(it);
-            }
-        }
+        {}
         
         virtual void modifyZone(double date, FAUSTFLOAT v)
         {
-            size_t res;
-            DatedControl dated_val(date, v);
-            if ((res = ringbuffer_write(GUI::gTimedZoneMap[fZone], (const char*)&dated_val, sizeof(DatedControl))) != sizeof(DatedControl)) {
-                std::cerr << "ringbuffer_write error DatedControl" << std::endl;
+            if (!GUI::controlBus().write(fZone, v, date)) {
+                uiItem::modifyZone(v);
             }
         }
     
@@ -296,6 +555,22 @@ class uiGroupItem : public uiItem
 
 };
 
+/**
+ * Update items of a zone that are not up to date, returns true if some were updated
+ */
+
+inline bool GUI::reflectItems(FAUSTFLOAT v, clist* l)
+{
+    bool changed = false;
+    for (clist::iterator c = l->begin(); c != l->end(); c++) {
+        if ((*c)->cache() != v) {
+            (*c)->reflectZone();
+            changed = true;
+        }
+    }
+    return changed;
+}
+
 /**
  * Update all user items reflecting zone z
  */
@@ -307,23 +582,70 @@ inline void GUI::updateZone(FAUSTFLOAT* z)
 	for (clist::iterator c = l->begin(); c != l->end(); c++) {
 		if ((*c)->cache() != v) (*c)->reflectZone();
 	}
+    notifyZone(z);
 }
 
 /**
- * Update all user items not up to date
+ * Update user items of modified zones
  */
 
 inline void GUI::updateAllZones()
 {
+    fChangedZones.clear();
+    if (!fChecked || !changeLog().read(fChangePos, fChangedZones)) {
+        checkAllZones();
+        return;
+    }
+    
+    // Zones notified as modified
+    for (size_t i = 0; i < fChangedZones.size(); i++) {
+        zmap::iterator m = fZoneMap.find(fChangedZones[i]);
+        if (m != fZoneMap.end()) {
+            reflectItems(*m->first, m->second);
+        }
+    }
+    
+    // Zones changed by the DSP (bargraphs) or by direct writes
+    for (size_t i = 0; i < fPolledZones.size(); i++) {
+        reflectItems(*fPolledZones[i]->first, fPolledZones[i]->second);
+    }
+    
+    sweepZones();
+}
+
+/**
+ * Check a few zones at each refresh, to find the ones changed without notification
+ */
+
+inline void GUI::sweepZones()
+{
+    for (int i = 0; i < kSweepSize; i++) {
+        if (fSweep == fZoneMap.end()) {
+            fSweep = fZoneMap.begin();
+            if (fSweep == fZoneMap.end()) return;
+        }
+        FAUSTFLOAT* z = fSweep->first;
+        clist* l = fSweep->second;
+        if (z && !l->fPolled && reflectItems(*z, l)) {
+            l->fPolled = true;
+            fPolledZones.push_back(fSweep);
+        }
+        fSweep++;
+    }
+}
+
+/**
+ * Update all user items not up to date
+ */
+
+inline void GUI::checkAllZones()
+{
+    fChangePos = changeLog().position();
+    fChecked = true;
 	for (zmap::iterator m = fZoneMap.begin(); m != fZoneMap.end(); m++) {
 		FAUSTFLOAT* z = m->first;
 		clist*	l = m->second;
-        if (z) {
-            FAUSTFLOAT	v = *z;
-            for (clist::iterator c = l->begin(); c != l->end(); c++) {
-                if ((*c)->cache() != v) (*c)->reflectZone();
-            }
-        }
+        if (z) reflectItems(*z, l);
 	}
 }
 
@@ -27,7 +27,10 @@
 #include <vector>
 #include <string>
 #include <utility>
+#include <algorithm>
 #include <iostream>
+#include <stdlib.h>
+#include <ctype.h>
 
 #include "faust/dsp/dsp.h"
 #include "faust/gui/meta.h"
@@ -36,12 +39,6 @@
 #include "faust/midi/midi.h"
 #include "faust/gui/ValueConverter.h"
 
-#ifdef _MSC_VER
-#define gsscanf sscanf_s
-#else
-#define gsscanf sscanf
-#endif
-
 /*****************************************************************************
 * Helper code for MIDI meta and polyphonic 'nvoices' parsing
 ******************************************************************************/
@@ -89,6 +86,9 @@ struct MidiMeta : public Meta, public std::map<std::string, std::string>
  * This class decodes MIDI meta data and maps incoming MIDI messages to them.
  * Currently ctrl, keyon/keyoff, keypress, pgm, chanpress, pitchwheel/pitchbend
  * start/stop/clock meta data is handled.
+ *
+ * Channel voice mappings take an optional MIDI channel (1 to 16) after the
+ * number, like [midi:ctrl 7 2], otherwise they respond on all channels.
  ******************************************************************************/
 
 class uiMidi {
@@ -97,10 +97,13 @@ class uiMidi {
         
         midi* fMidiOut;
         bool fInputCtrl;
+        int fChan;      // 1 to 16, or 0 for all channels
+    
+        int outChannel() { return (fChan > 0) ? fChan - 1 : 0; }
         
     public:
         
-        uiMidi(midi* midi_out, bool input):fMidiOut(midi_out), fInputCtrl(input)
+        uiMidi(midi* midi_out, bool input, int chan = 0):fMidiOut(midi_out), fInputCtrl(input), fChan(chan)
         {}
     
         virtual ~uiMidi()
@@ -112,8 +115,8 @@ class uiMidiItem : public uiMidi, public uiItem {
     
     public:
         
-        uiMidiItem(midi* midi_out, GUI* ui, FAUSTFLOAT* zone, bool input = true)
-            :uiMidi(midi_out, input), uiItem(ui, zone)
+        uiMidiItem(midi* midi_out, GUI* ui, FAUSTFLOAT* zone, bool input = true, int chan = 0)
+            :uiMidi(midi_out, input, chan), uiItem(ui, zone)
         {}
     
         virtual ~uiMidiItem()
@@ -121,6 +124,30 @@ class uiMidiItem : public uiMidi, public uiItem {
     
         virtual void reflectZone() {}
     
+        // Same as uiItem::modifyZone, the change goes through the control bus when active
+        void modifyZone(FAUSTFLOAT v)
+        {
+            if (GUI::controlBus().write(fZone, v)) {
+                fCache = v;
+            } else {
+                uiItem::modifyZone(v);
+            }
+        }
+    
+        // Same as modifyZone, with the item list of the zone already known
+        void fastModifyZone(FAUSTFLOAT v, clist* items)
+        {
+            fCache = v;
+            if (GUI::controlBus().write(fZone, v)) return;
+            if (*fZone != v) {
+                *fZone = v;
+                for (clist::iterator c = items->begin(); c != items->end(); c++) {
+                    if ((*c)->cache() != v) (*c)->reflectZone();
+                }
+                GUI::notifyZone(fZone);
+            }
+        }
+    
 };
 
 class uiMidiTimedItem : public uiMidi, public uiTimedItem {
@@ -222,8 +249,8 @@ class uiMidiProgChange : public uiMidiItem
   
     public:
     
-        uiMidiProgChange(midi* midi_out, int pgm, GUI* ui, FAUSTFLOAT* zone, bool input = true)
-            :uiMidiItem(midi_out, ui, zone, input), fPgm(pgm)
+        uiMidiProgChange(midi* midi_out, int pgm, int chan, GUI* ui, FAUSTFLOAT* zone, bool input = true)
+            :uiMidiItem(midi_out, ui, zone, input, chan), fPgm(pgm)
         {}
         virtual ~uiMidiProgChange()
         {}
@@ -233,7 +260,7 @@ class uiMidiProgChange : public uiMidiItem
             FAUSTFLOAT v = *fZone;
             fCache = v;
             if (v != FAUSTFLOAT(0)) {
-                fMidiOut->progChange(0, fPgm);
+                fMidiOut->progChange(outChannel(), fPgm);
             }
         }
         
@@ -247,8 +274,8 @@ class uiMidiChanPress : public uiMidiItem
   
     public:
     
-        uiMidiChanPress(midi* midi_out, int press, GUI* ui, FAUSTFLOAT* zone, bool input = true)
-            :uiMidiItem(midi_out, ui, zone, input), fPress(press)
+        uiMidiChanPress(midi* midi_out, int press, int chan, GUI* ui, FAUSTFLOAT* zone, bool input = true)
+            :uiMidiItem(midi_out, ui, zone, input, chan), fPress(press)
         {}
         virtual ~uiMidiChanPress()
         {}
@@ -258,7 +285,7 @@ class uiMidiChanPress : public uiMidiItem
             FAUSTFLOAT v = *fZone;
             fCache = v;
             if (v != FAUSTFLOAT(0)) {
-                fMidiOut->chanPress(0, fPress);
+                fMidiOut->chanPress(outChannel(), fPress);
             }
         }
         
@@ -273,8 +300,8 @@ class uiMidiCtrlChange : public uiMidiItem
  
     public:
     
-        uiMidiCtrlChange(midi* midi_out, int ctrl, GUI* ui, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max, bool input = true)
-            :uiMidiItem(midi_out, ui, zone, input), fCtrl(ctrl), fConverter(0., 127., double(min), double(max))
+        uiMidiCtrlChange(midi* midi_out, int ctrl, int chan, GUI* ui, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max, bool input = true)
+            :uiMidiItem(midi_out, ui, zone, input, chan), fCtrl(ctrl), fConverter(0., 127., double(min), double(max))
         {}
         virtual ~uiMidiCtrlChange()
         {}
@@ -283,13 +310,13 @@ class uiMidiCtrlChange : public uiMidiItem
         {
             FAUSTFLOAT v = *fZone;
             fCache = v;
-            fMidiOut->ctrlChange(0, fCtrl, fConverter.faust2ui(v));
+            fMidiOut->ctrlChange(outChannel(), fCtrl, fConverter.faust2ui(v));
         }
         
         void modifyZone(int v) 	
         { 
             if (fInputCtrl) {
-                uiItem::modifyZone(FAUSTFLOAT(fConverter.ui2faust(v)));
+                uiMidiItem::modifyZone(FAUSTFLOAT(fConverter.ui2faust(v)));
             }
         }
  
@@ -298,23 +325,21 @@ class uiMidiCtrlChange : public uiMidiItem
 class uiMidiPitchWheel : public uiMidiItem
 {
 
-    private:
+    public:
     	
 		// currently, the range is of pitchwheel if fixed (-2/2 semitones)
-        FAUSTFLOAT wheel2bend(float v)
+        static FAUSTFLOAT wheel2bend(float v)
         {
             return pow(2.0,(v/16383.0*4-2)/12);
         }
 
-        int bend2wheel(float v)
+        static int bend2wheel(float v)
         {
             return (int)((12*log(v)/log(2)+2)/4*16383);
         }
- 
-    public:
     
-        uiMidiPitchWheel(midi* midi_out, GUI* ui, FAUSTFLOAT* zone, bool input = true)
-            :uiMidiItem(midi_out, ui, zone, input)
+        uiMidiPitchWheel(midi* midi_out, int chan, GUI* ui, FAUSTFLOAT* zone, bool input = true)
+            :uiMidiItem(midi_out, ui, zone, input, chan)
         {}
         virtual ~uiMidiPitchWheel()
         {}
@@ -323,13 +348,13 @@ class uiMidiPitchWheel : public uiMidiItem
         {
             FAUSTFLOAT v = *fZone;
             fCache = v;
-            fMidiOut->pitchWheel(0, bend2wheel(v));
+            fMidiOut->pitchWheel(outChannel(), bend2wheel(v));
         }
         
         void modifyZone(int v) 	
         { 
             if (fInputCtrl) {
-                uiItem::modifyZone(wheel2bend(v));
+                uiMidiItem::modifyZone(wheel2bend(v));
             }
         }
  
@@ -345,8 +370,8 @@ class uiMidiKeyOn : public uiMidiItem
   
     public:
     
-        uiMidiKeyOn(midi* midi_out, int key, GUI* ui, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max, bool input = true)
-            :uiMidiItem(midi_out, ui, zone, input), fKeyOn(key), fConverter(0., 127., double(min), double(max))
+        uiMidiKeyOn(midi* midi_out, int key, int chan, GUI* ui, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max, bool input = true)
+            :uiMidiItem(midi_out, ui, zone, input, chan), fKeyOn(key), fConverter(0., 127., double(min), double(max))
         {}
         virtual ~uiMidiKeyOn()
         {}
@@ -355,13 +380,13 @@ class uiMidiKeyOn : public uiMidiItem
         {
             FAUSTFLOAT v = *fZone;
             fCache = v;
-            fMidiOut->keyOn(0, fKeyOn, fConverter.faust2ui(v));
+            fMidiOut->keyOn(outChannel(), fKeyOn, fConverter.faust2ui(v));
         }
         
         void modifyZone(int v) 	
         { 
             if (fInputCtrl) {
-                uiItem::modifyZone(FAUSTFLOAT(fConverter.ui2faust(v)));
+                uiMidiItem::modifyZone(FAUSTFLOAT(fConverter.ui2faust(v)));
             }
         }
         
@@ -377,8 +402,8 @@ class uiMidiKeyOff : public uiMidiItem
   
     public:
     
-        uiMidiKeyOff(midi* midi_out, int key, GUI* ui, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max, bool input = true)
-            :uiMidiItem(midi_out, ui, zone, input), fKeyOff(key), fConverter(0., 127., double(min), double(max))
+        uiMidiKeyOff(midi* midi_out, int key, int chan, GUI* ui, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max, bool input = true)
+            :uiMidiItem(midi_out, ui, zone, input, chan), fKeyOff(key), fConverter(0., 127., double(min), double(max))
         {}
         virtual ~uiMidiKeyOff()
         {}
@@ -387,13 +412,13 @@ class uiMidiKeyOff : public uiMidiItem
         {
             FAUSTFLOAT v = *fZone;
             fCache = v;
-            fMidiOut->keyOff(0, fKeyOff, fConverter.faust2ui(v));
+            fMidiOut->keyOff(outChannel(), fKeyOff, fConverter.faust2ui(v));
         }
         
         void modifyZone(int v) 	
         { 
             if (fInputCtrl) {
-                uiItem::modifyZone(FAUSTFLOAT(fConverter.ui2faust(v)));
+                uiMidiItem::modifyZone(FAUSTFLOAT(fConverter.ui2faust(v)));
             }
         }
         
@@ -409,8 +434,8 @@ class uiMidiKeyPress : public uiMidiItem
   
     public:
     
-        uiMidiKeyPress(midi* midi_out, int key, GUI* ui, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max, bool input = true)
-            :uiMidiItem(midi_out, ui, zone, input), fKey(key), fConverter(0., 127., double(min), double(max))
+        uiMidiKeyPress(midi* midi_out, int key, int chan, GUI* ui, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max, bool input = true)
+            :uiMidiItem(midi_out, ui, zone, input, chan), fKey(key), fConverter(0., 127., double(min), double(max))
         {}
         virtual ~uiMidiKeyPress()
         {}
@@ -419,18 +444,99 @@ class uiMidiKeyPress : public uiMidiItem
         {
             FAUSTFLOAT v = *fZone;
             fCache = v;
-            fMidiOut->keyPress(0, fKey, fConverter.faust2ui(v));
+            fMidiOut->keyPress(outChannel(), fKey, fConverter.faust2ui(v));
         }
         
         void modifyZone(int v) 	
         { 
             if (fInputCtrl) {
-                uiItem::modifyZone(FAUSTFLOAT(fConverter.ui2faust(v)));
+                uiMidiItem::modifyZone(FAUSTFLOAT(fConverter.ui2faust(v)));
             }
         }
         
 };
 
+/**
+ * Flat MIDI dispatch table: items are stored contiguously, grouped by
+ * (channel, number) slot, so that an incoming message is dispatched with
+ * a single indexed lookup. Items listening on all channels are replicated
+ * in each of the 16 channel rows.
+ */
+
+template <class ITEM>
+struct uiMidiSlot {
+    
+    ITEM* fItem;
+    clist* fZoneItems;  // items sharing the zone, to be reflected
+    double fCoef;       // linear MIDI value to zone conversion
+    double fOffset;
+    
+};
+
+template <class ITEM, int NUMS = 128>
+class uiMidiTable {
+    
+    private:
+    
+        struct Entry {
+            int fChan;
+            int fNum;
+            uiMidiSlot<ITEM> fSlot;
+        };
+    
+        std::vector<Entry> fEntries;                // in declaration order
+        std::vector<uiMidiSlot<ITEM> > fSlots;      // grouped by slot
+        std::vector<int> fIndex;                    // first item of each slot
+    
+        void rebuild()
+        {
+            std::fill(fIndex.begin(), fIndex.end(), 0);
+            for (size_t i = 0; i < fEntries.size(); i++) {
+                for (int chan = 0; chan < 16; chan++) {
+                    if (fEntries[i].fChan == 0 || fEntries[i].fChan == chan + 1) {
+                        fIndex[chan * NUMS + fEntries[i].fNum + 1]++;
+                    }
+                }
+            }
+            for (size_t s = 1; s < fIndex.size(); s++) {
+                fIndex[s] += fIndex[s - 1];
+            }
+            fSlots.resize(fIndex.back());
+            std::vector<int> fill(fIndex.begin(), fIndex.end() - 1);
+            for (size_t i = 0; i < fEntries.size(); i++) {
+                for (int chan = 0; chan < 16; chan++) {
+                    if (fEntries[i].fChan == 0 || fEntries[i].fChan == chan + 1) {
+                        fSlots[fill[chan * NUMS + fEntries[i].fNum]++] = fEntries[i].fSlot;
+                    }
+                }
+            }
+        }
+    
+    public:
+    
+        uiMidiTable():fIndex(16 * NUMS + 1, 0)
+        {}
+    
+        void add(int chan, int num, ITEM* item, clist* zone_items, double coef = 0., double offset = 0.)
+        {
+            if (chan < 0 || chan > 16 || num < 0 || num >= NUMS) return;
+            Entry entry = { chan, num, { item, zone_items, coef, offset } };
+            fEntries.push_back(entry);
+            rebuild();
+        }
+    
+        // Items mapped to (channel, num) as a [begin, end) range, channel in 0..15
+        const uiMidiSlot<ITEM>* begin(int channel, int num) const
+        {
+            return (unsigned(channel) < 16 && unsigned(num) < NUMS) ? fSlots.data() + fIndex[channel * NUMS + num] : fSlots.data();
+        }
+        const uiMidiSlot<ITEM>* end(int channel, int num) const
+        {
+            return (unsigned(channel) < 16 && unsigned(num) < NUMS) ? fSlots.data() + fIndex[channel * NUMS + num + 1] : fSlots.data();
+        }
+    
+};
+
 class MapUI;
 
 class MidiUI : public GUI, public midi
@@ -438,13 +544,13 @@ class MidiUI : public GUI, public midi
 
     protected:
     
-        std::map <int, std::vector<uiMidiCtrlChange*> > fCtrlChangeTable;
-        std::map <int, std::vector<uiMidiProgChange*> > fProgChangeTable;
-        std::map <int, std::vector<uiMidiChanPress*> >  fChanPressTable;
-        std::map <int, std::vector<uiMidiKeyOn*> >      fKeyOnTable;
-        std::map <int, std::vector<uiMidiKeyOff*> >     fKeyOffTable;
-        std::map <int, std::vector<uiMidiKeyPress*> >   fKeyPressTable;
-        std::vector<uiMidiPitchWheel*>                  fPitchWheelTable;
+        uiMidiTable<uiMidiItem>         fCtrlChangeTable;
+        uiMidiTable<uiMidiItem>         fProgChangeTable;
+        uiMidiTable<uiMidiItem>         fChanPressTable;
+        uiMidiTable<uiMidiItem>         fKeyOnTable;
+        uiMidiTable<uiMidiItem>         fKeyOffTable;
+        uiMidiTable<uiMidiItem>         fKeyPressTable;
+        uiMidiTable<uiMidiPitchWheel, 1> fPitchWheelTable;
         
         std::vector<uiMidiStart*>   fStartTable;
         std::vector<uiMidiStop*>    fStopTable;
@@ -455,36 +561,89 @@ class MidiUI : public GUI, public midi
         midi_handler* fMidiHandler;
         bool fDelete;
     
+        // Parse 'type [num [chan]]', returns the number of parsed integers, or -1 on syntax error
+        static int parseMeta(const std::string& meta, std::string& type, int& num, int& chan)
+        {
+            const char* p = meta.c_str();
+            while (isspace(*p)) p++;
+            const char* t = p;
+            while (isalpha(*p)) p++;
+            type.assign(t, p - t);
+            int* values[2] = { &num, &chan };
+            int res = 0;
+            while (res < 2) {
+                while (isspace(*p)) p++;
+                if (!isdigit(*p)) break;
+                char* e;
+                *values[res++] = int(strtol(p, &e, 10));
+                p = e;
+            }
+            while (isspace(*p)) p++;
+            return (*p == 0) ? res : -1;
+        }
+    
+        static void updateZones(const uiMidiTable<uiMidiItem>& table, int channel, int num, int value)
+        {
+            double v = (value < 0) ? 0. : (value > 127) ? 127. : double(value);
+            const uiMidiSlot<uiMidiItem>* end = table.end(channel, num);
+            for (const uiMidiSlot<uiMidiItem>* it = table.begin(channel, num); it != end; it++) {
+                it->fItem->fastModifyZone(FAUSTFLOAT(it->fOffset + v * it->fCoef), it->fZoneItems);
+            }
+        }
+    
+        void updatePitchWheel(int channel, int wheel)
+        {
+            const uiMidiSlot<uiMidiPitchWheel>* end = fPitchWheelTable.end(channel, 0);
+            for (const uiMidiSlot<uiMidiPitchWheel>* it = fPitchWheelTable.begin(channel, 0); it != end; it++) {
+                it->fItem->fastModifyZone(uiMidiPitchWheel::wheel2bend(wheel), it->fZoneItems);
+            }
+        }
+    
         void addGenericZone(FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max, bool input = true)
         {
-            if (fMetaAux.size() > 0) {
-                for (size_t i = 0; i < fMetaAux.size(); i++) {
-                    unsigned num;
-                    if (fMetaAux[i].first == "midi") {
-                        if (gsscanf(fMetaAux[i].second.c_str(), "ctrl %u", &num) == 1) {
-                            fCtrlChangeTable[num].push_back(new uiMidiCtrlChange(fMidiHandler, num, this, zone, min, max, input));
-                        } else if (gsscanf(fMetaAux[i].second.c_str(), "keyon %u", &num) == 1) {
-                            fKeyOnTable[num].push_back(new uiMidiKeyOn(fMidiHandler, num, this, zone, min, max, input));
-                        } else if (gsscanf(fMetaAux[i].second.c_str(), "keyoff %u", &num) == 1) {
-                            fKeyOffTable[num].push_back(new uiMidiKeyOff(fMidiHandler, num, this, zone, min, max, input));
-                        } else if (gsscanf(fMetaAux[i].second.c_str(), "keypress %u", &num) == 1) {
-                            fKeyPressTable[num].push_back(new uiMidiKeyPress(fMidiHandler, num, this, zone, min, max, input));
-                        } else if (gsscanf(fMetaAux[i].second.c_str(), "pgm %u", &num) == 1) {
-                            fProgChangeTable[num].push_back(new uiMidiProgChange(fMidiHandler, num, this, zone, input));
-                        } else if (gsscanf(fMetaAux[i].second.c_str(), "chanpress %u", &num) == 1) {
-                            fChanPressTable[num].push_back(new uiMidiChanPress(fMidiHandler, num, this, zone, input));
-                        } else if (strcmp(fMetaAux[i].second.c_str(), "pitchwheel") == 0 
-                            || strcmp(fMetaAux[i].second.c_str(), "pitchbend") == 0) {
-                            fPitchWheelTable.push_back(new uiMidiPitchWheel(fMidiHandler, this, zone, input));
-                        // MIDI sync
-                        } else if (strcmp(fMetaAux[i].second.c_str(), "start") == 0) {
-                            fStartTable.push_back(new uiMidiStart(fMidiHandler, this, zone, input));
-                        } else if (strcmp(fMetaAux[i].second.c_str(), "stop") == 0) {
-                            fStopTable.push_back(new uiMidiStop(fMidiHandler, this, zone, input));
-                        } else if (strcmp(fMetaAux[i].second.c_str(), "clock") == 0) {
-                            fClockTable.push_back(new uiMidiClock(fMidiHandler, this, zone, input));
-                        }
+            // Conversion of the [0..127] MIDI range, as done by LinearValueConverter
+            double coef = (double(max) - double(min)) / 127.;
+            for (size_t i = 0; i < fMetaAux.size(); i++) {
+                if (fMetaAux[i].first != "midi") continue;
+                std::string type;
+                int num = 0, chan = 0;
+                int res = parseMeta(fMetaAux[i].second, type, num, chan);
+                if (res < 0) continue;
+                if (res >= 1) {
+                    // Only items that receive MIDI are dispatched to, output is done by reflectZone
+                    if (type == "ctrl") {
+                        uiMidiItem* item = new uiMidiCtrlChange(fMidiHandler, num, chan, this, zone, min, max, input);
+                        if (input) fCtrlChangeTable.add(chan, num, item, getZoneItems(zone), coef, min);
+                    } else if (type == "keyon") {
+                        uiMidiItem* item = new uiMidiKeyOn(fMidiHandler, num, chan, this, zone, min, max, input);
+                        if (input) fKeyOnTable.add(chan, num, item, getZoneItems(zone), coef, min);
+                    } else if (type == "keyoff") {
+                        uiMidiItem* item = new uiMidiKeyOff(fMidiHandler, num, chan, this, zone, min, max, input);
+                        if (input) fKeyOffTable.add(chan, num, item, getZoneItems(zone), coef, min);
+                    } else if (type == "keypress") {
+                        uiMidiItem* item = new uiMidiKeyPress(fMidiHandler, num, chan, this, zone, min, max, input);
+                        if (input) fKeyPressTable.add(chan, num, item, getZoneItems(zone), coef, min);
+                    } else if (type == "pgm") {
+                        uiMidiItem* item = new uiMidiProgChange(fMidiHandler, num, chan, this, zone, input);
+                        if (input) fProgChangeTable.add(chan, num, item, getZoneItems(zone), 0., 1.);
+                    } else if (type == "chanpress") {
+                        uiMidiItem* item = new uiMidiChanPress(fMidiHandler, num, chan, this, zone, input);
+                        if (input) fChanPressTable.add(chan, num, item, getZoneItems(zone), 0., 1.);
+                    } else if ((type == "pitchwheel" || type == "pitchbend") && res == 1) {
+                        // channel only
+                        uiMidiPitchWheel* item = new uiMidiPitchWheel(fMidiHandler, num, this, zone, input);
+                        if (input) fPitchWheelTable.add(num, 0, item, getZoneItems(zone));
                     }
+                } else if (type == "pitchwheel" || type == "pitchbend") {
+                    uiMidiPitchWheel* item = new uiMidiPitchWheel(fMidiHandler, 0, this, zone, input);
+                    if (input) fPitchWheelTable.add(0, 0, item, getZoneItems(zone));
+                // MIDI sync
+                } else if (type == "start") {
+                    fStartTable.push_back(new uiMidiStart(fMidiHandler, this, zone, input));
+                } else if (type == "stop") {
+                    fStopTable.push_back(new uiMidiStop(fMidiHandler, this, zone, input));
+                } else if (type == "clock") {
+                    fClockTable.push_back(new uiMidiClock(fMidiHandler, this, zone, input));
                 }
             }
             fMetaAux.clear();
@@ -557,64 +716,39 @@ class MidiUI : public GUI, public midi
         
         MapUI* keyOn(double date, int channel, int note, int velocity)
         {
-            if (fKeyOnTable.find(note) != fKeyOnTable.end()) {
-                for (unsigned int i = 0; i < fKeyOnTable[note].size(); i++) {
-                    fKeyOnTable[note][i]->modifyZone(FAUSTFLOAT(velocity));
-                }
-            }
+            // A note-on with a null velocity is a note-off
+            updateZones((velocity == 0) ? fKeyOffTable : fKeyOnTable, channel, note, velocity);
             return 0;
         }
         
         void keyOff(double date,  int channel, int note, int velocity)
         {
-            if (fKeyOffTable.find(note) != fKeyOffTable.end()) {
-                for (unsigned int i = 0; i < fKeyOffTable[note].size(); i++) {
-                    fKeyOffTable[note][i]->modifyZone(FAUSTFLOAT(velocity));
-                }
-            }
+            updateZones(fKeyOffTable, channel, note, velocity);
         }
            
         void ctrlChange(double date, int channel, int ctrl, int value)
         {
-            if (fCtrlChangeTable.find(ctrl) != fCtrlChangeTable.end()) {
-                for (unsigned int i = 0; i < fCtrlChangeTable[ctrl].size(); i++) {
-                    fCtrlChangeTable[ctrl][i]->modifyZone(FAUSTFLOAT(value));
-                }
-            } 
+            updateZones(fCtrlChangeTable, channel, ctrl, value);
         }
         
         void progChange(double date, int channel, int pgm)
         {
-            if (fProgChangeTable.find(pgm) != fProgChangeTable.end()) {
-                for (unsigned int i = 0; i < fProgChangeTable[pgm].size(); i++) {
-                    fProgChangeTable[pgm][i]->modifyZone(FAUSTFLOAT(1));
-                }
-            } 
+            updateZones(fProgChangeTable, channel, pgm, 0);
         }
         
         void pitchWheel(double date, int channel, int wheel) 
         {
-            for (unsigned int i = 0; i < fPitchWheelTable.size(); i++) {
-                fPitchWheelTable[i]->modifyZone(FAUSTFLOAT(wheel));
-            }
+            updatePitchWheel(channel, wheel);
         }
         
         void keyPress(double date, int channel, int pitch, int press) 
         {
-            if (fKeyPressTable.find(pitch) != fKeyPressTable.end()) {
-                for (unsigned int i = 0; i < fKeyPressTable[pitch].size(); i++) {
-                    fKeyPressTable[pitch][i]->modifyZone(FAUSTFLOAT(press));
-                }
-            } 
+            updateZones(fKeyPressTable, channel, pitch, press);
         }
         
         void chanPress(double date, int channel, int press)
         {
-            if (fChanPressTable.find(press) != fChanPressTable.end()) {
-                for (unsigned int i = 0; i < fChanPressTable[press].size(); i++) {
-                    fChanPressTable[press][i]->modifyZone(FAUSTFLOAT(1));
-                }
-            } 
+            updateZones(fChanPressTable, channel, press, 0);
         }
         
         void ctrlChange14bits(double date, int channel, int ctrl, int value) {}
@@ -641,6 +775,42 @@ class MidiUI : public GUI, public midi
                 fClockTable[i]->modifyZone(date, FAUSTFLOAT(1));
             }
         }
+    
+        // Block API : dispatch all messages received during an audio block
+        void handleMessages(const midi_message* messages, int count)
+        {
+            // Changes of the block are applied together by the audio thread
+            ControlGroup group(GUI::controlBus());
+            for (int i = 0; i < count; i++) {
+                const midi_message& m = messages[i];
+                switch (m.fType) {
+                    case MIDI_NOTE_OFF:
+                        updateZones(fKeyOffTable, m.fChannel, m.fData1, m.fData2);
+                        break;
+                    case MIDI_NOTE_ON:
+                        keyOn(0, m.fChannel, m.fData1, m.fData2);
+                        break;
+                    case MIDI_CONTROL_CHANGE:
+                        updateZones(fCtrlChangeTable, m.fChannel, m.fData1, m.fData2);
+                        break;
+                    case MIDI_PROGRAM_CHANGE:
+                        updateZones(fProgChangeTable, m.fChannel, m.fData1, 0);
+                        break;
+                    case MIDI_AFTERTOUCH:
+                        updateZones(fChanPressTable, m.fChannel, m.fData1, 0);
+                        break;
+                    case MIDI_POLY_AFTERTOUCH:
+                        updateZones(fKeyPressTable, m.fChannel, m.fData1, m.fData2);
+                        break;
+                    case MIDI_PITCH_BEND:
+                        updatePitchWheel(m.fChannel, (m.fData2 * 128) + m.fData1);
+                        break;
+                    default:
+                        handleMessage(m);
+                        break;
+                }
+            }
+        }
 };
 
 #endif // FAUST_MIDIUI_H
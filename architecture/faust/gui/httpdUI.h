@@ -26,6 +26,9 @@
 
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
 
 #include "faust/gui/HTTPDControler.h"
 #include "faust/gui/DecoratorUI.h"
@@ -189,31 +192,69 @@ class httpdClientUI : public GUI, public PathBuilder, public httpdUIAux
 
         std::string fServerURL;
         std::string fJSON;
+        std::vector<FAUSTFLOAT*> fZones;    // in the server declaration order, 0 for buttons
         std::map<std::string, FAUSTFLOAT*> fZoneMap;
         pthread_t fThread;
         int fTCPPort;
         bool fRunning;
 
-        void insertMap(std::string label, FAUSTFLOAT* zone)
+        // Parses a '{"version": n, "values": [...]}' answer
+        bool updateZones(const char* answer, unsigned long long& version)
         {
-            fZoneMap[label] = zone;
+            const char* ptr = strstr(answer, "\"version\":");
+            if (!ptr) return false;
+            version = strtoull(ptr + 10, NULL, 10);
+            ptr = strchr(ptr, '[');
+            if (!ptr) return false;
+            ptr++;
+            for (size_t i = 0; i < fZones.size(); i++) {
+                char* end;
+                double v = strtod(ptr, &end);
+                if (end == ptr) break;
+                if (fZones[i]) *fZones[i] = FAUSTFLOAT(v);
+                ptr = end;
+                while (*ptr == ',' || *ptr == ' ') ptr++;
+            }
+            return true;
+        }
+
+        // One request per parameter, for servers without '/values'
+        void pollZones()
+        {
+            std::map<std::string, FAUSTFLOAT*>::iterator it;
+            for (it = fZoneMap.begin(); it != fZoneMap.end(); it++) {
+                char* answer = 0;
+                if (http_fetch((*it).first.c_str(), &answer) < 0 || !answer) continue;
+                const char* value = strchr(answer, ' ');
+                if (value) (*(*it).second) = (FAUSTFLOAT)strtod(value, NULL);
+                // 'http_fetch' result must be deallocated
+                free(answer);
+            }
         }
 
         static void* UpdateUI(void* arg)
         {
             httpdClientUI* ui = static_cast<httpdClientUI*>(arg);
-            std::map<std::string, FAUSTFLOAT*>::iterator it;
+            unsigned long long version = 0;
+            bool bulk = true;
+            int polls = 0;
             while (ui->fRunning) {
-                for (it = ui->fZoneMap.begin(); it != ui->fZoneMap.end(); it++) {
-                    char* answer;
-                    std::string path = (*it).first;
-                    http_fetch(path.c_str(), &answer);
-                    std::string answer_str = answer;
-                    (*(*it).second) = (FAUSTFLOAT)strtod(answer_str.substr(answer_str.find(' ')).c_str(), NULL);
+                if (bulk) {
+                    // All values in a single request, the server delays its answer until a value has changed
+                    char* answer = 0;
+                    std::stringstream url;
+                    url << ui->fServerURL << "/values?since=" << version;
+                    bool updated = http_fetch(url.str().c_str(), &answer) >= 0 && answer && ui->updateZones(answer, version);
                     // 'http_fetch' result must be deallocated
                     free(answer);
+                    // Older server (404), unexpected answer or network error : poll each parameter
+                    bulk = updated;
+                } else {
+                    ui->pollZones();
+                    usleep(100000);
+                    // Try '/values' again every 10 s
+                    if (++polls % 100 == 0) bulk = true;
                 }
-                usleep(100000);
             }
 			return 0;
         }
@@ -221,7 +262,8 @@ class httpdClientUI : public GUI, public PathBuilder, public httpdUIAux
         virtual void addGeneric(const char* label, FAUSTFLOAT* zone)
         {
             std::string url = fServerURL + buildPath(label);
-            insertMap(url, zone);
+            fZones.push_back(zone);
+            fZoneMap[url] = zone;
             new uiUrlValue(url, this, zone);
         }
 
@@ -273,6 +315,7 @@ class httpdClientUI : public GUI, public PathBuilder, public httpdUIAux
             // addGeneric(label, zone);
             // Do not update button state with received messages (otherwise on/off messages may be lost...)
             std::string url = fServerURL + buildPath(label);
+            fZones.push_back(0);
             new uiUrlValue(url, this, zone);
         }
         virtual void addCheckButton(const char* label, FAUSTFLOAT* zone)
@@ -54,25 +54,24 @@ class jack_midi_handler : public midi_handler {
 
         void processMidiInBuffer(void* port_buf_in)
         {
-            for (int i = 0; i < jack_midi_get_event_count(port_buf_in); ++i) {
+            // Messages of the block are delivered in batches
+            midi_message messages[64];
+            int count = 0;
+            int nevents = jack_midi_get_event_count(port_buf_in);
+            for (int i = 0; i < nevents; ++i) {
                 jack_midi_event_t event;
-                if (jack_midi_event_get(&event, port_buf_in, i) == 0) {
-
-                    size_t nBytes = event.size;
-                    int type = (int)event.buffer[0] & 0xf0;
-                    int channel = (int)event.buffer[0] & 0x0f;
-                    double time = event.time; // Timestamp in frames
-
-                    // MIDI sync
-                    if (nBytes == 1) {
-                        handleSync(time, (int)event.buffer[0]);
-                    } else if (nBytes == 2) {
-                        handleData1(time, type, channel, (int)event.buffer[1]);
-                    } else if (nBytes == 3) {
-                        handleData2(time, type, channel, (int)event.buffer[1], (int)event.buffer[2]);
+                // Timestamp in frames
+                if (jack_midi_event_get(&event, port_buf_in, i) == 0
+                    && decodeMessage(event.time, event.buffer, event.size, messages[count])) {
+                    if (++count == 64) {
+                        handleMessages(messages, count);
+                        count = 0;
                     }
                 }
             }
+            if (count > 0) {
+                handleMessages(messages, count);
+            }
         }
 
         void processMidiOutBuffer(void* port_buf_out_aux, bool reset = false)
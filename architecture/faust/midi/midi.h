@@ -30,6 +30,21 @@
 
 class MapUI;
 
+//----------------------------------------------------------------
+//  Decoded MIDI message, used to deliver all messages received
+//  during an audio block at once
+//----------------------------------------------------------------
+
+struct midi_message {
+
+    double fTime;
+    int fType;      // status without channel, or full status byte for sync messages
+    int fChannel;
+    int fData1;
+    int fData2;
+
+};
+
 //----------------------------------------------------------------
 //  MIDI processor definition
 //----------------------------------------------------------------
@@ -87,6 +102,55 @@ class midi {
         virtual void stop_sync(double date)   {}
         virtual void clock(double date)  {}
 
+        // Block API : messages are given in time order, the default implementation
+        // calls the time-stamped API for each of them
+        virtual void handleMessages(const midi_message* messages, int count)
+        {
+            for (int i = 0; i < count; i++) {
+                handleMessage(messages[i]);
+            }
+        }
+
+        void handleMessage(const midi_message& m)
+        {
+            switch (m.fType) {
+                case MIDI_NOTE_OFF:
+                    keyOff(m.fTime, m.fChannel, m.fData1, m.fData2);
+                    break;
+                case MIDI_NOTE_ON:
+                    if (m.fData2 == 0) {
+                        keyOff(m.fTime, m.fChannel, m.fData1, m.fData2);
+                    } else {
+                        keyOn(m.fTime, m.fChannel, m.fData1, m.fData2);
+                    }
+                    break;
+                case MIDI_CONTROL_CHANGE:
+                    ctrlChange(m.fTime, m.fChannel, m.fData1, m.fData2);
+                    break;
+                case MIDI_PROGRAM_CHANGE:
+                    progChange(m.fTime, m.fChannel, m.fData1);
+                    break;
+                case MIDI_PITCH_BEND:
+                    pitchWheel(m.fTime, m.fChannel, (m.fData2 * 128.0) + m.fData1);
+                    break;
+                case MIDI_AFTERTOUCH:
+                    chanPress(m.fTime, m.fChannel, m.fData1);
+                    break;
+                case MIDI_POLY_AFTERTOUCH:
+                    keyPress(m.fTime, m.fChannel, m.fData1, m.fData2);
+                    break;
+                case MIDI_CLOCK:
+                    clock(m.fTime);
+                    break;
+                case MIDI_START:
+                    start_sync(m.fTime);
+                    break;
+                case MIDI_STOP:
+                    stop_sync(m.fTime);
+                    break;
+            }
+        }
+
         // Standard MIDI API
         virtual MapUI* keyOn(int channel, int pitch, int velocity)      { return 0; }
         virtual void keyOff(int channel, int pitch, int velocity)       {}
@@ -204,6 +268,31 @@ class midi_handler : public midi {
             }
         }
 
+        // Decode a raw MIDI message, returns false if it is not handled
+        static bool decodeMessage(double time, const unsigned char* buffer, size_t size, midi_message& m)
+        {
+            m.fTime = time;
+            m.fChannel = (int)buffer[0] & 0x0f;
+            m.fData1 = (size > 1) ? (int)buffer[1] : 0;
+            m.fData2 = (size > 2) ? (int)buffer[2] : 0;
+            if (size == 1) {
+                m.fType = (int)buffer[0];
+            } else if (size == 2 || size == 3) {
+                m.fType = (int)buffer[0] & 0xf0;
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        // Deliver a block of messages to all MIDI inputs
+        void handleMessages(const midi_message* messages, int count)
+        {
+            for (unsigned int i = 0; i < fMidiInputs.size(); i++) {
+                fMidiInputs[i]->handleMessages(messages, count);
+            }
+        }
+
 
 };
 
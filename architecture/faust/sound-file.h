@@ -26,6 +26,7 @@
 
 #include <sndfile.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 #define BUFFER_SIZE 1024
 
@@ -37,10 +38,54 @@
 #define FAUSTFLOAT double
 #endif
 
+/*
+ By default the whole file is read in memory when the reader is created.
+ 
+ With SOUNDFILE_STREAMING defined, memory stays bounded whatever the file size:
+ - uncompressed WAV files (16/24/32 bits integer or 32/64 bits float PCM) are memory-mapped
+   and decoded on access. A prefetch thread locks in memory (mlock) the SOUNDFILE_PREFETCH_FRAMES
+   frames before and after the last read position and releases the ones outside of this window.
+   Only the locked frames are read, so that reading never page-faults. When the pages cannot be
+   locked (see RLIMIT_MEMLOCK) they are only paged in, and may be paged out again under memory
+   pressure: the mmap mode is then not strictly real-time safe.
+ - other formats are decoded by a background thread in a lock-free ring of SOUNDFILE_RING_FRAMES
+   frames, following the furthest read position. The SOUNDFILE_RING_BEHIND frames before it are
+   kept, so interpolating readers, slow playback or several read heads close to each other are
+   served from the ring. Reading outside of the decoded window never blocks: 0 is returned (and
+   a seek is requested when the read position jumps before the window or far ahead).
+ In both cases 'sampleSFR' is lock-free and allocation free. The streaming mode needs C++11.
+ 
+ 'createSFR' returns NULL when the file cannot be opened or read.
+*/
+
+#ifdef SOUNDFILE_STREAMING
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <new>
+#include <atomic>
+
+#ifndef SOUNDFILE_RING_FRAMES
+#define SOUNDFILE_RING_FRAMES 65536     // Must be a power of two
+#endif
+#ifndef SOUNDFILE_RING_BEHIND
+#define SOUNDFILE_RING_BEHIND (SOUNDFILE_RING_FRAMES / 4)   // Decoded frames kept before the read position
+#endif
+#ifndef SOUNDFILE_PREFETCH_FRAMES
+#define SOUNDFILE_PREFETCH_FRAMES 262144
+#endif
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifndef SOUNDFILE_STREAMING
+
 typedef struct SoundFileReader {
     FAUSTFLOAT** fBuffer;
     SNDFILE* fSoundFile;
@@ -50,6 +95,7 @@ typedef struct SoundFileReader {
     
 inline static SoundFileReader* createSFR(const char* name)
 {
+    FAUSTFLOAT* buffer = NULL;
     SoundFileReader* reader = (SoundFileReader*)calloc(1, sizeof(SoundFileReader));
     if (!reader) return NULL;
 
@@ -66,8 +112,8 @@ inline static SoundFileReader* createSFR(const char* name)
         reader->fChannels = snd_info.channels;
         reader->fFramesNum = snd_info.frames;
 
-        reader->fBuffer = (FAUSTFLOAT**)malloc(reader->fChannels * sizeof(FAUSTFLOAT*));
-        if (!reader) goto error;
+        reader->fBuffer = (FAUSTFLOAT**)calloc(reader->fChannels, sizeof(FAUSTFLOAT*));
+        if (!reader->fBuffer) goto error;
         
         for (int i = 0; i < reader->fChannels; i++) {
             reader->fBuffer[i] = (FAUSTFLOAT*)malloc(reader->fFramesNum * sizeof(FAUSTFLOAT));
@@ -76,7 +122,8 @@ inline static SoundFileReader* createSFR(const char* name)
         
         // Read file in memory
         int nbf, cur_index = 0;
-        FAUSTFLOAT buffer[BUFFER_SIZE * reader->fChannels];
+        buffer = (FAUSTFLOAT*)malloc(BUFFER_SIZE * reader->fChannels * sizeof(FAUSTFLOAT));
+        if (!buffer) goto error;
         do {
             nbf = READ_SAMPLE(reader->fSoundFile, buffer, BUFFER_SIZE);
             for (int sample = 0; sample < nbf; sample++) {
@@ -87,12 +134,20 @@ inline static SoundFileReader* createSFR(const char* name)
             cur_index += nbf;
         } while (nbf == BUFFER_SIZE);
         
+        free(buffer);
         return reader;
     }
     
 error:
-    if (reader->fBuffer) free(reader->fBuffer);
-    if (reader) free(reader);
+    if (reader->fBuffer) {
+        for (int i = 0; i < reader->fChannels; i++) {
+            free(reader->fBuffer[i]);
+        }
+        free(reader->fBuffer);
+    }
+    if (reader->fSoundFile) sf_close(reader->fSoundFile);
+    free(buffer);
+    free(reader);
     return NULL;
 }
 
@@ -123,6 +178,328 @@ inline static FAUSTFLOAT sampleSFR(SoundFileReader* reader, int channel, int ind
     return (reader) ? reader->fBuffer[channel][index] : 0.f;
 }
 
+#else
+
+enum { kSFRInt16, kSFRInt24, kSFRInt32, kSFRFloat32, kSFRFloat64 };
+
+typedef struct SoundFileReader {
+    int fChannels;
+    int fFramesNum;
+    
+    // Memory-mapped WAV file (fMap != NULL)
+    unsigned char* fMap;
+    size_t fMapSize;
+    const unsigned char* fData;
+    int fSampleFormat;
+    int fSampleBytes;
+    int fFrameBytes;
+    std::atomic<long> fMapBegin;        // Frames in [fMapBegin, fMapEnd) are locked in memory
+    std::atomic<long> fMapEnd;          // (written by the thread)
+    
+    // Streamed file (fSoundFile != NULL)
+    SNDFILE* fSoundFile;
+    FAUSTFLOAT* fRing;                  // SOUNDFILE_RING_FRAMES interleaved frames
+    std::atomic<long> fBegin;           // Frames in [max(fBegin, fReadFrame - SOUNDFILE_RING_BEHIND), fEnd)
+    std::atomic<long> fEnd;             // are available (written by the thread)
+    std::atomic<long> fSeekTarget;
+    std::atomic<int> fSeekRequest;      // Incremented by the reader
+    std::atomic<int> fSeekDone;         // Set to fSeekRequest by the thread when the seek is done
+    
+    // Shared by both modes
+    std::atomic<long> fReadFrame;       // Furthest read position (written by the reader)
+    std::atomic<int> fRunning;
+    pthread_t fThread;
+} SoundFileReader;
+
+inline static unsigned int readLE16SFR(const unsigned char* p) { return p[0] | (p[1] << 8); }
+inline static unsigned int readLE32SFR(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24); }
+
+// Parse a RIFF/WAVE header and setup the mapping, return 0 if the file cannot be mapped
+inline static int mapWAVSFR(SoundFileReader* reader, const char* name)
+{
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) return 0;
+    
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < 44) {
+        close(fd);
+        return 0;
+    }
+    
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+    
+    const unsigned char* p = (const unsigned char*)map;
+    const unsigned char* end = p + st.st_size;
+    int channels = 0, bits = 0, tag = 0;
+    const unsigned char* data = NULL;
+    size_t data_size = 0;
+    
+    if (memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0) goto error;
+    
+    for (p += 12; p + 8 <= end; ) {
+        size_t size = readLE32SFR(p + 4);
+        if (memcmp(p, "fmt ", 4) == 0 && size >= 16 && p + 8 + size <= end) {
+            tag = readLE16SFR(p + 8);
+            channels = readLE16SFR(p + 10);
+            bits = readLE16SFR(p + 22);
+            if (tag == 0xFFFE && size >= 26) tag = readLE16SFR(p + 32);  // WAVE_FORMAT_EXTENSIBLE sub-format
+        } else if (memcmp(p, "data", 4) == 0) {
+            data = p + 8;
+            data_size = ((size_t)(end - data) < size) ? (size_t)(end - data) : size;
+            break;
+        }
+        p += 8 + size + (size & 1);
+    }
+    
+    if (!data || channels <= 0) goto error;
+    
+    if (tag == 1 && bits == 16) {
+        reader->fSampleFormat = kSFRInt16;
+    } else if (tag == 1 && bits == 24) {
+        reader->fSampleFormat = kSFRInt24;
+    } else if (tag == 1 && bits == 32) {
+        reader->fSampleFormat = kSFRInt32;
+    } else if (tag == 3 && bits == 32) {
+        reader->fSampleFormat = kSFRFloat32;
+    } else if (tag == 3 && bits == 64) {
+        reader->fSampleFormat = kSFRFloat64;
+    } else {
+        goto error;
+    }
+    
+    reader->fMap = (unsigned char*)map;
+    reader->fMapSize = st.st_size;
+    reader->fData = data;
+    reader->fChannels = channels;
+    reader->fSampleBytes = bits / 8;
+    reader->fFrameBytes = reader->fSampleBytes * channels;
+    reader->fFramesNum = (int)(data_size / reader->fFrameBytes);
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    return 1;
+    
+error:
+    munmap(map, st.st_size);
+    return 0;
+}
+
+// Page in and lock the frames in [from, to), rounded outward to pages
+inline static void lockSFR(SoundFileReader* reader, long from, long to)
+{
+    if (from >= to) return;
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)(reader->fData + from * reader->fFrameBytes) & ~(uintptr_t)(page - 1);
+    uintptr_t end = (uintptr_t)(reader->fData + to * reader->fFrameBytes);
+    if (mlock((void*)begin, end - begin) != 0) {
+        // Not allowed to lock more memory: only page in
+        volatile unsigned char sum = 0;
+        for (const unsigned char* b = (const unsigned char*)begin; b < (const unsigned char*)end; b += page) sum += *b;
+    }
+}
+
+// Unlock and release the frames in [from, to), rounded inward to pages so that the frames around are kept
+inline static void releaseSFR(SoundFileReader* reader, long from, long to)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = ((uintptr_t)(reader->fData + from * reader->fFrameBytes) + page - 1) & ~(uintptr_t)(page - 1);
+    uintptr_t end = (uintptr_t)(reader->fData + to * reader->fFrameBytes) & ~(uintptr_t)(page - 1);
+    if (end > begin) {
+        munlock((void*)begin, end - begin);
+        madvise((void*)begin, end - begin, MADV_DONTNEED);
+    }
+}
+
+// Move the locked window [*released, *prefetched) around the read position. The window
+// published to the reader never contains frames that are not locked.
+inline static void prefetchSFR(SoundFileReader* reader, long* prefetched, long* released)
+{
+    long pos = reader->fReadFrame.load(std::memory_order_relaxed);
+    long begin = pos - SOUNDFILE_PREFETCH_FRAMES;
+    long end = pos + SOUNDFILE_PREFETCH_FRAMES;
+    if (begin < 0) begin = 0;
+    if (end > reader->fFramesNum) end = reader->fFramesNum;
+    
+    if (begin < *released || begin > *prefetched) {
+        // Backward or far forward jump: the window is emptied and restarts at the read position
+        reader->fMapEnd.store(0, std::memory_order_release);
+        releaseSFR(reader, *released, *prefetched);
+        *released = *prefetched = begin;
+        reader->fMapBegin.store(begin, std::memory_order_release);
+    }
+    
+    if (end > *prefetched) {
+        lockSFR(reader, *prefetched, end);
+        *prefetched = end;
+        reader->fMapEnd.store(end, std::memory_order_release);
+    }
+    
+    if (begin > *released) {
+        reader->fMapBegin.store(begin, std::memory_order_release);
+        releaseSFR(reader, *released, begin);
+        *released = begin;
+    }
+}
+
+// Decode chunks in the ring as long as there is room ahead of the read position
+inline static void decodeSFR(SoundFileReader* reader, FAUSTFLOAT* chunk)
+{
+    int request = reader->fSeekRequest.load(std::memory_order_acquire);
+    if (reader->fSeekDone.load(std::memory_order_relaxed) != request) {
+        long target = reader->fSeekTarget.load(std::memory_order_relaxed);
+        sf_seek(reader->fSoundFile, target, SEEK_SET);
+        reader->fBegin.store(target, std::memory_order_relaxed);
+        reader->fEnd.store(target, std::memory_order_relaxed);
+        reader->fSeekDone.store(request, std::memory_order_release);
+    }
+    
+    for (;;) {
+        // The slots of the frames kept before the read position are not overwritten
+        long end = reader->fEnd.load(std::memory_order_relaxed);
+        long room = reader->fReadFrame.load(std::memory_order_relaxed) - SOUNDFILE_RING_BEHIND + SOUNDFILE_RING_FRAMES - end;
+        if (room > BUFFER_SIZE) room = BUFFER_SIZE;
+        if (room > reader->fFramesNum - end) room = reader->fFramesNum - end;
+        if (room <= 0 || reader->fSeekDone.load(std::memory_order_relaxed) != reader->fSeekRequest.load(std::memory_order_relaxed)) return;
+        
+        long nbf = READ_SAMPLE(reader->fSoundFile, chunk, room);
+        if (nbf <= 0) return;
+        for (long frame = 0; frame < nbf; frame++) {
+            long slot = (end + frame) & (SOUNDFILE_RING_FRAMES - 1);
+            memcpy(&reader->fRing[slot * reader->fChannels], &chunk[frame * reader->fChannels], reader->fChannels * sizeof(FAUSTFLOAT));
+        }
+        reader->fEnd.store(end + nbf, std::memory_order_release);
+    }
+}
+
+inline static void* runSFR(void* arg)
+{
+    SoundFileReader* reader = (SoundFileReader*)arg;
+    long prefetched = 0, released = 0;
+    FAUSTFLOAT* chunk = (reader->fSoundFile) ? (FAUSTFLOAT*)malloc(BUFFER_SIZE * reader->fChannels * sizeof(FAUSTFLOAT)) : NULL;
+    
+    while (reader->fRunning.load(std::memory_order_acquire)) {
+        if (reader->fMap) {
+            prefetchSFR(reader, &prefetched, &released);
+        } else if (chunk) {
+            decodeSFR(reader, chunk);
+        }
+        usleep(1000);
+    }
+    
+    free(chunk);
+    return NULL;
+}
+
+inline static void destroySFR(SoundFileReader* reader)
+{
+    if (reader) {
+        if (reader->fRunning.load(std::memory_order_relaxed)) {
+            reader->fRunning.store(0, std::memory_order_release);
+            pthread_join(reader->fThread, NULL);
+        }
+        if (reader->fMap) munmap(reader->fMap, reader->fMapSize);
+        if (reader->fSoundFile) sf_close(reader->fSoundFile);
+        free(reader->fRing);
+        delete reader;
+    }
+}
+
+inline static SoundFileReader* createSFR(const char* name)
+{
+    SoundFileReader* reader = new (std::nothrow) SoundFileReader();   // Zero initialized
+    if (!reader) return NULL;
+    
+    if (!mapWAVSFR(reader, name)) {
+        SF_INFO	snd_info;
+        snd_info.format = 0;
+        reader->fSoundFile = sf_open(name, SFM_READ, &snd_info);
+        if (!reader->fSoundFile) goto error;
+        reader->fChannels = snd_info.channels;
+        reader->fFramesNum = snd_info.frames;
+        reader->fRing = (FAUSTFLOAT*)calloc(SOUNDFILE_RING_FRAMES * reader->fChannels, sizeof(FAUSTFLOAT));
+        if (!reader->fRing) goto error;
+        
+        // Fill the beginning of the ring before returning
+        FAUSTFLOAT* chunk = (FAUSTFLOAT*)malloc(BUFFER_SIZE * reader->fChannels * sizeof(FAUSTFLOAT));
+        if (!chunk) goto error;
+        decodeSFR(reader, chunk);
+        free(chunk);
+    } else {
+        long prefetched = 0, released = 0;
+        prefetchSFR(reader, &prefetched, &released);
+    }
+    
+    reader->fRunning.store(1, std::memory_order_release);
+    if (pthread_create(&reader->fThread, NULL, runSFR, reader) != 0) {
+        reader->fRunning.store(0, std::memory_order_relaxed);
+        goto error;
+    }
+    return reader;
+    
+error:
+    destroySFR(reader);
+    return NULL;
+}
+
+inline static int sizeSFR(SoundFileReader* reader)
+{
+    return (reader) ? reader->fFramesNum : 1; 
+}
+
+inline static int channelsSFR(SoundFileReader* reader)
+{
+    return (reader) ? reader->fChannels : 1; 
+}
+
+inline static FAUSTFLOAT decodeSampleSFR(SoundFileReader* reader, const unsigned char* p)
+{
+    switch (reader->fSampleFormat) {
+        case kSFRInt16: return FAUSTFLOAT((int16_t)readLE16SFR(p)) * FAUSTFLOAT(1.0/32768.0);
+        case kSFRInt24: return FAUSTFLOAT((int32_t)((p[0] << 8) | (p[1] << 16) | ((unsigned int)p[2] << 24)) >> 8) * FAUSTFLOAT(1.0/8388608.0);
+        case kSFRInt32: return FAUSTFLOAT((int32_t)readLE32SFR(p) * (1.0/2147483648.0));
+        case kSFRFloat32: { float v; memcpy(&v, p, 4); return FAUSTFLOAT(v); }
+        default: { double v; memcpy(&v, p, 8); return FAUSTFLOAT(v); }
+    }
+}
+
+inline static FAUSTFLOAT sampleSFR(SoundFileReader* reader, int channel, int index)
+{
+    if (!reader || index < 0 || index >= reader->fFramesNum) return 0.f;
+    
+    long pos = reader->fReadFrame.load(std::memory_order_relaxed);
+    if (reader->fMap) {
+        if (index >= reader->fMapBegin.load(std::memory_order_acquire) && index < reader->fMapEnd.load(std::memory_order_acquire)) {
+            // Only a read ahead moves the window
+            if (index > pos) reader->fReadFrame.store(index, std::memory_order_relaxed);
+            return decodeSampleSFR(reader, reader->fData + (size_t)index * reader->fFrameBytes + channel * reader->fSampleBytes);
+        }
+        // Outside of the locked window: the prefetch thread moves it, 0 is returned meanwhile
+        reader->fReadFrame.store(index, std::memory_order_relaxed);
+        return 0.f;
+    }
+    
+    int request = reader->fSeekRequest.load(std::memory_order_relaxed);
+    if (reader->fSeekDone.load(std::memory_order_acquire) != request) return 0.f;  // Seek in progress
+    
+    long begin = reader->fBegin.load(std::memory_order_relaxed);
+    long end = reader->fEnd.load(std::memory_order_acquire);
+    if (begin < pos - SOUNDFILE_RING_BEHIND) begin = pos - SOUNDFILE_RING_BEHIND;
+    if (index >= begin && index < end) {
+        // Only a read ahead moves the window
+        if (index > pos) reader->fReadFrame.store(index, std::memory_order_relaxed);
+        return reader->fRing[(index & (SOUNDFILE_RING_FRAMES - 1)) * reader->fChannels + channel];
+    } else if (index < begin || index >= end + SOUNDFILE_RING_FRAMES / 2) {
+        // Jump before the window or far forward
+        reader->fReadFrame.store(index, std::memory_order_relaxed);
+        reader->fSeekTarget.store(index, std::memory_order_relaxed);
+        reader->fSeekRequest.store(request + 1, std::memory_order_release);
+    }
+    // Otherwise the decoding thread is late
+    return 0.f;
+}
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,113 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+/*
+ Load testing without audio device:
+
+    --sr <rate>             sample rate (44100)
+    --bs <frames>           buffer size (256)
+    --speed <x>             run at x times real time, 0 for as fast as possible (0)
+    --instances <n>         number of DSP instances computed at each buffer (1)
+    --buffers <n>           number of buffers to compute (1000)
+    --noise                 white noise inputs (silence by default)
+    --input <file>          inputs read from a raw file of interleaved 32 bits floats
+    --controls <n>          random dated controls sent to each instance at each buffer (0)
+    --search <max>          print the number of instances (at most max) sustained before the deadline is missed
+    --percentile <p>        percentage of the buffers that have to be computed before the deadline (99.9)
+*/
+
+#include <libgen.h>
+#include <math.h>
+#include <stdlib.h>
+#include <iostream>
+#include <list>
+
+#include "faust/dsp/timed-dsp.h"
+#include "faust/gui/UI.h"
+#include "faust/misc.h"
+#include "faust/audio/headless-audio.h"
+
+/**************************BEGIN USER SECTION **************************/
+
+/******************************************************************************
+*******************************************************************************
+
+							       VECTOR INTRINSICS
+
+*******************************************************************************
+*******************************************************************************/
+
+<<includeIntrinsic>>
+
+<<includeclass>>
+
+using namespace std;
+
+/***************************END USER SECTION ***************************/
+
+/*******************BEGIN ARCHITECTURE SECTION (part 2/2)***************/
+
+list<GUI*> GUI::fGuiList;
+ztimedmap GUI::gTimedZoneMap;
+
+int main(int argc, char* argv[])
+{
+    char name[256];
+    snprintf(name, 255, "%s", basename(argv[0]));
+
+    mydsp* DSP = new mydsp();
+
+    headlessaudio audio(lopt(argv, "--sr", 44100),
+                        lopt(argv, "--bs", 256),
+                        atof(lopts(argv, "--speed", "0")),
+                        lopt(argv, "--instances", 1),
+                        lopt(argv, "--buffers", 1000));
+
+    if (isopt(argv, "--noise")) {
+        audio.setNoise();
+    }
+    if (isopt(argv, "--input") && !audio.setInputFile(lopts(argv, "--input", ""))) {
+        cerr << "Cannot read " << lopts(argv, "--input", "") << endl;
+        exit(1);
+    }
+    audio.setControls(lopt(argv, "--controls", 0));
+    audio.init(name, DSP);
+
+    cout << name << " : " << audio.getSampleRate() << " Hz, " << audio.getBufferSize() << " frames" << endl;
+
+    if (isopt(argv, "--search")) {
+        int instances = audio.sustainedInstances(lopt(argv, "--search", 64), lopt(argv, "--buffers", 1000),
+                                                 atof(lopts(argv, "--percentile", "99.9")));
+        cout << "sustained instances " << instances << endl;
+    } else {
+        audio.start();
+        cout << audio.getInstances() << " instance(s) " << audio.getMonitor().getLoad().json() << endl;
+    }
+
+    audio.stop();
+    delete DSP;
+    return 0;
+}
+
+/********************END ARCHITECTURE SECTION (part 2/2)****************/
+
@@ -88,7 +88,7 @@ static bool getNetInfos(string& name, string& ip)
 
 //--------------------------------------------------------------------------
 HTTPDControler::HTTPDControler(int argc, char *argv[], const char* applicationname, bool init)
-	: fTCPPort(kTCPBasePort), fJson(0), fInit(init)
+	: fTCPPort(kTCPBasePort), fJson(0), fInit(init), fRunning(false)
 {
 	fTCPPort = getPortOption(argc, argv, kPortOpt, fTCPPort);
 	fFactory = new FaustFactory();
@@ -122,6 +122,7 @@ template<> void HTTPDControler::addnode<float>(const char* type, const char* lab
 	fJson->addnode<float>(type, label, init, min, max, step, fCurrentMeta);
 	fHtml->addnode(type, label, init, min, max, step);
 	fCurrentMeta.clear();
+	changed();
 }
 template<> void HTTPDControler::addnode<float>(const char* type, const char* label, float* zone, float min, float max)
 {
@@ -129,6 +130,7 @@ template<> void HTTPDControler::addnode<float>(const char* type, const char* lab
 	fJson->addnode<float>(type, label, min, max, fCurrentMeta);
 	fHtml->addnode(type, label, min, max);
 	fCurrentMeta.clear();
+	changed();
 }
 template<> void HTTPDControler::addnode<float>(const char* type, const char* label, float* zone)
 {
@@ -136,6 +138,7 @@ template<> void HTTPDControler::addnode<float>(const char* type, const char* lab
 	fJson->addnode<float>(type, label, fCurrentMeta);
 	fHtml->addnode(type, label);
 	fCurrentMeta.clear();
+	changed();
 }
 
 template<> void HTTPDControler::addnode<double>(const char* type, const char* label, double* zone, double min, double max)
@@ -144,6 +147,7 @@ template<> void HTTPDControler::addnode<double>(const char* type, const char* la
 	fJson->addnode<double>(type, label, min, max, fCurrentMeta);
 	fHtml->addnode(type, label, min, max);
 	fCurrentMeta.clear();
+	changed();
 }
 
 template<> void HTTPDControler::addnode<double>(const char* type, const char* label, double* zone, double init, double min, double max, double step)
@@ -152,6 +156,7 @@ template<> void HTTPDControler::addnode<double>(const char* type, const char* la
 	fJson->addnode<double>(type, label, init, min, max, step, fCurrentMeta);
 	fHtml->addnode(type, label, init, min, max, step);
 	fCurrentMeta.clear();
+	changed();
 }
 template<> void HTTPDControler::addnode<double>(const char* type, const char* label, double* zone)
 {
@@ -159,6 +164,7 @@ template<> void HTTPDControler::addnode<double>(const char* type, const char* la
 	fJson->addnode<double>(type, label, fCurrentMeta);
 	fHtml->addnode(type, label);
 	fCurrentMeta.clear();
+	changed();
 }
 
 //--------------------------------------------------------------------------
@@ -168,6 +174,7 @@ void HTTPDControler::opengroup(const char* type, const char* label)
 	fJson->opengroup(type, label, fCurrentMeta);
 	fHtml->opengroup(type, label);
     fCurrentMeta.clear();
+	changed();
 }
 
 //--------------------------------------------------------------------------
@@ -176,6 +183,28 @@ void HTTPDControler::closegroup ()
 	fFactory->closegroup();
 	fJson->closegroup();
 	fHtml->closegroup();
+	changed();
+}
+
+//--------------------------------------------------------------------------
+void HTTPDControler::changed()
+{
+	fJSONCache.clear();
+	if (fRunning) updatePages();
+}
+
+//--------------------------------------------------------------------------
+void HTTPDControler::updatePages()
+{
+	SMessageDriven root = fFactory->root();
+	RootNode * rootnode = dynamic_cast<RootNode*>((MessageDriven*)root);
+	if (rootnode) {
+		string json = getJSON();
+		rootnode->setJSON(json);
+		stringstream strhtml;
+		fHtml->root().print(strhtml, json);
+		rootnode->setHtml(strhtml.str());
+	}
 }
 
 //--------------------------------------------------------------------------
@@ -184,17 +213,13 @@ void HTTPDControler::run()
 {
 	SMessageDriven root = fFactory->root();		// first get the root node
 	if (root) {
-		// and cast it to a RootNode
-		RootNode * rootnode = dynamic_cast<RootNode*>((MessageDriven*)root);
 		// starts the network services
 		if (fHttpd->start(root, fTCPPort)) {
             fJson->root().setPort(fTCPPort);
-            string json = fJson->root().json();  // fJson->root().json(true); to 'flatten' JSON 
-            if (rootnode) rootnode->setJSON(json);
-            stringstream strhtml;
             fHtml->root().setPort(fTCPPort);
-            fHtml->root().print(strhtml, json);
-            if (rootnode) rootnode->setHtml(strhtml.str());
+			fJSONCache.clear();
+			fRunning = true;
+			updatePages();
 			// and outputs a message
 			cout << "Faust httpd server version " << version() <<  " is running on TCP port " << fTCPPort << endl;
 		}
@@ -205,22 +230,26 @@ void HTTPDControler::run()
 void HTTPDControler::stop()
 {
 	fHttpd->stop();
+	fRunning = false;
 }
 
 //------------------------------Accessor to json Interface
 std::string HTTPDControler::getJSON() 
 {   
-    return fJson->root().json();
+	if (fJSONCache.empty()) fJSONCache = fJson->root().json();  // fJson->root().json(true); to 'flatten' JSON
+	return fJSONCache;
 }
     
 void HTTPDControler::setInputs(int numInputs) 
 {
     fJson->root().setInputs(numInputs);
+	changed();
 }
     
 void HTTPDControler::setOutputs(int numOutputs) 
 {
     fJson->root().setOutputs(numOutputs);
+	changed();
 }
     
 }
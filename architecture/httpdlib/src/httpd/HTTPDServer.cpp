@@ -28,10 +28,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <chrono>
+#include <algorithm>
 
 #include "HTTPDServer.h"
 #include "Message.h"
 #include "MessageProcessor.h"
+#include "RootNode.h"
 
 #ifdef _WIN32
 #include <io.h>
@@ -44,6 +47,27 @@ namespace httpdfaust
 {
 
 #define kPortsScanRange		1000		// scan this number of TCP ports to find a free one (in case of busy port)
+#define kWatchPeriod		20			// values are checked every kWatchPeriod ms
+#define kLongPollTimeout	10000		// long polling answers are delayed at most kLongPollTimeout ms
+#define kKeepAlive			15000		// events streams send a comment after kKeepAlive ms without change
+
+//--------------------------------------------------------------------------
+// a long polling or a server-sent events client
+//--------------------------------------------------------------------------
+struct HTTPDServer::client
+{
+	HTTPDServer*				fServer;
+	struct MHD_Connection*		fConnection;
+	unsigned long long			fVersion;		// the last version known by the client
+	chrono::steady_clock::time_point fDeadline;	// date of the answer, or of the next keep alive comment
+	bool						fStream;		// a server-sent events stream
+	bool						fSuspended;
+	string						fPending;		// events data not yet sent
+
+	client(HTTPDServer* server, struct MHD_Connection* connection, unsigned long long version, int timeout, bool stream)
+		: fServer(server), fConnection(connection), fVersion(version), fStream(stream), fSuspended(false)
+		{ fDeadline = chrono::steady_clock::now() + chrono::milliseconds(timeout); }
+};
 
 //--------------------------------------------------------------------------
 // static functions
@@ -53,7 +77,26 @@ static int _answer_to_connection (void *cls, struct MHD_Connection *connection,
                           const char *upload_data, size_t *upload_data_size, void **con_cls)
 {
 	HTTPDServer* server = (HTTPDServer*)cls;
-	return server->answer(connection, url, method, version, upload_data, upload_data_size, con_cls); 
+	return server->answer(connection, url, method, version, upload_data, upload_data_size, con_cls);
+}
+
+static ssize_t _read_events (void *cls, uint64_t pos, char *buf, size_t max)
+{
+	HTTPDServer::client* c = (HTTPDServer::client*)cls;
+	return c->fServer->readEvents(c, buf, max);
+}
+
+static void _free_events (void *cls)
+{
+	HTTPDServer::client* c = (HTTPDServer::client*)cls;
+	c->fServer->release(c);
+}
+
+static void _request_completed (void *cls, struct MHD_Connection *connection, void **con_cls, enum MHD_RequestTerminationCode toe)
+{
+	HTTPDServer::client* c = (HTTPDServer::client*)*con_cls;	// long polling clients only
+	if (c) c->fServer->release(c);
+	*con_cls = 0;
 }
 
 // Convert string to float. Accepts both . and , as decimal point
@@ -106,19 +149,257 @@ static int _get_params (void *cls, enum MHD_ValueKind kind, const char *key, con
 // the http server
 //--------------------------------------------------------------------------
 HTTPDServer::HTTPDServer(MessageProcessor* mp)
-	: fProcessor(mp), fServer(0), fDebug(false)
+	: fProcessor(mp), fServer(0), fDebug(false), fJSONResponse(0), fHtmlResponse(0), fUIVersion(0),
+	  fWatcher(0), fRunning(false), fVersion(0)
 {
+	fRoot = dynamic_cast<RootNode*>(mp);
 }
 
-HTTPDServer::~HTTPDServer() { stop(); }
+HTTPDServer::~HTTPDServer()
+{
+	stop();
+	if (fJSONResponse) MHD_destroy_response (fJSONResponse);
+	if (fHtmlResponse) MHD_destroy_response (fHtmlResponse);
+}
 
 //--------------------------------------------------------------------------
 bool HTTPDServer::start(int port)
 {
-	fServer = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY, port, NULL, NULL, _answer_to_connection, this, MHD_OPTION_END);
+	unsigned int flags = MHD_USE_SELECT_INTERNALLY;
+#ifdef HTTPD_SUSPEND_RESUME
+	flags |= MHD_USE_SUSPEND_RESUME;
+#endif
+	fServer = MHD_start_daemon (flags, port, NULL, NULL, _answer_to_connection, this,
+								MHD_OPTION_NOTIFY_COMPLETED, _request_completed, this, MHD_OPTION_END);
+	if (fServer && fRoot) {
+		fRunning = true;
+		fWatcher = new thread(&HTTPDServer::watch, this);
+	}
 	return fServer != 0;
 }
 
+//--------------------------------------------------------------------------
+void HTTPDServer::stop()
+{
+	if (fWatcher) {
+		{
+			lock_guard<mutex> lock(fMutex);
+			fRunning = false;
+		}
+		fWakeUp.notify_all();
+		fWatcher->join();
+		delete fWatcher;
+		fWatcher = 0;
+	}
+	if (fServer) {
+		{
+			// suspended connections have to be resumed before the daemon is stopped
+			lock_guard<mutex> lock(fMutex);
+			resumeAll();
+		}
+		MHD_stop_daemon (fServer);
+	}
+	fServer = 0;
+}
+
+//--------------------------------------------------------------------------
+// the values watcher
+//--------------------------------------------------------------------------
+bool HTTPDServer::update()
+{
+	fRoot->getValues (fCurrent);
+	if ((fVersion == 0) || (fCurrent != fValues)) {
+		fValues.swap (fCurrent);
+		fVersion++;
+		return true;
+	}
+	return false;
+}
+
+void HTTPDServer::resumeAll()
+{
+#ifdef HTTPD_SUSPEND_RESUME
+	for (list<client*>::iterator i = fClients.begin(); i != fClients.end(); i++) {
+		(*i)->fSuspended = false;
+		MHD_resume_connection ((*i)->fConnection);
+	}
+#endif
+	fClients.clear();
+}
+
+void HTTPDServer::watch()
+{
+	unique_lock<mutex> lock(fMutex);
+	while (fRunning) {
+		fWakeUp.wait_for (lock, chrono::milliseconds(kWatchPeriod));
+		if (!fRunning) break;
+		update();
+		// resume the clients that have something to receive
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		list<client*>::iterator i = fClients.begin();
+		while (i != fClients.end()) {
+			client* c = *i;
+			if ((c->fVersion < fVersion) || (now >= c->fDeadline)) {
+#ifdef HTTPD_SUSPEND_RESUME
+				c->fSuspended = false;
+				MHD_resume_connection (c->fConnection);
+#endif
+				i = fClients.erase(i);
+			}
+			else i++;
+		}
+	}
+}
+
+void HTTPDServer::release(client* c)
+{
+	{
+		lock_guard<mutex> lock(fMutex);
+		fClients.remove(c);
+	}
+	delete c;
+}
+
+//--------------------------------------------------------------------------
+void HTTPDServer::valuesJSON (ostream& out) const
+{
+	out << "{\"version\": " << fVersion << ", \"values\": [";
+	for (size_t i = 0; i < fValues.size(); i++) {
+		if (i) out << ", ";
+		out << fValues[i];
+	}
+	out << "]}";
+}
+
+//--------------------------------------------------------------------------
+// '/values' and '/values.bin', with long polling when a 'since' version is given
+int HTTPDServer::values (struct MHD_Connection *connection, void **con_cls, bool binary)
+{
+	unique_lock<mutex> lock(fMutex);
+	if (*con_cls == 0) {						// first call for this request
+		update();
+		const char* since = MHD_lookup_connection_value (connection, MHD_GET_ARGUMENT_KIND, "since");
+#ifdef HTTPD_SUSPEND_RESUME
+		if (since && (strtoull(since, 0, 10) >= fVersion)) {
+			// nothing new for the client: the connection is suspended until the next change
+			client* c = new client(this, connection, fVersion, kLongPollTimeout, false);
+			*con_cls = c;
+			c->fSuspended = true;
+			fClients.push_back(c);
+			MHD_suspend_connection (connection);
+			return MHD_YES;
+		}
+#endif
+	}
+	// the client has been resumed, or there is no need to wait
+	struct MHD_Response *response;
+	if (binary) {
+		vector<float> data (fValues.begin(), fValues.end());
+		response = MHD_create_response_from_buffer (data.size() * sizeof(float), data.size() ? (void*)&data[0] : (void*)"", MHD_RESPMEM_MUST_COPY);
+	}
+	else {
+		stringstream out;
+		valuesJSON (out);
+		string str = out.str();
+		response = MHD_create_response_from_buffer (str.size(), (void*)str.c_str(), MHD_RESPMEM_MUST_COPY);
+	}
+	if (!response) {
+		cerr << "MHD_create_response_from_buffer error: null response\n";
+		return MHD_NO;
+	}
+	stringstream version; version << fVersion;
+	lock.unlock();
+	MHD_add_response_header (response, "Content-Type", binary ? "application/octet-stream" : "application/json");
+	MHD_add_response_header (response, "Access-Control-Allow-Origin", "*");
+	MHD_add_response_header (response, "Cache-Control", "no-cache");
+	MHD_add_response_header (response, "X-Faust-Version", version.str().c_str());
+	int ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+	MHD_destroy_response (response);
+	return ret;
+}
+
+//--------------------------------------------------------------------------
+// '/events': a server-sent events stream of the values
+int HTTPDServer::events (struct MHD_Connection *connection)
+{
+#ifdef HTTPD_SUSPEND_RESUME
+	client* c = new client(this, connection, 0, kKeepAlive, true);
+	struct MHD_Response *response = MHD_create_response_from_callback (MHD_SIZE_UNKNOWN, 1024, _read_events, c, _free_events);
+	if (!response) {
+		delete c;
+		cerr << "MHD_create_response_from_callback error: null response\n";
+		return MHD_NO;
+	}
+	MHD_add_response_header (response, "Content-Type", "text/event-stream");
+	MHD_add_response_header (response, "Access-Control-Allow-Origin", "*");
+	MHD_add_response_header (response, "Cache-Control", "no-cache");
+	int ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+	MHD_destroy_response (response);
+	return ret;
+#else
+	return send (connection, "server-sent events are not supported", 0, MHD_HTTP_NOT_IMPLEMENTED);
+#endif
+}
+
+ssize_t HTTPDServer::readEvents (client* c, char* buffer, size_t max)
+{
+	lock_guard<mutex> lock(fMutex);
+	if (!fRunning) return MHD_CONTENT_READER_END_OF_STREAM;
+	if (c->fPending.empty()) {
+		update();
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		if (c->fVersion < fVersion) {
+			stringstream out;
+			out << "id: " << fVersion << "\ndata: ";
+			valuesJSON (out);
+			out << "\n\n";
+			c->fPending = out.str();
+			c->fVersion = fVersion;
+		}
+		else if (now >= c->fDeadline) {
+			c->fPending = ":\n\n";				// keep alive comment, also detects closed connections
+		}
+		else {
+#ifdef HTTPD_SUSPEND_RESUME
+			// nothing to send: the connection is suspended until the next change
+			c->fSuspended = true;
+			fClients.push_back(c);
+			MHD_suspend_connection (c->fConnection);
+#endif
+			return 0;
+		}
+		c->fDeadline = now + chrono::milliseconds(kKeepAlive);
+	}
+	size_t n = min(max, c->fPending.size());
+	memcpy (buffer, c->fPending.data(), n);
+	c->fPending.erase(0, n);
+	return n;
+}
+
+//--------------------------------------------------------------------------
+// the UI descriptions, rebuilt when the root node ones have changed
+int HTTPDServer::cached (struct MHD_Connection *connection, bool json)
+{
+	if (fRoot->getUIVersion() != fUIVersion) {
+		if (fJSONResponse) MHD_destroy_response (fJSONResponse);
+		if (fHtmlResponse) MHD_destroy_response (fHtmlResponse);
+		fJSONResponse = fHtmlResponse = 0;
+		fUIVersion = fRoot->getUIVersion();
+	}
+	struct MHD_Response*& response = json ? fJSONResponse : fHtmlResponse;
+	if (!response) {
+		const string& page = json ? fRoot->getJSON() : fRoot->getHtml();
+		response = MHD_create_response_from_buffer (page.size(), (void *)page.c_str(), MHD_RESPMEM_MUST_COPY);
+		if (!response) {
+			cerr << "MHD_create_response_from_buffer error: null response\n";
+			return MHD_NO;
+		}
+		MHD_add_response_header (response, "Content-Type", json ? "application/json" : "text/html");
+		MHD_add_response_header (response, "Access-Control-Allow-Origin", "*");
+	}
+	return MHD_queue_response (connection, MHD_HTTP_OK, response);
+}
+
 //--------------------------------------------------------------------------
 int HTTPDServer::send (struct MHD_Connection *connection, const char *page, const char* type, int status)
 {
@@ -211,6 +492,16 @@ int HTTPDServer::answer (struct MHD_Connection *connection, const char *url, con
 		return send (connection, msg.c_str(), 0, MHD_HTTP_BAD_REQUEST);
 	}
 
+	if (fRoot && fRoot->getUIVersion()) {
+		string addr (url);
+		if (addr == "/values")		return values (connection, con_cls, false);
+		if (addr == "/values.bin")	return values (connection, con_cls, true);
+		if (addr == "/events")		return events (connection);
+		if (addr == "/JSON")		return cached (connection, true);
+		if ((addr == "/") && (MHD_get_connection_values (connection, t, NULL, NULL) == 0))
+			return cached (connection, false);
+	}
+
 	Message msg (url);
 	MHD_get_connection_values (connection, t, _get_params, &msg);
 	vector<Message*> outMsgs;
@@ -28,6 +28,10 @@
 #include <string>
 #include <ostream>
 #include <vector>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -51,25 +55,71 @@ typedef size_t socklen_t;
 
 #include <microhttpd.h>
 
+// connections suspension is required for long polling and server-sent events
+#if MHD_VERSION >= 0x00093400
+#define HTTPD_SUSPEND_RESUME
+#endif
+
 namespace httpdfaust
 {
 
 class Message;
 class MessageProcessor;
+class RootNode;
 
 //--------------------------------------------------------------------------
 /*!
-	\brief a specific thread to listen incoming osc packets
+	\brief the http server
+	
+	In addition to the messages processing, the server provides:
+	- the cached JSON and HTML descriptions of the UI ('/JSON' and '/'), rebuilt only 
+	  when the root node descriptions change
+	- the values of all the parameters in a single answer, in declaration order:
+	  '/values' as {"version": n, "values": [...]}, '/values.bin' as an array of 32 bits floats
+	  (host byte order) with the version in a 'X-Faust-Version' header
+	- long polling with '/values?since=n': the answer is delayed until the version is greater than n
+	  (or until a timeout)
+	- server-sent events with '/events': the values are sent each time they change
+	
+	The version is incremented each time a value change is detected by a watcher thread.
 */
 class HTTPDServer
 {
+	public:
+		struct client;		// a long polling or server-sent events client
+	
+	private:
 	MessageProcessor*	fProcessor;
+	RootNode*			fRoot;
 	struct MHD_Daemon *	fServer;
 	bool				fDebug;
 	
+	// cached UI descriptions
+	struct MHD_Response* fJSONResponse;
+	struct MHD_Response* fHtmlResponse;
+	unsigned long		fUIVersion;
+	
+	// parameters values, shared with the watcher thread
+	std::mutex				fMutex;
+	std::condition_variable	fWakeUp;
+	std::thread*			fWatcher;
+	bool					fRunning;
+	std::vector<double>		fValues;		///< the last values read
+	std::vector<double>		fCurrent;		///< temporary values
+	unsigned long long		fVersion;		///< incremented at each values change
+	std::list<client*>		fClients;		///< suspended clients
+	
 	int send (struct MHD_Connection *connection, std::vector<Message*> msgs);
 	int page (struct MHD_Connection *connection, const char *page);
 	const char* getMIMEType (const std::string& page);
+	
+	int		cached	(struct MHD_Connection *connection, bool json);
+	int		values	(struct MHD_Connection *connection, void **con_cls, bool binary);
+	int		events	(struct MHD_Connection *connection);
+	bool	update	();								///< reads the values, must be called with fMutex locked
+	void	valuesJSON (std::ostream& out) const;	///< must be called with fMutex locked
+	void	watch	();
+	void	resumeAll ();
 
 	public:
 				 HTTPDServer(MessageProcessor* mp);
@@ -77,10 +127,13 @@ class HTTPDServer
 
 		/// \brief starts the httpd server
 		bool start (int port);
-		void stop ()			{ if (fServer) MHD_stop_daemon (fServer); fServer=0; }
+		void stop ();
 		int answer (struct MHD_Connection *connection, const char *url, const char *method, const char *version, 
 					const char *upload_data, size_t *upload_data_size, void **con_cls);
 
+		ssize_t	readEvents	(client* c, char* buffer, size_t max);	///< server-sent events content
+		void	release		(client* c);							///< a client connection is terminated
+
 		static int send (struct MHD_Connection *connection, const char *page, const char *type, int status=MHD_HTTP_OK);
 };
 
@@ -56,6 +56,11 @@ class HTTPDControler
 	std::map<std::string, std::string>	fCurrentMeta;	// the current meta declarations 
 
     bool            fInit;
+	std::string		fJSONCache;	// the JSON description, computed again only when the UI structure changes
+	bool			fRunning;
+	
+	void			changed();			// called at each UI structure change
+	void			updatePages();		// gives the JSON and HTML descriptions to the root node
     
 	public:
 		/*
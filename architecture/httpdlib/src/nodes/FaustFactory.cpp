@@ -43,7 +43,9 @@ void FaustFactory::opengroup (const char* label)
 {
 	if (fNodes.size() == 0) {	
 		// the stack is empty: creates a root node 
-		fRoot = RootNode::create (label);	
+		SRootNode root = RootNode::create (label);
+		fRootNode = root;
+		fRoot = root;
 		fNodes.push (fRoot);					
 		
 	} else {
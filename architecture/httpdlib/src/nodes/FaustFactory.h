@@ -30,6 +30,7 @@
 
 #include "MessageDriven.h"
 #include "FaustNode.h"
+#include "RootNode.h"
 
 namespace httpdfaust
 {
@@ -48,9 +49,10 @@ class FaustFactory
 {
 	std::stack<SMessageDriven>	fNodes;		///< maintains the current hierarchy level
 	SMessageDriven				fRoot;		///< keep track of the root node
+	RootNode*					fRootNode;	///< the same, to register the parameters zones
 
 	public:
-				 FaustFactory() {}
+				 FaustFactory() : fRootNode(0) {}
 		virtual ~FaustFactory() {}
 
 		/**
@@ -62,6 +64,7 @@ class FaustFactory
 			if (top) {
 				std::string prefix = top->getAddress();
 				top->add( FaustNode<C>::create (label, zone, init, min, max, prefix.c_str(), initZone));
+				if (fRootNode) fRootNode->addZone(zone);
 			}
 		}
 
@@ -74,6 +77,7 @@ class FaustFactory
 			if (top) {
 				std::string prefix = top->getAddress();
 				top->add( FaustNode<C>::create (label, zone, min, max, prefix.c_str(), initZone) );
+				if (fRootNode) fRootNode->addZone(zone);
 			}
 		}
 
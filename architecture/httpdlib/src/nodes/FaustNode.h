@@ -29,6 +29,7 @@
 
 #include "MessageDriven.h"
 #include "Message.h"
+#include "faust/gui/GUI.h"
 
 namespace httpdfaust
 {
@@ -50,6 +51,11 @@ template <typename C> struct mapping
 	C scale (C x) { C z = (x < fMinIn) ? fMinIn : (x > fMaxIn) ? fMaxIn : x; return fMinOut + (z - fMinIn) * fScale; }
 };
 
+//--------------------------------------------------------------------------
+// FAUSTFLOAT zones are changed by the audio thread when the control bus is active
+inline bool sendControl(FAUSTFLOAT* zone, FAUSTFLOAT val)	{ return GUI::controlBus().write(zone, val); }
+template <typename C> inline bool sendControl(C* zone, C val)	{ return false; }
+
 //--------------------------------------------------------------------------
 /*!
 	\brief a faust node is a terminal node and represents a faust parameter controler
@@ -59,7 +65,12 @@ template <typename C> class FaustNode : public MessageDriven
 	C *	fZone;			// the parameter memory zone
 	mapping<C>	fMapping;
 	
-	bool store(C val)			{ *fZone = fMapping.scale(val); return true; }
+	bool store(C val)
+	{
+		C v = fMapping.scale(val);
+		if (!sendControl(fZone, v)) *fZone = v;
+		return true;
+	}
 
 	protected:
 		FaustNode(const char *name, C* zone, C min, C max, const char* prefix, bool initZone) 
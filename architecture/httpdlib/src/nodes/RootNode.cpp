@@ -50,6 +50,14 @@ bool RootNode::processMessage(const Message* msg, vector<Message*>& outMsg)
 	return MessageDriven::processMessage(msg, outMsg);
 }
 
+//--------------------------------------------------------------------------
+void RootNode::getValues(vector<double>& values) const
+{
+	values.resize(fZones.size());
+	for (size_t i = 0; i < fZones.size(); i++)
+		values[i] = fZones[i].value();
+}
+
 //--------------------------------------------------------------------------
 bool RootNode::accept(const Message* msg, vector<Message*>& outMsg)
 {
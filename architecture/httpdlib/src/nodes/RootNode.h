@@ -26,6 +26,7 @@
 #define __RootNode__
 
 #include <string>
+#include <vector>
 #include "MessageDriven.h"
 
 namespace httpdfaust
@@ -40,18 +41,37 @@ typedef class SMARTP<RootNode>	SRootNode;
 */
 class RootNode : public MessageDriven
 {
+	//--------------------------------------------------------------------------
+	// a parameter zone, float or double
+	struct valuezone {
+		float*	fFloat;
+		double*	fDouble;
+		double	value() const	{ return fFloat ? double(*fFloat) : *fDouble; }
+	};
+
 	std::string fJson;
 	std::string fHtml;
+	unsigned long			fUIVersion;		///< incremented at each change of the UI descriptions
+	std::vector<valuezone>	fZones;			///< the parameters zones, in declaration order
 	
 	protected:
-				 RootNode(const char *name) : MessageDriven (name, "") {}
+				 RootNode(const char *name) : MessageDriven (name, ""), fUIVersion(0) {}
 		virtual ~RootNode() {}
 
 	public:
 		static SRootNode create(const char* name) { return new RootNode(name); }
 
-		void			setJSON(const std::string& json)	{ fJson = json; }
-		void			setHtml(const std::string& html)	{ fHtml = html; }
+		void			setJSON(const std::string& json)	{ fJson = json; fUIVersion++; }
+		void			setHtml(const std::string& html)	{ fHtml = html; fUIVersion++; }
+		const std::string&	getJSON() const		{ return fJson; }
+		const std::string&	getHtml() const		{ return fHtml; }
+		unsigned long		getUIVersion() const	{ return fUIVersion; }
+
+		void			addZone(float* zone)	{ valuezone z = { zone, 0 }; fZones.push_back(z); }
+		void			addZone(double* zone)	{ valuezone z = { 0, zone }; fZones.push_back(z); }
+		//--------------------------------------------------------------------------
+		// the current values of all parameters, in declaration order
+		void			getValues(std::vector<double>& values) const;
 		//--------------------------------------------------------------------------
 		bool			processMessage(const Message* msg, std::vector<Message*>& outMsg);
 		virtual bool	accept(const Message* msg, std::vector<Message*>& outMsg);
@@ -59,7 +59,16 @@ template <typename C> class FaustNode : public MessageDriven, public uiItem
     RootNode* fRoot;
     bool fInput;  // true for input nodes (slider, button...)
 	
-	bool	store(C val) { *fZone = fMapping.clip(val); return true; }
+	bool	store(C val)
+	{
+		C v = fMapping.clip(val);
+		// goes to the audio thread through the control bus when active
+		if (!GUI::controlBus().write(fZone, v)) {
+			*fZone = v;
+			GUI::notifyZone(fZone);
+		}
+		return true;
+	}
 	void	sendOSC() const;
 
 	protected:
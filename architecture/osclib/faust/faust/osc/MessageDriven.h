@@ -24,6 +24,7 @@
 #ifndef __MessageDriven__
 #define __MessageDriven__
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -35,6 +36,7 @@ namespace oscfaust
 
 class Message;
 class OSCRegexp;
+class OSCRegexpCache;
 class MessageDriven;
 typedef class SMARTP<MessageDriven>	SMessageDriven;
 
@@ -48,17 +50,28 @@ typedef class SMARTP<MessageDriven>	SMessageDriven;
 	
 	The principle of the dispatch is the following:
 	- first the processMessage() method should be called on the top level node
-	- next processMessage call propose 
+	- a plain address (without OSC wildcards) is then looked up along the tree
+	  using the subnodes names index
+	- otherwise the address parts containing wildcards are matched with a regular
+	  expression, compiled regular expressions are kept in a cache by the top level
+	  node, the plain parts are still looked up using the index
 */
 class MessageDriven : public MessageProcessor, public smartable
 {
+	typedef std::map<std::string, std::vector<MessageDriven*> > nodesindex;
+
 	std::string						fName;			///< the node name
 	std::string						fOSCPrefix;		///< the node OSC address prefix (OSCAddress = fOSCPrefix + '/' + fName)
 	std::vector<SMessageDriven>		fSubNodes;		///< the subnodes of the current node
+	nodesindex						fSubNodesIndex;	///< the subnodes by name
+	OSCRegexpCache*					fPatterns;		///< compiled address patterns (top level node only)
+
+	void	dispatch(const Message* msg, const std::vector<std::string>& parts, size_t i);
+	void	match(const Message* msg, const std::vector<std::string>& parts, const std::vector<const OSCRegexp*>& regexps, size_t i);
 
 	protected:
-				 MessageDriven(const char *name, const char *oscprefix) : fName (name), fOSCPrefix(oscprefix) {}
-		virtual ~MessageDriven() {}
+				 MessageDriven(const char *name, const char *oscprefix) : fName (name), fOSCPrefix(oscprefix), fPatterns(0) {}
+		virtual ~MessageDriven();
 
 	public:
 		static SMessageDriven create(const char* name, const char *oscprefix)	{ return new MessageDriven(name, oscprefix); }
@@ -117,7 +130,7 @@ class MessageDriven : public MessageProcessor, public smartable
 		*/
 		virtual void	get (unsigned long ipdest, const std::string & what) const {}
 
-		void			add(SMessageDriven node)	{ fSubNodes.push_back (node); }
+		void			add(SMessageDriven node);
 		const char*		getName() const				{ return fName.c_str(); }
 		std::string		getOSCAddress() const;
 		int				size() const				{ return fSubNodes.size (); }
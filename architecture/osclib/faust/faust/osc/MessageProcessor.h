@@ -24,6 +24,8 @@
 #ifndef __MessageProcessor__
 #define __MessageProcessor__
 
+#include <vector>
+
 namespace oscfaust
 {
 
@@ -37,6 +39,13 @@ class MessageProcessor
 	public:
 		virtual		~MessageProcessor() {}
 		virtual void processMessage( const Message* msg ) = 0;
+		/*!
+			\brief process the messages of an OSC bundle, in the bundle order
+		*/
+		virtual void processBundle( const std::vector<const Message*>& msgs )
+		{
+			for (size_t i = 0; i < msgs.size(); i++) processMessage(msgs[i]);
+		}
 };
 
 } // end namespoace
@@ -116,6 +116,7 @@ class RootNode : public MessageDriven
 		static SRootNode create(const char* name, OSCIO* io = 0) { return new RootNode(name, io); }
 
 		virtual void processMessage(const Message* msg);
+		virtual void processBundle(const std::vector<const Message*>& msgs);
 		virtual bool accept(const Message* msg);
 		virtual void get(unsigned long ipdest) const;
 		virtual void get(unsigned long ipdest, const std::string& what) const;
@@ -56,4 +56,44 @@ bool OSCRegexp::match (const char* str) const
 	return fRegexp.MatchExact(str);
 }
 
+//--------------------------------------------------------------------------
+// OSC wildcards, and regexp special characters that a plain address must not contain
+bool OSCRegexp::isPlain (const char* str)
+{
+	while (*str) {
+		switch (*str) {
+			case '*': case '?': case '[': case ']': case '{': case '}': case ',':
+			case '(': case ')': case '.': case '+': case '|': case '^': case '$': case '\\':
+				return false;
+		}
+		str++;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------
+OSCRegexpCache::~OSCRegexpCache()
+{
+	for (lrulist::iterator i = fList.begin(); i != fList.end(); i++)
+		delete i->second;
+}
+
+//--------------------------------------------------------------------------
+const OSCRegexp* OSCRegexpCache::get (const std::string& oscre)
+{
+	std::map<std::string, lrulist::iterator>::iterator i = fMap.find(oscre);
+	if (i != fMap.end()) {
+		fList.splice(fList.begin(), fList, i->second);		// moves the regexp in front
+		return i->second->second;
+	}
+	if (fList.size() >= fCapacity) {						// drops the least recently used regexp
+		fMap.erase(fList.back().first);
+		delete fList.back().second;
+		fList.pop_back();
+	}
+	fList.push_front(std::make_pair(oscre, new OSCRegexp(oscre.c_str())));
+	fMap[oscre] = fList.begin();
+	return fList.front().second;
+}
+
 }
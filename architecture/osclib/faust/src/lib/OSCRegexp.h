@@ -25,6 +25,8 @@
 #define __OSCRegexp__
 
 #include <string>
+#include <list>
+#include <map>
 #include "deelx.h"
 
 namespace oscfaust
@@ -46,6 +48,35 @@ class OSCRegexp
 		virtual ~OSCRegexp() {}
 		
 		bool match (const char* str) const;
+
+		/*!
+			\brief checks if a string contains OSC or regexp special characters
+			\return true when the string can only match an identical string
+		*/
+		static bool isPlain (const char* str);
+};
+
+//--------------------------------------------------------------------------
+/*!
+	\brief a cache of compiled OSC regexps
+
+	The least recently used regexp is dropped when the cache is full.
+	Returned regexps remain valid until \c capacity other patterns are requested.
+*/
+class OSCRegexpCache
+{
+	typedef std::list<std::pair<std::string, OSCRegexp*> > lrulist;
+
+	lrulist			fList;		///< most recently used first
+	std::map<std::string, lrulist::iterator> fMap;
+	size_t			fCapacity;
+
+	public:
+				 OSCRegexpCache (size_t capacity = 256) : fCapacity(capacity) {}
+		virtual ~OSCRegexpCache();
+
+		const OSCRegexp* get (const std::string& oscre);
+		size_t size() const		{ return fList.size(); }
 };
 
 }
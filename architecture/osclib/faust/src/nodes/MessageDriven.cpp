@@ -36,15 +36,78 @@ namespace oscfaust
 
 static const char * kGetMsg = "get";
 
+//--------------------------------------------------------------------------
+MessageDriven::~MessageDriven()
+{
+	delete fPatterns;
+}
+
+//--------------------------------------------------------------------------
+void MessageDriven::add(SMessageDriven node)
+{
+	fSubNodes.push_back(node);
+	fSubNodesIndex[node->name()].push_back(node);
+}
+
 //--------------------------------------------------------------------------
 void MessageDriven::processMessage(const Message* msg)
 {
-	const string addr = msg->address();
+	vector<string> parts;
+	if (!OSCAddress::addressSplit(msg->address(), parts)) return;
+
+	// a compiled regular expression for each address part containing wildcards
+	vector<const OSCRegexp*> regexps(parts.size(), (const OSCRegexp*)0);
+	bool plain = true;
+	for (size_t i = 0; i < parts.size(); i++) {
+		if (!OSCRegexp::isPlain(parts[i].c_str())) {
+			if (!fPatterns) fPatterns = new OSCRegexpCache();
+			regexps[i] = fPatterns->get(parts[i]);
+			plain = false;
+		}
+	}
+	if (plain) {
+		// exact match of each address part
+		if (parts[0] == fName) dispatch(msg, parts, 1);
+	} else {
+		match(msg, parts, regexps, 0);
+	}
+}
 
-	// create a regular expression
-	OSCRegexp r(OSCAddress::addressFirst(addr).c_str());
-	// and call propose with this regexp and with the dest osc address tail
-	propose(msg, &r, OSCAddress::addressTail(addr));
+//--------------------------------------------------------------------------
+// the current node matches parts[i-1]
+void MessageDriven::dispatch(const Message* msg, const vector<string>& parts, size_t i)
+{
+	if (i == parts.size()) {
+		accept(msg);
+	} else {
+		nodesindex::const_iterator n = fSubNodesIndex.find(parts[i]);
+		if (n != fSubNodesIndex.end()) {
+			for (size_t j = 0; j < n->second.size(); j++) {
+				n->second[j]->dispatch(msg, parts, i+1);
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------
+// parts[i] is either matched by regexps[i] or compared to the node name when plain
+void MessageDriven::match(const Message* msg, const vector<string>& parts, const vector<const OSCRegexp*>& regexps, size_t i)
+{
+	if (regexps[i] ? !regexps[i]->match(getName()) : (parts[i] != fName)) return;
+	if (i+1 == parts.size()) {
+		accept(msg);
+	} else if (regexps[i+1]) {
+		for (vector<SMessageDriven>::iterator n = fSubNodes.begin(); n != fSubNodes.end(); n++) {
+			(*n)->match(msg, parts, regexps, i+1);
+		}
+	} else {
+		nodesindex::const_iterator n = fSubNodesIndex.find(parts[i+1]);
+		if (n != fSubNodesIndex.end()) {
+			for (size_t j = 0; j < n->second.size(); j++) {
+				n->second[j]->match(msg, parts, regexps, i+1);
+			}
+		}
+	}
 }
 
 //--------------------------------------------------------------------------
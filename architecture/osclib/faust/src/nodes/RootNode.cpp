@@ -33,6 +33,7 @@
 #include "faust/osc/Message.h"
 #include "faust/OSCIO.h"
 #include "faust/osc/RootNode.h"
+#include "faust/gui/GUI.h"
 #include "OSCStream.h"
 
 #ifdef WIN32
@@ -145,7 +146,9 @@ void RootNode::get(unsigned long ipdest) const		///< handler for the 'get' messa
 //--------------------------------------------------------------------------
 void RootNode::processAlias(const string& address, float val)
 {
- 	vector<aliastarget> targets = fAliases[address];	// retrieve the address aliases
+	std::map<std::string, std::vector<aliastarget> >::const_iterator it = fAliases.find(address);
+	if (it == fAliases.end()) return;
+ 	const vector<aliastarget>& targets = it->second;	// retrieve the address aliases
 	size_t n = targets.size();							// that could point to an arbitraty number of targets
 	for (size_t i = 0; i < n; i++) {					// for each target
 		Message m(targets[i].fTarget, address);			// create a new message with the target address and the alias
@@ -169,6 +172,15 @@ std::vector<std::pair<std::string, double> > RootNode::getAliases(const std::str
     return res;
 }
 
+//--------------------------------------------------------------------------
+// the changes of a bundle are applied together by the audio thread
+//--------------------------------------------------------------------------
+void RootNode::processBundle(const vector<const Message*>& msgs)
+{
+	ControlGroup group(GUI::controlBus());
+	MessageDriven::processBundle(msgs);
+}
+
 //--------------------------------------------------------------------------
 // specific processMessage at RootNode: intended to handle aliases
 //--------------------------------------------------------------------------
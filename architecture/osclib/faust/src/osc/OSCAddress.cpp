@@ -60,5 +60,19 @@ string OSCAddress::addressTail (const string& a)
 	return "";
 }
 
+//--------------------------------------------------------------------------
+bool OSCAddress::addressSplit (const string& a, vector<string>& parts)
+{
+	parts.clear();
+	if (a.empty() || (a[0] != kAddressSep)) return false;
+	size_t start = 1;
+	size_t n;
+	while ((n = a.find_first_of(kAddressSep, start)) != string::npos) {
+		parts.push_back(a.substr(start, n - start));
+		start = n + 1;
+	}
+	parts.push_back(a.substr(start));
+	return true;
+}
 
 } // end namespoace
@@ -26,6 +26,7 @@
 #define __OSCAddress__
 
 #include <string>
+#include <vector>
 
 namespace oscfaust
 {
@@ -59,6 +60,13 @@ class OSCAddress
 			\return the tail of an address after its first part.
 		*/
 		static std::string	addressTail (const std::string& address);
+		/*!
+			\brief address decoding utility.
+			\param address the osc address to be processed
+			\param parts on output, the address parts (without '/')
+			\return false when the address does not start with '/'
+		*/
+		static bool			addressSplit (const std::string& address, std::vector<std::string>& parts);
 };
 
 
@@ -72,10 +72,10 @@ void OSCListener::run()
 }
 
 //--------------------------------------------------------------------------
-void OSCListener::ProcessMessage(const osc::ReceivedMessage& m, const IpEndpointName& src)
+Message* OSCListener::convert(const osc::ReceivedMessage& m, const IpEndpointName& src)
 {
- 	Message msg = Message(m.AddressPattern());
-	msg.setSrcIP(src.address);
+ 	Message* msg = new Message(m.AddressPattern());
+	msg->setSrcIP(src.address);
 	if (fSetDest && (src.address != kLocalhost)) {
 		oscout.setAddress(src.address);
 		fSetDest = false;
@@ -83,17 +83,45 @@ void OSCListener::ProcessMessage(const osc::ReceivedMessage& m, const IpEndpoint
 	ReceivedMessageArgumentIterator i = m.ArgumentsBegin();
 	while (i != m.ArgumentsEnd()) {
 		if (i->IsString()) {
-			msg.add<string>(i->AsStringUnchecked());			
+			msg->add<string>(i->AsStringUnchecked());			
 		}
 		else if (i->IsInt32()) {
-			msg.add<int>(i->AsInt32Unchecked());			
+			msg->add<int>(i->AsInt32Unchecked());			
 		}
 		else if (i->IsFloat()) {
-			msg.add<float>(i->AsFloatUnchecked());			
+			msg->add<float>(i->AsFloatUnchecked());			
 		}
 		i++;
 	}
-	fMsgHandler->processMessage(&msg);
+	return msg;
+}
+
+//--------------------------------------------------------------------------
+void OSCListener::ProcessMessage(const osc::ReceivedMessage& m, const IpEndpointName& src)
+{
+	Message* msg = convert(m, src);
+	fMsgHandler->processMessage(msg);
+	delete msg;
+}
+
+//--------------------------------------------------------------------------
+void OSCListener::collect(const osc::ReceivedBundle& b, const IpEndpointName& src, vector<const Message*>& msgs)
+{
+	for (ReceivedBundle::const_iterator i = b.ElementsBegin(); i != b.ElementsEnd(); ++i) {
+		if (i->IsBundle())
+			collect(ReceivedBundle(*i), src, msgs);
+		else
+			msgs.push_back(convert(ReceivedMessage(*i), src));
+	}
+}
+
+//--------------------------------------------------------------------------
+void OSCListener::ProcessBundle(const osc::ReceivedBundle& b, const IpEndpointName& src)
+{
+	vector<const Message*> msgs;
+	collect(b, src, msgs);
+	fMsgHandler->processBundle(msgs);
+	for (size_t i = 0; i < msgs.size(); i++) delete msgs[i];
 }
 
 } // end namespoace
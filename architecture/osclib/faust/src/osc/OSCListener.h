@@ -25,6 +25,8 @@
 #ifndef __OSCListener__
 #define __OSCListener__
 
+#include <vector>
+
 #include "faust/osc/smartpointer.h"
 #include "faust/osc/MessageProcessor.h"
 
@@ -37,6 +39,8 @@ typedef void (*ErrorCallback)(void*);
 namespace oscfaust
 {
 
+class Message;
+
 //--------------------------------------------------------------------------
 /*!
 	\brief an OSC listener that converts OSC input to Messages
@@ -53,6 +57,9 @@ class OSCListener : public osc::OscPacketListener, public smartable
 	bool	fSetDest;
 	int		fPort;
 
+	Message*	convert(const osc::ReceivedMessage& m, const IpEndpointName& src);
+	void		collect(const osc::ReceivedBundle& b, const IpEndpointName& src, std::vector<const Message*>& msgs);
+
 	public:
 		static SMARTP<OSCListener> create(MessageProcessor* mp, int port)
 			{ return new OSCListener(mp, port); }
@@ -64,6 +71,10 @@ class OSCListener : public osc::OscPacketListener, public smartable
 			\param remoteEndpoint the sender IP address
 		*/
 		virtual void ProcessMessage(const osc::ReceivedMessage& m, const IpEndpointName& remoteEndpoint);
+		/*!
+			\brief process OSC bundles: nested bundles are flattened and the messages are given at once to the message handler
+		*/
+		virtual void ProcessBundle(const osc::ReceivedBundle& b, const IpEndpointName& remoteEndpoint);
 		virtual void run();
 		virtual void stop()				{ fRunning = false; if (fSocket) fSocket->AsynchronousBreak(); }
 		virtual void setPort(int port)	{ fPort = port; }
@@ -49,6 +49,11 @@ typedef unsigned long long uint64;
 
 
 
+// compilers do not define x86_64 by themselves: derive it so that int32/uint32 are 4 bytes on 64 bits hosts
+#if !defined(x86_64) && (defined(__x86_64__) || defined(__LP64__))
+#define x86_64
+#endif
+
 #ifdef x86_64
 
 typedef signed int int32;
@@ -0,0 +1,408 @@
+/************************************************************************
+
+	IMPORTANT NOTE : this file contains two clearly delimited sections :
+	the ARCHITECTURE section (in two parts) and the USER section. Each section
+	is governed by its own copyright and license. Please check individually
+	each section for license and copyright information.
+*************************************************************************/
+
+/*******************BEGIN ARCHITECTURE SECTION (part 1/2)****************/
+
+/************************************************************************
+    FAUST Architecture File
+    Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This Architecture section is free software; you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+    EXCEPTION : As a special exception, you may create a larger work
+    that contains this FAUST architecture section and distribute
+    that work under terms of your choice, so long as this FAUST
+    architecture section is not modified.
+
+ ************************************************************************
+ ************************************************************************/
+
+/*
+ Offline batch renderer: processes a list of soundfiles with the DSP.
+
+ usage : render [--block N] [--threads N] [--continue N] [-param value ...] in1 out1 [in2 out2 ...]
+
+ - files are processed concurrently by N workers (default: number of cores), each owning a DSP instance.
+   The files are rendered by groups of same sample rate, the static tables shared by the instances
+   (mydsp::classInit) are initialized once before the workers of a group start.
+ - each file goes through a three stages pipeline (read + deinterleave / compute / interleave + write),
+   the stages run on separate threads and exchange a small set of large blocks (default 8192 frames).
+ - the realtime factor (soundfile duration / rendering time) is printed for each file.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sndfile.h>
+#include <vector>
+#include <stack>
+#include <string>
+#include <map>
+#include <iostream>
+
+#include "faust/gui/console.h"
+#include "faust/gui/FUI.h"
+#include "faust/dsp/dsp.h"
+#include "faust/misc.h"
+#include "faust/dsp/dsp-tools.h"
+
+#ifndef FAUSTFLOAT
+#define FAUSTFLOAT float
+#endif
+
+#define READ_SAMPLE sf_readf_float
+#define WRITE_SAMPLE sf_writef_float
+
+/******************************************************************************
+*******************************************************************************
+
+VECTOR INTRINSICS
+
+*******************************************************************************
+*******************************************************************************/
+
+<<includeIntrinsic>>
+
+/********************END ARCHITECTURE SECTION (part 1/2)****************/
+
+/**************************BEGIN USER SECTION **************************/
+
+<<includeclass>>
+
+/***************************END USER SECTION ***************************/
+
+/*******************BEGIN ARCHITECTURE SECTION (part 2/2)***************/
+
+#define kSlots 3
+
+// Blocking FIFO of block indexes exchanged between the pipeline stages
+class SlotQueue
+{
+    private:
+
+        int fSlots[kSlots + 1];
+        int fRead, fWrite;
+        pthread_mutex_t fMutex;
+        pthread_cond_t fCond;
+
+    public:
+
+        SlotQueue():fRead(0), fWrite(0)
+        {
+            pthread_mutex_init(&fMutex, NULL);
+            pthread_cond_init(&fCond, NULL);
+        }
+
+        ~SlotQueue()
+        {
+            pthread_mutex_destroy(&fMutex);
+            pthread_cond_destroy(&fCond);
+        }
+
+        void push(int slot)
+        {
+            pthread_mutex_lock(&fMutex);
+            fSlots[fWrite] = slot;
+            fWrite = (fWrite + 1) % (kSlots + 1);
+            pthread_cond_signal(&fCond);
+            pthread_mutex_unlock(&fMutex);
+        }
+
+        int pop()
+        {
+            pthread_mutex_lock(&fMutex);
+            while (fRead == fWrite) {
+                pthread_cond_wait(&fCond, &fMutex);
+            }
+            int slot = fSlots[fRead];
+            fRead = (fRead + 1) % (kSlots + 1);
+            pthread_mutex_unlock(&fMutex);
+            return slot;
+        }
+};
+
+struct Block
+{
+    Deinterleaver* fInput;
+    Interleaver* fOutput;
+    int fFrames;        // Frames to process, 0 at end of file
+};
+
+// One file processed by a worker
+struct RenderJob
+{
+    SNDFILE* fInFile;
+    SNDFILE* fOutFile;
+    SF_INFO fInInfo;
+    int fAppend;        // Number of frames to compute beyond input file
+    Block fBlocks[kSlots];
+    SlotQueue fFree, fToCompute, fToWrite;
+};
+
+static void* readStage(void* arg)
+{
+    RenderJob* job = static_cast<RenderJob*>(arg);
+    int append = job->fAppend;
+    int nbf;
+    do {
+        Block* block = &job->fBlocks[job->fFree.pop()];
+        int block_size = block->fInput->numFrames();
+        nbf = int(READ_SAMPLE(job->fInFile, block->fInput->input(), block_size));
+        if (nbf < block_size && append > 0) {
+            // Silence beyond input file for the tail
+            int tail = std::min(block_size - nbf, append);
+            memset(block->fInput->input() + nbf * job->fInInfo.channels, 0, sizeof(FAUSTFLOAT) * tail * job->fInInfo.channels);
+            append -= tail;
+            nbf += tail;
+        }
+        block->fInput->deinterleave();
+        block->fFrames = nbf;
+        job->fToCompute.push(int(block - job->fBlocks));
+    } while (nbf > 0);
+    return 0;
+}
+
+static void* writeStage(void* arg)
+{
+    RenderJob* job = static_cast<RenderJob*>(arg);
+    for (;;) {
+        Block* block = &job->fBlocks[job->fToWrite.pop()];
+        if (block->fFrames == 0) break;
+        block->fOutput->interleave();
+        WRITE_SAMPLE(job->fOutFile, block->fOutput->output(), block->fFrames);
+        job->fFree.push(int(block - job->fBlocks));
+    }
+    return 0;
+}
+
+static double getTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) + double(tv.tv_usec) / 1000000.;
+}
+
+class Renderer
+{
+    private:
+
+        std::vector<const char*> fFiles;
+        int fArgc;
+        char** fArgv;
+        int fBlockSize;
+        int fAppend;
+        int fNextFile;
+        pthread_mutex_t fMutex;
+
+        int nextFile()
+        {
+            pthread_mutex_lock(&fMutex);
+            int file = fNextFile;
+            fNextFile += 2;
+            pthread_mutex_unlock(&fMutex);
+            return (file + 1 < int(fFiles.size())) ? file : -1;
+        }
+
+        void render(mydsp* DSP, CMDUI* interface, const char* input, const char* output)
+        {
+            RenderJob job;
+            job.fAppend = fAppend;
+            job.fInInfo.format = 0;
+            job.fInFile = sf_open(input, SFM_READ, &job.fInInfo);
+            if (job.fInFile == NULL) {
+                fprintf(stderr, "*** Input file '%s' not found.\n", input);
+                return;
+            }
+
+            SF_INFO out_info = job.fInInfo;
+            out_info.channels = DSP->getNumOutputs();
+            job.fOutFile = sf_open(output, SFM_WRITE, &out_info);
+            if (job.fOutFile == NULL) {
+                fprintf(stderr, "*** Cannot write output file '%s'.\n", output);
+                sf_close(job.fInFile);
+                return;
+            }
+
+            DSP->instanceInit(job.fInInfo.samplerate);
+            interface->process_init();
+
+            int numInputs = std::max(job.fInInfo.channels, DSP->getNumInputs());
+            for (int i = 0; i < kSlots; i++) {
+                job.fBlocks[i].fInput = new Deinterleaver(fBlockSize, job.fInInfo.channels, numInputs);
+                job.fBlocks[i].fOutput = new Interleaver(fBlockSize, DSP->getNumOutputs());
+                // DSP inputs not present in the file stay silent
+                for (int chan = job.fInInfo.channels; chan < numInputs; chan++) {
+                    memset(job.fBlocks[i].fInput->outputs()[chan], 0, sizeof(FAUSTFLOAT) * fBlockSize);
+                }
+                job.fFree.push(i);
+            }
+
+            double start = getTime();
+            pthread_t reader, writer;
+            pthread_create(&reader, NULL, readStage, &job);
+            pthread_create(&writer, NULL, writeStage, &job);
+
+            long frames = 0;
+            for (;;) {
+                Block* block = &job.fBlocks[job.fToCompute.pop()];
+                // The block may be recycled by the other stages once pushed
+                int nbf = block->fFrames;
+                if (nbf > 0) {
+                    DSP->compute(nbf, block->fInput->outputs(), block->fOutput->inputs());
+                    frames += nbf;
+                }
+                job.fToWrite.push(int(block - job.fBlocks));
+                if (nbf == 0) break;
+            }
+
+            pthread_join(reader, NULL);
+            pthread_join(writer, NULL);
+            sf_close(job.fInFile);
+            sf_close(job.fOutFile);
+            double elapsed = getTime() - start;
+
+            for (int i = 0; i < kSlots; i++) {
+                delete job.fBlocks[i].fInput;
+                delete job.fBlocks[i].fOutput;
+            }
+
+            double duration = double(frames) / double(job.fInInfo.samplerate);
+            pthread_mutex_lock(&fMutex);
+            printf("%s -> %s : %ld frames, %.3f s in %.3f s, realtime factor %.1f\n",
+                   input, output, frames, duration, elapsed, (elapsed > 0.) ? duration / elapsed : 0.);
+            pthread_mutex_unlock(&fMutex);
+        }
+
+        void work()
+        {
+            AVOIDDENORMALS;
+            mydsp* DSP = new mydsp();
+            CMDUI* interface = new CMDUI(fArgc, fArgv);
+            DSP->buildUserInterface(interface);
+            int file;
+            while ((file = nextFile()) >= 0) {
+                render(DSP, interface, fFiles[file], fFiles[file + 1]);
+            }
+            delete interface;
+            delete DSP;
+        }
+
+        static void* workHandler(void* arg)
+        {
+            static_cast<Renderer*>(arg)->work();
+            return 0;
+        }
+
+    public:
+
+        Renderer(int argc, char* argv[], const std::vector<const char*>& files, int block_size, int append)
+            :fFiles(files), fArgc(argc), fArgv(argv), fBlockSize(block_size), fAppend(append), fNextFile(0)
+        {
+            pthread_mutex_init(&fMutex, NULL);
+        }
+
+        ~Renderer() { pthread_mutex_destroy(&fMutex); }
+
+        void run(int threads)
+        {
+            // Group the files by sample rate (the unreadable ones are reported by render)
+            std::map<int, std::vector<const char*> > groups;
+            for (size_t i = 0; i + 1 < fFiles.size(); i += 2) {
+                SF_INFO info;
+                info.format = 0;
+                SNDFILE* file = sf_open(fFiles[i], SFM_READ, &info);
+                int rate = (file) ? info.samplerate : 0;
+                if (file) sf_close(file);
+                groups[rate].push_back(fFiles[i]);
+                groups[rate].push_back(fFiles[i + 1]);
+            }
+
+            for (std::map<int, std::vector<const char*> >::iterator it = groups.begin(); it != groups.end(); it++) {
+                // classInit rewrites the static tables : never while workers are computing
+                if (it->first > 0) mydsp::classInit(it->first);
+                fFiles = it->second;
+                fNextFile = 0;
+                int count = std::max(1, std::min(threads, int(fFiles.size() / 2)));
+                std::vector<pthread_t> workers(count);
+                for (int i = 0; i < count; i++) {
+                    pthread_create(&workers[i], NULL, workHandler, this);
+                }
+                for (int i = 0; i < count; i++) {
+                    pthread_join(workers[i], NULL);
+                }
+            }
+        }
+};
+
+// loptrm : Scan command-line arguments and remove and return long int value when found
+long loptrm(int *argcP, char *argv[], const char* longname, const char* shortname, long def)
+{
+    int argc = *argcP;
+    for (int i=2; i<argc; i++) {
+        if (strcmp(argv[i-1], shortname) == 0 || strcmp(argv[i-1], longname) == 0) {
+            int optval = atoi(argv[i]);
+            for (int j=i-1; j<argc-2; j++) {  // make it go away for sake of "faust/gui/console.h"
+                argv[j] = argv[j+2];
+            }
+            *argcP -= 2;
+            return optval;
+        }
+    }
+    return def;
+}
+
+int main(int argc, char *argv[])
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int block_size = int(loptrm(&argc, argv, "--block", "-bs", 8192));
+    int threads = int(loptrm(&argc, argv, "--threads", "-t", (cores > 0) ? cores : 1));
+    int append = int(loptrm(&argc, argv, "--continue", "-c", 0));
+
+    // Parse parameters and file names
+    mydsp* tmp = new mydsp();
+    CMDUI* interface = new CMDUI(argc, argv);
+    tmp->buildUserInterface(interface);
+    interface->process_command();
+
+    if (interface->files() < 2 || interface->files() % 2 != 0 || block_size <= 0) {
+        fprintf(stderr, "*** USAGE: %s [--block N] [--threads N] [--continue N] in1 out1 [in2 out2 ...]\n", argv[0]);
+        exit(1);
+    }
+
+    std::vector<const char*> files;
+    for (unsigned long i = 0; i < interface->files(); i++) {
+        files.push_back(interface->file(i));
+    }
+    delete interface;
+    delete tmp;
+
+    Renderer renderer(argc, argv, files, block_size, append);
+    renderer.run(threads);
+    return 0;
+}
+
+/********************END ARCHITECTURE SECTION (part 2/2)****************/
+
@@ -51,6 +51,7 @@
 #include "faust/gui/FUI.h"
 #include "faust/dsp/dsp.h"
 #include "faust/misc.h"
+#include "faust/dsp/dsp-tools.h"
 
 #ifndef FAUSTFLOAT
 #define FAUSTFLOAT float
@@ -81,107 +82,6 @@ VECTOR INTRINSICS
 
 mydsp DSP;
 
-class Separator
-{
-  int		fNumFrames;
-  int		fNumInputs;
-  int		fNumOutputs;
-
-  FAUSTFLOAT*	fInput;
-  FAUSTFLOAT*	fOutputs[256];
-
-public:
-
-  Separator(int numFrames, int numInputs, int numOutputs)
-  {
-    fNumFrames 	= numFrames;
-    fNumInputs 	= numInputs;
-    fNumOutputs = max(numInputs, numOutputs);
-
-    // allocate interleaved input channel
-    fInput = (FAUSTFLOAT*) calloc(fNumFrames * fNumInputs, sizeof(FAUSTFLOAT));
-
-    // allocate separate output channels
-    for (int i = 0; i < fNumOutputs; i++) {
-      fOutputs[i] = (FAUSTFLOAT*) calloc (fNumFrames, sizeof(FAUSTFLOAT));
-    }
-  }
-
-  ~Separator()
-  {
-    // free interleaved input channel
-    free(fInput);
-
-    // free separate output channels
-    for (int i = 0; i < fNumOutputs; i++) {
-      free(fOutputs[i]);
-    }
-  }
-
-  FAUSTFLOAT*	input()		{ return fInput; }
-
-  FAUSTFLOAT** outputs()	{ return fOutputs; }
-
-  void 	separate()
-  {
-    for (int s = 0; s < fNumFrames; s++) {
-      for (int c = 0; c < fNumInputs; c++) {
-        fOutputs[c][s] = fInput[c + s*fNumInputs];
-      }
-    }
-  }
-};
-
-class Interleaver
-{
-  int fNumFrames;
-  int fNumChans;
-
-  FAUSTFLOAT* fInputs[256];
-  FAUSTFLOAT* fOutput;
-
-public:
-
-  Interleaver(int numFrames, int numChans)
-  {
-    fNumFrames = numFrames;
-    fNumChans  = numChans;
-
-    // allocate separate input channels
-    for (int i = 0; i < fNumChans; i++) {
-      fInputs[i] = (FAUSTFLOAT*) calloc (fNumFrames, sizeof(FAUSTFLOAT));
-    }
-
-    // allocate interleaved output channel
-    fOutput = (FAUSTFLOAT*) calloc(fNumFrames * fNumChans, sizeof(FAUSTFLOAT));
-
-  }
-
-  ~Interleaver()
-  {
-    // free separate input channels
-    for (int i = 0; i < fNumChans; i++) {
-      free(fInputs[i]);
-    }
-
-    // free interleaved output channel
-    free(fOutput);
-  }
-
-  FAUSTFLOAT**	inputs()		{ return fInputs; }
-
-  FAUSTFLOAT* 	output()		{ return fOutput; }
-
-  void interleave()
-  {
-    for (int s = 0; s < fNumFrames; s++) {
-      for (int c = 0; c < fNumChans; c++) {
-        fOutput[c + s*fNumChans] = fInputs[c][s];
-      }
-    }
-  }
-};
-
 #define kFrames 512
 
 // loptrm : Scan command-line arguments and remove and return long int value when found
@@ -240,8 +140,8 @@ int main(int argc, char *argv[])
     exit(1); 
   }
 
-  // create separator and interleaver
-  Separator   sep(kFrames, in_info.channels, DSP.getNumInputs());
+  // create deinterleaver and interleaver
+  Deinterleaver sep(kFrames, in_info.channels, DSP.getNumInputs());
   Interleaver ilv(kFrames, DSP.getNumOutputs());
 
   // init signal processor
@@ -253,7 +153,7 @@ int main(int argc, char *argv[])
   int nbf;
   do {
     nbf = READ_SAMPLE(in_sf, sep.input(), kFrames);
-    sep.separate();
+    sep.deinterleave();
     DSP.compute(nbf, sep.outputs(), ilv.inputs());
     ilv.interleave();
     sf_writef_float(out_sf, ilv.output(), nbf);
@@ -264,10 +164,10 @@ int main(int argc, char *argv[])
 
   // compute tail, if any
   if (nAppend>0) {
-    FAUSTFLOAT *input = (FAUSTFLOAT*) calloc(nAppend * DSP.getNumInputs(), sizeof(FAUSTFLOAT));
-    FAUSTFLOAT *inputs[1] = { input };
+    // silent input channels
+    Deinterleaver ain(nAppend, DSP.getNumInputs(), DSP.getNumInputs());
     Interleaver ailv(nAppend, DSP.getNumOutputs());
-    DSP.compute(nAppend, inputs, ailv.inputs());
+    DSP.compute(nAppend, ain.outputs(), ailv.inputs());
     ailv.interleave();
     sf_writef_float(out_sf, ailv.output(), nAppend);
   }
@@ -0,0 +1,21 @@
+#!/bin/bash
+# Runs all the headless binaries of the ghead*dir directories (see 'make headless') as fast as
+# possible on noise inputs, RUNS times each, and collects their loads in a single
+# 'results-load-yymmdd.hhmmss' file. The mean/p50 loads are the compute times of a buffer
+# divided by its period.
+AOPT=${AOPT:-"--bs 256 --buffers 100000 --noise"}
+RUNS=${RUNS:-3}
+DST=results-load-$(date +%y%m%d.%H%M%S)
+
+echo "Faust headless Benchmark : " $AOPT > $DST
+uname -a >> $DST
+date  >> $DST
+for d in ghead*dir; do
+	for f in $d/*; do
+		if [ -x $f ]; then
+			for r in $(seq $RUNS); do
+				echo "$f :" $($f $AOPT | tail -1) >> $DST
+			done
+		fi
+	done
+done
@@ -58,6 +58,7 @@ HEADERS += boxes/boxcomplexity.h \
            generator/contextor.hh \
            generator/description.hh \
            generator/floats.hh \
+           generator/instructions.hh \
            generator/klass.hh \
            generator/occurences.hh \
            generator/Text.hh \
@@ -82,6 +83,9 @@ HEADERS += boxes/boxcomplexity.h \
            signals/ppsig.hh \
            signals/prim2.hh \
            signals/recursivness.hh \
+           signals/firdetection.hh \
+           signals/biquaddetection.hh \
+           signals/mixedprecision.hh \
            signals/signals.hh \
            signals/sigorderrules.hh \
            signals/sigprint.hh \
@@ -167,6 +171,7 @@ SOURCES += main.cpp \
            generator/contextor.cpp \
            generator/description.cpp \
            generator/floats.cpp \
+           generator/instructions.cpp \
            generator/klass.cpp \
            generator/occurences.cpp \
            generator/sharing.cpp \
@@ -192,6 +197,9 @@ SOURCES += main.cpp \
            signals/ppsig.cpp \
            signals/prim2.cpp \
            signals/recursivness.cpp \
+           signals/firdetection.cpp \
+           signals/biquaddetection.cpp \
+           signals/mixedprecision.cpp \
            signals/signals.cpp \
            signals/sigorderrules.cpp \
            signals/sigprint.cpp \
@@ -1,14 +1,20 @@
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
 #include <cassert>
 #ifndef WIN32
 #include <sys/time.h>
+#include <sys/resource.h>
 #endif
 #include "compatibility.hh"
 #include "timing.hh"
+#include "tree.hh"
 
 using namespace std;
 
-extern bool gTimingSwitch;
+extern bool     gTimingSwitch;
+extern string   gTraceFile;
 
 #if 1
 double mysecond()
@@ -20,9 +26,49 @@ double mysecond()
         return ( (double) tp.tv_sec + (double) tp.tv_usec * 1.e-6 );
 }
 
-int		lIndex=0;
-double 	lStartTime[1024];
-double 	lEndTime[1024];
+// peak resident set size in KB (0 when unknown)
+static long peakRSS()
+{
+#ifndef WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    #ifdef __APPLE__
+        return usage.ru_maxrss / 1024;
+    #else
+        return usage.ru_maxrss;
+    #endif
+    }
+#endif
+    return 0;
+}
+
+// counters sampled at the begin and at the end of a span
+struct TimingCounters
+{
+    double          fTime;
+    unsigned long   fTrees;
+    unsigned long   fLookups;
+    unsigned long   fHits;
+    unsigned long   fMisses;
+
+    TimingCounters()
+        : fTime(mysecond()), fTrees(CTree::gLiveCount), fLookups(CTree::gPropertyLookups),
+          fHits(CTree::gHashConsHits), fMisses(CTree::gHashConsMisses)
+    {}
+};
+
+struct TimingSpan
+{
+    string          fName;
+    int             fDepth;
+    TimingCounters  fStart;
+    TimingCounters  fEnd;
+    long            fPeakRSS;
+};
+
+static vector<TimingSpan>   gOpenSpans;         // stack of the spans being measured
+static vector<TimingSpan>   gClosedSpans;       // spans to be written in the trace
+static double               gTraceOrigin = 0;
 
 static void tab (int n, ostream& fout)
 {
@@ -32,22 +78,95 @@ static void tab (int n, ostream& fout)
 
 void startTiming (const char* msg)
 {
-    if (gTimingSwitch) {
-        assert(lIndex < 1023);
-        tab(lIndex, cerr); cerr << "start " << msg << endl;
-        lStartTime[lIndex++] = mysecond();
+    if (gTimingSwitch || gTraceFile != "") {
+        if (gTraceOrigin == 0) gTraceOrigin = mysecond();
+        if (gTimingSwitch) {
+            tab((int)gOpenSpans.size(), cerr); cerr << "start " << msg << endl;
+        }
+        TimingSpan span;
+        span.fName = msg;
+        span.fDepth = (int)gOpenSpans.size();
+        span.fPeakRSS = 0;
+        gOpenSpans.push_back(span);
+        gOpenSpans.back().fStart = TimingCounters();
     }
 }
 
 void endTiming (const char* msg)
 {
-    if (gTimingSwitch) {
-        assert(lIndex>0);
-        lEndTime[--lIndex] = mysecond();
-        tab(lIndex, cerr); cerr << "end " << msg << " (duration : " << lEndTime[lIndex] - lStartTime[lIndex] << ")" << endl;
+    if (gTimingSwitch || gTraceFile != "") {
+        assert(gOpenSpans.size() > 0);
+        TimingSpan span = gOpenSpans.back();
+        gOpenSpans.pop_back();
+        span.fEnd = TimingCounters();
+        span.fPeakRSS = peakRSS();
+        if (gTimingSwitch) {
+            tab(span.fDepth, cerr);
+            cerr << "end " << msg << " (duration : " << span.fEnd.fTime - span.fStart.fTime
+                 << ", peak RSS : " << span.fPeakRSS << " KB"
+                 << ", live trees : " << span.fEnd.fTrees << " (" << (long)(span.fEnd.fTrees - span.fStart.fTrees) << ")"
+                 << ", property lookups : " << span.fEnd.fLookups - span.fStart.fLookups
+                 << ", hash-consing hits/misses : " << span.fEnd.fHits - span.fStart.fHits
+                 << "/" << span.fEnd.fMisses - span.fStart.fMisses << ")" << endl;
+        }
+        if (gTraceFile != "") gClosedSpans.push_back(span);
     }
 }
 
+// write a string as a JSON string literal
+static void writeJSONString (const string& str, ostream& fout)
+{
+    fout << '"';
+    for (size_t i = 0; i < str.size(); i++) {
+        unsigned char c = str[i];
+        switch (c) {
+            case '"':   fout << "\\\""; break;
+            case '\\':  fout << "\\\\"; break;
+            case '\n':  fout << "\\n"; break;
+            case '\t':  fout << "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    const char* hex = "0123456789abcdef";
+                    fout << "\\u00" << hex[c >> 4] << hex[c & 15];
+                } else {
+                    fout << c;
+                }
+        }
+    }
+    fout << '"';
+}
+
+/**
+ * Write the closed spans as "complete" trace events (times in usec),
+ * the counters being given as arguments of each event.
+ */
+void writeTimingTrace (const string& filename)
+{
+    ofstream fout(filename.c_str());
+    if (!fout) {
+        cerr << "ERROR : can't write the trace file " << filename << endl;
+        return;
+    }
+    fout << "{\"traceEvents\": [";
+    for (size_t i = 0; i < gClosedSpans.size(); i++) {
+        const TimingSpan& s = gClosedSpans[i];
+        fout << ((i > 0) ? "," : "") << "\n  {\"name\": ";
+        writeJSONString(s.fName, fout);
+        fout << ", \"cat\": \"faust\", \"ph\": \"X\""
+             << ", \"ts\": " << (long long)((s.fStart.fTime - gTraceOrigin) * 1e6)
+             << ", \"dur\": " << (long long)((s.fEnd.fTime - s.fStart.fTime) * 1e6)
+             << ", \"pid\": 1, \"tid\": 1, \"args\": {"
+             << "\"peak_rss_kb\": " << s.fPeakRSS
+             << ", \"live_trees\": " << s.fEnd.fTrees
+             << ", \"new_trees\": " << (long)(s.fEnd.fTrees - s.fStart.fTrees)
+             << ", \"property_lookups\": " << s.fEnd.fLookups - s.fStart.fLookups
+             << ", \"hashcons_hits\": " << s.fEnd.fHits - s.fStart.fHits
+             << ", \"hashcons_misses\": " << s.fEnd.fMisses - s.fStart.fMisses
+             << "}}";
+    }
+    fout << "\n],\n\"displayTimeUnit\": \"ms\"}" << endl;
+}
+
 #else
 
 void startTiming (const char* msg)
@@ -56,5 +175,8 @@ void startTiming (const char* msg)
 void endTiming (const char* msg)
 {}
 
+void writeTimingTrace (const string& filename)
+{}
+
 #endif
 
@@ -1,14 +1,18 @@
 #ifndef __TIMING__
 #define __TIMING__
 
+#include <string>
 
 // use startTiming("foo") and endTiming("foo") to measure the execution time of a portion of code
-// edit timing.cpp de unactivate the code
+// spans can be nested, they are displayed with -time and written as a Chrome trace with -trace <file>
+// each span also records the peak RSS, the number of live trees, the property lookups
+// and the hash-consing hits and misses done during the span
 
 void startTiming (const char* msg);
 
 void endTiming (const char* msg);
 
-#endif
-
+// write the recorded spans in Chrome trace-event JSON format (chrome://tracing, Perfetto)
+void writeTimingTrace (const std::string& filename);
 
+#endif
@@ -247,7 +247,7 @@ bool getArgName(Tree t, Tree& id)
  * @param localValEnv the local environment
  * @return a block diagram in normal form
  */
-static loopDetector LD(1024, 512);
+static loopDetector LD;
 
 
 static Node EVALPROPERTY(symbol("EvalProperty"));
@@ -283,9 +283,10 @@ static Tree eval (Tree exp, Tree visited, Tree localValEnv)
 	Tree 	result;
 	
     if (!getEvalProperty(exp, localValEnv, result)) {
-        LD.detect(cons(exp,localValEnv));
+        LD.enter(exp, localValEnv);
         //cerr << "ENTER eval("<< *exp << ") with env " << *localValEnv << endl;
 		result = realeval(exp, visited, localValEnv);
+		LD.leave(exp, localValEnv);
 		setEvalProperty(exp, localValEnv, result);
         //cerr << "EXIT eval(" << *exp << ") IS " << *result << " with env " << *localValEnv << endl;
 		if (getDefNameProperty(exp, id)) {
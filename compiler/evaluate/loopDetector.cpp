@@ -1,28 +1,24 @@
 #include "loopDetector.hh"
 #include "ppbox.hh"
 
-bool loopDetector::detect(Tree t)
+void loopDetector::enter(Tree exp, Tree env)
 {
-    fPhase++;
-    int w = fPhase%fBuffersize;
-    fBuffer[w] = t;
-    if ((fPhase%fCheckperiod) == 0) {
-        // time to check for a cycle
-        for (int i=1; i<fBuffersize; i++) {
-            int r = w-i; if (r < 0) { r += fBuffersize; }
-            assert(r>=0);
-            assert(r<fBuffersize);
-            assert(r != w);
-            if (fBuffer[r] == t) {
-                cerr 	<< "ERROR : after "
-                        << fPhase
-                        << " evaluation steps, the compiler has detected an endless evaluation cycle of "
-                        << i
-                        << " steps"
-                        << endl;
-                exit(1);
-            }
-        }
+    fSteps++;
+    pair<unordered_map<pair<Tree,Tree>, int, pairHash>::iterator, bool> r = fActive.insert(make_pair(make_pair(exp, env), fDepth));
+    if (!r.second) {
+        cerr    << "ERROR : after "
+                << fSteps
+                << " evaluation steps, the compiler has detected an endless evaluation cycle of "
+                << fDepth - r.first->second
+                << " steps"
+                << endl;
+        exit(1);
     }
-    return false;
+    fDepth++;
+}
+
+void loopDetector::leave(Tree exp, Tree env)
+{
+    fDepth--;
+    fActive.erase(make_pair(exp, env));
 }
@@ -37,18 +37,28 @@
 
 #include "boxes.hh"
 #include "sourcereader.hh"
+#include <unordered_map>
 
+/**
+ * Keep track of the active evaluations (exp, env) not yet memoized. Evaluating
+ * again an active pair means that the evaluation never ends : the cycle is
+ * detected as soon as it is entered, in constant time per evaluation step.
+ */
 class loopDetector
 {
-		const int		fBuffersize;
-		const int		fCheckperiod;
-		vector<Tree>	fBuffer;
-		int				fPhase;
-		
+		struct pairHash {
+			size_t operator() (const pair<Tree,Tree>& p) const { return size_t(p.first->hashkey()) * 31 + p.second->hashkey(); }
+		};
+
+		unordered_map<pair<Tree,Tree>, int, pairHash>	fActive;	///< active evaluations and their depth
+		int				fDepth;
+		int				fSteps;
+
 	public:
-        loopDetector(int buffersize, int checkperiod) : fBuffersize(buffersize), fCheckperiod(checkperiod), fBuffer(buffersize), fPhase(0) {}
-		bool 	detect 	(Tree t);
-		
+        loopDetector() : fDepth(0), fSteps(0) {}
+		void	enter	(Tree exp, Tree env);		///< exits with an error when (exp, env) is already being evaluated
+		void	leave	(Tree exp, Tree env);
+
 };
 
 
@@ -18,6 +18,11 @@ class TanPrim : public xtended
 	virtual Type 	infereSigType (const vector<Type>& args)
 	{
 		assert (args.size() == 1);
+		interval i = args[0]->getInterval();
+		if (i.valid && i.lo > -M_PI/2 && i.hi < M_PI/2) {
+			// tan is increasing on ]-pi/2, pi/2[
+			return castInterval(floatCast(args[0]), interval(tan(i.lo), tan(i.hi)));
+		}
 		return castInterval(floatCast(args[0]), interval());
 	}
 	
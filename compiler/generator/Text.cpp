@@ -28,6 +28,7 @@
 #include "compatibility.hh"
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <assert.h>
@@ -37,107 +38,79 @@
 extern bool gInternDoubleSwitch;
 extern int  gFloatSize;
 
-static string substitution (const string& model, const vector<string>& args);
+static string substitution (const string& model, const string* const* args, int nargs);
 
 /**
  * Text substitution. Creates a string by replacing all the $n
  * occurences in the model string, with the corresponding arguments.
  * Example :
  * 		subst("float $0 = $1;", "var", T(10.2))
+ * The arguments are passed by address, no argument vector is allocated.
  */
 string subst (const string& model, const vector<string>& args)
 {
-	return substitution(model, args);
+    const string* a[10];
+    int n = (int)min(args.size(), (size_t)10);
+    for (int i = 0; i < n; i++) a[i] = &args[i];
+	return substitution(model, a, n);
 }
 
 string subst (const string& model, const string& a0)
 {
-	vector<string> args(10);
-	args[0] = a0;
-	return substitution (model, args);
+    const string* a[] = { &a0 };
+	return substitution(model, a, 1);
 }
 
 string subst (const string& model, const string& a0, const string& a1)
 {
-	vector<string> args(10);
-	args[0] = a0;
-	args[1] = a1;
-
-	return substitution (model, args);
+    const string* a[] = { &a0, &a1 };
+	return substitution(model, a, 2);
 }
 
 string subst (const string& model, const string& a0, const string& a1, const string& a2)
 {
-	vector<string> args(10);
-
-	args[0] = a0;
-	args[1] = a1;
-	args[2] = a2;
-
-	return substitution (model, args);
+    const string* a[] = { &a0, &a1, &a2 };
+	return substitution(model, a, 3);
 }
 
 string subst (const string& model, const string& a0, const string& a1, const string& a2, const string& a3)
 {
-	vector<string> args(10);
-
-	args[0] = a0;
-	args[1] = a1;
-	args[2] = a2;
-	args[3] = a3;
-
-	return substitution (model, args);
+    const string* a[] = { &a0, &a1, &a2, &a3 };
+	return substitution(model, a, 4);
 }
 
 string subst (const string& model, const string& a0, const string& a1, const string& a2, const string& a3, const string& a4)
 {
-	vector<string> args(10);
-
-	args[0] = a0;
-	args[1] = a1;
-	args[2] = a2;
-	args[3] = a3;
-	args[4] = a4;
-
-	return substitution (model, args);
+    const string* a[] = { &a0, &a1, &a2, &a3, &a4 };
+	return substitution(model, a, 5);
 }
 
 string subst (const string& model, const string& a0, const string& a1, const string& a2, const string& a3, const string& a4, const string& a5)
 {
-	vector<string> args(10);
-
-	args[0] = a0;
-	args[1] = a1;
-	args[2] = a2;
-	args[3] = a3;
-	args[4] = a4;
-	args[5] = a5;
-
-	return substitution (model, args);
+    const string* a[] = { &a0, &a1, &a2, &a3, &a4, &a5 };
+	return substitution(model, a, 6);
 }
 
 string subst (const string& model, const string& a0, const string& a1, const string& a2, const string& a3, const string& a4, const string& a5, const string& a6)
 {
-	vector<string> args(10);
-
-	args[0] = a0;
-	args[1] = a1;
-	args[2] = a2;
-	args[3] = a3;
-	args[4] = a4;
-	args[5] = a5;
-	args[6] = a6;
-
-	return substitution (model, args);
+    const string* a[] = { &a0, &a1, &a2, &a3, &a4, &a5, &a6 };
+	return substitution(model, a, 7);
 }
 
 
-static string substitution (const string& model, const vector<string>& args)
+/**
+ * Replace $n by the nth argument, missing arguments being empty.
+ */
+static string substitution (const string& model, const string* const* args, int nargs)
 {
     char 	c;
     int 	i=0, ilast = (int)model.length()-1;
+    size_t  size = model.length();
     string 	result;
 
+    for (int a = 0; a < nargs; a++) size += args[a]->length();
+    result.reserve(size);
+
     while (i < ilast) {
         c = model[i++];
         if (c != '$') {
@@ -145,7 +118,7 @@ static string substitution (const string& model, const vector<string>& args)
         } else {
             c = model[i++];
             if (c >= '0' && c <= '9') {
-                result += args[c - '0'];
+                if (c - '0' < nargs) result += *args[c - '0'];
             } else {
                 result += c;
             }
@@ -42,6 +42,9 @@
 #include "sigprint.hh"
 #include "sigtyperules.hh"
 #include "recursivness.hh"
+#include "firdetection.hh"
+#include "biquaddetection.hh"
+#include "mixedprecision.hh"
 #include "simplify.hh"
 #include "privatise.hh"
 #include "prim2.hh"
@@ -58,6 +61,13 @@ extern bool     gDrawSignals;
 extern bool     gPrintJSONSwitch;
 extern bool     gDrawSignals;
 extern int      gMaxCopyDelay;
+extern int      gLazySelect;
+extern int      gFIRMinTaps;
+extern int      gBiquadMinSections;
+extern bool     gVectorSwitch;
+extern bool     gLocalDelaySwitch;
+extern bool     gMixedPrecision;
+extern int      gFloatSize;
 extern string   gClassName;
 extern string   gMasterDocument;
 
@@ -117,7 +127,9 @@ startTiming("ScalarCompiler::prepare");
  startTiming("second simplification");
 	Tree L2 = simplify(L1);			// simplify by executing every computable operation
  endTiming("second simplification");
+    startTiming("privatise");
 	Tree L3 = privatise(L2);		// Un-share tables with multiple writers
+    endTiming("privatise");
 
 	// dump normal form
 	if (gDumpNorm) {
@@ -125,14 +137,39 @@ startTiming("ScalarCompiler::prepare");
 		exit(0);
 	}
 
+    startTiming("recursivnessAnnotation");
 	recursivnessAnnotation(L3);		// Annotate L3 with recursivness information
+    endTiming("recursivnessAnnotation");
 
     startTiming("typeAnnotation");
         typeAnnotation(L3);				// Annotate L3 with type information
     endTiming("typeAnnotation");
 
+    if (gFIRMinTaps > 0 && !gVectorSwitch) {
+        startTiming("firAnnotation");
+        firAnnotation(L3, gFIRMinTaps);	// Annotate the FIR filters to compute by FFT convolution
+        endTiming("firAnnotation");
+    }
+
+    if (gBiquadMinSections > 0 && !gVectorSwitch) {
+        startTiming("biquadAnnotation");
+        biquadAnnotation(L3, gBiquadMinSections);	// Annotate the cascades of second order sections to compute by blocks
+        endTiming("biquadAnnotation");
+    }
+
+    if (gMixedPrecision && gFloatSize == 1 && !gVectorSwitch) {
+        startTiming("precisionAnnotation");
+        precisionAnnotation(L3);	// Annotate the signals of the sensitive recursions to compute in double precision
+        endTiming("precisionAnnotation");
+        fMixedPrecision = true;
+    }
+
+    startTiming("sharingAnalysis");
     sharingAnalysis(L3);			// annotate L3 with sharing count
+    endTiming("sharingAnalysis");
+    startTiming("occurrences");
   	fOccMarkup.mark(L3);			// annotate L3 with occurences analysis
+    endTiming("occurrences");
     //annotationStatistics();
 endTiming("ScalarCompiler::prepare");
 
@@ -175,10 +212,12 @@ void ScalarCompiler::compileMultiSignal (Tree L)
         fClass->addZone3(subst("$1* output$0 = output[$0];", T(i), xfloat()));
     }
 
+    startTiming("codegen");
 	for (int i = 0; isList(L); L = tl(L), i++) {
 		Tree sig = hd(L);
-		fClass->addExecCode(subst("output$0[i] = $2$1;", T(i), CS(sig), xcast()));
+		fClass->addExecCode(storeStm(subst("output$0", T(i)), varExp("i"), opExp(string(xcast()) + "$0", CS(sig))));
 	}
+    endTiming("codegen");
     
     generateMetaData();
 	generateUserInterfaceTree(prepareUserInterfaceTree(fUIRoot), true);
@@ -202,7 +241,7 @@ void ScalarCompiler::compileSingleSignal (Tree sig)
 {
 	//contextor recursivness(0);
 	sig = prepare2(sig);		// optimize and annotate expression
-	fClass->addExecCode(subst("output[i] = $0;", CS(sig)));
+	fClass->addExecCode(storeStm("output", varExp("i"), CS(sig)));
 	generateUserInterfaceTree(prepareUserInterfaceTree(fUIRoot), true);
 	generateMacroInterfaceTree("", prepareUserInterfaceTree(fUIRoot));
 	if (fDescription) {
@@ -218,25 +257,25 @@ void ScalarCompiler::compileSingleSignal (Tree sig)
 /**
  * Test if a signal is already compiled
  * @param sig the signal expression to compile.
- * @param name the string representing the compiled expression.
+ * @param cexp the compiled expression.
  * @return true is already compiled
  */
-bool ScalarCompiler::getCompiledExpression(Tree sig, string& cexp)
+bool ScalarCompiler::getCompiledExpression(Tree sig, Expression& cexp)
 {
     return fCompileProperty.get(sig, cexp);
 }
 
 /**
- * Set the string of a compiled expression is already compiled
+ * Set the compiled expression of a signal
  * @param sig the signal expression to compile.
- * @param cexp the string representing the compiled expression.
+ * @param cexp the compiled expression.
  * @return the cexp (for commodity)
  */
-string ScalarCompiler::setCompiledExpression(Tree sig, const string& cexp)
+Expression ScalarCompiler::setCompiledExpression(Tree sig, const Expression& cexp)
 {
-    //cerr << "ScalarCompiler::setCompiledExpression : " << cexp << " ==> " << ppsig(sig) << endl;
-    string old; if (fCompileProperty.get(sig, old) && (old != cexp)) {
-        cerr << "ERROR already a compiled expression attached : " << old << " replaced by " << cexp << endl;
+    //cerr << "ScalarCompiler::setCompiledExpression : " << cexp.toString() << " ==> " << ppsig(sig) << endl;
+    Expression old; if (fCompileProperty.get(sig, old) && (old != cexp)) {
+        cerr << "ERROR already a compiled expression attached : " << old.toString() << " replaced by " << cexp.toString() << endl;
         exit(1);
     }
     fCompileProperty.set(sig, cexp);
@@ -246,22 +285,44 @@ string ScalarCompiler::setCompiledExpression(Tree sig, const string& cexp)
 /**
  * Compile a signal
  * @param sig the signal expression to compile.
- * @return the C code translation of sig as a string
+ * @return the expression of the C code translation of sig
  */
-string  ScalarCompiler::CS (Tree sig)
+Expression  ScalarCompiler::CS (Tree sig)
 {
     //contextor   contextRecursivness;
-    string      code;
+    Expression  code;
 
     if (!getCompiledExpression(sig, code)) {
         // not compiled yet
 /*        if (getRecursivness(sig) != contextRecursivness.get()) {
             contextRecursivness.set(getRecursivness(sig));
         }*/
+        // in mixed precision, ifloat() and the float constants follow the precision of sig
+        int floatSize = gFloatSize;
+        if (fMixedPrecision) gFloatSize = isDoublePrecision(sig) ? 2 : 1;
         code = generateCode(sig);
+        gFloatSize = floatSize;
         setCompiledExpression(sig, code);
     }
-    return code;
+    return (fMixedPrecision) ? convertPrecision(sig, code) : code;
+}
+
+/**
+ * In mixed precision, explicit conversion of the code of a real signal to the
+ * precision of the signal being compiled (the current ifloat()).
+ */
+Expression ScalarCompiler::convertPrecision (Tree sig, const Expression& code)
+{
+    int     i;
+    Tree    x, y, z, id;
+
+    if (isDoublePrecision(sig) == (gFloatSize == 2)
+        || isProj(sig, &i, x) || isSigGen(sig, x) || isSigWaveform(sig)
+        || isSigTable(sig, id, x, y) || isSigWRTbl(sig, id, x, y, z)
+        || getCertifiedSigType(sig)->nature() != kReal) {
+        return code;        // same precision, or not a value (the name of a table...)
+    }
+    return opExp(string(ifloat()) + "($0)", code);
 }
 
 /*****************************************************************************
@@ -273,7 +334,7 @@ string  ScalarCompiler::CS (Tree sig)
  * @return the C code translation of sig
  */
 
-string	ScalarCompiler::generateCode (Tree sig)
+Expression	ScalarCompiler::generateCode (Tree sig)
 {
 #if 0
 	fprintf(stderr, "CALL generateCode(");
@@ -284,12 +345,14 @@ string	ScalarCompiler::generateCode (Tree sig)
 	int 	i;
 	double	r;
     Tree 	c, sel, x, y, z, label, id, ff, largs, type, name, file;
+    vector<double> coefs;
+    vector<Tree> stages;
 
 	//printf("compilation of %p : ", sig); print(sig); printf("\n");
 
 		 if ( getUserData(sig) ) 					{ return generateXtended(sig); }
-	else if ( isSigInt(sig, &i) ) 					{ return generateNumber(sig, T(i)); }
-	else if ( isSigReal(sig, &r) ) 					{ return generateNumber(sig, T(r)); }
+	else if ( isSigInt(sig, &i) ) 					{ return generateNumber(sig, constExp(T(i))); }
+	else if ( isSigReal(sig, &r) ) 					{ return generateNumber(sig, constExp(T(r))); }
     else if ( isSigWaveform(sig) )                  { return generateWaveform(sig); }
 	else if ( isSigInput(sig, &i) ) 				{ return generateInput 	(sig, T(i)); 			}
 	else if ( isSigOutput(sig, &i, x) ) 			{ return generateOutput 	(sig, T(i), CS(x));}
@@ -298,6 +361,8 @@ string	ScalarCompiler::generateCode (Tree sig)
 	else if ( isSigPrefix(sig, x, y) ) 				{ return generatePrefix 	(sig, x, y); 			}
 	else if ( isSigIota(sig, x) ) 					{ return generateIota 		(sig, x); 				}
 
+	else if ( isFIRFilter(sig, x, coefs) )			{ return generateFIR 		(sig, x, coefs); 		}
+	else if ( isBiquadCascade(sig, i, stages) )		{ return generateBiquadCascade(sig, i, stages); 	}
 	else if ( isSigBinOp(sig, &i, x, y) )			{ return generateBinOp 	(sig, i, x, y); 		}
 	else if ( isSigFFun(sig, ff, largs) )			{ return generateFFun 		(sig, ff, largs); 		}
     else if ( isSigFConst(sig, type, name, file) )  { return generateFConst(sig, tree2str(file), tree2str(name)); }
@@ -333,7 +398,7 @@ string	ScalarCompiler::generateCode (Tree sig)
 		printf("\n");
 		exit(1);
 	}
-	return "error in generate code";
+	return constExp("error in generate code");
 }
 
 
@@ -342,7 +407,7 @@ string	ScalarCompiler::generateCode (Tree sig)
 *****************************************************************************/
 
 
-string ScalarCompiler::generateNumber (Tree sig, const string& exp)
+Expression ScalarCompiler::generateNumber (Tree sig, const Expression& exp)
 {
 	string		ctype, vname;
 	Occurences* o = fOccMarkup.retrieve(sig);
@@ -355,13 +420,110 @@ string ScalarCompiler::generateNumber (Tree sig, const string& exp)
 	return exp;
 }
 
+/*****************************************************************************
+                               FIR FILTERS
+*****************************************************************************/
+
+/**
+ * Generate a FIR filter detected by firAnnotation (-fir option) : x is filtered
+ * by a zero latency FFT convolver (faust/dsp/fft-convolver.h, inlined in the
+ * generated code) instead of computing the weighted sum of its delayed values.
+ */
+Expression ScalarCompiler::generateFIR(Tree sig, Tree x, const vector<double>& coefs)
+{
+    string      ctype, vname;
+    string      conv = getFreshID("fConv");
+    int         taps = int(coefs.size());
+
+    fClass->rememberNeedConvolverDef();
+    fClass->addDeclCode(subst("fft_convolver \t$0;", conv));
+
+    fClass->addInitCode(subst("static const double $0Coefs[$1] = {", conv, T(taps)));
+    for (int i = 0; i < taps; i += 16) {
+        string line = "\t";
+        for (int j = i; j < i + 16 && j < taps; j++) {
+            line += T(coefs[j]) + ((j < taps - 1) ? ", " : "");
+        }
+        fClass->addInitCode(line);
+    }
+    fClass->addInitCode("};");
+    fClass->addInitCode(subst("$0.init($0Coefs, $1);", conv, T(taps)));
+    fClass->addClearCode(subst("$0.clear();", conv));
+
+    // the convolver must be called once per sample, with the current value of x
+    getTypedNames(getCertifiedSigType(sig), "Temp", ctype, vname);
+    fClass->addExecCode(declareStm(ctype, vname, opExp("$0.compute($1)", varExp(conv), CS(x))));
+    return (fOccMarkup.retrieve(sig)->getMaxDelay() > 0) ? generateCacheCode(sig, varExp(vname)) : varExp(vname);
+}
+
+/*****************************************************************************
+                          CASCADES OF SECOND ORDER SECTIONS
+*****************************************************************************/
+
+/**
+ * Generate the code of a coefficient of a cascade : a sum of monomials cons(k, factors)
+ */
+string ScalarCompiler::generateCascadeCoef(Tree coef)
+{
+    if (isNil(coef)) return T(0.0);
+    string sum;
+    for (; !isNil(coef); coef = tl(coef)) {
+        double k = tree2float(hd(hd(coef)));
+        string product = (k == 1.0 && !isNil(tl(hd(coef)))) ? "" : T(k);
+        for (Tree f = tl(hd(coef)); !isNil(f); f = tl(f)) {
+            product += (product.empty() ? "" : " * ") + CS(hd(f)).toString();
+        }
+        sum += (sum.empty() ? "" : " + ") + ((product.find(' ') == string::npos) ? product : subst("($0)", product));
+    }
+    return sum;
+}
+
+/**
+ * Generate a cascade of second order sections detected by biquadAnnotation (-bq option) :
+ * the audio input x is filtered by a biquad_cascade (faust/dsp/biquad-cascade.h, inlined
+ * in the generated code) by chunks, as the sample loop reads its output.
+ */
+Expression ScalarCompiler::generateBiquadCascade(Tree sig, int input, const vector<Tree>& coefs)
+{
+    string  casc = getFreshID("fCascade");
+    int     stages = int(coefs.size()) / 7;
+
+    fClass->rememberNeedBiquadDef();
+    fClass->addDeclCode(subst("biquad_cascade<$0,$1,FAUSTFLOAT> \t$2;", ifloat(), T(stages), casc));
+    fClass->addInitCode(subst("$0.init();", casc));
+    fClass->addClearCode(subst("$0.clear();", casc));
+
+    // the stages with constant coefficients are set once, the other ones every block
+    for (int s = 0; s < stages; s++) {
+        int variability = kKonst;
+        string args = T(s + 1);
+        for (int c = 0; c < 7; c++) {
+            for (Tree m = coefs[7*s + c]; !isNil(m); m = tl(m)) {
+                for (Tree f = tl(hd(m)); !isNil(f); f = tl(f)) {
+                    variability = max(variability, getCertifiedSigType(hd(f))->variability());
+                }
+            }
+            args += ", " + generateCascadeCoef(coefs[7*s + c]);
+        }
+        if (variability == kKonst) {
+            fClass->addInitCode(subst("$0.setStage($1);", casc, args));
+        } else {
+            fClass->addZone3(subst("$0.setStage($1);", casc, args));
+        }
+    }
+    fClass->addZone3(subst("$0.start(count, input$1);", casc, T(input)));
+    fClass->addZone4(subst("$0.finish();", casc));
+    return generateCacheCode(sig, opExp("$0.sample($1)", varExp(casc), varExp("i")));
+}
+
 /*****************************************************************************
                                FOREIGN CONSTANTS
 *****************************************************************************/
 
 
-string ScalarCompiler::generateFConst (Tree sig, const string& file, const string& exp)
+Expression ScalarCompiler::generateFConst (Tree sig, const string& file, const string& name)
 {
+    Expression  exp = varExp(name);
     string      ctype, vname;
     Occurences* o = fOccMarkup.retrieve(sig);
 
@@ -379,12 +541,10 @@ string ScalarCompiler::generateFConst (Tree sig, const string& file, const strin
 *****************************************************************************/
 
 
-string ScalarCompiler::generateFVar (Tree sig, const string& file, const string& exp)
+Expression ScalarCompiler::generateFVar (Tree sig, const string& file, const string& name)
 {
-    string      ctype, vname;
-
     addIncludeFile(file);
-    return generateCacheCode(sig, exp);
+    return generateCacheCode(sig, varExp(name));
 }
 
 /*****************************************************************************
@@ -392,22 +552,22 @@ string ScalarCompiler::generateFVar (Tree sig, const string& file, const string&
 *****************************************************************************/
 
 
-string ScalarCompiler::generateInput (Tree sig, const string& idx)
+Expression ScalarCompiler::generateInput (Tree sig, const string& idx)
 {
+    Expression input = opExp(string(icast()) + "$0", loadExp(varExp("input" + idx), varExp("i")));
     if (gInPlace) {
         // inputs must be cached for in-place transformations
-        return forceCacheCode(sig, subst("$1input$0[i]", idx, icast()));
+        return forceCacheCode(sig, input);
     } else {
-        return generateCacheCode(sig, subst("$1input$0[i]", idx, icast()));
+        return generateCacheCode(sig, input);
     }
 }
 
 
-string ScalarCompiler::generateOutput (Tree sig, const string& idx, const string& arg)
+Expression ScalarCompiler::generateOutput (Tree sig, const string& idx, const Expression& arg)
 {
-	string dst = subst("output$0[i]", idx);
-	fClass->addExecCode(subst("$0 = $2$1;", dst, arg, xcast()));
-	return dst;
+	fClass->addExecCode(storeStm(subst("output$0", idx), varExp("i"), opExp(string(xcast()) + "$0", arg)));
+	return loadExp(varExp("output" + idx), varExp("i"));
 }
 
 
@@ -415,7 +575,7 @@ string ScalarCompiler::generateOutput (Tree sig, const string& idx, const string
 							   BINARY OPERATION
 *****************************************************************************/
 
-string ScalarCompiler::generateBinOp(Tree sig, int opcode, Tree arg1, Tree arg2)
+Expression ScalarCompiler::generateBinOp(Tree sig, int opcode, Tree arg1, Tree arg2)
 {
     if (opcode == kDiv) {
         // special handling for division, we always want a float division
@@ -432,16 +592,16 @@ string ScalarCompiler::generateBinOp(Tree sig, int opcode, Tree arg1, Tree arg2)
 
 
         if (t1->nature()==kInt && t2->nature()==kInt ) {
-            return generateCacheCode(sig, subst("($3($0) $1 $3($2))", CS(arg1), gBinOpTable[opcode]->fName, CS(arg2), ifloat()));
+            return generateCacheCode(sig, opExp(subst("($1($$0) $0 $1($$1))", gBinOpTable[opcode]->fName, ifloat()), CS(arg1), CS(arg2)));
         } else if (t1->nature()==kInt && t2->nature()==kReal ) {
-            return generateCacheCode(sig, subst("($3($0) $1 $2)", CS(arg1), gBinOpTable[opcode]->fName, CS(arg2), ifloat()));
+            return generateCacheCode(sig, opExp(subst("($1($$0) $0 $$1)", gBinOpTable[opcode]->fName, ifloat()), CS(arg1), CS(arg2)));
         } else if (t1->nature()==kReal && t2->nature()==kInt ) {
-            return generateCacheCode(sig, subst("($0 $1 $3($2))", CS(arg1), gBinOpTable[opcode]->fName, CS(arg2), ifloat()));
+            return generateCacheCode(sig, opExp(subst("($$0 $0 $1($$1))", gBinOpTable[opcode]->fName, ifloat()), CS(arg1), CS(arg2)));
         } else  {
-            return generateCacheCode(sig, subst("($0 $1 $2)", CS(arg1), gBinOpTable[opcode]->fName, CS(arg2), ifloat()));
+            return generateCacheCode(sig, opExp(subst("($$0 $0 $$1)", gBinOpTable[opcode]->fName), CS(arg1), CS(arg2)));
         }
     } else {
-        return generateCacheCode(sig, subst("($0 $1 $2)", CS(arg1), gBinOpTable[opcode]->fName, CS(arg2)));
+        return generateCacheCode(sig, opExp(subst("($$0 $0 $$1)", gBinOpTable[opcode]->fName), CS(arg1), CS(arg2)));
     }
 }
 
@@ -450,21 +610,23 @@ string ScalarCompiler::generateBinOp(Tree sig, int opcode, Tree arg1, Tree arg2)
 							   Primitive Operations
 *****************************************************************************/
 
-string ScalarCompiler::generateFFun(Tree sig, Tree ff, Tree largs)
+Expression ScalarCompiler::generateFFun(Tree sig, Tree ff, Tree largs)
 {
 	addIncludeFile(ffincfile(ff)); 	//printf("inc file %s\n", ffincfile(ff));
 	addLibrary(fflibfile(ff));		//printf("lib file %s\n", fflibfile(ff));
 
-    string code = ffname(ff);
-    code += '(';
+    string              format = ffname(ff);
+    vector<Expression>  args;
+    format += '(';
     string sep = "";
     for (int i = 0; i< ffarity(ff); i++) {
-        code += sep;
-        code += CS(nth(largs, i));
+        format += sep;
+        format += "$" + T(i);
+        args.push_back(CS(nth(largs, i)));
         sep = ", ";
     }
-    code += ')';
-    return generateCacheCode(sig, code);
+    format += ')';
+    return generateCacheCode(sig, opExp(format, args));
 }
 
 
@@ -481,9 +643,10 @@ void ScalarCompiler::getTypedNames(Type t, const string& prefix, string& ctype,
     }
 }
 
-string ScalarCompiler::generateCacheCode(Tree sig, const string& exp)
+Expression ScalarCompiler::generateCacheCode(Tree sig, const Expression& exp)
 {
-	string 		vname, ctype, code;
+	string 		vname, ctype;
+	Expression	code;
 	int 		sharing = getSharingCount(sig);
 	Occurences* o = fOccMarkup.retrieve(sig);
 
@@ -515,13 +678,14 @@ string ScalarCompiler::generateCacheCode(Tree sig, const string& exp)
 		exit(1);
 	}
 
-	return "Error in generateCacheCode";
+	return constExp("Error in generateCacheCode");
 }
 
 // like generateCacheCode but we force caching like if sharing was always > 1
-string ScalarCompiler::forceCacheCode(Tree sig, const string& exp)
+Expression ScalarCompiler::forceCacheCode(Tree sig, const Expression& exp)
 {
-	string vname, ctype, code;
+	string vname, ctype;
+	Expression code;
 	Occurences* o = fOccMarkup.retrieve(sig);
 
 	// check reentrance
@@ -544,7 +708,7 @@ string ScalarCompiler::forceCacheCode(Tree sig, const string& exp)
 }
 
 
-string ScalarCompiler::generateVariableStore(Tree sig, const string& exp)
+Expression ScalarCompiler::generateVariableStore(Tree sig, const Expression& exp)
 {
     string      vname, ctype;
     Type        t = getCertifiedSigType(sig);
@@ -555,23 +719,23 @@ string ScalarCompiler::generateVariableStore(Tree sig, const string& exp)
 
             getTypedNames(t, "Const", ctype, vname);
             fClass->addDeclCode(subst("$0 \t$1;", ctype, vname));
-            fClass->addInitCode(subst("$0 = $1;", vname, exp));
+            fClass->addInitCode(subst("$0 = $1;", vname, exp.toString()));
             break;
 
         case kBlock :
 
             getTypedNames(t, "Slow", ctype, vname);
             fClass->addFirstPrivateDecl(vname);
-            fClass->addZone2(subst("$0 \t$1 = $2;", ctype, vname, exp));
+            fClass->addZone2(subst("$0 \t$1 = $2;", ctype, vname, exp.toString()));
             break;
 
         case kSamp :
 
             getTypedNames(t, "Temp", ctype, vname);
-            fClass->addExecCode(subst("$0 $1 = $2;", ctype, vname, exp));
+            fClass->addExecCode(declareStm(ctype, vname, exp));
             break;
     }
-    return vname;
+    return varExp(vname);
 }
 
 
@@ -580,21 +744,21 @@ string ScalarCompiler::generateVariableStore(Tree sig, const string& exp)
 *****************************************************************************/
 
 
-string ScalarCompiler::generateIntCast(Tree sig, Tree x)
+Expression ScalarCompiler::generateIntCast(Tree sig, Tree x)
 {
-	return generateCacheCode(sig, subst("int($0)", CS(x)));
+	return generateCacheCode(sig, opExp("int($0)", CS(x)));
 }
 
-string ScalarCompiler::generateFloatCast (Tree sig, Tree x)
+Expression ScalarCompiler::generateFloatCast (Tree sig, Tree x)
 {
-	return generateCacheCode(sig, subst("$1($0)", CS(x), ifloat()));
+	return generateCacheCode(sig, opExp(string(ifloat()) + "($0)", CS(x)));
 }
 
 /*****************************************************************************
 							user interface elements
 *****************************************************************************/
 
-string ScalarCompiler::generateButton(Tree sig, Tree path)
+Expression ScalarCompiler::generateButton(Tree sig, Tree path)
 {
 	string varname = getFreshID("fbutton");
 	fClass->addDeclCode(subst("$1 \t$0;", varname, xfloat()));
@@ -602,10 +766,10 @@ string ScalarCompiler::generateButton(Tree sig, Tree path)
 	addUIWidget(reverse(tl(path)), uiWidget(hd(path), tree(varname), sig));
 
     //return generateCacheCode(sig, varname);
-    return generateCacheCode(sig, subst("$1($0)", varname, ifloat()));
+    return generateCacheCode(sig, opExp(string(ifloat()) + "($0)", varExp(varname)));
 }
 
-string ScalarCompiler::generateCheckbox(Tree sig, Tree path)
+Expression ScalarCompiler::generateCheckbox(Tree sig, Tree path)
 {
 	string varname = getFreshID("fcheckbox");
 	fClass->addDeclCode(subst("$1 \t$0;", varname, xfloat()));
@@ -613,11 +777,11 @@ string ScalarCompiler::generateCheckbox(Tree sig, Tree path)
 	addUIWidget(reverse(tl(path)), uiWidget(hd(path), tree(varname), sig));
 
     //return generateCacheCode(sig, varname);
-    return generateCacheCode(sig, subst("$1($0)", varname, ifloat()));
+    return generateCacheCode(sig, opExp(string(ifloat()) + "($0)", varExp(varname)));
 }
 
 
-string ScalarCompiler::generateVSlider(Tree sig, Tree path, Tree cur, Tree min, Tree max, Tree step)
+Expression ScalarCompiler::generateVSlider(Tree sig, Tree path, Tree cur, Tree min, Tree max, Tree step)
 {
 	string varname = getFreshID("fslider");
 	fClass->addDeclCode(subst("$1 \t$0;", varname, xfloat()));
@@ -625,10 +789,10 @@ string ScalarCompiler::generateVSlider(Tree sig, Tree path, Tree cur, Tree min,
 	addUIWidget(reverse(tl(path)), uiWidget(hd(path), tree(varname), sig));
 
     //return generateCacheCode(sig, varname);
-    return generateCacheCode(sig, subst("$1($0)", varname, ifloat()));
+    return generateCacheCode(sig, opExp(string(ifloat()) + "($0)", varExp(varname)));
 }
 
-string ScalarCompiler::generateHSlider(Tree sig, Tree path, Tree cur, Tree min, Tree max, Tree step)
+Expression ScalarCompiler::generateHSlider(Tree sig, Tree path, Tree cur, Tree min, Tree max, Tree step)
 {
 	string varname = getFreshID("fslider");
 	fClass->addDeclCode(subst("$1 \t$0;", varname, xfloat()));
@@ -636,10 +800,10 @@ string ScalarCompiler::generateHSlider(Tree sig, Tree path, Tree cur, Tree min,
 	addUIWidget(reverse(tl(path)), uiWidget(hd(path), tree(varname), sig));
 
     //return generateCacheCode(sig, varname);
-    return generateCacheCode(sig, subst("$1($0)", varname, ifloat()));
+    return generateCacheCode(sig, opExp(string(ifloat()) + "($0)", varExp(varname)));
 }
 
-string ScalarCompiler::generateNumEntry(Tree sig, Tree path, Tree cur, Tree min, Tree max, Tree step)
+Expression ScalarCompiler::generateNumEntry(Tree sig, Tree path, Tree cur, Tree min, Tree max, Tree step)
 {
 	string varname = getFreshID("fentry");
 	fClass->addDeclCode(subst("$1 \t$0;", varname, xfloat()));
@@ -647,11 +811,11 @@ string ScalarCompiler::generateNumEntry(Tree sig, Tree path, Tree cur, Tree min,
 	addUIWidget(reverse(tl(path)), uiWidget(hd(path), tree(varname), sig));
 
     //return generateCacheCode(sig, varname);
-    return generateCacheCode(sig, subst("$1($0)", varname, ifloat()));
+    return generateCacheCode(sig, opExp(string(ifloat()) + "($0)", varExp(varname)));
 }
 
 
-string ScalarCompiler::generateVBargraph(Tree sig, Tree path, Tree min, Tree max, const string& exp)
+Expression ScalarCompiler::generateVBargraph(Tree sig, Tree path, Tree min, Tree max, const Expression& exp)
 {
 	string varname = getFreshID("fbargraph");
 	fClass->addDeclCode(subst("$1 \t$0;", varname, xfloat()));
@@ -661,24 +825,24 @@ string ScalarCompiler::generateVBargraph(Tree sig, Tree path, Tree min, Tree max
 	switch (t->variability()) {
 
 		case kKonst :
-			fClass->addInitUICode(subst("$0 = $1;", varname, exp));
+			fClass->addInitUICode(subst("$0 = $1;", varname, exp.toString()));
 			break;
 
 		case kBlock :
-			fClass->addZone2(subst("$0 = $1;", varname, exp));
+			fClass->addZone2(subst("$0 = $1;", varname, exp.toString()));
 			break;
 
 		case kSamp :
-			fClass->addExecCode(subst("$0 = $1;", varname, exp));
+			fClass->addExecCode(storeStm(varname, exp));
 			break;
 	}
 
 	//return varname;
-    return generateCacheCode(sig, varname);
+    return generateCacheCode(sig, varExp(varname));
 }
 
 
-string ScalarCompiler::generateHBargraph(Tree sig, Tree path, Tree min, Tree max, const string& exp)
+Expression ScalarCompiler::generateHBargraph(Tree sig, Tree path, Tree min, Tree max, const Expression& exp)
 {
 	string varname = getFreshID("fbargraph");
 	fClass->addDeclCode(subst("$1 \t$0;", varname, xfloat()));
@@ -688,20 +852,20 @@ string ScalarCompiler::generateHBargraph(Tree sig, Tree path, Tree min, Tree max
 	switch (t->variability()) {
 
 		case kKonst :
-			fClass->addInitUICode(subst("$0 = $1;", varname, exp));
+			fClass->addInitUICode(subst("$0 = $1;", varname, exp.toString()));
 			break;
 
 		case kBlock :
-			fClass->addZone2(subst("$0 = $1;", varname, exp));
+			fClass->addZone2(subst("$0 = $1;", varname, exp.toString()));
 			break;
 
 		case kSamp :
-			fClass->addExecCode(subst("$0 = $1;", varname, exp));
+			fClass->addExecCode(storeStm(varname, exp));
 			break;
 	}
 
     //return varname;
-    return generateCacheCode(sig, varname);
+    return generateCacheCode(sig, varExp(varname));
 }
 
 
@@ -717,7 +881,7 @@ string ScalarCompiler::generateHBargraph(Tree sig, Tree path, Tree min, Tree max
 						sigGen : initial table content
 ----------------------------------------------------------------------------*/
 
-string ScalarCompiler::generateSigGen(Tree sig, Tree content)
+Expression ScalarCompiler::generateSigGen(Tree sig, Tree content)
 {
 	string klassname = getFreshID("SIG");
 	string signame = getFreshID("sig");
@@ -726,10 +890,10 @@ string ScalarCompiler::generateSigGen(Tree sig, Tree content)
 	fClass->addInitCode(subst("$0 $1;", klassname, signame));
     fInstanceInitProperty.set(content, pair<string,string>(klassname,signame));
 
-	return signame;
+	return varExp(signame);
 }
 
-string ScalarCompiler::generateStaticSigGen(Tree sig, Tree content)
+Expression ScalarCompiler::generateStaticSigGen(Tree sig, Tree content)
 {
 	string klassname = getFreshID("SIG");
 	string signame = getFreshID("sig");
@@ -738,7 +902,7 @@ string ScalarCompiler::generateStaticSigGen(Tree sig, Tree content)
 	fClass->addStaticInitCode(subst("$0 $1;", klassname, signame));
     fStaticInitProperty.set(content, pair<string,string>(klassname,signame));
 
-	return signame;
+	return varExp(signame);
 }
 
 
@@ -746,11 +910,10 @@ string ScalarCompiler::generateStaticSigGen(Tree sig, Tree content)
 						sigTable : table declaration
 ----------------------------------------------------------------------------*/
 
-string ScalarCompiler::generateTable(Tree sig, Tree tsize, Tree content)
+Expression ScalarCompiler::generateTable(Tree sig, Tree tsize, Tree content)
 {
-	string 		generator(CS(content));
+	string 		generator(CS(content).toString());
     Tree		g;
-    string 		cexp;
     string		ctype, vname;
 	int 		size;
 
@@ -793,14 +956,14 @@ string ScalarCompiler::generateTable(Tree sig, Tree tsize, Tree content)
 	fClass->addInitCode(subst("$0.fill($1,$2);", generator, T(size), vname));
 
 	// on retourne le nom de la table
-	return vname;
+	return varExp(vname);
 }
 
-string ScalarCompiler::generateStaticTable(Tree sig, Tree tsize, Tree content)
+Expression ScalarCompiler::generateStaticTable(Tree sig, Tree tsize, Tree content)
 {
 	//string 		generator(CS(content));
 	Tree		g;
-	string 		cexp;
+	Expression	cexp;
 	string		ctype, vname;
 	int 		size;
 
@@ -843,12 +1006,12 @@ string ScalarCompiler::generateStaticTable(Tree sig, Tree tsize, Tree content)
     fClass->addStaticFields(subst("$0 \t$1::$2[$3];", ctype, fClass->getClassName(), vname, T(size) ));
 
 	// initialisation du generateur de contenu
-	fClass->addStaticInitCode(subst("$0.init(samplingFreq);", cexp));
+	fClass->addStaticInitCode(subst("$0.init(samplingFreq);", cexp.toString()));
 	// remplissage de la table
-	fClass->addStaticInitCode(subst("$0.fill($1,$2);", cexp, T(size), vname));
+	fClass->addStaticInitCode(subst("$0.fill($1,$2);", cexp.toString(), T(size), vname));
 
 	// on retourne le nom de la table
-	return vname;
+	return varExp(vname);
 }
 
 
@@ -856,10 +1019,10 @@ string ScalarCompiler::generateStaticTable(Tree sig, Tree tsize, Tree content)
 						sigWRTable : table assignement
 ----------------------------------------------------------------------------*/
 
-string ScalarCompiler::generateWRTbl(Tree sig, Tree tbl, Tree idx, Tree data)
+Expression ScalarCompiler::generateWRTbl(Tree sig, Tree tbl, Tree idx, Tree data)
 {
-	string tblName(CS(tbl));
-	fClass->addExecCode(subst("$0[$1] = $2;", tblName, CS(idx), CS(data)));
+	Expression tblName(CS(tbl));
+	fClass->addExecCode(storeStm(tblName.toString(), CS(idx), CS(data)));
 	return tblName;
 }
 
@@ -868,7 +1031,7 @@ string ScalarCompiler::generateWRTbl(Tree sig, Tree tbl, Tree idx, Tree data)
 						sigRDTable : table access
 ----------------------------------------------------------------------------*/
 
-string ScalarCompiler::generateRDTbl(Tree sig, Tree tbl, Tree idx)
+Expression ScalarCompiler::generateRDTbl(Tree sig, Tree tbl, Tree idx)
 {
 	// YO le 21/04/05 : La lecture des tables n'�ait pas mise dans le cache
 	// et donc le code �ait dupliqu�(dans tester.dsp par exemple)
@@ -879,13 +1042,13 @@ string ScalarCompiler::generateRDTbl(Tree sig, Tree tbl, Tree idx)
 	// has a static member
 	Tree 	id, size, content;
 	if(	isSigTable(tbl, id, size, content) ) {
-		string tblname;
+		Expression tblname;
 		if (!getCompiledExpression(tbl, tblname)) {
 			tblname = setCompiledExpression(tbl, generateStaticTable(tbl, size, content));
 		}
-		return generateCacheCode(sig, subst("$0[$1]", tblname, CS(idx)));
+		return generateCacheCode(sig, loadExp(tblname, CS(idx)));
 	} else {
-		return generateCacheCode(sig, subst("$0[$1]", CS(tbl), CS(idx)));
+		return generateCacheCode(sig, loadExp(CS(tbl), CS(idx)));
 	}
 }
 
@@ -899,7 +1062,7 @@ string ScalarCompiler::generateRDTbl(Tree sig, Tree tbl, Tree idx)
 /**
  * Generate code for a projection of a group of mutually recursive definitions
  */
-string ScalarCompiler::generateRecProj(Tree sig, Tree r, int i)
+Expression ScalarCompiler::generateRecProj(Tree sig, Tree r, int i)
 {
     string  vname;
     Tree    var, le;
@@ -909,7 +1072,7 @@ string ScalarCompiler::generateRecProj(Tree sig, Tree r, int i)
         generateRec(r, var, le);
         assert(getVectorNameProperty(sig, vname));
     }
-    return "[[UNUSED EXP]]";    // make sure the resulting expression is never used in the generated code
+    return constExp("[[UNUSED EXP]]");    // make sure the resulting expression is never used in the generated code
 }
 
 
@@ -944,7 +1107,14 @@ void ScalarCompiler::generateRec(Tree sig, Tree var, Tree le)
     // generate delayline for each element of a recursive definition
     for (int i=0; i<N; i++) {
         if (used[i]) {
-            generateDelayLine(ctype[i], vname[i], delay[i], CS(nth(le,i)));
+            Expression exp = CS(nth(le,i));
+            double radius;
+            if (fMixedPrecision && ctype[i] != "int" && getFeedbackRadius(sig, radius)) {
+                // report the precision chosen for the recursion
+                fClass->addDeclCode(subst("// $0 : $1 precision, feedback radius $2", vname[i], ctype[i],
+                                          (radius < HUGE_VAL) ? subst("$0", T(radius)) : "unbounded"));
+            }
+            generateDelayLine(ctype[i], vname[i], delay[i], exp);
         }
     }
 }
@@ -954,7 +1124,7 @@ void ScalarCompiler::generateRec(Tree sig, Tree var, Tree le)
 							   PREFIX, DELAY A PREFIX VALUE
 *****************************************************************************/
 
-string ScalarCompiler::generatePrefix (Tree sig, Tree x, Tree e)
+Expression ScalarCompiler::generatePrefix (Tree sig, Tree x, Tree e)
 {
 	Type te = getCertifiedSigType(sig);//, tEnv);
 
@@ -964,11 +1134,11 @@ string ScalarCompiler::generatePrefix (Tree sig, Tree x, Tree e)
 	string type = cType(te);
 
 	fClass->addDeclCode(subst("$0 \t$1;", type, vperm));
-	fClass->addInitCode(subst("$0 = $1;", vperm, CS(x)));
+	fClass->addInitCode(subst("$0 = $1;", vperm, CS(x).toString()));
 
-	fClass->addExecCode(subst("$0 $1 = $2;", type, vtemp, vperm));
-	fClass->addExecCode(subst("$0 = $1;", vperm, CS(e)));
-	return vtemp;
+	fClass->addExecCode(declareStm(type, vtemp, varExp(vperm)));
+	fClass->addExecCode(storeStm(vperm, CS(e)));
+	return varExp(vtemp);
 }
 
 
@@ -980,7 +1150,7 @@ static bool isPowerOf2(int n)
 	return !(n & (n - 1));
 }
 
-string ScalarCompiler::generateIota (Tree sig, Tree n)
+Expression ScalarCompiler::generateIota (Tree sig, Tree n)
 {
 	int size;
 	if (!isSigInt(n, &size)) { fprintf(stderr, "error in generateIota\n"); exit(1); }
@@ -991,11 +1161,11 @@ string ScalarCompiler::generateIota (Tree sig, Tree n)
 	fClass->addClearCode(subst("$0 = 0;", vperm));
 
 	if (isPowerOf2(size)) {
-		fClass->addExecCode(subst("$0 = ($0+1)&$1;", vperm, T(size-1)));
+		fClass->addExecCode(storeStm(vperm, opExp("($0+1)&$1", varExp(vperm), constExp(T(size-1)))));
 	} else {
-		fClass->addExecCode(subst("if (++$0 == $1) $0=0;", vperm, T(size)));
+		fClass->addExecCode(incrementStm(vperm, size));
 	}
-	return vperm;
+	return varExp(vperm);
 }
 
 
@@ -1007,9 +1177,15 @@ string ScalarCompiler::generateIota (Tree sig, Tree n)
  * Generate a select2 code
  */
 
-string ScalarCompiler::generateSelect2  (Tree sig, Tree sel, Tree s1, Tree s2)
+Expression ScalarCompiler::generateSelect2  (Tree sig, Tree sel, Tree s1, Tree s2)
 {
-    return generateCacheCode(sig, subst( "(($0)?$1:$2)", CS(sel), CS(s2), CS(s1) ) );
+    if (gLazySelect > 0 && !gVectorSwitch) {
+        vector<Expression> conds; conds.push_back(CS(sel));
+        vector<Tree> branches; branches.push_back(s2); branches.push_back(s1);
+        Expression code;
+        if (generateLazySelect(sig, sel, conds, branches, code)) return code;
+    }
+    return generateCacheCode(sig, opExp( "(($0)?$1:$2)", CS(sel), CS(s2), CS(s1) ) );
 }
 
 
@@ -1018,9 +1194,218 @@ string ScalarCompiler::generateSelect2  (Tree sig, Tree sel, Tree s1, Tree s2)
  * ((int n = sel==0)? s0 : ((sel==1)? s1 : s2))
  * int nn; ((nn=sel) ? ((nn==1)? s1 : s2) : s0);
  */
-string ScalarCompiler::generateSelect3  (Tree sig, Tree sel, Tree s1, Tree s2, Tree s3)
+Expression ScalarCompiler::generateSelect3  (Tree sig, Tree sel, Tree s1, Tree s2, Tree s3)
+{
+    if (gLazySelect > 0 && !gVectorSwitch) {
+        vector<Expression> conds; conds.push_back(opExp("$0==0", CS(sel))); conds.push_back(opExp("$0==1", CS(sel)));
+        vector<Tree> branches; branches.push_back(s1); branches.push_back(s2); branches.push_back(s3);
+        Expression code;
+        if (generateLazySelect(sig, sel, conds, branches, code)) return code;
+    }
+    return generateCacheCode(sig, opExp( "(($0==0)? $1 : (($0==1)?$2:$3) )", CS(sel), CS(s1), CS(s2), CS(s3) ) );
+}
+
+
+/**
+ * Count the references to the sample rate subsignals of sig that are not compiled yet,
+ * from sig and its own subsignals (following the rules of sharingAnnotation).
+ */
+void ScalarCompiler::countBranchReferences(Tree sig, map<Tree,int>& refs)
+{
+    vector<Tree> subsig, coefs;
+    vector<double> taps;
+    Tree c, x, y, z;
+    int input;
+    if (isSigSelect3(sig, c, x, y, z)) {
+        subsig.push_back(c); subsig.push_back(c); subsig.push_back(x); subsig.push_back(y); subsig.push_back(z);
+    } else if (isFIRFilter(sig, x, taps)) {
+        subsig.push_back(x);    // computed by the convolver from x only
+    } else if (isBiquadCascade(sig, input, coefs)) {
+        // computed before the loop from an input
+    } else if (!isSigGen(sig)) {
+        getSubSignals(sig, subsig);
+    }
+    for (size_t i = 0; i < subsig.size(); i++) {
+        Expression code;
+        Tree s = subsig[i];
+        if (getCertifiedSigType(s)->variability() < kSamp || getCompiledExpression(s, code)) continue;
+        if (refs[s]++ == 0) countBranchReferences(s, refs);
+    }
+}
+
+/**
+ * True if compiling sig (up to the already compiled signals) will generate state:
+ * delay lines, recursions, write tables, iotas or bargraphs.
+ */
+bool ScalarCompiler::isStatefulBranch(Tree sig, set<Tree>& visited)
 {
-    return generateCacheCode(sig, subst( "(($0==0)? $1 : (($0==1)?$2:$3) )", CS(sel), CS(s1), CS(s2), CS(s3) ) );
+    Tree x, y, z, w;
+    int i;
+    Expression code;
+    if (getCertifiedSigType(sig)->variability() < kSamp || getCompiledExpression(sig, code) || !visited.insert(sig).second) {
+        return false;
+    }
+    if (isSigDelay1(sig, x) || isSigFixDelay(sig, x, y) || isSigPrefix(sig, x, y) || isProj(sig, &i, x)
+        || isSigWRTbl(sig, x, y, z, w) || isSigIota(sig, x) || isSigHBargraph(sig) || isSigVBargraph(sig)
+        || fOccMarkup.retrieve(sig)->getMaxDelay() > 0) {
+        return true;
+    }
+    vector<Tree> subsig;
+    int n = isSigGen(sig) ? 0 : getSubSignals(sig, subsig);
+    for (int k = 0; k < n; k++) {
+        if (isStatefulBranch(subsig[k], visited)) return true;
+    }
+    return false;
+}
+
+/**
+ * True if compiling sig (up to the already compiled signals) will generate a ring buffer
+ * or use IOTA : IOTA is increased at each sample whether the branch is computed or not,
+ * so the state of such a branch can't be frozen.
+ */
+bool ScalarCompiler::usesRingBuffer(Tree sig, set<Tree>& visited)
+{
+    Tree x;
+    Expression code;
+    if (getCertifiedSigType(sig)->variability() < kSamp || getCompiledExpression(sig, code) || !visited.insert(sig).second) {
+        return false;
+    }
+    if (isSigIota(sig, x) || fOccMarkup.retrieve(sig)->getMaxDelay() >= gMaxCopyDelay) {
+        return true;
+    }
+    vector<Tree> subsig;
+    int n = isSigGen(sig) ? 0 : getSubSignals(sig, subsig);
+    for (int k = 0; k < n; k++) {
+        if (usesRingBuffer(subsig[k], visited)) return true;
+    }
+    return false;
+}
+
+/**
+ * Lazy select (-ls option, scalar mode) : the branches are computed in the blocks of
+ * an if (conds[0]) {branches[0]} else if (conds[1]) {branches[1]} ... else {branches[n]}.
+ *
+ * The subsignals of the branches that are also used elsewhere are compiled first,
+ * then the code generated by each branch is moved in its block. A branch with state
+ * is only made conditional with -ls 2 when the selector is not a sample rate signal
+ * and the branch has no ring buffer : its state is frozen while the branch is not selected.
+ *
+ * @return false when no branch can be computed conditionally
+ */
+bool ScalarCompiler::generateLazySelect(Tree sig, Tree sel, const vector<Expression>& conds, const vector<Tree>& branches, Expression& code)
+{
+    // the subsignals used outside of a branch are computed unconditionally
+    map<Tree,int> refs, branchCount;
+    for (size_t b = 0; b < branches.size(); b++) {
+        Expression c;
+        map<Tree,int> brefs;
+        Tree s = branches[b];
+        if (getCertifiedSigType(s)->variability() < kSamp || getCompiledExpression(s, c)) continue;
+        if (brefs[s]++ == 0) countBranchReferences(s, brefs);
+        for (map<Tree,int>::iterator r = brefs.begin(); r != brefs.end(); r++) {
+            refs[r->first] += r->second;
+            branchCount[r->first]++;
+        }
+    }
+    bool sharedRec = false;
+    for (map<Tree,int>::iterator r = refs.begin(); r != refs.end(); r++) {
+        Tree id, body;
+        if (r->second < getSharingCount(r->first) || branchCount[r->first] > 1) {
+            // a recursive group (or its list of definitions) used elsewhere can't be made conditional
+            if (isRec(r->first, id, body) || isList(r->first)) {
+                sharedRec = true;
+            } else {
+                CS(r->first);
+            }
+        }
+    }
+
+    bool blockSelector = getCertifiedSigType(sel)->variability() < kSamp;
+    vector<bool> lazy(branches.size());
+    bool anyLazy = false;
+    for (size_t b = 0; b < branches.size(); b++) {
+        set<Tree> visited, ringVisited;
+        Expression c;
+        lazy[b] = !getCompiledExpression(branches[b], c)
+                  && (!isStatefulBranch(branches[b], visited)
+                      || (gLazySelect > 1 && blockSelector && !sharedRec && !usesRingBuffer(branches[b], ringVisited)));
+        anyLazy |= lazy[b];
+    }
+    if (!anyLazy) return false;
+
+    // compile the branches, moving the code of the lazy ones apart
+    list<Statement>& exec = fClass->topLoop()->fExecCode;
+    list<Statement>& post = fClass->topLoop()->fPostCode;
+    vector<Expression> values(branches.size());
+    vector<list<Statement> > execCode(branches.size());
+    vector<list<Statement> > postCode(branches.size());
+    bool hasCode = false;
+    for (size_t b = 0; b < branches.size(); b++) {
+        size_t e = exec.size(), p = post.size();
+        values[b] = CS(branches[b]);
+        if (lazy[b]) {
+            list<Statement>::iterator i = exec.begin(); advance(i, e);
+            execCode[b].splice(execCode[b].end(), exec, i, exec.end());
+            // post code statements are added at the front of the list
+            list<Statement>::iterator j = post.begin(); advance(j, post.size() - p);
+            for (list<Statement>::iterator k = post.begin(); k != j; ) {
+                list<Statement>::iterator next = k; next++;
+                if (k->writes() != "IOTA") postCode[b].splice(postCode[b].end(), post, k);
+                k = next;
+            }
+            hasCode |= (execCode[b].size() + postCode[b].size()) > 0;
+        }
+    }
+
+    if (!hasCode) {
+        // the C++ conditional operator is already lazy
+        Expression exp = values.back();
+        for (int b = int(conds.size()) - 1; b >= 0; b--) {
+            exp = opExp("(($0)?$1:$2)", conds[b], values[b], exp);
+        }
+        code = generateCacheCode(sig, exp);
+        return true;
+    }
+
+    string ctype, vname;
+    getTypedNames(getCertifiedSigType(sig), "Temp", ctype, vname);
+    fClass->addExecCode(declareStm(ctype, vname));
+    for (size_t b = 0; b < branches.size(); b++) {
+        if (b == 0) {
+            fClass->addExecCode(ifStm(conds[b]));
+        } else if (b < conds.size()) {
+            fClass->addExecCode(elseIfStm(conds[b]));
+        } else {
+            fClass->addExecCode(elseStm());
+        }
+        for (list<Statement>::iterator i = execCode[b].begin(); i != execCode[b].end(); i++) {
+            i->fLevel++;
+            fClass->addExecCode(*i);
+        }
+        Statement store = storeStm(vname, values[b]);
+        store.fLevel = 1;
+        fClass->addExecCode(store);
+    }
+    fClass->addExecCode(endStm());
+
+    // the state of the lazy branches is updated only when they are selected
+    for (size_t b = 0; b < branches.size(); b++) {
+        if (postCode[b].size() > 0) {
+            Expression cond = (b < conds.size()) ? conds[b] : Expression();
+            for (size_t k = 0; k < b; k++) {
+                cond = cond.isNone() ? opExp("!($0)", conds[k]) : opExp("!($0) && $1", conds[k], cond);
+            }
+            fClass->addPostCode(endStm());
+            for (list<Statement>::reverse_iterator i = postCode[b].rbegin(); i != postCode[b].rend(); i++) {
+                i->fLevel++;
+                fClass->addPostCode(*i);
+            }
+            fClass->addPostCode(ifStm(cond));
+        }
+    }
+
+    code = (fOccMarkup.retrieve(sig)->getMaxDelay() > 0) ? generateCacheCode(sig, varExp(vname)) : varExp(vname);
+    return true;
 }
 
 #if 0
@@ -1047,7 +1432,7 @@ string ScalarCompiler::generateSelect3  (Tree sig, Tree sel, Tree s1, Tree s2, T
             fClass->addZone1(subst("$0 \t$1[3];", type, var));
             break;
         case kSamp :
-            fClass->addExecCode(subst("$0 \t$1[3];", type, var));
+            fClass->addExecCode(declareArrayStm(type, var, 3));
             break;
     }
 
@@ -1060,7 +1445,7 @@ string ScalarCompiler::generateSelect3  (Tree sig, Tree sel, Tree s1, Tree s2, T
             fClass->addZone2b(subst("$0[0] = $1;", var, CS(s1)));
             break;
         case kSamp :
-            fClass->addExecCode(subst("$0[0] = $1;", var, CS(s1)));
+            fClass->addExecCode(storeStm(var, "0", CS(s1)));
             break;
     }
 
@@ -1073,7 +1458,7 @@ string ScalarCompiler::generateSelect3  (Tree sig, Tree sel, Tree s1, Tree s2, T
             fClass->addZone2b(subst("$0[1] = $1;", var, CS(s2)));
             break;
         case kSamp :
-            fClass->addExecCode(subst("$0[1] = $1;", var, CS(s2)));
+            fClass->addExecCode(storeStm(var, "1", CS(s2)));
             break;
     }
 
@@ -1086,7 +1471,7 @@ string ScalarCompiler::generateSelect3  (Tree sig, Tree sel, Tree s1, Tree s2, T
             fClass->addZone2b(subst("$0[2] = $1;", var, CS(s3)));
             break;
         case kSamp :
-            fClass->addExecCode(subst("$0[2] = $1;", var, CS(s3)));
+            fClass->addExecCode(storeStm(var, "2", CS(s3)));
             break;
     }
 
@@ -1098,21 +1483,25 @@ string ScalarCompiler::generateSelect3  (Tree sig, Tree sel, Tree s1, Tree s2, T
  * retrieve the type annotation of sig
  * @param sig the signal we want to know the type
  */
-string ScalarCompiler::generateXtended 	(Tree sig)
+Expression ScalarCompiler::generateXtended 	(Tree sig)
 {
 	xtended* 		p = (xtended*) getUserData(sig);
-	vector<string> 	args;
+	vector<Expression> args;
+	vector<string> 	params;
 	vector<Type> 	types;
 
 	for (int i=0; i<sig->arity(); i++) {
 		args.push_back(CS(sig->branch(i)));
+		params.push_back("$" + T(i));
 		types.push_back(getCertifiedSigType(sig->branch(i)));
 	}
 
+	// the primitive substitutes its arguments in its code, the placeholders give the format of the operation
+	Expression code = opExp(p->generateCode(fClass, params, types), args);
 	if (p->needCache()) {
-		return generateCacheCode(sig, p->generateCode(fClass, args, types));
+		return generateCacheCode(sig, code);
 	} else {
-		return p->generateCode(fClass, args, types);
+		return code;
 	}
 }
 
@@ -1189,7 +1578,7 @@ int ScalarCompiler::pow2limit(int x)
  * the maximum delay attached to exp and the gLessTempSwitch.
  */
 
-string ScalarCompiler::generateFixDelay (Tree sig, Tree exp, Tree delay)
+Expression ScalarCompiler::generateFixDelay (Tree sig, Tree exp, Tree delay)
 {
 	int 	mxd, d;
 	string 	vecname;
@@ -1198,7 +1587,7 @@ string ScalarCompiler::generateFixDelay (Tree sig, Tree exp, Tree delay)
     //cerr << "ScalarCompiler::generateFixDelay exp = " << *exp << endl;
     //cerr << "ScalarCompiler::generateFixDelay del = " << *delay << endl;
 
-    string code = CS(exp); // ensure exp is compiled to have a vector name
+    Expression code = CS(exp); // ensure exp is compiled to have a vector name
 
 	mxd = fOccMarkup.retrieve(exp)->getMaxDelay();
 
@@ -1214,20 +1603,20 @@ string ScalarCompiler::generateFixDelay (Tree sig, Tree exp, Tree delay)
 
     if (mxd == 0) {
         // not a real vector name but a scalar name
-        return vecname;
+        return varExp(vecname);
 
 	} else if (mxd < gMaxCopyDelay) {
 		if (isSigInt(delay, &d)) {
-			return subst("$0[$1]", vecname, CS(delay));
+			return loadExp(varExp(vecname), CS(delay));
 		} else {
-			return generateCacheCode(sig, subst("$0[$1]", vecname, CS(delay)));
+			return generateCacheCode(sig, loadExp(varExp(vecname), CS(delay)));
 		}
 
 	} else {
 
 		// long delay : we use a ring buffer of size 2^x
 		int 	N 	= pow2limit( mxd+1 );
-		return generateCacheCode(sig, subst("$0[(IOTA-$1)&$2]", vecname, CS(delay), T(N-1)));
+		return generateCacheCode(sig, loadExp(varExp(vecname), opExp("($0-$1)&$2", varExp("IOTA"), CS(delay), constExp(T(N-1)))));
 	}
 }
 
@@ -1237,9 +1626,9 @@ string ScalarCompiler::generateFixDelay (Tree sig, Tree exp, Tree delay)
  * maximum delay attached to exp and the "less temporaries" switch
  */
 
-string ScalarCompiler::generateDelayVec(Tree sig, const string& exp, const string& ctype, const string& vname, int mxd)
+Expression ScalarCompiler::generateDelayVec(Tree sig, const Expression& exp, const string& ctype, const string& vname, int mxd)
 {
-	string s = generateDelayVecNoTemp(sig, exp, ctype, vname, mxd);
+	Expression s = generateDelayVecNoTemp(sig, exp, ctype, vname, mxd);
 	if (getCertifiedSigType(sig)->variability() < kSamp) {
         return exp;
 	} else {
@@ -1251,7 +1640,7 @@ string ScalarCompiler::generateDelayVec(Tree sig, const string& exp, const strin
  * Generate code for the delay mecchanism without using temporary variables
  */
 
-string ScalarCompiler::generateDelayVecNoTemp(Tree sig, const string& exp, const string& ctype, const string& vname, int mxd)
+Expression ScalarCompiler::generateDelayVecNoTemp(Tree sig, const Expression& exp, const string& ctype, const string& vname, int mxd)
 {
     assert(mxd > 0);
 
@@ -1260,21 +1649,13 @@ string ScalarCompiler::generateDelayVecNoTemp(Tree sig, const string& exp, const
     if (mxd < gMaxCopyDelay) {
 
         // short delay : we copy
-        fClass->addDeclCode(subst("$0 \t$1[$2];", ctype, vname, T(mxd+1)));
-        fClass->addClearCode(subst("for (int i=0; i<$1; i++) $0[i] = 0;", vname, T(mxd+1)));
-        fClass->addExecCode(subst("$0[0] = $1;", vname, exp));
+        declareCopyDelayLine(ctype, vname, mxd);
+        fClass->addExecCode(storeStm(vname, constExp("0"), exp));
 
         // generate post processing copy code to update delay values
-        if (mxd == 1) {
-            fClass->addPostCode(subst("$0[1] = $0[0];", vname));
-        } else if (mxd == 2) {
-            //fClass->addPostCode(subst("$0[2] = $0[1];", vname));
-            fClass->addPostCode(subst("$0[2] = $0[1]; $0[1] = $0[0];", vname));
-        } else {
-            fClass->addPostCode(subst("for (int i=$0; i>0; i--) $1[i] = $1[i-1];", T(mxd), vname));
-        }
+        fClass->addPostCode(shiftStm(vname, mxd));
         setVectorNameProperty(sig, vname);
-        return subst("$0[0]", vname);
+        return loadExp(varExp(vname), constExp("0"));
 
     } else {
 
@@ -1289,9 +1670,27 @@ string ScalarCompiler::generateDelayVecNoTemp(Tree sig, const string& exp, const
         fClass->addClearCode(subst("for (int i=0; i<$1; i++) $0[i] = 0;", vname, T(N)));
 
         // execute
-        fClass->addExecCode(subst("$0[IOTA&$1] = $2;", vname, T(N-1), exp));
+        fClass->addExecCode(storeStm(vname, opExp("$0&$1", varExp("IOTA"), constExp(T(N-1))), exp));
         setVectorNameProperty(sig, vname);
-        return subst("$0[IOTA&$1]", vname, T(N-1));
+        return loadExp(varExp(vname), opExp("$0&$1", varExp("IOTA"), constExp(T(N-1))));
+    }
+}
+
+/**
+ * Declare a short delay line of mxd+1 elements, shifted after each sample. With
+ * -ld in scalar mode, a local copy of the line shadows the member during compute :
+ * the C++ compiler can then keep its elements in registers across the samples,
+ * which it can't do on the members because of the possible aliasing with the
+ * output buffers. The shortest lines (see -ldu) are also rotated instead of
+ * shifted, in a sample loop unrolled by their size (see Klass::rotatedDelays).
+ */
+void ScalarCompiler::declareCopyDelayLine(const string& ctype, const string& vname, int mxd)
+{
+    fClass->addDeclCode(subst("$0 \t$1[$2];", ctype, vname, T(mxd+1)));
+    fClass->addClearCode(subst("for (int i=0; i<$1; i++) $0[i] = 0;", vname, T(mxd+1)));
+
+    if (gLocalDelaySwitch && !gVectorSwitch) {
+        fClass->addLocalDelay(ctype, vname, mxd);
     }
 }
 
@@ -1299,31 +1698,24 @@ string ScalarCompiler::generateDelayVecNoTemp(Tree sig, const string& exp, const
  * Generate code for the delay mecchanism without using temporary variables
  */
 
-void ScalarCompiler::generateDelayLine(const string& ctype, const string& vname, int mxd, const string& exp)
+void ScalarCompiler::generateDelayLine(const string& ctype, const string& vname, int mxd, const Expression& exp)
 {
     //assert(mxd > 0);
     if (mxd == 0) {
         // cerr << "MXD==0 :  " << vname << " := " << exp << endl;
         // no need for a real vector
-        fClass->addExecCode(subst("$0 \t$1 = $2;", ctype, vname, exp));
+        fClass->addExecCode(declareStm(ctype, vname, exp));
 
 
     } else if (mxd < gMaxCopyDelay) {
         // cerr << "small delay : " << vname << "[" << mxd << "]" << endl;
 
         // short delay : we copy
-        fClass->addDeclCode(subst("$0 \t$1[$2];", ctype, vname, T(mxd+1)));
-        fClass->addClearCode(subst("for (int i=0; i<$1; i++) $0[i] = 0;", vname, T(mxd+1)));
-        fClass->addExecCode(subst("$0[0] = $1;", vname, exp));
+        declareCopyDelayLine(ctype, vname, mxd);
+        fClass->addExecCode(storeStm(vname, constExp("0"), exp));
 
         // generate post processing copy code to update delay values
-        if (mxd == 1) {
-            fClass->addPostCode(subst("$0[1] = $0[0];", vname));
-        } else if (mxd == 2) {
-            fClass->addPostCode(subst("$0[2] = $0[1]; $0[1] = $0[0];", vname));
-        } else {
-            fClass->addPostCode(subst("for (int i=$0; i>0; i--) $1[i] = $1[i-1];", T(mxd), vname));
-        }
+        fClass->addPostCode(shiftStm(vname, mxd));
 
     } else {
 
@@ -1338,7 +1730,7 @@ void ScalarCompiler::generateDelayLine(const string& ctype, const string& vname,
         fClass->addClearCode(subst("for (int i=0; i<$1; i++) $0[i] = 0;", vname, T(N)));
 
         // execute
-        fClass->addExecCode(subst("$0[IOTA&$1] = $2;", vname, T(N-1), exp));
+        fClass->addExecCode(storeStm(vname, opExp("$0&$1", varExp("IOTA"), constExp(T(N-1))), exp));
     }
 }
 
@@ -1352,7 +1744,7 @@ void ScalarCompiler::ensureIotaCode()
         fHasIota = true;
         fClass->addDeclCode("int \tIOTA;");
         fClass->addClearCode("IOTA = 0;");
-        fClass->addPostCode("IOTA = IOTA+1;");
+        fClass->addPostCode(storeStm("IOTA", opExp("$0+1", varExp("IOTA"))));
     }
 }
 
@@ -1387,12 +1779,12 @@ void ScalarCompiler::declareWaveform(Tree sig, string& vname, int& size)
                 + content.str() + ";");
 }
 
-string ScalarCompiler::generateWaveform(Tree sig)
+Expression ScalarCompiler::generateWaveform(Tree sig)
 {
     string  vname;
     int     size;
 
     declareWaveform(sig, vname, size);
-    fClass->addPostCode(subst("idx$0 = (idx$0 + 1) % $1;", vname, T(size)));
-    return generateCacheCode(sig, subst("$0[idx$0]", vname));
+    fClass->addPostCode(storeStm("idx" + vname, opExp("($0 + 1) % $1", varExp("idx" + vname), constExp(T(size)))));
+    return generateCacheCode(sig, loadExp(varExp(vname), varExp("idx" + vname)));
 }
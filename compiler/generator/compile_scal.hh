@@ -40,7 +40,7 @@
 class ScalarCompiler : public Compiler
 {
   protected:
-    property<string>            fCompileProperty;
+    property<Expression>        fCompileProperty;
     property<string>            fVectorProperty;
     property<pair<string,string> >  fStaticInitProperty;        // property added to solve 20101208 kjetil bug
     property<pair<string,string> >  fInstanceInitProperty;      // property added to solve 20101208 kjetil bug
@@ -49,18 +49,19 @@ class ScalarCompiler : public Compiler
 	Tree                      	fSharingKey;
 	OccMarkup					fOccMarkup;
     bool						fHasIota;
+    bool                        fMixedPrecision;        ///< the signals have their own precision (-mp)
 
 
   public:
 
 	ScalarCompiler ( const string& name, const string& super, int numInputs, int numOutputs) :
 		Compiler(name,super,numInputs,numOutputs,false),
-        fHasIota(false)
+        fHasIota(false), fMixedPrecision(false)
 	{}
 	
 	ScalarCompiler ( Klass* k) : 
 		Compiler(k),
-        fHasIota(false)
+        fHasIota(false), fMixedPrecision(false)
 	{}
 	
 	virtual void 		compileMultiSignal  (Tree lsig);
@@ -69,12 +70,13 @@ class ScalarCompiler : public Compiler
 
   protected:
 
-    virtual string      CS (Tree sig);
-    virtual string      generateCode (Tree sig);
-    virtual string      generateCacheCode(Tree sig, const string& exp) ;
-    virtual string      forceCacheCode(Tree sig, const string& exp) ;
+    virtual Expression  CS (Tree sig);
+    virtual Expression  generateCode (Tree sig);
+    Expression          convertPrecision (Tree sig, const Expression& code);
+    virtual Expression  generateCacheCode(Tree sig, const Expression& exp) ;
+    virtual Expression  forceCacheCode(Tree sig, const Expression& exp) ;
 
-    virtual string      generateVariableStore(Tree sig, const string& exp);
+    virtual Expression  generateVariableStore(Tree sig, const Expression& exp);
 
 	string 		getFreshID (const string& prefix);
 
@@ -83,8 +85,8 @@ class ScalarCompiler : public Compiler
 	Tree 		prepare2 (Tree L0);
 	
 	
-	bool 		getCompiledExpression(Tree sig, string& name);
-	string		setCompiledExpression(Tree sig, const string& name);
+	bool 		getCompiledExpression(Tree sig, Expression& cexp);
+	Expression	setCompiledExpression(Tree sig, const Expression& cexp);
 
 	void 		setVectorNameProperty(Tree sig, const string& vecname);
 	bool 		getVectorNameProperty(Tree sig, string& vecname);
@@ -97,51 +99,60 @@ class ScalarCompiler : public Compiler
 	
 	// generation du code
 	
-    string          generateXtended		(Tree sig);
-	virtual string 		generateFixDelay	(Tree sig, Tree arg, Tree size);
-    string          generatePrefix 		(Tree sig, Tree x, Tree e);
-    string          generateIota		(Tree sig, Tree arg);
-    string          generateBinOp 		(Tree sig, int opcode, Tree arg1, Tree arg2);
+    Expression      generateXtended		(Tree sig);
+	virtual Expression	generateFixDelay	(Tree sig, Tree arg, Tree size);
+    Expression      generatePrefix 		(Tree sig, Tree x, Tree e);
+    Expression      generateIota		(Tree sig, Tree arg);
+    Expression      generateBinOp 		(Tree sig, int opcode, Tree arg1, Tree arg2);
 	
-    string          generateFFun  		(Tree sig, Tree ff, Tree largs);
-    virtual string      generateWaveform    (Tree sig);
+    Expression      generateFFun  		(Tree sig, Tree ff, Tree largs);
+    virtual Expression  generateWaveform    (Tree sig);
 
-    string          generateInput 		(Tree sig, const string& idx);
-    string          generateOutput		(Tree sig, const string& idx, const string& arg1);
+    Expression      generateInput 		(Tree sig, const string& idx);
+    Expression      generateOutput		(Tree sig, const string& idx, const Expression& arg1);
 	
-    string          generateTable 		(Tree sig, Tree tsize, Tree content);
-    string          generateStaticTable	(Tree sig, Tree tsize, Tree content);
-    string          generateWRTbl 		(Tree sig, Tree tbl, Tree idx, Tree data);
-    string          generateRDTbl 		(Tree sig, Tree tbl, Tree idx);
-    string          generateSigGen		(Tree sig, Tree content);
-    string          generateStaticSigGen(Tree sig, Tree content);
+    Expression      generateTable 		(Tree sig, Tree tsize, Tree content);
+    Expression      generateStaticTable	(Tree sig, Tree tsize, Tree content);
+    Expression      generateWRTbl 		(Tree sig, Tree tbl, Tree idx, Tree data);
+    Expression      generateRDTbl 		(Tree sig, Tree tbl, Tree idx);
+    Expression      generateSigGen		(Tree sig, Tree content);
+    Expression      generateStaticSigGen(Tree sig, Tree content);
 	
-    string          generateSelect2 	(Tree sig, Tree sel, Tree s1, Tree s2);
-    string          generateSelect3 	(Tree sig, Tree sel, Tree s1, Tree s2, Tree s3);
+    Expression      generateSelect2 	(Tree sig, Tree sel, Tree s1, Tree s2);
+    Expression      generateSelect3 	(Tree sig, Tree sel, Tree s1, Tree s2, Tree s3);
+    bool            generateLazySelect  (Tree sig, Tree sel, const vector<Expression>& conds, const vector<Tree>& branches, Expression& code);
+    void            countBranchReferences(Tree sig, map<Tree,int>& refs);
+    bool            isStatefulBranch    (Tree sig, set<Tree>& visited);
+    bool            usesRingBuffer      (Tree sig, set<Tree>& visited);
 	
-    string          generateRecProj 	(Tree sig, Tree exp, int i);
+    Expression      generateFIR         (Tree sig, Tree x, const vector<double>& coefs);
+    Expression      generateBiquadCascade(Tree sig, int input, const vector<Tree>& coefs);
+    string          generateCascadeCoef (Tree coef);
+
+    Expression      generateRecProj 	(Tree sig, Tree exp, int i);
     void            generateRec         (Tree sig, Tree var, Tree le);
 	
-    string          generateIntCast   	(Tree sig, Tree x);
-    string          generateFloatCast 	(Tree sig, Tree x);
+    Expression      generateIntCast   	(Tree sig, Tree x);
+    Expression      generateFloatCast 	(Tree sig, Tree x);
 	
-    string          generateButton 		(Tree sig, Tree label);
-    string          generateCheckbox 	(Tree sig, Tree label);
-    string          generateVSlider 	(Tree sig, Tree label, Tree cur, Tree min, Tree max, Tree step);
-    string          generateHSlider	 	(Tree sig, Tree label, Tree cur, Tree min, Tree max, Tree step);
-    string          generateNumEntry 	(Tree sig, Tree label, Tree cur, Tree min, Tree max, Tree step);
+    Expression      generateButton 		(Tree sig, Tree label);
+    Expression      generateCheckbox 	(Tree sig, Tree label);
+    Expression      generateVSlider 	(Tree sig, Tree label, Tree cur, Tree min, Tree max, Tree step);
+    Expression      generateHSlider	 	(Tree sig, Tree label, Tree cur, Tree min, Tree max, Tree step);
+    Expression      generateNumEntry 	(Tree sig, Tree label, Tree cur, Tree min, Tree max, Tree step);
 	
-    string          generateVBargraph 	(Tree sig, Tree label, Tree min, Tree max, const string& exp);
-    string          generateHBargraph	(Tree sig, Tree label, Tree min, Tree max, const string& exp);
+    Expression      generateVBargraph 	(Tree sig, Tree label, Tree min, Tree max, const Expression& exp);
+    Expression      generateHBargraph	(Tree sig, Tree label, Tree min, Tree max, const Expression& exp);
 
-    string          generateNumber(Tree sig, const string& exp);
-    string          generateFConst (Tree sig, const string& file, const string& name);
-    string          generateFVar (Tree sig, const string& file, const string& name);
+    Expression      generateNumber(Tree sig, const Expression& exp);
+    Expression      generateFConst (Tree sig, const string& file, const string& name);
+    Expression      generateFVar (Tree sig, const string& file, const string& name);
 	
-    virtual string  generateDelayVec(Tree sig, const string& exp, const string& ctype, const string& vname, int mxd);
-    string          generateDelayVecNoTemp(Tree sig, const string& exp, const string& ctype, const string& vname, int mxd);
+    virtual Expression  generateDelayVec(Tree sig, const Expression& exp, const string& ctype, const string& vname, int mxd);
+    Expression      generateDelayVecNoTemp(Tree sig, const Expression& exp, const string& ctype, const string& vname, int mxd);
 	//string		generateDelayVecWithTemp(Tree sig, const string& exp, const string& ctype, const string& vname, int mxd);
-    virtual void    generateDelayLine(const string& ctype, const string& vname, int mxd, const string& exp);
+    virtual void    generateDelayLine(const string& ctype, const string& vname, int mxd, const Expression& exp);
+    void            declareCopyDelayLine(const string& ctype, const string& vname, int mxd);
 
     void            getTypedNames(Type t, const string& prefix, string& ctype, string& vname);
     void            ensureIotaCode();
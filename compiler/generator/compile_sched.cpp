@@ -24,6 +24,7 @@
 #include "compile_sched.hh"
 #include "floats.hh"
 #include "ppsig.hh"
+#include "timing.hh"
 
 extern int gVecSize;
 
@@ -43,15 +44,19 @@ void SchedulerCompiler::compileMultiSignal (Tree L)
     fClass->addSharedDecl("input"); 
     fClass->addSharedDecl("output"); 
     
+    startTiming("codegen");
     for (int i = 0; isList(L); L = tl(L), i++) {
         Tree sig = hd(L);
         fClass->openLoop("count");
-        fClass->addExecCode(subst("output$0[i] = $2$1;", T(i), CS(sig), xcast()));
+        fClass->addExecCode(storeStm(subst("output$0", T(i)), varExp("i"), opExp(string(xcast()) + "$0", CS(sig))));
         fClass->closeLoop(sig);
     }
+    endTiming("codegen");
     
     // Build tasks list 
+    startTiming("buildTasksList");
     fClass->buildTasksList();
+    endTiming("buildTasksList");
     
     generateUserInterfaceTree(prepareUserInterfaceTree(fUIRoot), true);
  	generateMacroInterfaceTree("", prepareUserInterfaceTree(fUIRoot));
@@ -70,7 +75,7 @@ void SchedulerCompiler::compileMultiSignal (Tree L)
  * @param delay the maximum delay
  * @param cexp the content of the signal as a C++ expression 
  */
-void  SchedulerCompiler::vectorLoop (const string& tname, const string& vecname, const string& cexp) 
+void  SchedulerCompiler::vectorLoop (const string& tname, const string& vecname, const Expression& cexp) 
 {  
     // -- declare the vector
     fClass->addSharedDecl(vecname);
@@ -79,7 +84,7 @@ void  SchedulerCompiler::vectorLoop (const string& tname, const string& vecname,
     fClass->addDeclCode(subst("$0 \t$1[$2];", tname, vecname, T(gVecSize)));
     
     // -- compute the new samples
-    fClass->addExecCode(subst("$0[i] = $1;", vecname, cexp));
+    fClass->addExecCode(storeStm(vecname, varExp("i"), cexp));
 }
 
 
@@ -92,7 +97,7 @@ void  SchedulerCompiler::vectorLoop (const string& tname, const string& vecname,
  * @param delay the maximum delay
  * @param cexp the content of the signal as a C++ expression 
  */
-void  SchedulerCompiler::dlineLoop (const string& tname, const string& dlname, int delay, const string& cexp) 
+void  SchedulerCompiler::dlineLoop (const string& tname, const string& dlname, int delay, const Expression& cexp) 
 {
     if (delay < gMaxCopyDelay) {
         
@@ -124,13 +129,13 @@ void  SchedulerCompiler::dlineLoop (const string& tname, const string& dlname, i
         fClass->addZone2(subst("$0* \t$1 = &$2[$3];", tname, dlname, buf, dsize));
         
         // -- copy the stored samples to the delay line
-        fClass->addPreCode(subst("for (int i=0; i<$2; i++) $0[i]=$1[i];", buf, pmem, dsize));
+        fClass->addPreCode(copyStm(buf, pmem, Expression(), delay));
         
         // -- compute the new samples
-        fClass->addExecCode(subst("$0[i] = $1;", dlname, cexp));
+        fClass->addExecCode(storeStm(dlname, varExp("i"), cexp));
         
         // -- copy back to stored samples
-        fClass->addPostCode(subst("for (int i=0; i<$2; i++) $0[i]=$1[count+i];", pmem, buf, dsize));
+        fClass->addPostCode(copyStm(pmem, buf, varExp("count"), delay));
         
     } else {
         
@@ -156,12 +161,12 @@ void  SchedulerCompiler::dlineLoop (const string& tname, const string& dlname, i
         fClass->addClearCode(subst("$0 = 0;", idx_save));
         
         // -- update index
-        fClass->addPreCode(subst("$0 = ($0+$1)&$2;", idx, idx_save, mask));
+        fClass->addPreCode(storeStm(idx, opExp("($0+$1)&$2", varExp(idx), varExp(idx_save), constExp(mask))));
         
         // -- compute the new samples
-        fClass->addExecCode(subst("$0[($2+i)&$3] = $1;", dlname, cexp, idx, mask));
+        fClass->addExecCode(storeStm(dlname, opExp("($0+$1)&$2", varExp(idx), varExp("i"), constExp(mask)), cexp));
         
         // -- save index
-        fClass->addPostCode(subst("$0 = count;", idx_save));
+        fClass->addPostCode(storeStm(idx_save, varExp("count")));
     }
 }
@@ -49,8 +49,8 @@ public:
     
 protected:
     
-    virtual void        vectorLoop (const string& tname, const string& dlname, const string& cexp);
-    virtual void        dlineLoop ( const string& tname, const string& dlname, int delay, const string& cexp);
+    virtual void        vectorLoop (const string& tname, const string& dlname, const Expression& cexp);
+    virtual void        dlineLoop ( const string& tname, const string& dlname, int delay, const Expression& cexp);
 
 
 };
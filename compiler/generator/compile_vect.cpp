@@ -26,6 +26,7 @@
 #include "compile_vect.hh"
 #include "floats.hh"
 #include "ppsig.hh"
+#include "timing.hh"
 
 extern int gVecSize;
 extern bool gPrintJSONSwitch;
@@ -48,12 +49,14 @@ void VectorCompiler::compileMultiSignal (Tree L)
     fClass->addSharedDecl("input");
     fClass->addSharedDecl("output");
 
+    startTiming("codegen");
     for (int i = 0; isList(L); L = tl(L), i++) {
         Tree sig = hd(L);
         fClass->openLoop("count");
-        fClass->addExecCode(subst("output$0[i] = $2$1;", T(i), CS(sig), xcast()));
+        fClass->addExecCode(storeStm(subst("output$0", T(i)), varExp("i"), opExp(string(xcast()) + "$0", CS(sig))));
         fClass->closeLoop(sig);
     }
+    endTiming("codegen");
 
     generateMetaData();
     generateUserInterfaceTree(prepareUserInterfaceTree(fUIRoot), true);
@@ -72,11 +75,11 @@ void VectorCompiler::compileMultiSignal (Tree L)
 /**
  * Compile a signal
  * @param sig the signal expression to compile.
- * @return the C code translation of sig as a string
+ * @return the expression of the C code translation of sig
  */
-string  VectorCompiler::CS (Tree sig)
+Expression  VectorCompiler::CS (Tree sig)
 {
-    string      code;
+    Expression  code;
     //cerr << "ENTER VectorCompiler::CS : "<< ppsig(sig) << endl;
     if (!getCompiledExpression(sig, code)) {
         code = generateCode(sig);
@@ -123,7 +126,7 @@ string  VectorCompiler::CS (Tree sig)
 	return code;
 }
 
-string VectorCompiler::generateCode (Tree sig)
+Expression VectorCompiler::generateCode (Tree sig)
 {
     generateCodeRecursions(sig);
     return generateCodeNonRec(sig);
@@ -132,14 +135,14 @@ string VectorCompiler::generateCode (Tree sig)
 void VectorCompiler::generateCodeRecursions (Tree sig)
 {
     Tree    id, body;
-    string  code;
+    Expression code;
     //cerr << "VectorCompiler::generateCodeRecursions( " << ppsig(sig) << " )" << endl;
     if (getCompiledExpression(sig, code)) {
         //cerr << "** ALREADY VISITED : " << code << " ===> " << ppsig(sig) << endl;
         return;
     } else if( isRec(sig, id, body) ) {
         //cerr << "we have a recursive expression non compiled yet : " << ppsig(sig) << endl;
-        setCompiledExpression(sig, "[RecursionVisited]");
+        setCompiledExpression(sig, constExp("[RecursionVisited]"));
         fClass->openLoop(sig, "count");
         generateRec(sig, id, body);
         fClass->closeLoop(sig);
@@ -151,9 +154,9 @@ void VectorCompiler::generateCodeRecursions (Tree sig)
     }
 }
 
-string VectorCompiler::generateCodeNonRec (Tree sig)
+Expression VectorCompiler::generateCodeNonRec (Tree sig)
 {
-    string  code;
+    Expression code;
     if (getCompiledExpression(sig, code)) {
         // already visited
         return code;
@@ -168,9 +171,9 @@ string VectorCompiler::generateCodeNonRec (Tree sig)
 /**
  * Compile a signal
  * @param sig the signal expression to compile.
- * @return the C code translation of sig as a string
+ * @return the expression of the C code translation of sig
  */
-string VectorCompiler::generateLoopCode (Tree sig)
+Expression VectorCompiler::generateLoopCode (Tree sig)
 {
     int     i;
     Tree    x;
@@ -189,13 +192,13 @@ string VectorCompiler::generateLoopCode (Tree sig)
             } else {
                 // x must be defined
                 fClass->openLoop(x, "count");
-                string c = ScalarCompiler::generateCode(sig);
+                Expression c = ScalarCompiler::generateCode(sig);
                 fClass->closeLoop(sig);
                 return c;
             }
         } else {
             fClass->openLoop("count");
-            string c = ScalarCompiler::generateCode(sig);
+            Expression c = ScalarCompiler::generateCode(sig);
             fClass->closeLoop(sig);
             return c;
         }
@@ -211,7 +214,7 @@ string VectorCompiler::generateLoopCode (Tree sig)
  * @param exp the corresponding C code.
  * @return the cached C code
  */
-string VectorCompiler::generateCacheCode(Tree sig, const string& exp)
+Expression VectorCompiler::generateCacheCode(Tree sig, const Expression& exp)
 {
     string      vname, ctype;
     int         sharing = getSharingCount(sig);
@@ -231,7 +234,7 @@ string VectorCompiler::generateCacheCode(Tree sig, const string& exp)
             if ((sharing > 1) && !verySimple(sig)) {
                 // first cache this expression because it
                 // it is shared and complex
-                string cachedexp =  generateVariableStore(sig, exp);
+                Expression cachedexp =  generateVariableStore(sig, exp);
                 generateDelayLine(ctype, vname, d, cachedexp);
                 setVectorNameProperty(sig, vname);
                 return cachedexp;
@@ -255,11 +258,11 @@ string VectorCompiler::generateCacheCode(Tree sig, const string& exp)
                 return exp;
             } else {
                 if (d < gMaxCopyDelay) {
-                    return subst("$0[i]", vname);
+                    return loadExp(varExp(vname), varExp("i"));
                 } else {
                     // we use a ring buffer
                     string mask = T(pow2limit(d + gVecSize)-1);
-                    return subst("$0[($0_idx+i) & $1]", vname, mask);
+                    return loadExp(varExp(vname), opExp("($0+$1) & $2", varExp(vname + "_idx"), varExp("i"), constExp(mask)));
                 }
             }
         } else {
@@ -270,7 +273,7 @@ string VectorCompiler::generateCacheCode(Tree sig, const string& exp)
                 getTypedNames(getCertifiedSigType(sig), "Zec", ctype, vname);
                 generateDelayLine(ctype, vname, d, exp);
                 setVectorNameProperty(sig, vname);
-                return subst("$0[i]", vname);
+                return loadExp(varExp(vname), varExp("i"));
            } else {
                 // not shared or simple : no cache needed
                 return exp;
@@ -321,7 +324,7 @@ bool VectorCompiler::needSeparateLoop(Tree sig)
     return b;
 }
 
-void VectorCompiler::generateDelayLine(const string& ctype, const string& vname, int mxd, const string& exp)
+void VectorCompiler::generateDelayLine(const string& ctype, const string& vname, int mxd, const Expression& exp)
 {
     if (mxd == 0) {
         vectorLoop(ctype, vname, exp);
@@ -330,7 +333,7 @@ void VectorCompiler::generateDelayLine(const string& ctype, const string& vname,
     }
 }
 
-string VectorCompiler::generateVariableStore(Tree sig, const string& exp)
+Expression VectorCompiler::generateVariableStore(Tree sig, const Expression& exp)
 {
     Type        t = getCertifiedSigType(sig);
 
@@ -338,7 +341,7 @@ string VectorCompiler::generateVariableStore(Tree sig, const string& exp)
         string      vname, ctype;
         getTypedNames(t, "Vector", ctype, vname);
         vectorLoop(ctype, vname, exp);
-        return subst("$0[i]", vname);
+        return loadExp(varExp(vname), varExp("i"));
     } else {
         return ScalarCompiler::generateVariableStore(sig, exp);
     }
@@ -350,14 +353,14 @@ string VectorCompiler::generateVariableStore(Tree sig, const string& exp)
  * the maximum delay attached to exp and the gLessTempSwitch.
  */
 
-string VectorCompiler::generateFixDelay (Tree sig, Tree exp, Tree delay)
+Expression VectorCompiler::generateFixDelay (Tree sig, Tree exp, Tree delay)
 {
     int     mxd, d;
     string  vecname;
 
     //cerr << "VectorCompiler::generateFixDelay " << ppsig(sig) << endl;
 
-    string code = CS(exp); // ensure exp is compiled to have a vector name
+    Expression code = CS(exp); // ensure exp is compiled to have a vector name
 
     mxd = fOccMarkup.retrieve(exp)->getMaxDelay();
 
@@ -373,17 +376,17 @@ string VectorCompiler::generateFixDelay (Tree sig, Tree exp, Tree delay)
 
     if (mxd == 0) {
         // not a real vector name but a scalar name
-        return subst("$0[i]", vecname);
+        return loadExp(varExp(vecname), varExp("i"));
 
     } else if (mxd < gMaxCopyDelay){
         if (isSigInt(delay, &d)) {
             if (d == 0) {
-                return subst("$0[i]", vecname);
+                return loadExp(varExp(vecname), varExp("i"));
             } else {
-                return subst("$0[i-$1]", vecname, T(d));
+                return loadExp(varExp(vecname), opExp("$0-$1", varExp("i"), constExp(T(d))));
             }
         } else {
-            return subst("$0[i-$1]", vecname, CS(delay));
+            return loadExp(varExp(vecname), opExp("$0-$1", varExp("i"), CS(delay)));
         }
 
     } else {
@@ -391,14 +394,15 @@ string VectorCompiler::generateFixDelay (Tree sig, Tree exp, Tree delay)
         // long delay : we use a ring buffer of size 2^x
         int     N   = pow2limit( mxd+gVecSize );
 
+        Expression idx = opExp("$0+$1", varExp(vecname + "_idx"), varExp("i"));
         if (isSigInt(delay, &d)) {
             if (d == 0) {
-                return subst("$0[($0_idx+i)&$1]", vecname, T(N-1));
+                return loadExp(varExp(vecname), opExp("($0)&$1", idx, constExp(T(N-1))));
             } else {
-                return subst("$0[($0_idx+i-$2)&$1]", vecname, T(N-1), T(d));
+                return loadExp(varExp(vecname), opExp("($0-$1)&$2", idx, constExp(T(d)), constExp(T(N-1))));
             }
         } else {
-            return subst("$0[($0_idx+i-$2)&$1]", vecname, T(N-1), CS(delay));
+            return loadExp(varExp(vecname), opExp("($0-$1)&$2", idx, CS(delay), constExp(T(N-1))));
         }
     }
 }
@@ -409,7 +413,7 @@ string VectorCompiler::generateFixDelay (Tree sig, Tree exp, Tree delay)
  * maximum delay attached to exp and the "less temporaries" switch
  */
 
-string VectorCompiler::generateDelayVec(Tree sig, const string& exp, const string& ctype, const string& vname, int mxd)
+Expression VectorCompiler::generateDelayVec(Tree sig, const Expression& exp, const string& ctype, const string& vname, int mxd)
 {
     // it is a non-sample but used delayed
     // we need a delay line
@@ -418,7 +422,7 @@ string VectorCompiler::generateDelayVec(Tree sig, const string& exp, const strin
     if (verySimple(sig)) {
         return exp;
     } else {
-        return subst("$0[i]", vname);
+        return loadExp(varExp(vname), varExp("i"));
     }
 }
 
@@ -440,7 +444,7 @@ static int pow2limit(int x)
  * @param delay the maximum delay
  * @param cexp the content of the signal as a C++ expression
  */
-void  VectorCompiler::vectorLoop (const string& tname, const string& vecname, const string& cexp)
+void  VectorCompiler::vectorLoop (const string& tname, const string& vecname, const Expression& cexp)
 {
     // -- declare the vector
     fClass->addSharedDecl(vecname);
@@ -449,7 +453,7 @@ void  VectorCompiler::vectorLoop (const string& tname, const string& vecname, co
     fClass->addZone1(subst("$0 \t$1[$2];", tname, vecname, T(gVecSize)));
 
     // -- compute the new samples
-    fClass->addExecCode(subst("$0[i] = $1;", vecname, cexp));
+    fClass->addExecCode(storeStm(vecname, varExp("i"), cexp));
 }
 
 
@@ -462,7 +466,7 @@ void  VectorCompiler::vectorLoop (const string& tname, const string& vecname, co
  * @param delay the maximum delay
  * @param cexp the content of the signal as a C++ expression
  */
-void  VectorCompiler::dlineLoop (const string& tname, const string& dlname, int delay, const string& cexp)
+void  VectorCompiler::dlineLoop (const string& tname, const string& dlname, int delay, const Expression& cexp)
 {
     if (delay < gMaxCopyDelay) {
 
@@ -494,13 +498,13 @@ void  VectorCompiler::dlineLoop (const string& tname, const string& dlname, int
         fClass->addZone2(subst("$0* \t$1 = &$2[$3];", tname, dlname, buf, dsize));
 
         // -- copy the stored samples to the delay line
-        fClass->addPreCode(subst("for (int i=0; i<$2; i++) $0[i]=$1[i];", buf, pmem, dsize));
+        fClass->addPreCode(copyStm(buf, pmem, Expression(), delay));
 
         // -- compute the new samples
-        fClass->addExecCode(subst("$0[i] = $1;", dlname, cexp));
+        fClass->addExecCode(storeStm(dlname, varExp("i"), cexp));
 
         // -- copy back to stored samples
-        fClass->addPostCode(subst("for (int i=0; i<$2; i++) $0[i]=$1[count+i];", pmem, buf, dsize));
+        fClass->addPostCode(copyStm(pmem, buf, varExp("count"), delay));
 
     } else {
 
@@ -526,23 +530,23 @@ void  VectorCompiler::dlineLoop (const string& tname, const string& dlname, int
         fClass->addClearCode(subst("$0 = 0;", idx_save));
 
         // -- update index
-        fClass->addPreCode(subst("$0 = ($0+$1)&$2;", idx, idx_save, mask));
+        fClass->addPreCode(storeStm(idx, opExp("($0+$1)&$2", varExp(idx), varExp(idx_save), constExp(mask))));
 
         // -- compute the new samples
-        fClass->addExecCode(subst("$0[($2+i)&$3] = $1;", dlname, cexp, idx, mask));
+        fClass->addExecCode(storeStm(dlname, opExp("($0+$1)&$2", varExp(idx), varExp("i"), constExp(mask)), cexp));
 
         // -- save index
-        fClass->addPostCode(subst("$0 = count;", idx_save));
+        fClass->addPostCode(storeStm(idx_save, varExp("count")));
     }
 }
 
 
-string VectorCompiler::generateWaveform(Tree sig)
+Expression VectorCompiler::generateWaveform(Tree sig)
 {
     string  vname;
     int     size;
 
     declareWaveform(sig, vname, size);
-    fClass->addPostCode(subst("idx$0 = (idx$0 + count) % $1;", vname, T(size)) );
-    return generateCacheCode(sig, subst("$0[(idx$0+i)%$1]", vname, T(size)));
+    fClass->addPostCode(storeStm("idx" + vname, opExp("($0 + $1) % $2", varExp("idx" + vname), varExp("count"), constExp(T(size)))));
+    return generateCacheCode(sig, loadExp(varExp(vname), opExp("($0+$1)%$2", varExp("idx" + vname), varExp("i"), constExp(T(size)))));
 }
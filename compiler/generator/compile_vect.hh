@@ -51,20 +51,20 @@ public:
 
 protected:
 
-    virtual string      CS (Tree sig);
-    virtual string      generateCode (Tree sig);
+    virtual Expression  CS (Tree sig);
+    virtual Expression  generateCode (Tree sig);
     virtual void        generateCodeRecursions (Tree sig);
-    virtual string      generateCodeNonRec (Tree sig);
-    virtual string      generateLoopCode (Tree sig);
+    virtual Expression  generateCodeNonRec (Tree sig);
+    virtual Expression  generateLoopCode (Tree sig);
 
-    virtual string      generateCacheCode(Tree sig, const string& exp);
-    virtual void        generateDelayLine(const string& ctype, const string& vname, int mxd, const string& exp);
-    virtual string      generateVariableStore(Tree sig, const string& exp);
-    virtual string      generateFixDelay (Tree sig, Tree exp, Tree delay);
-    virtual string      generateDelayVec(Tree sig, const string& exp, const string& ctype, const string& vname, int mxd);
-    virtual void        vectorLoop (const string& tname, const string& dlname, const string& cexp);
-    virtual void        dlineLoop ( const string& tname, const string& dlname, int delay, const string& cexp);
-    virtual string      generateWaveform(Tree sig);
+    virtual Expression  generateCacheCode(Tree sig, const Expression& exp);
+    virtual void        generateDelayLine(const string& ctype, const string& vname, int mxd, const Expression& exp);
+    virtual Expression  generateVariableStore(Tree sig, const Expression& exp);
+    virtual Expression  generateFixDelay (Tree sig, Tree exp, Tree delay);
+    virtual Expression  generateDelayVec(Tree sig, const Expression& exp, const string& ctype, const string& vname, int mxd);
+    virtual void        vectorLoop (const string& tname, const string& dlname, const Expression& cexp);
+    virtual void        dlineLoop ( const string& tname, const string& dlname, int delay, const Expression& cexp);
+    virtual Expression  generateWaveform(Tree sig);
 
     bool    needSeparateLoop(Tree sig);
     
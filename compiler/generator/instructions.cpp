@@ -0,0 +1,265 @@
+/************************************************************************
+ ************************************************************************
+    FAUST compiler
+	Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ ************************************************************************
+ ************************************************************************/
+
+#include <stdlib.h>
+#include <ctype.h>
+#include "instructions.hh"
+#include "Text.hh"
+
+void tab(int n, ostream& fout);
+
+/*****************************************************************************
+                                EXPRESSIONS
+*****************************************************************************/
+
+Expression constExp(const string& value)
+{
+    return Expression(Expression::kConst, value);
+}
+
+Expression varExp(const string& name)
+{
+    return Expression(Expression::kVar, name);
+}
+
+Expression loadExp(const Expression& array, const Expression& index)
+{
+    Expression e(Expression::kLoad, "$0[$1]");
+    e.fArgs.push_back(array);
+    e.fArgs.push_back(index);
+    return e;
+}
+
+Expression opExp(const string& format, const Expression& a)
+{
+    Expression e(Expression::kOp, format);
+    e.fArgs.push_back(a);
+    return e;
+}
+
+Expression opExp(const string& format, const Expression& a, const Expression& b)
+{
+    Expression e(Expression::kOp, format);
+    e.fArgs.push_back(a);
+    e.fArgs.push_back(b);
+    return e;
+}
+
+Expression opExp(const string& format, const Expression& a, const Expression& b, const Expression& c)
+{
+    Expression e(Expression::kOp, format);
+    e.fArgs.push_back(a);
+    e.fArgs.push_back(b);
+    e.fArgs.push_back(c);
+    return e;
+}
+
+Expression opExp(const string& format, const Expression& a, const Expression& b, const Expression& c, const Expression& d)
+{
+    Expression e(Expression::kOp, format);
+    e.fArgs.push_back(a);
+    e.fArgs.push_back(b);
+    e.fArgs.push_back(c);
+    e.fArgs.push_back(d);
+    return e;
+}
+
+Expression opExp(const string& format, const vector<Expression>& args)
+{
+    Expression e(Expression::kOp, format);
+    e.fArgs = args;
+    return e;
+}
+
+void Expression::reads(set<string>& names) const
+{
+    if (fKind == kVar) {
+        names.insert(fName);
+    } else {
+        for (size_t i = 0; i < fArgs.size(); i++) fArgs[i].reads(names);
+    }
+}
+
+string Expression::toString() const
+{
+    switch (fKind) {
+        case kLoad:
+        case kOp: {
+            // $n is replaced by the code of the argument n (n can have several digits)
+            string code;
+            for (size_t i = 0; i < fName.size(); i++) {
+                if (fName[i] == '$' && i + 1 < fName.size() && isdigit(fName[i+1])) {
+                    size_t n = 0;
+                    while (i + 1 < fName.size() && isdigit(fName[i+1])) n = 10 * n + (fName[++i] - '0');
+                    if (n < fArgs.size()) code += fArgs[n].toString();
+                } else {
+                    code += fName[i];
+                }
+            }
+            return code;
+        }
+        default:
+            return fName;
+    }
+}
+
+/**
+ * All the identifiers of some C++ code (a conservative set of the variables it uses).
+ */
+void identifiers(const string& code, set<string>& names)
+{
+    for (size_t i = 0; i < code.size(); ) {
+        if ((isalpha(code[i]) || code[i] == '_') && (i == 0 || !(isalnum(code[i-1]) || code[i-1] == '_' || code[i-1] == '.'))) {
+            size_t j = i + 1;
+            while (j < code.size() && (isalnum(code[j]) || code[j] == '_')) j++;
+            names.insert(code.substr(i, j - i));
+            i = j;
+        } else {
+            i++;
+        }
+    }
+}
+
+/*****************************************************************************
+                                STATEMENTS
+*****************************************************************************/
+
+Statement declareStm(const string& type, const string& name, const Expression& value)
+{
+    return Statement(Statement::kDeclare, type, name, Expression(), value, 0);
+}
+
+Statement declareStm(const string& type, const string& name)
+{
+    return Statement(Statement::kDeclare, type, name, Expression(), Expression(), 0);
+}
+
+Statement declareArrayStm(const string& type, const string& name, int size)
+{
+    return Statement(Statement::kDeclare, type, name, Expression(), Expression(), size);
+}
+
+Statement storeStm(const string& name, const Expression& value)
+{
+    return Statement(Statement::kStore, "", name, Expression(), value, 0);
+}
+
+Statement storeStm(const string& name, const Expression& index, const Expression& value)
+{
+    return Statement(Statement::kStore, "", name, index, value, 0);
+}
+
+/**
+ * Shift by one sample of a delay line of maximum delay 'mxd' (of mxd+1 elements).
+ */
+Statement shiftStm(const string& name, int mxd)
+{
+    return Statement(Statement::kShift, "", name, Expression(), Expression(), mxd);
+}
+
+/**
+ * Copy of 'size' elements of 'src' starting at 'offset' (possibly none) to 'dst'.
+ */
+Statement copyStm(const string& dst, const string& src, const Expression& offset, int size)
+{
+    return Statement(Statement::kCopy, "", dst, offset, varExp(src), size);
+}
+
+/**
+ * Increment of a counter modulo 'size'.
+ */
+Statement incrementStm(const string& name, int size)
+{
+    return Statement(Statement::kIncrement, "", name, Expression(), Expression(), size);
+}
+
+Statement ifStm(const Expression& cond)
+{
+    return Statement(Statement::kIf, "", "", Expression(), cond, 0);
+}
+
+Statement elseIfStm(const Expression& cond)
+{
+    return Statement(Statement::kElseIf, "", "", Expression(), cond, 0);
+}
+
+Statement elseStm()
+{
+    return Statement(Statement::kElse, "", "", Expression(), Expression(), 0);
+}
+
+Statement endStm()
+{
+    return Statement(Statement::kEnd, "", "", Expression(), Expression(), 0);
+}
+
+string Statement::toString() const
+{
+    switch (fKind) {
+        case kDeclare:
+            if (!fValue.isNone()) {
+                return subst("$0 $1 = $2;", fType, fName, fValue.toString());
+            } else {
+                return (fSize == 0) ? subst("$0 \t$1;", fType, fName) : subst("$0 \t$1[$2];", fType, fName, T(fSize));
+            }
+        case kStore:
+            return (fIndex.isNone()) ? subst("$0 = $1;", fName, fValue.toString())
+                                     : subst("$0[$1] = $2;", fName, fIndex.toString(), fValue.toString());
+        case kShift:
+            if (fSize == 1) {
+                return subst("$0[1] = $0[0];", fName);
+            } else if (fSize == 2) {
+                return subst("$0[2] = $0[1]; $0[1] = $0[0];", fName);
+            } else {
+                return subst("for (int i=$0; i>0; i--) $1[i] = $1[i-1];", T(fSize), fName);
+            }
+        case kCopy:
+            return subst("for (int i=0; i<$0; i++) $1[i]=$2[$3i];", T(fSize), fName, fValue.toString(),
+                         (fIndex.isNone()) ? "" : fIndex.toString() + "+");
+        case kIncrement:
+            return subst("if (++$0 == $1) $0=0;", fName, T(fSize));
+        case kIf:
+            return subst("if ($0) {", fValue.toString());
+        case kElseIf:
+            return subst("} else if ($0) {", fValue.toString());
+        case kElse:
+            return "} else {";
+        default:
+            return "}";
+    }
+}
+
+void Statement::reads(set<string>& names) const
+{
+    fIndex.reads(names);
+    fValue.reads(names);
+    if (fKind == kShift || fKind == kIncrement) names.insert(fName);
+}
+
+/**
+ * Print a list of statements, one per line.
+ */
+void printlines(int n, list<Statement>& lines, ostream& fout)
+{
+    for (list<Statement>::iterator s = lines.begin(); s != lines.end(); s++) {
+        tab(n + s->fLevel, fout); fout << s->toString();
+    }
+}
@@ -0,0 +1,124 @@
+/************************************************************************
+ ************************************************************************
+    FAUST compiler
+	Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ ************************************************************************
+ ************************************************************************/
+
+#ifndef _INSTRUCTIONS_H
+#define _INSTRUCTIONS_H
+
+/**********************************************************************
+			- instructions.hh : typed statements of the generated code -
+
+		The code generators emit the statements of the loops as typed
+		instructions (declarations, stores, delay line shifts, block
+		copies, conditional blocks) whose values are typed expressions
+		(variables, constants, array loads and operations), so that later
+		passes know what each statement reads and writes. They are only
+		printed as C++ at the end.
+***********************************************************************/
+
+#include <string>
+#include <list>
+#include <vector>
+#include <set>
+#include <ostream>
+using namespace std;
+
+struct Expression
+{
+    enum Kind {
+        kNone,          ///< no expression (a store without index...)
+        kConst,         ///< literal (fName)
+        kVar,           ///< variable (fName)
+        kLoad,          ///< element fArgs[1] of the array fArgs[0]
+        kOp             ///< operation on fArgs, printed with the format fName where $0, $1... are the arguments
+    };
+
+    Kind                fKind;
+    string              fName;
+    vector<Expression>  fArgs;
+
+    Expression() : fKind(kNone) {}
+    Expression(Kind kind, const string& name) : fKind(kind), fName(name) {}
+
+    bool    isNone() const { return fKind == kNone; }
+    bool    operator==(const Expression& e) const { return fKind == e.fKind && fName == e.fName && fArgs == e.fArgs; }
+    bool    operator!=(const Expression& e) const { return !(*this == e); }
+    void    reads(set<string>& names) const;    ///< adds the variables and arrays read by the expression
+    string  toString() const;                   ///< the C++ code
+};
+
+Expression constExp(const string& value);
+Expression varExp(const string& name);
+Expression loadExp(const Expression& array, const Expression& index);
+Expression opExp(const string& format, const Expression& a);
+Expression opExp(const string& format, const Expression& a, const Expression& b);
+Expression opExp(const string& format, const Expression& a, const Expression& b, const Expression& c);
+Expression opExp(const string& format, const Expression& a, const Expression& b, const Expression& c, const Expression& d);
+Expression opExp(const string& format, const vector<Expression>& args);
+
+void identifiers(const string& code, set<string>& names);
+
+struct Statement
+{
+    enum Kind {
+        kDeclare,       ///< fType fName = fValue;  or  fType fName[fSize];  or  fType fName;  when there is no value
+        kStore,         ///< fName = fValue;  or  fName[fIndex] = fValue;
+        kShift,         ///< fName[fSize..1] = fName[fSize-1..0]; (delay line shift, fSize being the maximum delay)
+        kCopy,          ///< for (int i=0; i<fSize; i++) fName[i]=fValue[fIndex+i]; (block copy)
+        kIncrement,     ///< if (++fName == fSize) fName=0;
+        kIf,            ///< if (fValue) {
+        kElseIf,        ///< } else if (fValue) {
+        kElse,          ///< } else {
+        kEnd            ///< }
+    };
+
+    Kind        fKind;
+    string      fType;
+    string      fName;      ///< the variable or array written
+    Expression  fIndex;
+    Expression  fValue;
+    int         fSize;
+    int         fLevel;     ///< nesting level inside the conditional blocks of the loop
+
+    Statement(Kind kind, const string& type, const string& name, const Expression& index, const Expression& value, int size)
+        : fKind(kind), fType(type), fName(name), fIndex(index), fValue(value), fSize(size), fLevel(0)
+    {}
+
+    string  writes() const  { return fName; }   ///< variable written, empty for the conditional blocks
+    void    reads(set<string>& names) const;    ///< variables read
+    string  toString() const;                   ///< the C++ code
+};
+
+Statement declareStm(const string& type, const string& name, const Expression& value);
+Statement declareStm(const string& type, const string& name);
+Statement declareArrayStm(const string& type, const string& name, int size);
+Statement storeStm(const string& name, const Expression& value);
+Statement storeStm(const string& name, const Expression& index, const Expression& value);
+Statement shiftStm(const string& name, int mxd);
+Statement copyStm(const string& dst, const string& src, const Expression& offset, int size);
+Statement incrementStm(const string& name, int size);
+Statement ifStm(const Expression& cond);
+Statement elseIfStm(const Expression& cond);
+Statement elseStm();
+Statement endStm();
+
+void printlines(int n, list<Statement>& lines, ostream& fout);
+
+#endif
@@ -49,9 +49,11 @@
 #include "signals.hh"
 #include "ppsig.hh"
 #include "recursivness.hh"
+#include "enrobage.hh"
 
 
 extern int  gFloatSize;
+extern bool gMixedPrecision;
 extern bool gVectorSwitch;
 extern bool gDeepFirstSwitch;
 extern bool gOpenMPSwitch;
@@ -61,6 +63,9 @@ extern int  gVecSize;
 extern bool gUIMacroSwitch;
 extern int  gVectorLoopVariant;
 extern bool	gGroupTaskSwitch;
+extern int  gLoopFunctions;
+extern int  gLoopFunctionParts;
+extern int  gLocalDelayUnroll;
 
 extern map<Tree, set<Tree> > gMetaDataSet;
 static int gTaskCount = 0;
@@ -72,6 +77,8 @@ void tab (int n, ostream& fout)
 }
 
 bool Klass::fNeedPowerDef = false;
+bool Klass::fNeedConvolverDef = false;
+bool Klass::fNeedBiquadDef = false;
 
 /**
  * Store the loop used to compute a signal
@@ -215,6 +222,21 @@ void Klass::printIncludeFile(ostream& fout)
     }
 }
 
+/**
+ * Copy an architecture file in the generated code
+ */
+static void inlineArchitectureFile(const char* name, ostream& fout)
+{
+    istream* file = open_arch_stream(name);
+    if (file) {
+        streamCopy(*file, fout);
+        delete file;
+    } else {
+        cerr << "ERROR : can't include \"" << name << "\", file not found" << endl;
+        exit(1);
+    }
+}
+
 /**
  * Print additional functions required by the generated code
  */
@@ -238,7 +260,8 @@ void Klass::printAdditionalCode(ostream& fout)
             fout << "template <> 	 inline float faustpower<1>(float x)          { return x; }" << endl;
             fout << "template <> 	 inline float faustpower<2>(float x)          { return x*x; }" << endl;
             
-        } else if (gFloatSize==2) {
+        }
+        if (gFloatSize==2 || (gFloatSize==1 && gMixedPrecision)) {
         
             fout << "template <int N> inline double faustpower(double x)          { return faustpower<N/2>(x) * faustpower<N-N/2>(x); } " << endl;
             fout << "template <> 	 inline double faustpower<0>(double x)        { return 1; }" << endl;
@@ -254,6 +277,29 @@ void Klass::printAdditionalCode(ostream& fout)
 
     }
 
+    if (gLoopFunctions > 0 && gVectorSwitch) {
+        // Keep the loop functions out of compute
+        fout << "#ifndef FAUST_NOINLINE" << endl;
+        fout << "#if defined(__GNUC__)" << endl;
+        fout << "#define FAUST_NOINLINE __attribute__((noinline))" << endl;
+        fout << "#elif defined(_MSC_VER)" << endl;
+        fout << "#define FAUST_NOINLINE __declspec(noinline)" << endl;
+        fout << "#else" << endl;
+        fout << "#define FAUST_NOINLINE" << endl;
+        fout << "#endif" << endl;
+        fout << "#endif" << endl;
+    }
+
+    if (fNeedConvolverDef) {
+        // Add the FFT convolver used by the FIR filters
+        inlineArchitectureFile("faust/dsp/fft-convolver.h", fout);
+    }
+
+    if (fNeedBiquadDef) {
+        // Add the kernel used by the cascades of second order sections
+        inlineArchitectureFile("faust/dsp/biquad-cascade.h", fout);
+    }
+
 }
 
 /**
@@ -476,6 +522,14 @@ void Klass::buildTasksList()
  */
 void Klass::printLoopGraphVector(int n, ostream& fout)
 {
+    if (!fLoopFunctions.empty()) {
+        // the loops are computed by separate functions
+        for (unsigned int f = 0; f < fLoopFunctions.size(); f++) {
+            tab(n, fout); fout << "computeLoops" << f << "(" << fLoopFunctions[f].fArgs << ");";
+        }
+        return;
+    }
+
     if (gGroupTaskSwitch) {
         computeUseCount(fTopLoop);
         set<Loop*> visited;
@@ -602,6 +656,412 @@ void Klass::printLoopGraphScalar(int n, ostream& fout)
     fTopLoop->printoneln(n, fout);
 }
 
+/**
+ * Check the loads of the delay lines of 'lines' in an expression of the sample loop : a line
+ * can be rotated when it is only loaded at a constant index > 0, or anywhere in the exec
+ * code after its store (not in the post code, that follows the shift).
+ */
+static void checkDelayReads(const Expression& e, const map<string,int>& lines, const set<string>& stored, bool post, set<string>& rejected)
+{
+    if (e.fKind == Expression::kLoad && e.fArgs[0].fKind == Expression::kVar) {
+        const string& name = e.fArgs[0].fName;
+        if (lines.count(name)) {
+            const string& index = e.fArgs[1].fName;
+            bool constant = (e.fArgs[1].fKind == Expression::kConst) && !index.empty() && index.find_first_not_of("0123456789") == string::npos
+                            && atoi(index.c_str()) > 0;
+            if (post || !(constant || stored.count(name))) rejected.insert(name);
+        }
+        checkDelayReads(e.fArgs[1], lines, stored, post, rejected);
+        return;
+    }
+    for (size_t i = 0; i < e.fArgs.size(); i++) checkDelayReads(e.fArgs[i], lines, stored, post, rejected);
+    if (e.fKind == Expression::kVar) {
+        // the line is used as a whole
+        if (lines.count(e.fName)) rejected.insert(e.fName);
+    } else if (e.fKind != Expression::kNone) {
+        set<string> ids;
+        identifiers(e.fName, ids);
+        for (set<string>::const_iterator i = ids.begin(); i != ids.end(); i++) {
+            if (lines.count(*i)) rejected.insert(*i);
+        }
+    }
+}
+
+/**
+ * Choose the copy delay lines kept in local variables (-ld option) that are rotated instead
+ * of shifted : the lines of at most gLocalDelayUnroll elements (rounded up to a power of 2)
+ * only stored at index 0 and shifted at the top level of the sample loop, only loaded by the
+ * loop, and not mentioned by the other code of compute. The sample loop is then unrolled by the
+ * largest of their sizes (see Loop::printrotatedln).
+ * @param masks the rotated lines with the mask of their size
+ * @return the unroll factor, 1 when no line is rotated
+ */
+int Klass::rotatedDelays(map<string,int>& masks)
+{
+    if (gLocalDelayUnroll < 2 || fLocalDelays.empty() || !fTopLoop->fExtraLoops.empty()) return 1;
+
+    set<string> used;
+    list<string>* code[] = { &fZone1Code, &fZone2Code, &fZone2bCode, &fZone2cCode, &fZone3Code, &fZone4Code };
+    for (unsigned int c = 0; c < sizeof(code)/sizeof(code[0]); c++) {
+        for (list<string>::const_iterator l = code[c]->begin(); l != code[c]->end(); l++) identifiers(*l, used);
+    }
+
+    map<string,int> lines;
+    for (list<LocalDelay>::const_iterator d = fLocalDelays.begin(); d != fLocalDelays.end(); d++) {
+        int size = 1;
+        while (size < d->fMaxDelay + 1) size *= 2;
+        if (size <= gLocalDelayUnroll && !used.count(d->fName)) lines[d->fName] = size - 1;
+    }
+
+    // the pre code comes before the stores, the post code after the shifts
+    set<string> stored, shifted, rejected;
+    list<Statement>* lists[] = { &fTopLoop->fPreCode, &fTopLoop->fExecCode, &fTopLoop->fPostCode };
+    for (int c = 0; c < 3; c++) {
+        for (list<Statement>::const_iterator s = lists[c]->begin(); s != lists[c]->end(); s++) {
+            checkDelayReads(s->fIndex, lines, stored, c == 2, rejected);
+            checkDelayReads(s->fValue, lines, stored, c == 2, rejected);
+            if (!lines.count(s->fName)) continue;
+            if (s->fKind == Statement::kStore && c == 1 && s->fLevel == 0 && s->fIndex == constExp("0") && !stored.count(s->fName)) {
+                stored.insert(s->fName);
+            } else if (s->fKind == Statement::kShift && c == 2 && s->fLevel == 0) {
+                shifted.insert(s->fName);
+            } else {
+                rejected.insert(s->fName);
+            }
+        }
+    }
+
+    int unroll = 1;
+    for (map<string,int>::const_iterator l = lines.begin(); l != lines.end(); l++) {
+        if (stored.count(l->first) && shifted.count(l->first) && !rejected.count(l->first)) {
+            masks.insert(*l);
+            unroll = max(unroll, l->second + 1);
+        }
+    }
+    return unroll;
+}
+
+/**
+ * Declare the local copies of the delay lines (-ld option) before the sample loop. A rotated
+ * line of size P starts with the element j of the member in the slot (-j)&(P-1).
+ */
+void Klass::printLocalDelaysBegin(int n, const map<string,int>& masks, ostream& fout)
+{
+    for (list<LocalDelay>::const_iterator d = fLocalDelays.begin(); d != fLocalDelays.end(); d++) {
+        map<string,int>::const_iterator m = masks.find(d->fName);
+        int size = (m != masks.end()) ? m->second + 1 : d->fMaxDelay + 1;
+        string values;
+        for (int s = 0; s < size; s++) {
+            int j = (m != masks.end()) ? (-s) & m->second : s;
+            values += (s > 0) ? ", " : "";
+            values += (j <= d->fMaxDelay) ? subst("this->$0[$1]", d->fName, T(j)) : "0";
+        }
+        tab(n, fout); fout << subst("$0 \t$1[$2] = { $3 };", d->fType, d->fName, T(size), values);
+    }
+}
+
+/**
+ * Store the local copies of the delay lines (-ld option) back in the members after the sample
+ * loop. After 'count' samples the element j of a rotated line is in the slot (count-j)&(P-1),
+ * the element 0 of the shifted members is a copy of the element 1.
+ */
+void Klass::printLocalDelaysEnd(int n, const map<string,int>& masks, ostream& fout)
+{
+    for (list<LocalDelay>::const_iterator d = fLocalDelays.begin(); d != fLocalDelays.end(); d++) {
+        map<string,int>::const_iterator m = masks.find(d->fName);
+        if (m != masks.end()) {
+            tab(n, fout); fout << subst("for (int j=1; j<$1; j++) this->$0[j] = $0[($2-j)&$3];",
+                                        d->fName, T(d->fMaxDelay + 1), fTopLoop->fSize, T(m->second));
+            tab(n, fout); fout << subst("this->$0[0] = this->$0[1];", d->fName);
+        } else {
+            tab(n, fout); fout << subst("for (int i=0; i<$1; i++) this->$0[i] = $0[i];", d->fName, T(d->fMaxDelay + 1));
+        }
+    }
+}
+
+/**
+ * Number of lines of code of a loop and of its sequence of extra loops
+ */
+static int loopSize(Loop* l)
+{
+    int size = int(l->fPreCode.size() + l->fExecCode.size() + l->fPostCode.size());
+    for (list<Loop*>::const_iterator s = l->fExtraLoops.begin(); s != l->fExtraLoops.end(); s++) {
+        size += loopSize(*s);
+    }
+    return size;
+}
+
+/**
+ * Collect the loops of a loop graph in the order of printLoopDeepFirst
+ */
+static void collectLoopDeepFirst(Loop* l, set<Loop*>& visited, vector<Loop*>& loops)
+{
+    if (isElement(visited, l)) return;
+    visited.insert(l);
+    for (lset::const_iterator p =l->fBackwardLoopDependencies.begin(); p!=l->fBackwardLoopDependencies.end(); p++) {
+        collectLoopDeepFirst(*p, visited, loops);
+    }
+    loops.push_back(l);
+}
+
+static const char* kIdentChars = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+
+/**
+ * Decompose a declaration "type name = exp;" or "type name[size];" of a local
+ * variable of compute. An array is passed to the loop functions as a pointer.
+ */
+static bool isLocalDecl(const string& line, string& type, string& name)
+{
+    size_t end = line.find_first_of("=[;");
+    if (end == string::npos || end == 0) return false;
+    size_t last = line.find_last_not_of(" \t", end-1);
+    if (last == string::npos) return false;
+    size_t first = line.find_last_not_of(kIdentChars, last);
+    if (first == string::npos || first == last || isdigit(line[first+1])) return false;
+    size_t tb = line.find_first_not_of(" \t");
+    size_t te = line.find_last_not_of(" \t", first);
+    if (te == string::npos || tb > te) return false;
+    type = line.substr(tb, te-tb+1);
+    if (type.find_first_not_of(string(kIdentChars) + " \t*:") != string::npos) return false;
+    name = line.substr(first+1, last-first);
+    if (line[end] == '[') type += "*";
+    return true;
+}
+
+/**
+ * Collect all the loops of a loop graph
+ */
+static void collectLoops(Loop* l, set<Loop*>& loops)
+{
+    if (!loops.insert(l).second) return;
+    for (lset::const_iterator p = l->fBackwardLoopDependencies.begin(); p != l->fBackwardLoopDependencies.end(); p++) {
+        collectLoops(*p, loops);
+    }
+    for (list<Loop*>::const_iterator e = l->fExtraLoops.begin(); e != l->fExtraLoops.end(); e++) {
+        collectLoops(*e, loops);
+    }
+}
+
+/**
+ * Collect the names read or written by the statements of a loop and of its extra loops
+ */
+static void loopNames(Loop* l, set<string>& names)
+{
+    for (list<Loop*>::const_iterator e = l->fExtraLoops.begin(); e != l->fExtraLoops.end(); e++) {
+        loopNames(*e, names);
+    }
+    list<Statement>* lists[] = { &l->fPreCode, &l->fExecCode, &l->fPostCode };
+    for (int c = 0; c < 3; c++) {
+        for (list<Statement>::const_iterator s = lists[c]->begin(); s != lists[c]->end(); s++) {
+            s->reads(names);
+            names.insert(s->writes());
+        }
+    }
+}
+
+/**
+ * Remove the lines of 'code' that only mention 'name' (and type names), when no other line mentions it
+ */
+static void removeLines(list<string>& code, const string& name, const set<string>& ignored)
+{
+    list<list<string>::iterator> lines;
+    for (list<string>::iterator l = code.begin(); l != code.end(); l++) {
+        set<string> ids;
+        identifiers(*l, ids);
+        if (!ids.count(name)) continue;
+        for (set<string>::const_iterator i = ids.begin(); i != ids.end(); i++) {
+            if (*i != name && !ignored.count(*i)) return;
+        }
+        lines.push_back(l);
+    }
+    for (list<list<string>::iterator>::iterator l = lines.begin(); l != lines.end(); l++) code.erase(*l);
+}
+
+/**
+ * Dead store elimination (-dse option) : remove the statements of the loops that write a
+ * variable or an array that is never read, but by the statements that write it (like the
+ * projections of a recursive group that are not used outside of the group). What the
+ * statements read is given by their typed expressions, the other code of the class is
+ * conservatively supposed to read all the names it contains, so that the outputs, the
+ * bargraphs and the local vectors are kept. The members that become unused are removed
+ * from the declarations and the clear code.
+ * @return the number of removed statements
+ */
+int Klass::eliminateDeadStores()
+{
+    struct StatementRef {
+        list<Statement>* fCode;
+        list<Statement>::iterator fStatement;
+        set<string> fReads;
+        bool fLive;
+    };
+
+    // names read by the code that is not made of typed statements
+    set<string> used;
+    list<string>* code[] = { &fStaticInitCode, &fInitCode, &fInitUICode, &fUICode, &fUIMacro, &fSharedDecl, &fFirstPrivateDecl,
+                             &fZone1Code, &fZone2Code, &fZone2bCode, &fZone2cCode, &fZone3Code, &fZone4Code };
+    for (unsigned int c = 0; c < sizeof(code)/sizeof(code[0]); c++) {
+        for (list<string>::const_iterator l = code[c]->begin(); l != code[c]->end(); l++) identifiers(*l, used);
+    }
+
+    vector<StatementRef> statements;
+    set<Loop*> loops;
+    collectLoops(fTopLoop, loops);
+    for (set<Loop*>::const_iterator l = loops.begin(); l != loops.end(); l++) {
+        list<Statement>* lists[] = { &(*l)->fPreCode, &(*l)->fExecCode, &(*l)->fPostCode };
+        for (int c = 0; c < 3; c++) {
+            for (list<Statement>::iterator s = lists[c]->begin(); s != lists[c]->end(); s++) {
+                StatementRef ref = { lists[c], s, set<string>(), true };
+                s->reads(ref.fReads);
+                ref.fReads.erase(s->writes());
+                statements.push_back(ref);
+            }
+        }
+    }
+
+    // remove the dead statements until the remaining ones are all used
+    set<string> dead;
+    for (bool changed = true; changed; ) {
+        set<string> reads = used;
+        for (unsigned int i = 0; i < statements.size(); i++) {
+            if (statements[i].fLive) reads.insert(statements[i].fReads.begin(), statements[i].fReads.end());
+        }
+        changed = false;
+        for (unsigned int i = 0; i < statements.size(); i++) {
+            string name = statements[i].fStatement->writes();
+            if (statements[i].fLive && name != "" && !reads.count(name)) {
+                statements[i].fLive = false;
+                dead.insert(name);
+                changed = true;
+            }
+        }
+    }
+
+    int removed = 0;
+    for (unsigned int i = 0; i < statements.size(); i++) {
+        if (!statements[i].fLive) {
+            statements[i].fCode->erase(statements[i].fStatement);
+            removed++;
+        }
+    }
+
+    set<string> ignored;
+    const char* types[] = { "for", "int", "float", "double", "long", "quad", "FAUSTFLOAT", "i", 0 };
+    for (int t = 0; types[t]; t++) ignored.insert(types[t]);
+    for (set<string>::const_iterator n = dead.begin(); n != dead.end(); n++) {
+        removeLines(fDeclCode, *n, ignored);
+        removeLines(fClearCode, *n, ignored);
+    }
+    for (list<LocalDelay>::iterator d = fLocalDelays.begin(); d != fLocalDelays.end(); ) {
+        d = (dead.count(d->fName)) ? fLocalDelays.erase(d) : ++d;
+    }
+    return removed;
+}
+
+/**
+ * Group the loops of the loop graph (vector mode) in functions of at least
+ * gLoopFunctions lines of code. The local variables of compute used by the
+ * loops of a function (vectors, pointers, slow variables...) are passed as
+ * parameters, the state of the dsp is accessed as members.
+ */
+void Klass::buildLoopFunctions()
+{
+    // the loops in the order of printLoopGraphVector
+    vector<Loop*> loops;
+    if (gGroupTaskSwitch) {
+        computeUseCount(fTopLoop);
+        set<Loop*> visited;
+        groupSeqLoops(fTopLoop, visited);
+    }
+    if (gDeepFirstSwitch) {
+        set<Loop*> visited;
+        collectLoopDeepFirst(fTopLoop, visited, loops);
+    } else {
+        lgraph G;
+        sortGraph(fTopLoop, G);
+        for (int l=(int)G.size()-1; l>=0; l--) {
+            loops.insert(loops.end(), G[l].begin(), G[l].end());
+        }
+    }
+
+    LoopFunction f;
+    int size = 0;
+    for (unsigned int l = 0; l < loops.size(); l++) {
+        if (loops[l]->isEmpty()) continue;
+        f.fLoops.push_back(loops[l]);
+        size += loopSize(loops[l]);
+        if (size >= gLoopFunctions) {
+            fLoopFunctions.push_back(f);
+            f.fLoops.clear();
+            size = 0;
+        }
+    }
+    if (!f.fLoops.empty()) fLoopFunctions.push_back(f);
+
+    // the local variables of compute, in declaration order
+    vector<pair<string,string> > locals;
+    set<string> names;
+    list<string>* zones[] = { &fZone1Code, &fZone2Code, &fZone3Code };
+    for (int z = 0; z < 3; z++) {
+        for (list<string>::const_iterator s = zones[z]->begin(); s != zones[z]->end(); s++) {
+            string type, name;
+            if (isLocalDecl(*s, type, name) && names.insert(name).second) locals.push_back(make_pair(type, name));
+        }
+    }
+
+    for (unsigned int i = 0; i < fLoopFunctions.size(); i++) {
+        set<string> ids;
+        for (list<Loop*>::const_iterator l = fLoopFunctions[i].fLoops.begin(); l != fLoopFunctions[i].fLoops.end(); l++) {
+            loopNames(*l, ids);
+        }
+        fLoopFunctions[i].fParams = "int count";
+        fLoopFunctions[i].fArgs = "count";
+        for (unsigned int v = 0; v < locals.size(); v++) {
+            if (ids.count(locals[v].second)) {
+                fLoopFunctions[i].fParams += subst(", $0 $1", locals[v].first, locals[v].second);
+                fLoopFunctions[i].fArgs += ", " + locals[v].second;
+            }
+        }
+    }
+}
+
+/**
+ * Print the loop functions in the class, with their code or as declarations
+ * when they are defined in separate files
+ */
+void Klass::printLoopFunctions(int n, bool definitions, ostream& fout)
+{
+    for (unsigned int f = 0; f < fLoopFunctions.size(); f++) {
+        tab(n, fout); fout << "FAUST_NOINLINE void computeLoops" << f << "(" << fLoopFunctions[f].fParams << ")";
+        if (definitions) {
+            fout << " {";
+            for (list<Loop*>::const_iterator l = fLoopFunctions[f].fLoops.begin(); l != fLoopFunctions[f].fLoops.end(); l++) {
+                (*l)->println(n+1, fout);
+            }
+            tab(n, fout); fout << "}";
+        } else {
+            fout << ";";
+        }
+    }
+}
+
+/**
+ * Print a file with the class declaration and the definitions of the loop
+ * functions part, part+parts, part+2*parts... (-lfp option)
+ */
+void Klass::printLoopFunctionPart(int part, int parts, ostream& fout)
+{
+    printClass(0, fout);
+    for (unsigned int f = part; f < fLoopFunctions.size(); f += parts) {
+        tab(0, fout); fout << "void " << fKlassName << "::computeLoops" << f << "(" << fLoopFunctions[f].fParams << ") {";
+        for (list<Loop*>::const_iterator l = fLoopFunctions[f].fLoops.begin(); l != fLoopFunctions[f].fLoops.end(); l++) {
+            (*l)->println(1, fout);
+        }
+        tab(0, fout); fout << "}" << endl;
+    }
+    fout << endl;
+}
+
 /**
  * returns true if all the loops are non recursive
  */
@@ -767,6 +1227,29 @@ void Klass::printLoopLevelScheduler(int n, int lnum, const lset& L, ostream& fou
  * Print a full C++ class corresponding to a Faust dsp
  */
 void Klass::println(int n, ostream& fout)
+{
+    printClass(n, fout);
+
+	printlines(n, fStaticFields, fout);
+
+	// generate user interface macros if needed
+	if (gUIMacroSwitch) {
+		tab(n, fout); fout << "#ifdef FAUST_UIMACROS";
+            tab(n+1,fout); fout << "#define FAUST_INPUTS " << fNumInputs;
+            tab(n+1,fout); fout << "#define FAUST_OUTPUTS " << fNumOutputs;
+            tab(n+1,fout); fout << "#define FAUST_ACTIVES " << fNumActives;
+            tab(n+1,fout); fout << "#define FAUST_PASSIVES " << fNumPassives;
+			printlines(n+1, fUIMacro, fout);
+		tab(n, fout); fout << "#endif";
+	}
+
+	fout << endl;
+}
+
+/**
+ * Print the declaration of the class (without its static fields)
+ */
+void Klass::printClass(int n, ostream& fout)
 {
 	list<Klass* >::iterator k;
 
@@ -853,23 +1336,9 @@ void Klass::println(int n, ostream& fout)
     tab(n+1,fout); fout << "}";
 
     printComputeMethod(n, fout);
+    printLoopFunctions(n+1, gLoopFunctionParts == 0, fout);
 
 	tab(n,fout); fout << "};\n" << endl;
-
-	printlines(n, fStaticFields, fout);
-
-	// generate user interface macros if needed
-	if (gUIMacroSwitch) {
-		tab(n, fout); fout << "#ifdef FAUST_UIMACROS";
-            tab(n+1,fout); fout << "#define FAUST_INPUTS " << fNumInputs;
-            tab(n+1,fout); fout << "#define FAUST_OUTPUTS " << fNumOutputs;
-            tab(n+1,fout); fout << "#define FAUST_ACTIVES " << fNumActives;
-            tab(n+1,fout); fout << "#define FAUST_PASSIVES " << fNumPassives;
-			printlines(n+1, fUIMacro, fout);
-		tab(n, fout); fout << "#endif";
-	}
-
-	fout << endl;
 }
 
 /**
@@ -882,6 +1351,7 @@ void Klass::printComputeMethod(int n, ostream& fout)
     } else if (gOpenMPSwitch) {
         printComputeMethodOpenMP (n, fout);
     } else if (gVectorSwitch) {
+        if (gLoopFunctions > 0 && fLoopFunctions.empty()) buildLoopFunctions();
         switch (gVectorLoopVariant) {
             case 0 : printComputeMethodVectorFaster(n, fout); break;
             case 1 : printComputeMethodVectorSimple(n, fout); break;
@@ -899,7 +1369,16 @@ void Klass::printComputeMethodScalar(int n, ostream& fout)
         printlines (n+2, fZone2Code, fout);
         printlines (n+2, fZone2bCode, fout);
         printlines (n+2, fZone3Code, fout);
-        printLoopGraphScalar (n+2,fout);
+        map<string,int> masks;
+        int unroll = rotatedDelays(masks);
+        printLocalDelaysBegin (n+2, masks, fout);
+        if (unroll > 1) {
+            fTopLoop->printrotatedln(n+2, masks, unroll, fout);
+        } else {
+            printLoopGraphScalar (n+2,fout);
+        }
+        printLocalDelaysEnd (n+2, masks, fout);
+        printlines (n+2, fZone4Code, fout);
     tab(n+1,fout); fout << "}";
 }
 
@@ -1223,7 +1702,10 @@ void SigIntGenKlass::println(int n, ostream& fout)
             printlines (n+2, fZone2Code, fout);
             printlines (n+2, fZone2bCode, fout);
             printlines (n+2, fZone3Code, fout);
+            printLocalDelaysBegin (n+2, map<string,int>(), fout);
             printLoopGraphInternal (n+2,fout);
+            printLocalDelaysEnd (n+2, map<string,int>(), fout);
+            printlines (n+2, fZone4Code, fout);
 		tab(n+1,fout); fout << "}";
 
 	tab(n,fout); fout << "};\n" << endl;
@@ -1263,7 +1745,10 @@ void SigFloatGenKlass::println(int n, ostream& fout)
             printlines (n+2, fZone2Code, fout);
             printlines (n+2, fZone2bCode, fout);
             printlines (n+2, fZone3Code, fout);
+            printLocalDelaysBegin (n+2, map<string,int>(), fout);
             printLoopGraphInternal(n+2,fout);
+            printLocalDelaysEnd (n+2, map<string,int>(), fout);
+            printlines (n+2, fZone4Code, fout);
  		tab(n+1,fout); fout << "}";
 
 	tab(n,fout); fout << "};\n" << endl;
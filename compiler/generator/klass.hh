@@ -41,6 +41,7 @@ using namespace std;
 #include <list>
 #include <set>
 #include <map>
+#include <vector>
 #include "sigtype.hh"
 #include "smartpointer.hh"
 #include "tlib.hh"
@@ -52,6 +53,26 @@ using namespace std;
 #include "loop.hh"
 #include "graphSorting.hh"
 
+/**
+ * A group of consecutive loops of the loop graph printed in a separate function (vector mode)
+ */
+struct LoopFunction
+{
+    list<Loop*>     fLoops;                     ///< loops computed by the function
+    string          fParams;                    ///< parameters : the local variables of compute used by the loops
+    string          fArgs;                      ///< arguments of the call in compute
+};
+
+/**
+ * A copy delay line kept in a local variable during compute (-ld option)
+ */
+struct LocalDelay
+{
+    string          fType;
+    string          fName;
+    int             fMaxDelay;                  ///< the line has fMaxDelay+1 elements
+};
+
 class Klass //: public Target
 {
 
@@ -59,6 +80,8 @@ protected:
     // we make it global because several classes may need
     // power def but we want the code to be generated only once
     static bool     fNeedPowerDef;              ///< true when faustpower definition is needed
+    static bool     fNeedConvolverDef;          ///< true when the fft_convolver class is needed
+    static bool     fNeedBiquadDef;             ///< true when the biquad_cascade class is needed
 
 
  protected:
@@ -100,9 +123,12 @@ protected:
     list<string>        fZone2bCode;             ///< single once per block
     list<string>        fZone2cCode;             ///< single once per block
     list<string>        fZone3Code;             ///< private every sub block
+    list<string>        fZone4Code;             ///< after the loop (scalar mode)
+    list<LocalDelay>    fLocalDelays;           ///< copy delay lines kept in local variables during compute (-ld)
   
     Loop*               fTopLoop;               ///< active loops currently open
     property<Loop*>     fLoopProperty;          ///< loops used to compute some signals
+    vector<LoopFunction> fLoopFunctions;        ///< functions computing the loops (-lf option)
 
     bool                fVec;
 
@@ -135,6 +161,8 @@ protected:
     Loop*   topLoop()   { return fTopLoop; }
     
     void buildTasksList();
+
+    int eliminateDeadStores();
     
 	void addIncludeFile (const string& str) { fIncludeFileSet.insert(str); }
 
@@ -142,6 +170,10 @@ protected:
 
     void rememberNeedPowerDef ()            { fNeedPowerDef = true; }
 
+    void rememberNeedConvolverDef ()        { fNeedConvolverDef = true; }
+
+    void rememberNeedBiquadDef ()           { fNeedBiquadDef = true; }
+
 	void collectIncludeFile(set<string>& S);
 
 	void collectLibrary(set<string>& S);
@@ -173,12 +205,20 @@ protected:
     void addZone2b (const string& str)  { fZone2bCode.push_back(str); }
     void addZone2c (const string& str)  { fZone2cCode.push_back(str); }
     void addZone3 (const string& str)  { fZone3Code.push_back(str); }
+    void addZone4 (const string& str)  { fZone4Code.push_back(str); }
+
+    void addLocalDelay (const string& type, const string& name, int mxd)
+    {
+        LocalDelay d = { type, name, mxd };
+        fLocalDelays.push_back(d);
+    }
  
-    void addPreCode ( const string& str)   { fTopLoop->addPreCode(str); }
-    void addExecCode ( const string& str)   { fTopLoop->addExecCode(str); }
-	void addPostCode (const string& str)	{ fTopLoop->addPostCode(str); }
+    void addPreCode (const Statement& stm)  { fTopLoop->addPreCode(stm); }
+    void addExecCode (const Statement& stm) { fTopLoop->addExecCode(stm); }
+    void addPostCode (const Statement& stm) { fTopLoop->addPostCode(stm); }
 
 	virtual void println(int n, ostream& fout);
+    virtual void printClass(int n, ostream& fout);
     
     virtual void printComputeMethod (int n, ostream& fout);
     virtual void printComputeMethodScalar (int n, ostream& fout);
@@ -192,8 +232,15 @@ protected:
     virtual void printLoopGraphOpenMP(int n, ostream& fout);
     virtual void printLoopGraphScheduler(int n, ostream& fout);
     virtual void printLoopGraphInternal(int n, ostream& fout);
+    virtual int  rotatedDelays(map<string,int>& masks);
+    virtual void printLocalDelaysBegin(int n, const map<string,int>& masks, ostream& fout);
+    virtual void printLocalDelaysEnd(int n, const map<string,int>& masks, ostream& fout);
     virtual void printGraphDotFormat(ostream& fout);
 
+    virtual void buildLoopFunctions();
+    virtual void printLoopFunctions(int n, bool definitions, ostream& fout);
+    virtual void printLoopFunctionPart(int part, int parts, ostream& fout);
+
     // experimental
 	virtual void printLoopDeepFirst(int n, ostream& fout, Loop* l, set<Loop*>& visited);
 
@@ -4,6 +4,8 @@
 #include "occurences.hh"
 #include "sigtype.hh"
 #include "sigtyperules.hh"
+#include "firdetection.hh"
+#include "biquaddetection.hh"
 #include <iostream>
 
 using namespace std;
@@ -108,7 +110,20 @@ void OccMarkup::incOcc(Tree env, int v, int r, int d, Tree t)
 
 		// We mark the subtrees of t
         Tree c, x, y, z;
-		if (isSigFixDelay(t,x,y)) {
+        int input;
+        vector<double> taps;
+        vector<Tree> coefs;
+        if (isFIRFilter(t, x, taps)) {
+            // computed by the convolver from the current value of x only, the delayed terms are not compiled
+            incOcc(env, v0, r0, 0, x);
+        } else if (isBiquadCascade(t, input, coefs)) {
+            // computed from the input buffer, only the factors of the coefficients are compiled
+            for (size_t k = 0; k < coefs.size(); k++) {
+                for (Tree m = coefs[k]; !isNil(m); m = tl(m)) {
+                    for (Tree f = tl(hd(m)); !isNil(f); f = tl(f)) incOcc(env, v0, r0, 0, hd(f));
+                }
+            }
+		} else if (isSigFixDelay(t,x,y)) {
 			Type g2 = getCertifiedSigType(y);
 			int d2 = checkDelayInterval(g2);
 			assert(d2>=0);
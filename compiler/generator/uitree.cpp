@@ -203,10 +203,10 @@ AJOUTER (Dossier[(l1,d1)...(ln,dn)], (lx,dx)) -> Dossier[(l1,d1)...(lx,dx)...(ln
 AJOUTER (Dossier[(l1,d1)...(lx,dx)...(ln,dn)], (lx,dx')) -> Dossier[(l1,d1)...(lx,dx')...(ln,dn)]
 */
 
-// Handle empty labels in a consistent way
+// Handle empty labels in a consistent way (the serial number of the tree, that doesn't depend on the allocator, makes them unique)
 string ptrToHex(Tree ptr)
 {
-    stringstream res; res << hex << ptr; return res.str();
+    stringstream res; res << "0x" << hex << ptr->serial(); return res.str();
 }
 
 string checkNullLabel(Tree t, const string& label, bool bargraph)
@@ -114,6 +114,8 @@ bool			gHelpSwitch 	= false;
 bool			gVersionSwitch 	= false;
 bool            gDetailsSwitch  = false;
 bool            gTimingSwitch   = false;
+string          gTraceFile;             // Chrome trace of the compilation phases (-trace)
+bool            gCollectSwitch  = false;    // delete the trees no longer used between phases (-gc)
 bool            gDrawSignals    = false;
 bool            gShadowBlur     = false;	// note: svg2pdf doesn't like the blur filter
 bool            gScaledSVG      = false;	// to draw scaled SVG files
@@ -132,6 +134,13 @@ bool			gSimpleNames 	= false;
 bool            gSimplifyDiagrams = false;
 bool			gLessTempSwitch = false;
 int				gMaxCopyDelay	= 16;
+bool			gLocalDelaySwitch = false;	// keep the copy delay lines in local variables during compute
+int				gLocalDelayUnroll = 1;		// with -ld, rotate the delay lines of at most gLocalDelayUnroll elements in an unrolled sample loop (1: never)
+bool			gDeadStoreSwitch = false;	// remove the statements writing variables that are never read
+int				gLazySelect		= 0;		// 0: compute all the select branches, 1: only the selected stateless ones, 2: also bypass stateful ones without ring buffer
+int				gFIRMinTaps		= 0;		// FFT convolution of the FIR filters of at least gFIRMinTaps taps (0: never)
+int				gBiquadMinSections = 0;		// block kernel for the cascades of at least gBiquadMinSections sections (0: never)
+bool			gMixedPrecision = false;	// double precision for the sensitive recursions only
 string			gArchFile;
 string			gOutputFile;
 list<string>	gInputFiles;
@@ -142,6 +151,8 @@ bool            gVectorSwitch   = false;
 bool            gDeepFirstSwitch= false;
 int             gVecSize        = 32;
 int             gVectorLoopVariant = 0;
+int             gLoopFunctions  = 0;        // loops printed in functions of at least gLoopFunctions lines (0: in compute)
+int             gLoopFunctionParts = 0;     // loop functions defined in gLoopFunctionParts separate files (0: in the class)
 
 bool            gOpenMPSwitch   = false;
 bool            gOpenMPLoop     = false;
@@ -303,6 +314,34 @@ bool process_cmdline(int argc, char* argv[])
             gMaxCopyDelay = atoi(argv[i+1]);
             i += 2;
 
+        } else if (isCmd(argv[i], "-ld", "--local-delays")) {
+            gLocalDelaySwitch = true;
+            i += 1;
+
+        } else if (isCmd(argv[i], "-ldu", "--local-delay-unroll") && (i+1 < argc)) {
+            gLocalDelayUnroll = atoi(argv[i+1]);
+            i += 2;
+
+        } else if (isCmd(argv[i], "-dse", "--dead-store-elimination")) {
+            gDeadStoreSwitch = true;
+            i += 1;
+
+        } else if (isCmd(argv[i], "-ls", "--lazy-select") && (i+1 < argc)) {
+            gLazySelect = atoi(argv[i+1]);
+            i += 2;
+
+        } else if (isCmd(argv[i], "-fir", "--fir-convolution") && (i+1 < argc)) {
+            gFIRMinTaps = atoi(argv[i+1]);
+            i += 2;
+
+        } else if (isCmd(argv[i], "-bq", "--biquad-cascade") && (i+1 < argc)) {
+            gBiquadMinSections = atoi(argv[i+1]);
+            i += 2;
+
+        } else if (isCmd(argv[i], "-mp", "--mixed-precision")) {
+            gMixedPrecision = true;
+            i += 1;
+
         } else if (isCmd(argv[i], "-sd", "--simplify-diagrams")) {
             gSimplifyDiagrams = true;
             i += 1;
@@ -323,6 +362,14 @@ bool process_cmdline(int argc, char* argv[])
             gVectorLoopVariant = atoi(argv[i+1]);
             i += 2;
 
+        } else if (isCmd(argv[i], "-lf", "--loop-functions") && (i+1 < argc)) {
+            gLoopFunctions = atoi(argv[i+1]);
+            i += 2;
+
+        } else if (isCmd(argv[i], "-lfp", "--loop-function-parts") && (i+1 < argc)) {
+            gLoopFunctionParts = atoi(argv[i+1]);
+            i += 2;
+
         } else if (isCmd(argv[i], "-omp", "--openMP")) {
             gOpenMPSwitch = true;
             i += 1;
@@ -351,6 +398,14 @@ bool process_cmdline(int argc, char* argv[])
             gTimingSwitch = true;
             i += 1;
             
+        } else if (isCmd(argv[i], "-gc", "--garbage-collect")) {
+            gCollectSwitch = true;
+            i += 1;
+            
+        } else if (isCmd(argv[i], "-trace", "--trace-file") && (i+1 < argc)) {
+            gTraceFile = argv[i+1];
+            i += 2;
+            
         // double float options
         } else if (isCmd(argv[i], "-single", "--single-precision-floats")) {
             gFloatSize = 1;
@@ -515,15 +570,26 @@ void printhelp()
 	cout << "-rb \t\tgenerate --right-balanced expressions\n";
 	cout << "-lt \t\tgenerate --less-temporaries in compiling delays\n";
 	cout << "-mcd <n> \t--max-copy-delay <n> threshold between copy and ring buffer implementation (default 16 samples)\n";
+	cout << "-ld \t\t--local-delays in scalar mode, keep the copy delay lines (see -mcd) in local variables during compute\n";
+	cout << "-ldu <n> \t--local-delay-unroll <n> with -ld, rotate the delay lines of at most <n> elements (rounded up to a power of 2) instead of shifting them, in a sample loop unrolled <n> times at most (default 1: never)\n";
+	cout << "-dse \t\t--dead-store-elimination remove the code computing variables and delay lines that are never read\n";
+	cout << "-ls <n> \t--lazy-select <n> in scalar mode, [0: compute all select2/select3 branches (default), 1: compute only the selected stateless branches, 2: also bypass the stateful branches without ring buffer when the selector is a control (their state is kept while bypassed)]\n";
+	cout << "-fir <n> \t--fir-convolution <n> in scalar mode, compute the FIR filters of at least <n> taps by FFT convolution (default 0: never)\n";
+	cout << "-bq <n> \t--biquad-cascade <n> in scalar mode, compute the cascades of at least <n> second order sections applied to an input by blocks (default 0: never)\n";
+	cout << "-mp \t\t--mixed-precision in scalar mode with single precision, compute the sensitive recursions (poles near the unit circle, phase accumulators...) and their coefficients in double precision\n";
 	cout << "-a <file> \tC++ architecture file\n";
 	cout << "-i \t\t--inline-architecture-files \n";
 	cout << "-cn <name> \t--class-name <name> specify the name of the dsp class to be used instead of mydsp \n";
 	cout << "-t <sec> \t--timeout <sec>, abort compilation after <sec> seconds (default 120)\n";
 	cout << "-time \t\t--compilation-time, flag to display compilation phases timing information\n";
+	cout << "-gc \t\t--garbage-collect delete the trees no longer used after the evaluation and the propagation (lower peak memory, slower compilation)\n";
+	cout << "-trace <file> \t--trace-file <file>, write the compilation phases timing and memory counters in Chrome trace format\n";
     cout << "-o <file> \tC++ output file\n";
     cout << "-vec    \t--vectorize generate easier to vectorize code\n";
     cout << "-vs <n> \t--vec-size <n> size of the vector (default 32 samples)\n";
     cout << "-lv <n> \t--loop-variant [0:fastest (default), 1:simple] \n";
+    cout << "-lf <n> \t--loop-functions <n> in --vectorize mode, compute the loops in separate functions of at least <n> lines of code (default 0: in compute)\n";
+    cout << "-lfp <n> \t--loop-function-parts <n> with --loop-functions, define the loop functions in <n> separate files <output>_part<i>.cpp (needs -o)\n";
     cout << "-omp    \t--openMP generate OpenMP pragmas, activates --vectorize option\n";
     cout << "-pl     \t--par-loop generate parallel loops in --openMP mode\n";
     cout << "-sch    \t--scheduler generate tasks and use a Work Stealing scheduler, activates --vectorize option\n";
@@ -548,6 +614,18 @@ void printhelp()
 }
 
 
+/**
+ * Name of the file of a part of the loop functions : "dir/file_part<n>.cpp" for "dir/file.cpp"
+ */
+static string partFileName(const string& path, int n)
+{
+    size_t dot = path.rfind('.');
+    size_t slash = path.rfind('/');
+    if (dot == string::npos || (slash != string::npos && dot < slash)) dot = path.size();
+    string ext = (dot < path.size()) ? path.substr(dot) : ".cpp";
+    return subst("$0_part$1$2", path.substr(0, dot), T(n), ext);
+}
+
 void printheader(ostream& dst)
 {
     // defines the metadata we want to print as comments at the begin of in the C++ file
@@ -661,6 +739,31 @@ static void initFaustDirectories()
 
 
 
+/**
+ * With -gc, delete the trees that are not reachable from 'root' or from the metadata,
+ * the parsed definitions being dropped. Nothing is collected when the documentation, that evaluates boxes again, is generated.
+ */
+static void collectTrees(Tree root)
+{
+    if (!gCollectSwitch || gPrintDocSwitch) return;
+    startTiming("collection");
+    gResult = gResult2 = gExpandedDefList = nil;
+    tvec roots;
+    roots.push_back(root);
+    for (map<Tree, set<Tree> >::iterator i = gMetaDataSet.begin(); i != gMetaDataSet.end(); i++) {
+        roots.push_back(i->first);
+        roots.insert(roots.end(), i->second.begin(), i->second.end());
+    }
+    unsigned long collected = CTree::collect(roots);
+    if (gDetailsSwitch) { cerr << collected << " trees collected" << endl; }
+    endTiming("collection");
+}
+
+static void writeTrace()
+{
+    writeTimingTrace(gTraceFile);
+}
+
 int main (int argc, char* argv[])
 {
     ostream*    dst;
@@ -679,6 +782,8 @@ int main (int argc, char* argv[])
 
     initFaustDirectories();
     alarm(gTimeout);
+    CTree::protectAll();
+    if (gTraceFile != "") atexit(writeTrace);
 
 
     /****************************************************************
@@ -687,6 +792,9 @@ int main (int argc, char* argv[])
     if (gOutputFile != "") {
         string outpath = (gOutputDir != "") ? (gOutputDir + "/" + gOutputFile) : gOutputFile;
         dst = new ofstream(outpath.c_str());
+    } else if (gLoopFunctionParts > 0) {
+        cerr << "ERROR : the loop function parts (-lfp) need an output file (-o)" << endl;
+        exit(1);
     } else {
         dst = &cout;
     }
@@ -797,6 +905,9 @@ int main (int argc, char* argv[])
         xout << "process = " << boxpp(process) << ";" << endl;
         return 0;
     }
+
+    // the definitions and the intermediate results of the evaluation are no longer needed
+    collectTrees(process);
  
 	/****************************************************************
 	 3.5 - output file list is needed
@@ -824,6 +935,13 @@ int main (int argc, char* argv[])
 	endTiming("propagation");
 
 
+	/****************************************************************
+	 4.5 - reclaim the box level trees and their properties
+	*****************************************************************/
+
+	collectTrees(lsignals);
+
+
 	/****************************************************************
 	 5 - translate output signals into C++ code
 	*****************************************************************/
@@ -838,6 +956,7 @@ int main (int argc, char* argv[])
 	if (gPrintXMLSwitch || gPrintDocSwitch) C->setDescription(new Description());
 	
 	C->compileMultiSignal(lsignals);
+	if (gDeadStoreSwitch) C->getClass()->eliminateDeadStores();
 
 	endTiming("compilation");
 
@@ -881,6 +1000,8 @@ int main (int argc, char* argv[])
 	 8 - generate output file
 	*****************************************************************/
 
+    startTiming("printing");
+
     printheader(*dst);
     C->getClass()->printLibrary(*dst);
     C->getClass()->printIncludeFile(*dst);
@@ -910,6 +1031,25 @@ int main (int argc, char* argv[])
         C->getClass()->println(0,*dst);
     }
 
+    if (gLoopFunctionParts > 0) {
+        // the loop functions are defined in separate files, with their own copy of the class declaration
+        string outpath = (gOutputDir != "") ? (gOutputDir + "/" + gOutputFile) : gOutputFile;
+        for (int p = 0; p < gLoopFunctionParts; p++) {
+            ofstream part(partFileName(outpath, p+1).c_str());
+            printheader(part);
+            C->getClass()->printIncludeFile(part);
+            part << "#include <math.h>" << endl;
+            part << "#include \"faust/misc.h\"" << endl;
+            part << "#include \"faust/gui/UI.h\"" << endl;
+            part << "#include \"faust/dsp/dsp.h\"" << endl;
+            C->getClass()->printAdditionalCode(part);
+            printfloatdef(part);
+            C->getClass()->printLoopFunctionPart(p, gLoopFunctionParts, part);
+        }
+    }
+
+    endTiming("printing");
+
 
     /****************************************************************
      9 - generate the task graph file in dot format
@@ -44,7 +44,7 @@ static Tree simplifyingAdd(Tree t1, Tree t2)
 	} else if (isZero(t2)) {
 		return t1;
 
-	} else if (t1 <= t2) {
+	} else if (!less<Tree>()(t2, t1)) {
 		return sigAdd(t1, t2);
 
 	} else {
@@ -1,10 +1,15 @@
+#include <stdlib.h>
+#include <ctype.h>
 #include "loop.hh"
+#include "Text.hh"
 extern bool gVectorSwitch;
 extern bool gOpenMPSwitch;
 extern bool gOpenMPLoop;
 
 using namespace std;
 
+int Loop::gLoopCount = 0;
+
 /**
  * Print n tabs (for indentation purpose)
  * @param n number of tabs to print
@@ -17,21 +22,6 @@ static void tab (int n, ostream& fout)
 }
 
 
-/**
- * Print a list of lines
- * @param n number of tabs of indentation
- * @param lines list of lines to be printed
- * @param fout output stream
- */
-static void printlines (int n, list<string>& lines, ostream& fout)
-{
-    list<string>::iterator s;
-    for (s = lines.begin(); s != lines.end(); s++) {
-        tab(n, fout); fout << *s;
-    }
-}
-
-
 /**
  * Create a recursive loop
  * @param recsymbol the recursive symbol defined in this loop
@@ -39,7 +29,7 @@ static void printlines (int n, list<string>& lines, ostream& fout)
  * @param size the number of iterations of the loop
  */
 Loop::Loop(Tree recsymbol, Loop* encl, const string& size)
-        : fIsRecursive(true), fRecSymbolSet(singleton(recsymbol)), fEnclosingLoop(encl), fSize(size), fOrder(-1), fIndex(-1), fUseCount(0), fPrinted(0)
+        : fNum(gLoopCount++), fIsRecursive(true), fRecSymbolSet(singleton(recsymbol)), fEnclosingLoop(encl), fSize(size), fOrder(-1), fIndex(-1), fUseCount(0), fPrinted(0)
 {}
 
 
@@ -49,7 +39,7 @@ Loop::Loop(Tree recsymbol, Loop* encl, const string& size)
  * @param size the number of iterations of the loop
  */
 Loop::Loop(Loop* encl, const string& size) 
-        : fIsRecursive(false), fRecSymbolSet(nil), fEnclosingLoop(encl), fSize(size), fOrder(-1), fIndex(-1), fUseCount(0), fPrinted(0)
+        : fNum(gLoopCount++), fIsRecursive(false), fRecSymbolSet(nil), fEnclosingLoop(encl), fSize(size), fOrder(-1), fIndex(-1), fUseCount(0), fPrinted(0)
 {}
 
 
@@ -77,31 +67,28 @@ bool Loop::isEmpty()
 }
 
 /**
- * Add a line of pre code  (begin of the loop)
+ * Add a statement of pre code (begin of the loop)
  */
-void Loop::addPreCode (const string& str)    
+void Loop::addPreCode (const Statement& stm)
 { 
-   // cerr << this << "->addExecCode " << str << endl;
-    fPreCode.push_back(str); 
+    fPreCode.push_back(stm); 
 }
 
 /**
- * Add a line of exec code 
+ * Add a statement of exec code
  */
-void Loop::addExecCode (const string& str)    
+void Loop::addExecCode (const Statement& stm)
 { 
-   // cerr << this << "->addExecCode " << str << endl;
-    fExecCode.push_back(str); 
+    fExecCode.push_back(stm); 
 }
 
 
 /**
- * Add a line of post exec code (end of the loop) 
+ * Add a statement of post exec code (end of the loop)
  */
-void Loop::addPostCode (const string& str)    
+void Loop::addPostCode (const Statement& stm)
 { 
-   // cerr << this << "->addPostCode " << str << endl;
-    fPostCode.push_front(str); 
+    fPostCode.push_front(stm); 
 }
 
 
@@ -143,7 +130,7 @@ void Loop::println(int n, ostream& fout)
             fout << ((fIsRecursive) ? "// recursive loop" : "// vectorizable loop");
         }*/
 
-        tab(n,fout); fout << "// LOOP " << this ;
+        tab(n,fout); fout << "// LOOP " << fNum;
         if (fPreCode.size()>0) {
             tab(n,fout); fout << "// pre processing";
             printlines(n, fPreCode, fout);
@@ -180,7 +167,7 @@ void Loop::printParLoopln(int n, ostream& fout)
 
     if (fPreCode.size()+fExecCode.size()+fPostCode.size() > 0) {
 
-        tab(n,fout); fout << "// LOOP " << this ;
+        tab(n,fout); fout << "// LOOP " << fNum;
         if (fPreCode.size()>0) {
             tab(n,fout); fout << "#pragma omp single";
             tab(n,fout); fout << "{";
@@ -233,6 +220,87 @@ void Loop::printoneln(int n, ostream& fout)
     }
 }
 
+/**
+ * The constant value of an index expression, -1 when it is not a constant
+ */
+static int constIndex(const Expression& e)
+{
+    if (e.fKind != Expression::kConst || e.fName.empty()) return -1;
+    for (size_t i = 0; i < e.fName.size(); i++) {
+        if (!isdigit(e.fName[i])) return -1;
+    }
+    return atoi(e.fName.c_str());
+}
+
+/**
+ * Rewrite the loads of the rotated delay lines for the sample k of the unrolled loop :
+ * the element j of a line of mask m is the slot (k-j)&m of its local array
+ */
+static Expression rotatedExp(const Expression& e, const map<string,int>& masks, int k)
+{
+    Expression r = e;
+    for (size_t i = 0; i < e.fArgs.size(); i++) r.fArgs[i] = rotatedExp(e.fArgs[i], masks, k);
+    if (e.fKind == Expression::kLoad && e.fArgs[0].fKind == Expression::kVar) {
+        map<string,int>::const_iterator m = masks.find(e.fArgs[0].fName);
+        if (m != masks.end()) {
+            int j = constIndex(e.fArgs[1]);
+            r.fArgs[1] = (j >= 0) ? constExp(T((k - j) & m->second))
+                                  : opExp("($0-$1)&$2", constExp(T(k)), r.fArgs[1], constExp(T(m->second)));
+        }
+    }
+    return r;
+}
+
+/**
+ * The statements of the sample k of the unrolled loop : the element 0 of the rotated delay
+ * lines is stored in the slot k&m and their shifts are removed
+ */
+static list<Statement> rotatedStm(const list<Statement>& lines, const map<string,int>& masks, int k)
+{
+    list<Statement> code;
+    for (list<Statement>::const_iterator s = lines.begin(); s != lines.end(); s++) {
+        map<string,int>::const_iterator m = masks.find(s->fName);
+        if (s->fKind == Statement::kShift && m != masks.end()) continue;
+        Statement r = *s;
+        r.fIndex = rotatedExp(s->fIndex, masks, k);
+        r.fValue = rotatedExp(s->fValue, masks, k);
+        if (s->fKind == Statement::kStore && m != masks.end()) r.fIndex = constExp(T(k & m->second));
+        code.push_back(r);
+    }
+    return code;
+}
+
+/**
+ * Print the loop in scalar mode, unrolled 'unroll' times (a multiple of the sizes of the
+ * rotated delay lines, given by their masks) : the rotated lines are never shifted, the
+ * slots of their local arrays are renamed from one sample to the next instead. Each sample
+ * is a block, for the declarations of its temporaries.
+ */
+void Loop::printrotatedln(int n, const map<string,int>& masks, int unroll, ostream& fout)
+{
+    tab(n,fout); fout << "for (int i=0; i<" << fSize << "; i++) {";
+    for (int k = 0; k < unroll; k++) {
+        list<Statement> pre = rotatedStm(fPreCode, masks, k);
+        list<Statement> exec = rotatedStm(fExecCode, masks, k);
+        list<Statement> post = rotatedStm(fPostCode, masks, k);
+        if (k > 0) {
+            tab(n+1,fout); fout << "if (++i == " << fSize << ") break;";
+        }
+        tab(n+1,fout); fout << "{";
+        if (pre.size()>0) {
+            tab(n+2,fout); fout << "// pre processing";
+            printlines(n+2, pre, fout);
+        }
+        printlines(n+2, exec, fout);
+        if (post.size()>0) {
+            tab(n+2,fout); fout << "// post processing";
+            printlines(n+2, post, fout);
+        }
+        tab(n+1,fout); fout << "}";
+    }
+    tab(n,fout); fout << "}";
+}
+
 //-------------------------------------------------------
 void Loop::concat(Loop* l)
 {
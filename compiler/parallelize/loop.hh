@@ -42,15 +42,30 @@ using namespace std;
 #include <set>
 #include <map>
 #include "tlib.hh"
+#include "instructions.hh"
 
 #define kMaxCategory 32
 
+struct Loop;
+
+/**
+ * The sets of loops are ordered by the creation order of the loops (see Loop::fNum) instead
+ * of their addresses, so that the loops are printed in the same order at each compilation.
+ */
+namespace std {
+    template <> struct less<Loop*> {
+        bool operator() (Loop* a, Loop* b) const;
+    };
+}
+
 /*
  * Loops are lines of code that correspond to a recursive expression or a vector expression.
  */
 
 struct Loop
 {
+    static int          gLoopCount;         ///< number of loops created
+    const int           fNum;               ///< creation order of the loop
     const bool          fIsRecursive;       ///< recursive loops can't be SIMDed
     Tree                fRecSymbolSet;      ///< recursive loops define a set of recursive symbol
     Loop* const         fEnclosingLoop;     ///< Loop from which this one originated
@@ -58,9 +73,9 @@ struct Loop
     // fields concerned by absorbsion
     set<Loop*>          fBackwardLoopDependencies;  ///< Loops that must be computed before this one
     set<Loop*>          fForwardLoopDependencies;   ///< Loops that will be computed after this one
-    list<string>        fPreCode;           ///< code to execute at the begin of the loop
-    list<string>        fExecCode;          ///< code to execute in the loop
-    list<string>        fPostCode;          ///< code to execute at the end of the loop
+    list<Statement>     fPreCode;           ///< code to execute at the begin of the loop
+    list<Statement>     fExecCode;          ///< code to execute in the loop
+    list<Statement>     fPostCode;          ///< code to execute at the end of the loop
     // for topological sort
     int                 fOrder;             ///< used during topological sort
     int                 fIndex;             ///< used during scheduler mode code generation
@@ -77,17 +92,23 @@ public:
     bool isEmpty();                         ///< true when the loop doesn't contain any line of code
     bool hasRecDependencyIn(Tree S);        ///< returns true is this loop or its ancestors define a symbol in S
 
-    void addPreCode (const string& str);        ///< add a line of C++ code pre code
-    void addExecCode (const string& str);       ///< add a line of C++ code
-    void addPostCode (const string& str);       ///< add a line of C++ post code
+    void addPreCode (const Statement& stm);     ///< add a pre code statement
+    void addExecCode (const Statement& stm);    ///< add a statement
+    void addPostCode (const Statement& stm);    ///< add a post code statement
     void println (int n, ostream& fout);        ///< print the loop
     void printParLoopln(int n, ostream& fout);  ///< print the loop with a #pragma omp loop
 
     void printoneln (int n, ostream& fout);    ///< print the loop in scalar mode
+    void printrotatedln (int n, const map<string,int>& masks, int unroll, ostream& fout);  ///< print the loop in scalar mode, unrolled with rotated delay lines
 
     void absorb(Loop* l);                   ///< absorb a loop inside this one
     // new method
     void concat(Loop* l);
 };
 
+inline bool std::less<Loop*>::operator() (Loop* a, Loop* b) const
+{
+    return a->fNum < b->fNum;
+}
+
 #endif
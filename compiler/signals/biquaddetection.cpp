@@ -0,0 +1,329 @@
+/************************************************************************
+ ************************************************************************
+    FAUST compiler
+	Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ ************************************************************************
+ ************************************************************************/
+#include <map>
+#include <set>
+#include "biquaddetection.hh"
+#include "recursivness.hh"
+#include "sigtyperules.hh"
+#include "binop.hh"
+
+/**
+ * @file biquaddetection.cpp
+ * Detect the cascades of second order sections of a (normalized) signal
+ * expression, like the ones produced by fi.tf2 and the filters built on it :
+ *
+ *     W1 = b1(x) - a1(W1),  W2 = b2(W1) - a2(W2) ... y = c(WK)
+ *
+ * where x is an audio input, each Wk a single recursive definition, and each
+ * b, a, c a linear combination of the current and two previous values of its
+ * argument (only the previous ones for a) with coefficients that don't change
+ * during a block. The output y of each cascade of at least minSections recursive
+ * sections is annotated with x and the coefficients of the stages. Cascades
+ * with intermediate values used elsewhere are left alone.
+ *
+ * A coefficient is a list of monomials cons(k, factors) : the product of the
+ * number k and of the list of (constant or block rate) signals factors.
+ */
+
+//--------------------------------------------------------------------------
+Tree BIQUADCASCADE = tree(symbol("BiquadCascadeProp"));
+
+static const int kMaxSteps = 1 << 16;   // bound of the expansion of shared subexpressions
+
+typedef map<pair<Tree,int>, Tree> Terms;    // (signal, delay) -> coefficient
+//--------------------------------------------------------------------------
+
+static bool isNumber(Tree sig, double& r)
+{
+    int i;
+    if (isSigReal(sig, &r)) return true;
+    if (isSigInt(sig, &i)) { r = i; return true; }
+    return false;
+}
+
+/**
+ * A signal that can be a factor of a coefficient.
+ */
+static bool isSlowFactor(Tree sig)
+{
+    return getCertifiedSigType(sig)->variability() < kSamp && getRecursivness(sig) == 0;
+}
+
+/**
+ * The projection of a recursive group with a single definition.
+ */
+static bool isSection(Tree sig, Tree& rg)
+{
+    int i;
+    Tree var, body;
+    return isProj(sig, &i, rg) && i == 0 && isRec(rg, var, body) && len(body) == 1;
+}
+
+/**
+ * Decompose k.factors.sig@offset as a linear combination of delayed audio inputs
+ * and recursive sections, accumulated in terms. The decomposed nodes are added to nodes.
+ */
+static bool linearize(Tree sig, int offset, double k, Tree factors, Terms& terms, set<Tree>& nodes, int& steps)
+{
+    int op, d, i;
+    double r;
+    Tree a, b, rg;
+
+    if (++steps > kMaxSteps) {
+        return false;
+    } else if (isSigInput(sig, &i) || isSection(sig, rg)) {
+        Tree& c = terms[make_pair(sig, offset)];
+        c = cons(cons(tree(k), factors), (c) ? c : nil);
+        return true;
+    }
+    nodes.insert(sig);
+    if (isSigDelay1(sig, a)) {
+        return linearize(a, offset + 1, k, factors, terms, nodes, steps);
+    } else if (isSigFixDelay(sig, a, b)) {
+        return isSigInt(b, &d) && d >= 0 && linearize(a, offset + d, k, factors, terms, nodes, steps);
+    } else if (isSigBinOp(sig, &op, a, b)) {
+        switch (op) {
+            case kAdd : return linearize(a, offset, k, factors, terms, nodes, steps) && linearize(b, offset, k, factors, terms, nodes, steps);
+            case kSub : return linearize(a, offset, k, factors, terms, nodes, steps) && linearize(b, offset, -k, factors, terms, nodes, steps);
+            case kMul :
+                if (isNumber(a, r)) return linearize(b, offset, k * r, factors, terms, nodes, steps);
+                if (isNumber(b, r)) return linearize(a, offset, k * r, factors, terms, nodes, steps);
+                if (isSlowFactor(a)) return linearize(b, offset, k, cons(a, factors), terms, nodes, steps);
+                if (isSlowFactor(b)) return linearize(a, offset, k, cons(b, factors), terms, nodes, steps);
+                return false;
+            case kDiv : return isNumber(b, r) && r != 0 && linearize(a, offset, k / r, factors, terms, nodes, steps);
+            default : return false;
+        }
+    }
+    return false;
+}
+
+/**
+ * The coefficients of sig@first ... sig@last in terms (nil when absent),
+ * false if sig appears with another delay.
+ */
+static bool getTaps(const Terms& terms, Tree sig, int first, int last, Tree taps[3])
+{
+    taps[0] = taps[1] = taps[2] = nil;
+    for (Terms::const_iterator t = terms.begin(); t != terms.end(); t++) {
+        if (t->first.first != sig) continue;
+        if (t->first.second < first || t->first.second > last) return false;
+        taps[t->first.second] = t->second;
+    }
+    return true;
+}
+
+static Tree negateCoef(Tree coef)
+{
+    Tree l = nil;
+    for (; !isNil(coef); coef = tl(coef)) l = cons(cons(tree(-tree2float(hd(hd(coef)))), tl(hd(coef))), l);
+    return l;
+}
+
+/**
+ * The list of factors without one occurrence of f, false if f is not a factor.
+ */
+static bool removeFactor(Tree factors, Tree f, Tree& rest)
+{
+    if (isNil(factors)) return false;
+    if (hd(factors) == f) {
+        rest = tl(factors);
+        return true;
+    }
+    if (!removeFactor(tl(factors), f, rest)) return false;
+    rest = cons(hd(factors), rest);
+    return true;
+}
+
+/**
+ * Extract the factors common to all the monomials of the n coefficients coefs,
+ * the way the DSP code applies them to the whole sum. Returns the gain (a coefficient).
+ */
+static Tree factorCoefs(Tree* coefs, int n)
+{
+    Tree common = nil;
+    Tree first = nil;
+    for (int i = 0; i < n && isNil(first); i++) first = coefs[i];
+    if (!isNil(first)) {
+        for (Tree f = tl(hd(first)); !isNil(f); f = tl(f)) {
+            bool shared = true;
+            Tree rest;
+            for (int i = 0; i < n && shared; i++) {
+                for (Tree m = coefs[i]; !isNil(m) && shared; m = tl(m)) shared = removeFactor(tl(hd(m)), hd(f), rest);
+            }
+            if (!shared) continue;
+            for (int i = 0; i < n; i++) {
+                Tree l = nil;
+                for (Tree m = coefs[i]; !isNil(m); m = tl(m)) {
+                    removeFactor(tl(hd(m)), hd(f), rest);
+                    l = cons(cons(hd(hd(m)), rest), l);
+                }
+                coefs[i] = reverse(l);
+            }
+            common = cons(hd(f), common);
+        }
+    }
+    return cons(cons(tree(1.0), common), nil);
+}
+
+/**
+ * True if all the references to the nodes of a cascade, but to its output sig,
+ * come from the cascade itself.
+ */
+static bool isOwned(Tree sig, const set<Tree>& nodes, map<Tree,int>& parents)
+{
+    map<Tree,int> inside;
+    for (set<Tree>::const_iterator n = nodes.begin(); n != nodes.end(); n++) {
+        vector<Tree> v; getSubSignals(*n, v);
+        set<Tree> children(v.begin(), v.end());
+        for (set<Tree>::iterator c = children.begin(); c != children.end(); c++) {
+            if (nodes.count(*c)) inside[*c]++;
+        }
+    }
+    for (set<Tree>::const_iterator n = nodes.begin(); n != nodes.end(); n++) {
+        if (*n != sig && inside[*n] != parents[*n]) return false;
+    }
+    return true;
+}
+
+/**
+ * Recognize sig as the output of a cascade of at least minSections sections applied
+ * to the audio input x. The coefficients gb b0 b1 b2 ga a1 a2 of the stages, from the input
+ * to the output, are stored in coefs. The last stage is the output one (a1 = a2 = nil).
+ */
+static bool recognize(Tree sig, int minSections, map<Tree,int>& parents, Tree& x, vector<Tree>& coefs)
+{
+    int op, i, steps = 0;
+    Tree a, b, p, rg, var, body;
+    Tree ff[3], fb[3];
+    Terms terms;
+    set<Tree> nodes;
+
+    if (!isSigBinOp(sig, &op, a, b) && !isSection(sig, rg)) return false;
+    // (no recursivness test : the taps of sig are shared with the definitions of the sections)
+    if (getCertifiedSigType(sig)->nature() != kReal || getCertifiedSigType(sig)->variability() != kSamp) return false;
+    if (!linearize(sig, 0, 1.0, nil, terms, nodes, steps)) return false;
+
+    // the output stage
+    p = terms.begin()->first.first;
+    if (!isSection(p, rg) || !getTaps(terms, p, 0, 2, ff)) return false;
+    for (Terms::iterator t = terms.begin(); t != terms.end(); t++) {
+        if (t->first.first != p) return false;
+    }
+    vector<Tree> stages;
+    stages.push_back(nil); stages.push_back(nil);
+    stages.push_back(ff[2]); stages.push_back(ff[1]); stages.push_back(ff[0]);
+
+    // the recursive sections, from the output to the input
+    int sections = 0;
+    while (true) {
+        if (nodes.count(rg)) return false;
+        isRec(rg, var, body);
+        nodes.insert(p); nodes.insert(rg); nodes.insert(body);
+        sections++;
+
+        Terms def;
+        if (!linearize(hd(body), 0, 1.0, nil, def, nodes, steps)) return false;
+        Tree v = 0;
+        for (Terms::iterator t = def.begin(); t != def.end(); t++) {
+            if (t->first.first == p) continue;
+            if (v && v != t->first.first) return false;
+            v = t->first.first;
+        }
+        if (!v || !getTaps(def, p, 1, 2, fb) || !getTaps(def, v, 0, 2, ff)) return false;
+        stages.push_back(negateCoef(fb[2])); stages.push_back(negateCoef(fb[1]));
+        stages.push_back(ff[2]); stages.push_back(ff[1]); stages.push_back(ff[0]);
+
+        if (isSigInput(v, &i)) {
+            x = v;
+            break;
+        }
+        p = v;
+        isSection(p, rg);
+    }
+    if (sections < minSections || !isOwned(sig, nodes, parents)) return false;
+
+    // gb b0 b1 b2 ga a1 a2 of the stages, from the input to the output
+    coefs.clear();
+    for (int s = int(stages.size()) - 5; s >= 0; s -= 5) {
+        Tree c[5] = { stages[s+4], stages[s+3], stages[s+2], stages[s+1], stages[s] };
+        Tree gb = factorCoefs(&c[0], 3);
+        Tree ga = factorCoefs(&c[3], 2);
+        coefs.push_back(gb); coefs.push_back(c[0]); coefs.push_back(c[1]); coefs.push_back(c[2]);
+        coefs.push_back(ga); coefs.push_back(c[3]); coefs.push_back(c[4]);
+    }
+    return true;
+}
+
+static void countParents(Tree sig, map<Tree,int>& parents, set<Tree>& visited)
+{
+    if (!visited.insert(sig).second) return;
+    vector<Tree> v; getSubSignals(sig, v);
+    set<Tree> children(v.begin(), v.end());
+    for (set<Tree>::iterator c = children.begin(); c != children.end(); c++) {
+        parents[*c]++;
+        countParents(*c, parents, visited);
+    }
+}
+
+static void annotate(Tree sig, int minSections, map<Tree,int>& parents, set<Tree>& visited)
+{
+    if (!visited.insert(sig).second) return;
+
+    Tree x;
+    vector<Tree> coefs;
+    if (recognize(sig, minSections, parents, x, coefs)) {
+        Tree l = nil;
+        for (int i = int(coefs.size()) - 1; i >= 0; i--) l = cons(coefs[i], l);
+        setProperty(sig, BIQUADCASCADE, cons(x, l));
+    } else {
+        vector<Tree> v; getSubSignals(sig, v);
+        for (unsigned int i = 0; i < v.size(); i++) annotate(v[i], minSections, parents, visited);
+    }
+}
+
+/**
+ * Annotate the cascades of second order sections of a signal (or list of signals)
+ * that was previously annotated with recursivness and type information.
+ * @param sig signal to annotate
+ * @param minSections minimal number of recursive sections of the cascades
+ */
+void biquadAnnotation(Tree sig, int minSections)
+{
+    map<Tree,int> parents;
+    set<Tree> visited;
+    countParents(sig, parents, visited);
+    visited.clear();
+    annotate(sig, minSections, parents, visited);
+}
+
+/**
+ * True if sig was annotated as the output of a cascade applied to the audio input number input.
+ * coefs holds 7 coefficients per stage : gb b0 b1 b2 ga a1 a2 (see biquad_cascade)
+ */
+bool isBiquadCascade(Tree sig, int& input, vector<Tree>& coefs)
+{
+    Tree prop;
+    if (!getProperty(sig, BIQUADCASCADE, prop) || !isSigInput(hd(prop), &input)) return false;
+    coefs.clear();
+    for (Tree l = tl(prop); !isNil(l); l = tl(l)) coefs.push_back(hd(l));
+    return true;
+}
@@ -0,0 +1,169 @@
+/************************************************************************
+ ************************************************************************
+    FAUST compiler
+	Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ ************************************************************************
+ ************************************************************************/
+#include <map>
+#include <set>
+#include "firdetection.hh"
+#include "recursivness.hh"
+#include "sigtyperules.hh"
+#include "binop.hh"
+
+/**
+ * @file firdetection.cpp
+ * Detect the FIR filters of a (normalized) signal expression : sums of constant
+ * weighted fixed delays of the same signal x, sum(k, c[k].x@k), like the ones
+ * produced by fi.fir or fi.conv. The outermost sum of each FIR filter of at least
+ * minTaps non null coefficients is annotated with x and the coefficients.
+ */
+
+//--------------------------------------------------------------------------
+Tree FIRFILTER = tree(symbol("FIRFilterProp"));
+
+static const int kMaxSteps = 1 << 20;   // bound of the expansion of shared subexpressions
+//--------------------------------------------------------------------------
+
+static bool isNumber(Tree sig, double& r)
+{
+    int i;
+    if (isSigReal(sig, &r)) return true;
+    if (isSigInt(sig, &i)) { r = i; return true; }
+    return false;
+}
+
+/**
+ * The signal a FIR filter candidate is applied to : its leftmost term stripped
+ * of the constant weights and delays.
+ */
+static Tree firInput(Tree sig)
+{
+    int op, d;
+    double r;
+    Tree x, y;
+    if (isSigFixDelay(sig, x, y) && isSigInt(y, &d)) {
+        return firInput(x);
+    } else if (isSigBinOp(sig, &op, x, y)) {
+        if (op == kAdd || op == kSub || (op == kDiv && isNumber(y, r))) return firInput(x);
+        if (op == kMul && isNumber(x, r)) return firInput(y);
+        if (op == kMul && isNumber(y, r)) return firInput(x);
+    }
+    return sig;
+}
+
+/**
+ * Decompose scale.sig@offset as a weighted sum of delayed versions of x,
+ * accumulated in taps (delay -> coefficient).
+ */
+static bool linearize(Tree sig, Tree x, int offset, double scale, map<int, double>& taps, int& steps)
+{
+    int op, d;
+    double r;
+    Tree a, b;
+
+    if (++steps > kMaxSteps) {
+        return false;
+    } else if (sig == x) {
+        taps[offset] += scale;
+        return true;
+    } else if (isSigFixDelay(sig, a, b)) {
+        return isSigInt(b, &d) && d >= 0 && linearize(a, x, offset + d, scale, taps, steps);
+    } else if (isSigBinOp(sig, &op, a, b)) {
+        switch (op) {
+            case kAdd : return linearize(a, x, offset, scale, taps, steps) && linearize(b, x, offset, scale, taps, steps);
+            case kSub : return linearize(a, x, offset, scale, taps, steps) && linearize(b, x, offset, -scale, taps, steps);
+            case kMul :
+                if (isNumber(a, r)) return linearize(b, x, offset, scale * r, taps, steps);
+                if (isNumber(b, r)) return linearize(a, x, offset, scale * r, taps, steps);
+                return false;
+            case kDiv : return isNumber(b, r) && r != 0 && linearize(a, x, offset, scale / r, taps, steps);
+            default : return false;
+        }
+    }
+    return false;
+}
+
+/**
+ * Recognize sig as a FIR filter of at least minTaps taps applied to x.
+ * The filter must be dense enough for the FFT convolution to pay off.
+ */
+static bool recognize(Tree sig, int minTaps, Tree& x, vector<double>& coefs)
+{
+    int op, steps = 0;
+    Tree a, b;
+    map<int, double> taps;
+
+    if (!isSigBinOp(sig, &op, a, b) || (op != kAdd && op != kSub)) return false;
+    if (getCertifiedSigType(sig)->nature() != kReal || getRecursivness(sig) != 0) return false;
+
+    x = firInput(sig);
+    if (getCertifiedSigType(x)->variability() != kSamp || !linearize(sig, x, 0, 1.0, taps, steps)) return false;
+
+    int n = 0;
+    for (map<int, double>::iterator t = taps.begin(); t != taps.end(); t++) {
+        if (t->second != 0) n++;
+    }
+    int length = taps.rbegin()->first + 1;
+    if (n < minTaps || length < 2 || 4 * n < length) return false;
+
+    coefs.assign(length, 0.0);
+    for (map<int, double>::iterator t = taps.begin(); t != taps.end(); t++) coefs[t->first] = t->second;
+    return true;
+}
+
+static void annotate(Tree sig, int minTaps, set<Tree>& visited)
+{
+    if (!visited.insert(sig).second) return;
+
+    Tree x;
+    vector<double> coefs;
+    if (recognize(sig, minTaps, x, coefs)) {
+        Tree l = nil;
+        for (int i = int(coefs.size()) - 1; i >= 0; i--) l = cons(tree(coefs[i]), l);
+        setProperty(sig, FIRFILTER, cons(x, l));
+        annotate(x, minTaps, visited);
+    } else {
+        vector<Tree> v; getSubSignals(sig, v);
+        for (unsigned int i = 0; i < v.size(); i++) annotate(v[i], minTaps, visited);
+    }
+}
+
+/**
+ * Annotate the FIR filters of a signal (or list of signals) that was
+ * previously annotated with recursivness and type information.
+ * @param sig signal to annotate
+ * @param minTaps minimal number of non null coefficients of the filters
+ */
+void firAnnotation(Tree sig, int minTaps)
+{
+    set<Tree> visited;
+    annotate(sig, minTaps, visited);
+}
+
+/**
+ * True if sig was annotated as a FIR filter : sig = sum(k, coefs[k].x@k)
+ */
+bool isFIRFilter(Tree sig, Tree& x, vector<double>& coefs)
+{
+    Tree prop;
+    if (!getProperty(sig, FIRFILTER, prop)) return false;
+    x = hd(prop);
+    coefs.clear();
+    for (Tree l = tl(prop); !isNil(l); l = tl(l)) coefs.push_back(tree2float(hd(l)));
+    return true;
+}
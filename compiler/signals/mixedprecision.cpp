@@ -0,0 +1,333 @@
+/************************************************************************
+ ************************************************************************
+    FAUST compiler
+	Copyright (C) 2003-2017 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ ************************************************************************
+ ************************************************************************/
+#include <map>
+#include <set>
+#include <math.h>
+#include "mixedprecision.hh"
+#include "sigtyperules.hh"
+#include "xtended.hh"
+#include "binop.hh"
+
+/**
+ * @file mixedprecision.cpp
+ * Choose the precision of the signals in mixed precision mode (-mp option).
+ *
+ * The rounding errors of a recursion are amplified by its feedback, roughly by
+ * 1/(1-r) for a pole of radius r. For each recursive group, the feedback taps of
+ * the definitions are decomposed with interval coefficients (given by the types)
+ * to estimate the radius r : the largest pole of a first or second order linear
+ * recursion, a bound of the feedback gain otherwise (the nonlinear operations
+ * counted as a unit gain, the quantizing ones as no gain). The recursions with
+ * r >= kSensitiveRadius, like high Q filters, slow smoothers and phase
+ * accumulators (r = 1), are sensitive : the signals of their feedback loop and
+ * the constant or block rate signals these use (the coefficients) are computed
+ * in double precision, as well as the delays and the arithmetic operations of
+ * double signals. All the other signals stay in single precision.
+ */
+
+//--------------------------------------------------------------------------
+Tree DOUBLEPRECISION = tree(symbol("DoublePrecisionProp"));
+Tree FEEDBACKRADIUS = tree(symbol("FeedbackRadiusProp"));
+
+static const double kSensitiveRadius = 0.99;
+static const int kMaxSteps = 1 << 16;   // bound of the expansion of shared subexpressions
+
+typedef map<pair<int,int>, interval> Feedback;  // (projection, delay) -> coefficient (delay -1 : unknown)
+//--------------------------------------------------------------------------
+
+static bool isTableLike(Tree sig)
+{
+    Tree id, a, b, c;
+    return isSigTable(sig, id, a, b) || isSigWRTbl(sig, id, a, b, c) || isSigGen(sig, a) || isSigWaveform(sig);
+}
+
+/**
+ * True if sig depends on the projections of the recursive group rg (without
+ * looking into the other recursive groups).
+ */
+static bool dependsOn(Tree sig, Tree rg, map<Tree,bool>& deps)
+{
+    map<Tree,bool>::iterator p = deps.find(sig);
+    if (p != deps.end()) return p->second;
+
+    int i;
+    Tree r, var, body;
+    bool d = false;
+    if (isProj(sig, &i, r)) {
+        d = (r == rg);
+    } else if (!isRec(sig, var, body)) {
+        vector<Tree> v; getSubSignals(sig, v, false);
+        for (unsigned int k = 0; k < v.size() && !d; k++) d = dependsOn(v[k], rg, deps);
+    }
+    deps[sig] = d;
+    return d;
+}
+
+static bool isQuantizer(Tree sig)
+{
+    int op;
+    Tree a, b;
+    xtended* p = (xtended*)getUserData(sig);
+    if (p) {
+        string n = p->name();
+        return n == "floor" || n == "ceil" || n == "rint";
+    }
+    return isSigIntCast(sig, a) || (isSigBinOp(sig, &op, a, b) && op >= kGT);
+}
+
+static void addTap(Feedback& fb, int proj, int delay, const interval& k)
+{
+    pair<int,int> key(proj, delay);
+    Feedback::iterator t = fb.find(key);
+    if (t == fb.end()) {
+        fb.insert(make_pair(key, k));
+    } else {
+        t->second = t->second + k;
+    }
+}
+
+/**
+ * Accumulate in fb the feedback taps of k.sig@delay on the projections of rg.
+ * linear is set to false when sig isn't a linear combination of these taps.
+ */
+static void feedback(Tree sig, Tree rg, int delay, const interval& k, Feedback& fb, bool& linear, map<Tree,bool>& deps, int& steps)
+{
+    int op, i, d;
+    Tree a, b, r;
+
+    if (!dependsOn(sig, rg, deps)) {
+        return;                             // an input of the recursion
+    } else if (++steps > kMaxSteps) {
+        linear = false;
+        addTap(fb, 0, -1, interval());
+    } else if (isProj(sig, &i, r)) {
+        addTap(fb, i, delay, k);
+    } else if (isSigDelay1(sig, a)) {
+        feedback(a, rg, (delay < 0) ? -1 : delay + 1, k, fb, linear, deps, steps);
+    } else if (isSigFixDelay(sig, a, b)) {
+        feedback(a, rg, (delay >= 0 && isSigInt(b, &d)) ? delay + d : -1, k, fb, linear, deps, steps);
+    } else if (isSigFloatCast(sig, a)) {
+        feedback(a, rg, delay, k, fb, linear, deps, steps);
+    } else if (isQuantizer(sig)) {
+        linear = false;
+    } else if (isSigBinOp(sig, &op, a, b) && op <= kDiv) {
+        bool da = dependsOn(a, rg, deps), db = dependsOn(b, rg, deps);
+        interval ia = getCertifiedSigType(a)->getInterval(), ib = getCertifiedSigType(b)->getInterval();
+        switch (op) {
+            case kAdd :
+                feedback(a, rg, delay, k, fb, linear, deps, steps);
+                feedback(b, rg, delay, k, fb, linear, deps, steps);
+                break;
+            case kSub :
+                feedback(a, rg, delay, k, fb, linear, deps, steps);
+                feedback(b, rg, delay, interval(0.0) - k, fb, linear, deps, steps);
+                break;
+            case kMul :
+                linear = linear && !(da && db);
+                if (da) feedback(a, rg, delay, k * ib, fb, linear, deps, steps);
+                if (db) feedback(b, rg, delay, k * ia, fb, linear, deps, steps);
+                break;
+            default :
+                // kDiv, the gain of a dependent divisor is unknown
+                linear = linear && !db;
+                if (da) feedback(a, rg, delay, k * (interval(1.0) / ib), fb, linear, deps, steps);
+                if (db) feedback(b, rg, delay, interval(), fb, linear, deps, steps);
+                break;
+        }
+    } else {
+        // other operations : a unit gain on the dependent arguments
+        linear = false;
+        vector<Tree> v; getSubSignals(sig, v, false);
+        for (unsigned int j = 0; j < v.size(); j++) feedback(v[j], rg, delay, k, fb, linear, deps, steps);
+    }
+}
+
+static double magnitude(const interval& i)
+{
+    return (i.valid) ? max(fabs(i.lo), fabs(i.hi)) : HUGE_VAL;
+}
+
+/**
+ * Largest root modulus of z^2 - c1.z - c2, the poles of y = c1.y@1 + c2.y@2 + x
+ */
+static double rootModulus(double c1, double c2)
+{
+    double disc = c1*c1 + 4*c2;
+    if (disc < 0) return sqrt(-c2);
+    return max(fabs(c1 + sqrt(disc)), fabs(c1 - sqrt(disc))) / 2;
+}
+
+/**
+ * Estimated radius of the recursive group rg of definitions body.
+ */
+static double feedbackRadius(Tree rg, Tree body)
+{
+    int n = len(body);
+    double radius = 0;
+    map<Tree,bool> deps;
+
+    for (int i = 0; i < n; i++) {
+        Feedback fb;
+        bool linear = true;
+        int steps = 0;
+        feedback(nth(body, i), rg, 0, interval(1.0), fb, linear, deps, steps);
+
+        double r = 0;
+        Feedback::iterator t1 = fb.find(make_pair(i, 1)), t2 = fb.find(make_pair(i, 2));
+        unsigned int own = (t1 != fb.end()) + (t2 != fb.end());
+        if (linear && n == 1 && own > 0 && own == fb.size()) {
+            // first or second order recursion : the largest pole over the corners of the coefficients
+            interval c1 = (t1 != fb.end()) ? t1->second : interval(0.0);
+            interval c2 = (t2 != fb.end()) ? t2->second : interval(0.0);
+            r = (c1.valid && c2.valid)
+                ? max4(rootModulus(c1.lo, c2.lo), rootModulus(c1.lo, c2.hi), rootModulus(c1.hi, c2.lo), rootModulus(c1.hi, c2.hi))
+                : HUGE_VAL;
+        } else {
+            for (Feedback::iterator t = fb.begin(); t != fb.end(); t++) r += magnitude(t->second);
+        }
+        radius = max(radius, r);
+    }
+    return radius;
+}
+
+static void setDoublePrecision(Tree sig)
+{
+    setProperty(sig, DOUBLEPRECISION, tree(1));
+}
+
+/**
+ * Mark the real constant or block rate signals used by a feedback loop.
+ */
+static void markCoefficients(Tree sig, set<Tree>& visited)
+{
+    int i;
+    Tree var, body, r;
+    if (!visited.insert(sig).second || isTableLike(sig) || isRec(sig, var, body) || isProj(sig, &i, r)) return;
+    Type t = getCertifiedSigType(sig);
+    if (t->variability() == kSamp || t->nature() != kReal) return;
+
+    setDoublePrecision(sig);
+    vector<Tree> v; getSubSignals(sig, v, false);
+    for (unsigned int j = 0; j < v.size(); j++) markCoefficients(v[j], visited);
+}
+
+/**
+ * Mark the signals of the feedback loop of rg and their coefficients.
+ */
+static void markLoop(Tree sig, Tree rg, map<Tree,bool>& deps, set<Tree>& visited, set<Tree>& coefs)
+{
+    int i;
+    Tree r;
+    if (!visited.insert(sig).second) return;
+    if (!isTableLike(sig)) setDoublePrecision(sig);
+    if (isProj(sig, &i, r)) return;
+
+    vector<Tree> v; getSubSignals(sig, v, false);
+    for (unsigned int j = 0; j < v.size(); j++) {
+        if (dependsOn(v[j], rg, deps)) {
+            markLoop(v[j], rg, deps, visited, coefs);
+        } else if (!isTableLike(sig)) {
+            markCoefficients(v[j], coefs);
+        }
+    }
+}
+
+static void annotateRecursions(Tree sig, set<Tree>& visited, set<Tree>& coefs)
+{
+    Tree var, body;
+    if (!visited.insert(sig).second) return;
+
+    if (isRec(sig, var, body)) {
+        double radius = feedbackRadius(sig, body);
+        setProperty(sig, FEEDBACKRADIUS, tree(radius));
+        if (radius >= kSensitiveRadius) {
+            map<Tree,bool> deps;
+            set<Tree> loop;
+            for (int i = 0; i < len(body); i++) {
+                setDoublePrecision(sigProj(i, sig));
+                if (dependsOn(nth(body, i), sig, deps)) markLoop(nth(body, i), sig, deps, loop, coefs);
+            }
+        }
+    }
+    vector<Tree> v; getSubSignals(sig, v, false);
+    for (unsigned int i = 0; i < v.size(); i++) annotateRecursions(v[i], visited, coefs);
+}
+
+/**
+ * Extend the double precision signals to their delays and to the arithmetic
+ * operations that only combine them with constant or block rate signals : a
+ * conversion to single precision costs more than these operations, and it would
+ * lose the precision between two sensitive recursions of a cascade.
+ */
+static void annotateForward(Tree sig, set<Tree>& visited, set<Tree>& coefs)
+{
+    int op;
+    Tree x, y;
+    if (!visited.insert(sig).second) return;
+
+    vector<Tree> v; getSubSignals(sig, v, false);
+    for (unsigned int i = 0; i < v.size(); i++) annotateForward(v[i], visited, coefs);
+
+    if ((isSigFixDelay(sig, x, y) || isSigDelay1(sig, x)) && isDoublePrecision(x)) {
+        setDoublePrecision(sig);
+    } else if (isSigBinOp(sig, &op, x, y) && op <= kDiv && getCertifiedSigType(sig)->nature() == kReal
+               && (isDoublePrecision(x) || isDoublePrecision(y))) {
+        Tree slow = isDoublePrecision(x) ? y : x;
+        if (isDoublePrecision(slow) || getCertifiedSigType(slow)->variability() < kSamp) {
+            setDoublePrecision(sig);
+            markCoefficients(slow, coefs);
+        }
+    }
+}
+
+/**
+ * Annotate the signals of a signal (or list of signals), previously annotated
+ * with type information, that must be computed in double precision, and the
+ * recursive groups with their estimated feedback radius.
+ * @param sig signal to annotate
+ */
+void precisionAnnotation(Tree sig)
+{
+    set<Tree> visited, coefs;
+    annotateRecursions(sig, visited, coefs);
+    visited.clear();
+    annotateForward(sig, visited, coefs);
+}
+
+/**
+ * True if sig was annotated to be computed in double precision.
+ */
+bool isDoublePrecision(Tree sig)
+{
+    Tree p;
+    return getProperty(sig, DOUBLEPRECISION, p);
+}
+
+/**
+ * The estimated feedback radius of a recursive group (HUGE_VAL if unbounded).
+ */
+bool getFeedbackRadius(Tree rg, double& radius)
+{
+    Tree p;
+    if (!getProperty(rg, FEEDBACKRADIUS, p)) return false;
+    radius = tree2float(p);
+    return true;
+}
@@ -259,11 +259,14 @@ Tree reverseall (Tree l)
 // Sets : implemented as ordered list
 //------------------------------------------------------------------------------
 
+// the elements are ordered like in the sets of trees, by creation order (see std::less<CTree*>)
+static inline bool before(Tree a, Tree b) { return less<Tree>()(a, b); }
+
 bool isElement (Tree e, Tree l)
 {
 	while (isList(l)) {
 		if (hd(l) == e) return true;
-		if (hd(l) > e) return false;
+		if (before(e, hd(l))) return false;
 		l = tl(l);
 	}
 	return false;
@@ -272,7 +275,7 @@ bool isElement (Tree e, Tree l)
 Tree addElement(Tree e, Tree l)
 {
 	if (isList(l)) {
-		if (e < hd(l)) {
+		if (before(e, hd(l))) {
 			return cons(e,l);
 		} else if (e == hd(l)) {
 			return l;
@@ -287,7 +290,7 @@ Tree addElement(Tree e, Tree l)
 Tree remElement(Tree e, Tree l)
 {
 	if (isList(l)) {
-		if (e < hd(l)) {
+		if (before(e, hd(l))) {
 			return l;
 		} else if (e == hd(l)) {
 			return tl(l);
@@ -320,7 +323,7 @@ Tree setUnion (Tree A, Tree B)
 	if (isNil(B)) 		return A;
 	
 	if (hd(A) == hd(B)) return cons(hd(A), setUnion(tl(A),tl(B)));
-	if (hd(A) < hd(B)) 	return cons(hd(A), setUnion(tl(A),B));
+	if (before(hd(A), hd(B))) 	return cons(hd(A), setUnion(tl(A),B));
 	/* hd(A) > hd(B) */	return cons(hd(B), setUnion(A,tl(B)));
 }
 
@@ -329,7 +332,7 @@ Tree setIntersection (Tree A, Tree B)
 	if (isNil(A)) 		return A;
 	if (isNil(B)) 		return B;
 	if (hd(A) == hd(B)) return cons(hd(A), setIntersection(tl(A),tl(B)));
-	if (hd(A) < hd(B)) 	return setIntersection(tl(A),B);
+	if (before(hd(A), hd(B))) 	return setIntersection(tl(A),B);
 	/* (hd(A) > hd(B)*/	return setIntersection(A,tl(B));
 }
 
@@ -338,7 +341,7 @@ Tree setDifference (Tree A, Tree B)
 	if (isNil(A)) 		return A;
 	if (isNil(B)) 		return A;
 	if (hd(A) == hd(B)) return setDifference(tl(A),tl(B));
-	if (hd(A) < hd(B)) 	return cons(hd(A), setDifference(tl(A),B));
+	if (before(hd(A), hd(B))) 	return cons(hd(A), setDifference(tl(A),B));
 	/* (hd(A) > hd(B)*/	return setDifference(A,tl(B));
 }
 	
@@ -82,6 +82,7 @@ storage of trees.
 #include "tree.hh"
 #include <fstream>
 #include <cstdlib>
+#include <unordered_map>
 
 Tabber TABBER(1);	
 extern Tabber TABBER;
@@ -99,6 +100,27 @@ static void error(const char * s, Tree t)
 Tree CTree::gHashTable[kHashTableSize];
 bool CTree::gDetails = false;
 unsigned int  CTree::gVisitTime = 0;
+unsigned long CTree::gLiveCount = 0;
+unsigned long CTree::gHashConsHits = 0;
+unsigned long CTree::gHashConsMisses = 0;
+unsigned long CTree::gPropertyLookups = 0;
+tvec CTree::gProtectedTrees;
+unsigned long CTree::gSerialCount = 0;
+
+// the serial numbers of the collected trees, by fingerprint of their content
+static unordered_map<unsigned long long, unsigned long> gCollectedSerials;
+
+/**
+ * Fingerprint of the content of a tree, from its node and the serial numbers of its branches
+ */
+static unsigned long long fingerprint(const Node& n, const tvec& br)
+{
+	unsigned long long f = (unsigned long long)n.type() * 0x9E3779B97F4A7C15ULL ^ (unsigned long long)(uintptr_t)n.getPointer();
+	for (tvec::const_iterator b = br.begin(); b != br.end(); b++) {
+		f = (f ^ (f >> 29)) * 0xBF58476D1CE4E5B9ULL + (*b)->serial();
+	}
+	return f;
+}
 
 // Constructor : add the tree to the hash table
 CTree::CTree (unsigned int hk, const Node& n, const tvec& br) 
@@ -113,6 +135,16 @@ CTree::CTree (unsigned int hk, const Node& n, const tvec& br)
    	int j = hk % kHashTableSize;
 	fNext = gHashTable[j];
 	gHashTable[j] = this;
+	gLiveCount++;
+
+	// a tree made again after its collection keeps its place in the creation order
+	unordered_map<unsigned long long, unsigned long>::iterator c;
+	if (!gCollectedSerials.empty() && (c = gCollectedSerials.find(fingerprint(n, br))) != gCollectedSerials.end()) {
+		fSerial = c->second;
+		gCollectedSerials.erase(c);
+	} else {
+		fSerial = gSerialCount++;
+	}
 
 }
 
@@ -123,6 +155,7 @@ CTree::~CTree ()
 	Tree	t = gHashTable[i];
 	
 	//printf("Delete of "); this->print(); printf("\n");
+	gLiveCount--;
 	if (t == this) {
 		gHashTable[i] = fNext;
 	} else {
@@ -172,7 +205,12 @@ Tree CTree::make(const Node& n, int ar, Tree* tbl)
 	while (t && !t->equiv(n, br)) {
 		t = t->fNext;
 	}
-	return (t) ? t : new CTree(hk, n, br);
+	if (t) {
+		gHashConsHits++;
+		return t;
+	}
+	gHashConsMisses++;
+	return new CTree(hk, n, br);
 }
 
 
@@ -184,7 +222,82 @@ Tree CTree::make(const Node& n, const tvec& br)
 	while (t && !t->equiv(n, br)) {
 		t = t->fNext;
 	}
-	return (t) ? t : new CTree(hk, n, br);
+	if (t) {
+		gHashConsHits++;
+		return t;
+	}
+	gHashConsMisses++;
+	return new CTree(hk, n, br);
+}
+
+/**
+ * Protect all the trees currently allocated against collect(). Used at the
+ * beginning of the compilation to keep the trees created by the static
+ * initializations (property keys, nil, etc.) that are referenced by global variables.
+ */
+void CTree::protectAll()
+{
+	for (int i = 0; i < kHashTableSize; i++) {
+		for (Tree t = gHashTable[i]; t; t = t->fNext) {
+			gProtectedTrees.push_back(t);
+		}
+	}
+}
+
+/**
+ * Mark and sweep collection of the hash-consing table. The trees reachable from
+ * the roots, the protected trees and the trees carrying a type (used to memoize the
+ * audio types), by their branches or by their properties (keys and values), are kept.
+ * All the other trees are deleted with their properties. The pointers to deleted trees
+ * held elsewhere (global variables, C++ containers) become invalid. The serial numbers of
+ * the deleted trees are kept, to give them back to the same trees if they are made again :
+ * the trees are then ordered as if nothing was collected.
+ */
+unsigned long CTree::collect(const tvec& roots)
+{
+	tvec	stack(roots);
+	stack.insert(stack.end(), gProtectedTrees.begin(), gProtectedTrees.end());
+	for (int i = 0; i < kHashTableSize; i++) {
+		for (Tree t = gHashTable[i]; t; t = t->fNext) {
+			if (t->fType) stack.push_back(t);
+		}
+	}
+
+	// mark, with an explicit stack since trees can be very deep
+	startNewVisit();
+	while (!stack.empty()) {
+		Tree t = stack.back();
+		stack.pop_back();
+		if (!t || t->isAlreadyVisited()) continue;
+		t->setVisited();
+		stack.insert(stack.end(), t->fBranch.begin(), t->fBranch.end());
+		for (plist::iterator p = t->fProperties.begin(); p != t->fProperties.end(); p++) {
+			stack.push_back(p->first);
+			stack.push_back(p->second);
+		}
+	}
+
+	// keep the serial numbers, before the branches are deleted
+	for (int i = 0; i < kHashTableSize; i++) {
+		for (Tree t = gHashTable[i]; t; t = t->fNext) {
+			if (!t->isAlreadyVisited()) gCollectedSerials[fingerprint(t->fNode, t->fBranch)] = t->fSerial;
+		}
+	}
+
+	// sweep, the destructor removes the tree from its hash table entry
+	unsigned long	collected = 0;
+	for (int i = 0; i < kHashTableSize; i++) {
+		Tree t = gHashTable[i];
+		while (t) {
+			Tree next = t->fNext;
+			if (!t->isAlreadyVisited()) {
+				delete t;
+				collected++;
+			}
+			t = next;
+		}
+	}
+	return collected;
 }
 
 ostream& CTree::print (ostream& fout) const
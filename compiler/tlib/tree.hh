@@ -86,6 +86,17 @@
 class 	CTree;
 typedef CTree* Tree;
 
+/**
+ * The sets and maps of trees are ordered by the creation order of the trees (see CTree::serial())
+ * instead of their addresses, so that the generated code does not depend on the allocator, and
+ * is the same with and without the collection of the trees (-gc).
+ */
+namespace std {
+	template <> struct less<CTree*> {
+		bool operator() (CTree* a, CTree* b) const;
+	};
+}
+
 typedef map<Tree, Tree>	plist;
 typedef vector<Tree>	tvec;
 
@@ -103,7 +114,10 @@ typedef vector<Tree>	tvec;
  * a deBruijn representation and progressively build a classical representation such that
  * alpha-equivalent recursive CTrees are necesseraly identical (and therefore shared).
  *
- * WARNING : in the current implementation CTrees are allocated but never deleted
+ * CTrees are never deleted individually. Instead collect() can be used between two phases of the
+ * compiler to delete all the trees (and their properties) that are no longer reachable from a set of roots.
+ * It is the responsability of the caller to give as roots all the trees that will still be used
+ * (see CTree::collect())
  **/
 
 class CTree
@@ -116,6 +130,16 @@ class CTree
 	static bool			gDetails;					///< Ctree::print() print with more details when true
     static unsigned int gVisitTime;                 ///< Should be incremented for each new visit to keep track of visited tree.
 
+	// statistics (see timing.cpp)
+	static unsigned long	gLiveCount;					///< number of trees currently allocated
+	static unsigned long	gHashConsHits;				///< calls to make() returning an existing tree
+	static unsigned long	gHashConsMisses;			///< calls to make() allocating a new tree
+	static unsigned long	gPropertyLookups;			///< calls to getProperty()
+
+	// memory reclamation
+	static tvec			gProtectedTrees;			///< trees that are never collected
+	static unsigned long	gSerialCount;				///< number of serial numbers given to the trees
+
  private:
 	// fields
     Tree            fNext;				///< next tree in the same hashtable entry
@@ -126,6 +150,7 @@ class CTree
     int             fAperture;			///< how "open" is a tree (synthezised field)
     unsigned int	fVisitTime;			///< keep track of visits
     tvec            fBranch;			///< the subtrees
+    unsigned long   fSerial;			///< creation order, a collected tree gets the same serial when it is made again
 
 	CTree (unsigned int hk, const Node& n, const tvec& br); 						///< construction is private, uses tree::make instead
 
@@ -139,12 +164,16 @@ class CTree
 	static Tree make (const Node& n, int ar, Tree br[]);		///< return a new tree or an existing equivalent one
 	static Tree make(const Node& n, const tvec& br);			///< return a new tree or an existing equivalent one
 
+	static void protectAll();									///< the trees currently allocated will never be collected
+	static unsigned long collect(const tvec& roots);			///< delete the trees not reachable from roots, return the number of deleted trees
+
  	// Accessors
  	const Node& node() const		{ return fNode; 		}	///< return the content of the tree
  	int 		arity() const		{ return (int)fBranch.size();}	///< return the number of branches (subtrees) of a tree
     Tree 		branch(int i) const	{ return fBranch[i];	}	///< return the ith branch (subtree) of a tree
     const tvec& branches() const	{ return fBranch;	}       ///< return all branches (subtrees) of a tree
     unsigned int 		hashkey() const		{ return fHashKey; 		}	///< return the hashkey of the tree
+    unsigned long 		serial() const		{ return fSerial; 		}	///< return the creation order of the tree
  	int 		aperture() const	{ return fAperture; 	}	///< return how "open" is a tree in terms of free variables
  	void 		setAperture(int a) 	{ fAperture=a; 			}	///< modify the aperture of a tree
 
@@ -171,6 +200,7 @@ class CTree
 	void		exportProperties(vector<Tree>& keys, vector<Tree>& values);
 
 	Tree		getProperty(Tree key) {
+		gPropertyLookups++;
 		plist::iterator i = fProperties.find(key);
 		if (i==fProperties.end()) {
 			return 0;
@@ -180,6 +210,12 @@ class CTree
 	}
 };
 
+inline bool std::less<CTree*>::operator() (CTree* a, CTree* b) const
+{
+	if (!a || !b) return !a && b;
+	return (a->serial() < b->serial()) || (a->serial() == b->serial() && a < b);
+}
+
 //---------------------------------API---------------------------------------
 
 // to build trees
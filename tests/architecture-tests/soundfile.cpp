@@ -0,0 +1,131 @@
+/*
+  Streaming soundfile reader test: reads memory-mapped (16 bits) and streamed (8 bits) WAV files
+  with the SOUNDFILE_STREAMING reader of faust/sound-file.h and checks the read values, the
+  locked window of the mapped file and the backward jumps (see README).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <vector>
+
+#define SOUNDFILE_STREAMING
+#include "faust/sound-file.h"
+
+#define kFrames     1000000
+#define kChannels   2
+
+static int gErrors = 0;
+
+static void check(bool cond, const char* what, const char* file)
+{
+    if (!cond) {
+        printf("FAILED: %s (%s)\n", what, file);
+        gErrors++;
+    }
+}
+
+static void writeLE(FILE* file, unsigned int value, int bytes)
+{
+    for (int i = 0; i < bytes; i++) fputc((value >> (8 * i)) & 0xFF, file);
+}
+
+static int sample(int frame, int chan, int bits)
+{
+    return (bits == 16) ? ((frame * 7 + chan * 1000) % 30000) - 15000 : ((frame * 3 + chan * 50) % 250) + 3;
+}
+
+static double expected(int frame, int chan, int bits)
+{
+    // 8 bits samples are unsigned
+    return (bits == 16) ? sample(frame, chan, bits) / 32768.0 : (sample(frame, chan, bits) - 128) / 128.0;
+}
+
+static void writeWAV(const char* name, int bits)
+{
+    FILE* file = fopen(name, "wb");
+    int bytes = bits / 8;
+    unsigned int data = kFrames * kChannels * bytes;
+    fwrite("RIFF", 1, 4, file); writeLE(file, 36 + data, 4); fwrite("WAVE", 1, 4, file);
+    fwrite("fmt ", 1, 4, file); writeLE(file, 16, 4);
+    writeLE(file, 1, 2); writeLE(file, kChannels, 2); writeLE(file, 44100, 4);
+    writeLE(file, 44100 * kChannels * bytes, 4); writeLE(file, kChannels * bytes, 2); writeLE(file, bits, 2);
+    fwrite("data", 1, 4, file); writeLE(file, data, 4);
+    for (int frame = 0; frame < kFrames; frame++) {
+        for (int chan = 0; chan < kChannels; chan++) writeLE(file, sample(frame, chan, bits), bytes);
+    }
+    fclose(file);
+}
+
+// Reads a frame, waiting for the reader thread when it is outside of the available window
+static bool readFrame(SoundFileReader* reader, int frame, int bits)
+{
+    for (int tries = 0; tries < 2000; tries++) {
+        bool ok = true;
+        for (int chan = 0; chan < kChannels; chan++) {
+            ok &= (fabs(sampleSFR(reader, chan, frame) - expected(frame, chan, bits)) < 1e-6);
+        }
+        if (ok) return true;
+        usleep(1000);
+    }
+    return false;
+}
+
+// All the pages of the locked window are in memory
+static bool resident(SoundFileReader* reader)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)(reader->fData + reader->fMapBegin * reader->fFrameBytes) & ~(uintptr_t)(page - 1);
+    uintptr_t end = (uintptr_t)(reader->fData + reader->fMapEnd * reader->fFrameBytes);
+    std::vector<unsigned char> pages((end - begin + page - 1) / page);
+    if (pages.empty() || mincore((void*)begin, end - begin, &pages[0]) != 0) return false;
+    for (size_t i = 0; i < pages.size(); i++) {
+        if (!(pages[i] & 1)) return false;
+    }
+    return true;
+}
+
+static void test(const char* name, int bits)
+{
+    writeWAV(name, bits);
+    SoundFileReader* reader = createSFR(name);
+    check(reader != NULL, "open", name);
+    if (!reader) return;
+    check(sizeSFR(reader) == kFrames && channelsSFR(reader) == kChannels, "size and channels", name);
+    check((bits == 16) == (reader->fMap != NULL), "memory-mapped", name);
+
+    // Sequential reading, with an interpolating reader going back one frame
+    bool ok = true;
+    for (int frame = 0; frame < kFrames && ok; frame++) {
+        ok = readFrame(reader, frame, bits) && (frame == 0 || readFrame(reader, frame - 1, bits));
+    }
+    check(ok, "sequential read", name);
+
+    if (reader->fMap) {
+        check(reader->fMapBegin > 0 && reader->fMapEnd - reader->fMapBegin <= 2 * SOUNDFILE_PREFETCH_FRAMES, "bounded window", name);
+        check(resident(reader), "window in memory", name);
+    }
+
+    // Backward jump
+    check(readFrame(reader, 10, bits) && readFrame(reader, 11, bits), "backward jump", name);
+    if (reader->fMap) check(reader->fMapBegin == 0, "window moved back", name);
+
+    // Out of range reads
+    check(sampleSFR(reader, 0, -1) == 0 && sampleSFR(reader, 0, kFrames) == 0, "out of range", name);
+
+    destroySFR(reader);
+    unlink(name);
+}
+
+int main(int argc, char* argv[])
+{
+    test("soundfile16.wav", 16);
+    test("soundfile8.wav", 8);
+    check(createSFR("nofile.wav") == NULL, "missing file", "nofile.wav");
+
+    printf("%s\n", (gErrors == 0) ? "OK" : "FAILED");
+    return (gErrors == 0) ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+/*
+  Biquad cascade test: compares the output of biquad_cascade with the sample by
+  sample computation of the same sections, for several block sizes (see README).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "faust/dsp/biquad-cascade.h"
+
+#define STAGES 6
+
+static int gErrors = 0;
+
+static void check(bool cond, const char* what, int blocksize)
+{
+    if (!cond) {
+        printf("FAILED: %s (blocks of %d samples)\n", what, blocksize);
+        gErrors++;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // 5 resonant sections and an output stage without feedback
+    double coefs[STAGES+1][5];
+    for (int s = 1; s <= STAGES; s++) {
+        double r = 0.9 + 0.015 * s, theta = 0.1 * s;
+        coefs[s][0] = 0.1 * s;
+        coefs[s][1] = -0.2;
+        coefs[s][2] = 0.05;
+        coefs[s][3] = (s < STAGES) ? -2 * r * cos(theta) : 0;
+        coefs[s][4] = (s < STAGES) ? r * r : 0;
+    }
+    int blocks[] = { 1, 2, STAGES, STAGES+1, 64, 1000 };
+
+    for (int b = 0; b < 6; b++) {
+        biquad_cascade<double, STAGES> casc;
+        for (int s = 1; s <= STAGES; s++) {
+            casc.setStage(s, coefs[s][0], coefs[s][1], coefs[s][2], coefs[s][3], coefs[s][4]);
+        }
+
+        // Zero latency, the same output after a clear(), by blocks or read by chunks (every sample or one of three)
+        const char* passes[] = { "cascade", "cascade after clear", "cascade read by chunks", "cascade partly read" };
+        for (int pass = 0; pass < 4; pass++) {
+            double w[STAGES+1][3] = {{0}};
+            double err = 0;
+            int n = 0;
+            while (n < 10000) {
+                int count = std::min(blocks[b], 10000 - n);
+                std::vector<float> x(count);
+                std::vector<double> y(count);
+                for (int i = 0; i < count; i++) x[i] = rand() / float(RAND_MAX) - 0.5f;
+                if (pass < 2) {
+                    casc.compute(count, &x[0], &y[0]);
+                } else {
+                    casc.start(count, &x[0]);
+                    for (int i = 0; i < count; i++) {
+                        if (pass == 2 || i % 3 == 0) y[i] = casc.sample(i);
+                    }
+                    casc.finish();
+                }
+                for (int i = 0; i < count; i++) {
+                    double v = x[i];
+                    for (int s = 0; s <= STAGES; s++) {
+                        if (s > 0) {
+                            v = coefs[s][0] * w[s-1][0] + coefs[s][1] * w[s-1][1] + coefs[s][2] * w[s-1][2]
+                                - coefs[s][3] * w[s][0] - coefs[s][4] * w[s][1];
+                        }
+                        w[s][2] = w[s][1];
+                        w[s][1] = w[s][0];
+                        w[s][0] = v;
+                    }
+                    if (pass < 3 || i % 3 == 0) err = std::max(err, fabs(v - y[i]));
+                }
+                n += count;
+            }
+            check(err < 1e-10, passes[pass], blocks[b]);
+            casc.clear();
+        }
+    }
+
+    printf("%s\n", (gErrors == 0) ? "OK" : "FAILED");
+    return (gErrors == 0) ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+/*
+  Threaded combiner test: computes the same parallelizer/sequencer tree with the sequential
+  and the threaded combiners, on pools of several sizes, and compares their outputs (see README).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "faust/dsp/dsp-threaded-combiner.h"
+
+// One pole filter, the state makes the output depend on the order of the blocks
+class onepole : public dsp {
+
+    public:
+
+        float fPole;
+        float fState;
+        int fSampleRate;
+
+        onepole(float pole):fPole(pole), fState(0.f), fSampleRate(0) {}
+
+        virtual int getNumInputs() { return 1; }
+        virtual int getNumOutputs() { return 1; }
+        virtual void buildUserInterface(UI* ui_interface) {}
+        virtual int getSampleRate() { return fSampleRate; }
+        virtual void init(int samplingRate) { instanceInit(samplingRate); }
+        virtual void instanceInit(int samplingRate) { fSampleRate = samplingRate; instanceClear(); }
+        virtual void instanceConstants(int samplingRate) {}
+        virtual void instanceResetUserInterface() {}
+        virtual void instanceClear() { fState = 0.f; }
+        virtual dsp* clone() { return new onepole(fPole); }
+        virtual void metadata(Meta* m) {}
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            for (int i = 0; i < count; i++) {
+                fState = fPole * fState + inputs[0][i];
+                outputs[0][i] = fState;
+            }
+        }
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            compute(count, inputs, outputs);
+        }
+};
+
+static int gErrors = 0;
+
+static void check(bool cond, const char* what, int workers)
+{
+    if (!cond) {
+        printf("FAILED: %s (%d workers)\n", what, workers);
+        gErrors++;
+    }
+}
+
+static dsp* parallelize(dsp* dsp1, dsp* dsp2, dsp_thread_pool* pool)
+{
+    return (pool) ? new dsp_threaded_parallelizer(dsp1, dsp2, pool) : new dsp_parallelizer(dsp1, dsp2);
+}
+
+// (p1 : p2), ((p3 : p4), p5), ((p6, p7) : (p8, p9)) : 5 inputs and 5 outputs
+static dsp* tree(dsp_thread_pool* pool)
+{
+    dsp* branch1 = new dsp_sequencer(new onepole(0.5f), new onepole(0.9f));
+    dsp* branch2 = parallelize(new dsp_sequencer(new onepole(0.3f), new onepole(0.7f)), new onepole(0.1f), pool);
+    dsp* branch3 = new dsp_sequencer(parallelize(new onepole(0.2f), new onepole(0.4f), pool),
+                                     parallelize(new onepole(0.6f), new onepole(0.8f), pool));
+    return parallelize(branch1, parallelize(branch2, branch3, pool), pool);
+}
+
+struct buffers {
+
+    int fChannels;
+    int fCount;
+    std::vector<std::vector<FAUSTFLOAT> > fData;
+    std::vector<FAUSTFLOAT*> fChans;
+
+    buffers(int channels, int count):fChannels(channels), fCount(count), fData(channels, std::vector<FAUSTFLOAT>(count)), fChans(channels)
+    {
+        for (int i = 0; i < channels; i++) fChans[i] = &fData[i][0];
+    }
+
+    void noise()
+    {
+        for (int i = 0; i < fChannels; i++) {
+            for (int j = 0; j < fCount; j++) fData[i][j] = rand() / FAUSTFLOAT(RAND_MAX) - 0.5f;
+        }
+    }
+
+    bool equals(const buffers& b) const { return fData == b.fData; }
+    bool silent() const
+    {
+        for (int i = 0; i < fChannels; i++) {
+            for (int j = 0; j < fCount; j++) if (fData[i][j] != 0) return false;
+        }
+        return true;
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    const int count = 256;
+    int workers[] = { 0, 1, 3 };
+
+    for (int w = 0; w < 3; w++) {
+        dsp_thread_pool pool(workers[w]);
+        check(pool.getNumWorkers() == workers[w], "workers", workers[w]);
+
+        // Same outputs as the sequential parallelizer
+        dsp* ref = tree(NULL);
+        dsp* threaded = tree(&pool);
+        ref->init(48000);
+        threaded->init(48000);
+        check(threaded->getNumInputs() == 5 && threaded->getNumOutputs() == 5, "channels", workers[w]);
+        buffers in(5, count), out1(5, count), out2(5, count);
+        bool same = true;
+        for (int block = 0; block < 200; block++) {
+            in.noise();
+            ref->compute(count, &in.fChans[0], &out1.fChans[0]);
+            threaded->compute(count, &in.fChans[0], &out2.fChans[0]);
+            same &= out1.equals(out2);
+        }
+        check(same, "threaded parallelizer", workers[w]);
+        delete ref;
+        delete threaded;
+
+        // Pipelined sequencer : the output of the sequential one delayed by one block
+        dsp* seq_ref = new dsp_sequencer(new dsp_parallelizer(new onepole(0.5f), new onepole(0.25f)), new dsp_parallelizer(new onepole(0.9f), new onepole(0.75f)));
+        dsp* pipe = new dsp_pipelined_sequencer(parallelize(new onepole(0.5f), new onepole(0.25f), &pool),
+                                                parallelize(new onepole(0.9f), new onepole(0.75f), &pool), &pool);
+        seq_ref->init(48000);
+        pipe->init(48000);
+        buffers in2(2, count), prev(2, count), cur(2, count), piped(2, count);
+        bool delayed = true;
+        for (int block = 0; block < 200; block++) {
+            in2.noise();
+            seq_ref->compute(count, &in2.fChans[0], &cur.fChans[0]);
+            pipe->compute(count, &in2.fChans[0], &piped.fChans[0]);
+            delayed &= (block == 0) ? piped.silent() : piped.equals(prev);
+            prev.fData = cur.fData;
+        }
+        check(delayed, "pipelined sequencer", workers[w]);
+
+        // A block size change restarts the pipeline with one silent block
+        buffers in3(2, count / 2), out3(2, count / 2);
+        in3.noise();
+        pipe->compute(count / 2, &in3.fChans[0], &out3.fChans[0]);
+        check(out3.silent(), "pipeline restart", workers[w]);
+        delete seq_ref;
+        delete pipe;
+    }
+
+    printf("%s\n", (gErrors == 0) ? "OK" : "FAILED");
+    return (gErrors == 0) ? 0 : 1;
+}
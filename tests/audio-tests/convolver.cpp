@@ -0,0 +1,53 @@
+/*
+  FFT convolver test: compares the output of fft_convolver with the direct form
+  convolution for several impulse response sizes and block sizes (see README).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "faust/dsp/fft-convolver.h"
+
+static int gErrors = 0;
+
+static void check(bool cond, const char* what, int taps)
+{
+    if (!cond) {
+        printf("FAILED: %s (%d taps)\n", what, taps);
+        gErrors++;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int sizes[] = { 1, 5, 16, 17, 100, 1000, 4096 };
+    int blocks[] = { 0, 16, 64 };
+
+    for (int s = 0; s < 7; s++) {
+        for (int b = 0; b < 3; b++) {
+            int taps = sizes[s];
+            std::vector<double> h(taps), x(10000);
+            for (int i = 0; i < taps; i++) h[i] = rand() / double(RAND_MAX) - 0.5;
+            for (int i = 0; i < 10000; i++) x[i] = rand() / double(RAND_MAX) - 0.5;
+
+            fft_convolver conv;
+            conv.init(&h[0], taps, blocks[b]);
+
+            // Zero latency, the same output after a clear()
+            for (int pass = 0; pass < 2; pass++) {
+                double err = 0;
+                for (int n = 0; n < 10000; n++) {
+                    double y = 0;
+                    for (int k = 0; k < taps && k <= n; k++) y += h[k] * x[n-k];
+                    err = std::max(err, fabs(y - conv.compute(x[n])));
+                }
+                check(err < 1e-10, (pass == 0) ? "convolution" : "convolution after clear", taps);
+                conv.clear();
+            }
+        }
+    }
+
+    printf("%s\n", (gErrors == 0) ? "OK" : "FAILED");
+    return (gErrors == 0) ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+/*
+  DSP graph test: checks the compute order of the steps, the number of internal buffers
+  and the outputs of dsp_graph against the same expression built with dsp_sequencer
+  and dsp_parallelizer (see README).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "faust/dsp/dsp-graph.h"
+#include "faust/dsp/dsp-combiner.h"
+
+static std::string gOrder;
+
+// One pole filter with 'ins' inputs summed on 'outs' outputs, logging its name when computed
+class onepole : public dsp {
+
+    public:
+
+        char fName;
+        float fPole;
+        int fInputs;
+        int fOutputs;
+        float fState;
+        int fSampleRate;
+
+        onepole(char name, float pole, int ins = 1, int outs = 1)
+            :fName(name), fPole(pole), fInputs(ins), fOutputs(outs), fState(0.f), fSampleRate(0)
+        {}
+
+        virtual int getNumInputs() { return fInputs; }
+        virtual int getNumOutputs() { return fOutputs; }
+        virtual void buildUserInterface(UI* ui_interface) {}
+        virtual int getSampleRate() { return fSampleRate; }
+        virtual void init(int samplingRate) { instanceInit(samplingRate); }
+        virtual void instanceInit(int samplingRate) { fSampleRate = samplingRate; instanceClear(); }
+        virtual void instanceConstants(int samplingRate) {}
+        virtual void instanceResetUserInterface() {}
+        virtual void instanceClear() { fState = 0.f; }
+        virtual dsp* clone() { return new onepole(fName, fPole, fInputs, fOutputs); }
+        virtual void metadata(Meta* m) {}
+        // Works in place: each sample of the inputs is read before the outputs are written
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            gOrder += fName;
+            for (int i = 0; i < count; i++) {
+                float in = 0.f;
+                for (int c = 0; c < fInputs; c++) in += inputs[c][i];
+                fState = fPole * fState + in;
+                for (int c = 0; c < fOutputs; c++) outputs[c][i] = fState * float(c + 1);
+            }
+        }
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            compute(count, inputs, outputs);
+        }
+};
+
+static int gErrors = 0;
+
+static void check(bool cond, const char* what)
+{
+    if (!cond) {
+        printf("FAILED: %s\n", what);
+        gErrors++;
+    }
+}
+
+// (a : b : c : d)
+static dsp_graph_node* chain(bool inplace)
+{
+    return graphSequence(graphSequence(graphDSP(new onepole('a', 0.1f), inplace), graphDSP(new onepole('b', 0.2f), inplace)),
+                         graphSequence(graphDSP(new onepole('c', 0.3f), inplace), graphDSP(new onepole('d', 0.4f), inplace)));
+}
+
+// (a : b), (c : (d, e) : f) : g, with 'c' having 2 outputs and 'f' and 'g' 2 inputs
+static dsp_graph_node* expression()
+{
+    dsp_graph_node* branch1 = graphSequence(graphDSP(new onepole('a', 0.5f)), graphDSP(new onepole('b', 0.9f)));
+    dsp_graph_node* branch2 = graphSequence(graphSequence(graphDSP(new onepole('c', 0.3f, 1, 2)),
+                                                          graphParallel(graphDSP(new onepole('d', 0.7f)), graphDSP(new onepole('e', 0.1f)))),
+                                            graphDSP(new onepole('f', 0.2f, 2, 1)));
+    return graphSequence(graphParallel(branch1, branch2), graphDSP(new onepole('g', 0.6f, 2, 2)));
+}
+
+// The same expression with dsp_sequencer/dsp_parallelizer
+static dsp* combination()
+{
+    dsp* branch1 = new dsp_sequencer(new onepole('a', 0.5f), new onepole('b', 0.9f));
+    dsp* branch2 = new dsp_sequencer(new dsp_sequencer(new onepole('c', 0.3f, 1, 2),
+                                                       new dsp_parallelizer(new onepole('d', 0.7f), new onepole('e', 0.1f))),
+                                     new onepole('f', 0.2f, 2, 1));
+    return new dsp_sequencer(new dsp_parallelizer(branch1, branch2), new onepole('g', 0.6f, 2, 2));
+}
+
+struct buffers {
+
+    std::vector<std::vector<FAUSTFLOAT> > fData;
+    std::vector<FAUSTFLOAT*> fChans;
+
+    buffers(int channels, int count):fData(channels, std::vector<FAUSTFLOAT>(count)), fChans(channels)
+    {
+        for (int i = 0; i < channels; i++) fChans[i] = &fData[i][0];
+    }
+
+    void noise()
+    {
+        for (size_t i = 0; i < fData.size(); i++) {
+            for (size_t j = 0; j < fData[i].size(); j++) fData[i][j] = rand() / FAUSTFLOAT(RAND_MAX) - 0.5f;
+        }
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    const int count = 256;
+
+    // Steps are computed in the order of the expression
+    dsp_graph graph(expression(), count);
+    graph.init(48000);
+    check(graph.getNumInputs() == 2 && graph.getNumOutputs() == 2, "channels");
+    buffers in(2, count), out(2, count);
+    gOrder.clear();
+    graph.compute(count, &in.fChans[0], &out.fChans[0]);
+    check(gOrder == "abcdefg", "compute order");
+
+    // Internal buffers are reused along a chain, inplace DSPs need only one
+    dsp_graph graph1(chain(false), count);
+    dsp_graph graph2(chain(true), count);
+    check(graph1.getNumBuffers() == 2, "buffers of a chain");
+    check(graph2.getNumBuffers() == 1, "buffers of an inplace chain");
+
+    // Same outputs as the combinators, with separate or aliased inputs and outputs, and for a clone
+    dsp* ref = combination();
+    dsp* clone = graph.clone();
+    ref->init(48000);
+    graph.instanceClear();
+    clone->init(48000);
+    buffers out1(2, count), out2(2, count), inout(2, count);
+    bool same = true, cloned = true;
+    for (int block = 0; block < 100; block++) {
+        in.noise();
+        inout.fData = in.fData;
+        ref->compute(count, &in.fChans[0], &out1.fChans[0]);
+        graph.compute(count, &in.fChans[0], &out2.fChans[0]);
+        same &= (out1.fData == out2.fData);
+        clone->compute(count, &inout.fChans[0], &inout.fChans[0]);
+        cloned &= (out1.fData == inout.fData);
+    }
+    check(same, "outputs");
+    check(cloned, "outputs of a clone with aliased buffers");
+    delete ref;
+    delete clone;
+
+    printf("%s\n", (gErrors == 0) ? "OK" : "FAILED");
+    return (gErrors == 0) ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+/*
+  DSP load monitor test: replays a timing scenario with the dummy driver and checks
+  the load statistics (see README).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "faust/audio/dummy-audio.h"
+
+class silence : public dsp {
+
+    public:
+
+        int fSampleRate;
+
+        virtual int getNumInputs() { return 0; }
+        virtual int getNumOutputs() { return 1; }
+        virtual void buildUserInterface(UI* ui_interface) {}
+        virtual int getSampleRate() { return fSampleRate; }
+        virtual void init(int samplingRate) { fSampleRate = samplingRate; }
+        virtual void instanceInit(int samplingRate) { fSampleRate = samplingRate; }
+        virtual void instanceConstants(int samplingRate) {}
+        virtual void instanceResetUserInterface() {}
+        virtual void instanceClear() {}
+        virtual dsp* clone() { return new silence(); }
+        virtual void metadata(Meta* m) {}
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            for (int i = 0; i < count; i++) outputs[0][i] = 0;
+        }
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            compute(count, inputs, outputs);
+        }
+};
+
+static int gErrors = 0;
+
+static void check(bool cond, const char* what)
+{
+    if (!cond) {
+        printf("FAILED: %s\n", what);
+        gErrors++;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // 1000 callbacks of 256 frames at 48 kHz: 98% at 20% of the period, 2% at 150%
+    std::vector<double> scenario(50, 0.2);
+    scenario[10] = 1.5;
+    
+    monitor_dsp* DSP = new monitor_dsp(new silence());
+    load_monitor monitor;
+    {
+        dummyaudio audio(48000, 256, 1001);
+        audio.init("monitor", DSP);
+        audio.setMonitor(&monitor);
+        audio.setScenario(scenario);
+        audio.start();
+    }
+    
+    dsp_load load = monitor.getLoad();
+    printf("driver: %s\n", load.json().c_str());
+    check(load.fCount == 1000, "callbacks count");
+    check(load.fMisses >= 20 && load.fMisses < 30, "deadline misses");
+    check(load.fMax >= 1.5, "worst case");
+    check(load.percentile(50.) >= 0.19 && load.percentile(50.) < 0.3, "median load");
+    check(load.percentile(99.) >= 1.5, "99th percentile");
+    check(load.fMean > 0.2 && load.fMean < 0.4, "mean load");
+    
+    // DSP side: the silence DSP is far from the deadline
+    dsp_load dsp_load = DSP->getLoad();
+    printf("dsp: %s\n", dsp_load.json().c_str());
+    check(dsp_load.fCount == 1000, "dsp callbacks count");
+    check(dsp_load.fMisses == 0, "dsp deadline misses");
+    
+    // Xruns attribution
+    monitor.record(400., 1000.);
+    monitor.xrun();
+    monitor.record(1200., 1000.);
+    monitor.xrun();
+    load = monitor.getLoad();
+    check(load.fXRuns == 2 && load.fDSPXRuns == 1, "xruns attribution");
+    
+    // Reset is done at the next record
+    monitor.reset();
+    monitor.record(100., 1000.);
+    load = monitor.getLoad();
+    check(load.fCount == 1 && load.fMisses == 0 && load.fBins[10] == 1, "reset");
+    
+    delete DSP;
+    printf("%s\n", gErrors ? "FAILED" : "OK");
+    return gErrors ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+/*
+  DSP instance pool test: computes instances of two classes on several pinned workers
+  and checks their placement, batching and outputs (see README).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "faust/dsp/dsp-pool.h"
+
+// Output a constant, a static table being shared by the instances of a class
+template <int VALUE>
+class constant : public dsp {
+
+    public:
+
+        static float fTable[1024];
+        int fSampleRate;
+
+        static void classInit(int samplingRate)
+        {
+            for (int i = 0; i < 1024; i++) fTable[i] = float(VALUE);
+        }
+
+        virtual int getNumInputs() { return 1; }
+        virtual int getNumOutputs() { return 1; }
+        virtual void buildUserInterface(UI* ui_interface) {}
+        virtual int getSampleRate() { return fSampleRate; }
+        virtual void init(int samplingRate) { classInit(samplingRate); instanceInit(samplingRate); }
+        virtual void instanceInit(int samplingRate) { fSampleRate = samplingRate; }
+        virtual void instanceConstants(int samplingRate) {}
+        virtual void instanceResetUserInterface() {}
+        virtual void instanceClear() {}
+        virtual dsp* clone() { return new constant<VALUE>(); }
+        virtual void metadata(Meta* m) {}
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            for (int i = 0; i < count; i++) outputs[0][i] = inputs[0][i] + fTable[i & 1023];
+        }
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            compute(count, inputs, outputs);
+        }
+};
+
+template <int VALUE> float constant<VALUE>::fTable[1024];
+
+static int gErrors = 0;
+
+static void check(bool cond, const char* what)
+{
+    if (!cond) {
+        printf("FAILED: %s\n", what);
+        gErrors++;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    constant<1> one;
+    constant<2> two;
+    one.init(48000);
+    two.init(48000);
+    
+    dsp_instance_pool pool(48000, 256, 3);
+    check(pool.getNumWorkers() == 3, "workers");
+    for (int i = 0; i < pool.getNumWorkers(); i++) {
+        printf("worker %d : cpu %d, node %d\n", i, pool.getWorkerCPU(i), pool.getWorkerNode(i));
+    }
+    
+    // Interleaved additions are spread evenly
+    std::vector<pooled_dsp*> instances;
+    for (int i = 0; i < 12; i++) {
+        instances.push_back(pool.add((i % 2) ? (dsp*)&two : (dsp*)&one));
+    }
+    for (int i = 0; i < pool.getNumWorkers(); i++) {
+        check(pool.getWorkerInstances(i) == 4, "balanced placement");
+    }
+    
+    for (int cycle = 0; cycle < 100; cycle++) {
+        for (size_t i = 0; i < instances.size(); i++) {
+            for (int frame = 0; frame < 256; frame++) instances[i]->getInputs()[0][frame] = float(cycle);
+        }
+        pool.compute(256);
+        for (size_t i = 0; i < instances.size(); i++) {
+            float expected = float(cycle + ((i % 2) ? 2 : 1));
+            check(instances[i]->getOutputs()[0][0] == expected && instances[i]->getOutputs()[0][255] == expected, "outputs");
+        }
+    }
+    
+    // Removed instances are no longer computed, explicit placement is kept
+    pool.remove(instances[0]);
+    pooled_dsp* pinned = pool.add(&one, 2);
+    check(pinned->getWorker() == 2, "explicit placement");
+    check(pool.getWorkerInstances(2) == 5, "instances count");
+    pool.compute(128);
+    check(pinned->getOutputs()[0][0] == 1.f && pinned->getOutputs()[0][128] == 0.f, "partial cycle");
+    
+    printf("%s\n", (gErrors == 0) ? "OK" : "FAILED");
+    return (gErrors == 0) ? 0 : 1;
+}
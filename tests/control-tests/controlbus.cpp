@@ -0,0 +1,137 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2017 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+#include "faust/gui/GUI.h"
+
+std::list<GUI*> GUI::fGuiList;
+ztimedmap GUI::gTimedZoneMap;
+
+// Counts allocations, the bus must not allocate once the threads are running
+static std::atomic<long> gAllocations(0);
+
+void* operator new(size_t size)
+{
+    gAllocations++;
+    void* ptr = malloc(size);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+#define kGroupSize  8
+
+static std::atomic<bool> gStart(false);
+static std::atomic<int> gRunning(0);
+
+// Each producer writes increasing values in its own zone, one by one or by groups,
+// the date of a record is the index of its group in the producer sequence
+static void producer(ControlBus* bus, FAUSTFLOAT* zone, int count)
+{
+    while (!gStart) {}
+    int value = 0;
+    while (value < count) {
+        if (value % 3 == 0 && value + kGroupSize <= count) {
+            ControlBus::Control controls[kGroupSize];
+            for (int i = 0; i < kGroupSize; i++) {
+                ControlBus::Control control = { zone, FAUSTFLOAT(value + i), double(value) };
+                controls[i] = control;
+            }
+            while (!bus->push(controls, kGroupSize)) std::this_thread::yield();
+            value += kGroupSize;
+        } else {
+            while (!bus->write(zone, FAUSTFLOAT(value), double(value))) std::this_thread::yield();
+            value++;
+        }
+    }
+    gRunning--;
+}
+
+int main(int argc, char* argv[])
+{
+    int producers = (argc > 1) ? atoi(argv[1]) : 4;
+    int count = (argc > 2) ? atoi(argv[2]) : 1000000;
+    // Values are exact in a float
+    count = std::min(count, 1 << 23);
+    
+    static ControlBus bus;
+    bus.attach();
+    std::vector<FAUSTFLOAT> zones(producers, FAUSTFLOAT(-1));
+    std::vector<FAUSTFLOAT> dates(producers, FAUSTFLOAT(-1));
+    static ControlBus::Control block[ControlBus::kSize];
+    
+    std::vector<std::thread*> threads;
+    gRunning = producers;
+    for (int i = 0; i < producers; i++) {
+        threads.push_back(new std::thread(producer, &bus, &zones[i], count));
+    }
+    
+    long allocations = gAllocations;
+    auto start = std::chrono::steady_clock::now();
+    gStart = true;
+    
+    // Consumer : reads by blocks like an audio thread would do
+    long received = 0, blocks = 0, errors = 0;
+    for (;;) {
+        bool running = gRunning > 0;
+        int size = bus.read(block, 256);
+        blocks++;
+        for (int i = 0; i < size; i++) {
+            int p = int(block[i].fZone - &zones[0]);
+            if (p < 0 || p >= producers) { errors++; continue; }
+            // Values of a producer come in order, without loss
+            if (block[i].fValue != zones[p] + 1) errors++;
+            // A group is read in a single block
+            if (block[i].fDate != dates[p] && block[i].fDate != block[i].fValue) errors++;
+            zones[p] = block[i].fValue;
+            dates[p] = block[i].fDate;
+            received++;
+        }
+        if (!running && size == 0) break;
+        if (size == 0) std::this_thread::yield();
+    }
+    
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+    allocations = gAllocations - allocations;
+    
+    for (int i = 0; i < producers; i++) {
+        threads[i]->join();
+        delete threads[i];
+        if (zones[i] != FAUSTFLOAT(count - 1)) errors++;
+    }
+    
+    // A group larger than the block is read alone
+    std::vector<ControlBus::Control> group(300, ControlBus::Control());
+    for (size_t i = 0; i < group.size(); i++) group[i].fZone = &zones[0];
+    if (!bus.push(&group[0], int(group.size())) || bus.read(block, 256) != int(group.size())) errors++;
+    
+    printf("producers = %d records = %ld blocks = %ld : %.1f Mrecords/s\n", producers, received, blocks, received / duration.count() / 1e6);
+    printf("errors = %ld allocations = %ld\n", errors, allocations);
+    
+    return (errors == 0 && allocations == 0) ? 0 : 1;
+}
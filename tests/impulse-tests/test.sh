@@ -26,6 +26,17 @@ for f in *.dsp; do
     filesCompare $D/$f.scal.ir ../expected-responses/$f.scal.ir && echo "OK $f scalar mode" || echo "ERROR $f scalar mode"
 done
 
+for f in *.dsp; do
+    faust2impulse -double -ls 1 $f > $D/$f.scal.ir
+    filesCompare $D/$f.scal.ir ../expected-responses/$f.scal.ir && echo "OK $f scalar -ls 1 mode" || echo "ERROR $f scalar -ls 1 mode"
+done
+
+# the controls keep their default value, so the bypassed stateful branches are never selected
+for f in *.dsp; do
+    faust2impulse -double -ls 2 $f > $D/$f.scal.ir
+    filesCompare $D/$f.scal.ir ../expected-responses/$f.scal.ir && echo "OK $f scalar -ls 2 mode" || echo "ERROR $f scalar -ls 2 mode"
+done
+
 #for f in *.dsp; do
 #    faust2impulsebis -double $f > $D/$f.scal.ir
 #    filesCompare $D/$f.scal.ir ../expected-responses/$f.scal.ir && echo "OK $f scalar expanded mode" || echo "ERROR $f scalar mode"
@@ -81,6 +92,18 @@ for f in *.dsp; do
 	filesCompare $D/$f.vec.ir ../expected-responses/$f.scal.ir 0.001 && echo "OK $f vector -lv 0 mode" || echo "ERROR $f vector -lv 0 mode"
 done
 
+echo "==============================================================="
+echo "Same code with the collection of the trees (-gc)"
+echo "==============================================================="
+
+for m in "" "-vec -lv 1" "-sch"; do
+    for f in *.dsp; do
+        faust $m $f > $D/$f.cpp
+        faust $m -gc $f > $D/$f.gc.cpp
+        cmp -s $D/$f.cpp $D/$f.gc.cpp && echo "OK $f -gc $m" || echo "ERROR $f -gc $m"
+    done
+done
+
 echo "==============================================================="
 echo "Valgrind test in scalar mode "
 echo "==============================================================="
@@ -0,0 +1,98 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2017 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <vector>
+#include <algorithm>
+
+#include "faust/gui/MidiUI.h"
+
+std::list<GUI*> GUI::fGuiList;
+ztimedmap GUI::gTimedZoneMap;
+
+#define kMessages   (1 << 20)
+#define kRounds     8
+#define kBlockSize  256
+
+static double getTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+int main(int argc, char* argv[])
+{
+    int nzones = (argc > 1) ? atoi(argv[1]) : 512;
+    
+    midi_handler handler;
+    MidiUI midiinterface(&handler);
+    std::vector<FAUSTFLOAT> zones(nzones * 2);
+    char meta[64];
+    
+    // Each zone is mapped on a controller and a key, all channels
+    for (int i = 0; i < nzones; i++) {
+        snprintf(meta, 64, "ctrl %d", i % 128);
+        midiinterface.declare(&zones[i], "midi", meta);
+        midiinterface.addHorizontalSlider("ctrl", &zones[i], 0, 0, 1, 0.01);
+        snprintf(meta, 64, "keyon %d", i % 128);
+        midiinterface.declare(&zones[nzones + i], "midi", meta);
+        midiinterface.addHorizontalSlider("key", &zones[nzones + i], 0, 0, 1, 0.01);
+    }
+    
+    std::vector<midi_message> messages(kMessages);
+    srand(1);
+    for (int i = 0; i < kMessages; i++) {
+        messages[i].fTime = i;
+        messages[i].fType = midi::MIDI_CONTROL_CHANGE;
+        messages[i].fChannel = rand() % 16;
+        messages[i].fData1 = rand() % 128;
+        messages[i].fData2 = rand() % 128;
+    }
+    
+    double start = getTime();
+    for (int r = 0; r < kRounds; r++) {
+        for (int i = 0; i < kMessages; i++) {
+            const midi_message& m = messages[i];
+            handler.handleData2(m.fTime, m.fType, m.fChannel, m.fData1, m.fData2);
+        }
+    }
+    double end = getTime();
+    printf("zones = %d, per message : %.2f Mmessages/s\n", nzones, kRounds * kMessages / (end - start) * 1e-6);
+    
+    // The block API must give the same zone values as the per-message API
+    std::vector<FAUSTFLOAT> reference(zones);
+    std::fill(zones.begin(), zones.end(), FAUSTFLOAT(0));
+    
+    start = getTime();
+    for (int r = 0; r < kRounds; r++) {
+        for (int i = 0; i < kMessages; i += kBlockSize) {
+            handler.handleMessages(&messages[i], kBlockSize);
+        }
+    }
+    end = getTime();
+    printf("zones = %d, block : %.2f Mmessages/s\n", nzones, kRounds * kMessages / (end - start) * 1e-6);
+    
+    bool changed = false;
+    for (int i = 0; i < nzones; i++) changed |= (reference[i] != 0);
+    bool same = (zones == reference);
+    printf("%s\n", (changed && same) ? "OK" : "FAILED");
+    return (changed && same) ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2017 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <vector>
+#include <string>
+
+#include "faust/gui/OSCUI.h"
+
+#include "osc/OscOutboundPacketStream.h"
+#include "ip/UdpSocket.h"
+
+std::list<GUI*> GUI::fGuiList;
+ztimedmap GUI::gTimedZoneMap;
+
+#define kPort       5710
+#define kBurst      64          // messages sent before waiting for the receiver
+#define kMessages   (1 << 17)
+
+static double getTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// Waits until the receiver has processed the burst, identified by its sequence number
+static bool waitSequence(FAUSTFLOAT* zone, int seq)
+{
+    for (int i = 0; i < 1000000; i++) {
+        if (*zone == FAUSTFLOAT(seq)) return true;
+        usleep(0);
+    }
+    return false;
+}
+
+static bool run(const char* name, UdpTransmitSocket& socket, std::vector<FAUSTFLOAT>& zones, bool bundle, bool pattern)
+{
+    int nzones = zones.size() - 1;
+    char buffer[65536];
+    char address[256];
+    int seq = 0;
+    
+    double start = getTime();
+    for (int sent = 0; sent < kMessages; sent += kBurst) {
+        if (bundle) {
+            osc::OutboundPacketStream p(buffer, sizeof(buffer));
+            p << osc::BeginBundleImmediate;
+            for (int i = 0; i < kBurst; i++) {
+                int n = (sent + i) % nzones;
+                snprintf(address, 256, "/bench/group/s%d", n);
+                p << osc::BeginMessage(address) << float(i) << osc::EndMessage;
+            }
+            p << osc::BeginMessage("/bench/group/seq") << float(++seq) << osc::EndMessage;
+            p << osc::EndBundle;
+            socket.Send(p.Data(), p.Size());
+        } else {
+            for (int i = 0; i < kBurst; i++) {
+                osc::OutboundPacketStream p(buffer, sizeof(buffer));
+                int n = (sent + i) % nzones;
+                if (pattern) {
+                    snprintf(address, 256, "/bench/gr*/s%d", n);
+                } else {
+                    snprintf(address, 256, "/bench/group/s%d", n);
+                }
+                p << osc::BeginMessage(address) << float(i) << osc::EndMessage;
+                socket.Send(p.Data(), p.Size());
+            }
+            osc::OutboundPacketStream p(buffer, sizeof(buffer));
+            p << osc::BeginMessage("/bench/group/seq") << float(++seq) << osc::EndMessage;
+            socket.Send(p.Data(), p.Size());
+        }
+        if (!waitSequence(&zones[nzones], seq)) {
+            printf("%s : messages lost\n", name);
+            return false;
+        }
+    }
+    double end = getTime();
+    printf("%s : %.0f messages/s\n", name, kMessages / (end - start));
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int nzones = (argc > 1) ? atoi(argv[1]) : 256;
+    
+    char port[16];
+    snprintf(port, 16, "%d", kPort);
+    const char* args[] = { "oscbench", "-port", port, "-xmit", "0" };
+    OSCUI oscinterface("oscbench", 5, (char**)args);
+    
+    std::vector<FAUSTFLOAT> zones(nzones + 1);
+    char label[32];
+    oscinterface.openVerticalBox("bench");
+    oscinterface.openVerticalBox("group");
+    for (int i = 0; i < nzones; i++) {
+        snprintf(label, 32, "s%d", i);
+        oscinterface.addHorizontalSlider(label, &zones[i], 0, 0, 1000, 1);
+    }
+    oscinterface.addHorizontalSlider("seq", &zones[nzones], 0, 0, 1e9, 1);
+    oscinterface.closeBox();
+    oscinterface.closeBox();
+    oscinterface.run();
+    usleep(100000);
+    
+    UdpTransmitSocket socket(IpEndpointName("127.0.0.1", kPort));
+    printf("zones = %d\n", nzones);
+    bool ok = run("plain", socket, zones, false, false);
+    ok &= run("pattern", socket, zones, false, true);
+    zones[nzones] = 0;
+    ok &= run("bundle", socket, zones, true, false);
+    
+    oscinterface.stop();
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
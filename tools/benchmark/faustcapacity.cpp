@@ -0,0 +1,288 @@
+/************************************************************************
+    FAUST Architecture File
+    Copyright (C) 2017 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This Architecture section is free software; you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+    EXCEPTION : As a special exception, you may create a larger work
+    that contains this FAUST architecture section and distribute
+    that work under terms of your choice, so long as this FAUST
+    architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Capacity planning: how many instances of a DSP can be computed on this machine.
+
+    -threads <n>        number of computing threads, each pinned on a core (number of cores)
+    -sr <rate>          sample rate (48000)
+    -bs <frames>        buffer size (256)
+    -fraction <f>       fraction of the buffer duration allowed for computing (0.8)
+    -percentile <p>     percentage of the buffers that have to be computed in time (99)
+    -count <n>          number of buffers measured for each number of instances (1000)
+    -max <n>            maximum number of instances (4096)
+
+ The instances are spread over the threads, each thread computing its instances one after the other
+ at each buffer. Threads run simultaneously so that they share caches and memory bandwidth as in a real server.
+ The number of instances is doubled then bisected until the given percentile of the per-buffer compute
+ time of the slowest thread exceeds the deadline (fraction * buffer duration).
+*/
+
+#include <vector>
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <malloc.h>
+
+#include "faust/gui/UI.h"
+#include "faust/dsp/dsp.h"
+#include "faust/dsp/dsp-bench.h"
+#include "faust/misc.h"
+
+#include "capacity_dsp.h"
+
+using namespace std;
+
+/*
+    A group of instances computed one after the other, each one with its own outputs.
+*/
+
+class group_dsp : public dsp {
+
+    private:
+
+        vector<dsp*> fInstances;
+        vector<FAUSTFLOAT**> fOutputs;
+        int fBufferSize;
+        int fNumInputs;
+        int fNumOutputs;
+
+    public:
+
+        group_dsp(int instances, int sample_rate, int buffer_size):fBufferSize(buffer_size)
+        {
+            for (int i = 0; i < instances; i++) {
+                dsp* instance = new capacity_dsp();
+                instance->init(sample_rate);
+                FAUSTFLOAT** outputs = new FAUSTFLOAT*[instance->getNumOutputs()];
+                for (int chan = 0; chan < instance->getNumOutputs(); chan++) {
+                    outputs[chan] = new FAUSTFLOAT[buffer_size];
+                    memset(outputs[chan], 0, sizeof(FAUSTFLOAT) * buffer_size);
+                }
+                fInstances.push_back(instance);
+                fOutputs.push_back(outputs);
+            }
+            capacity_dsp proto;
+            fNumInputs = proto.getNumInputs();
+            fNumOutputs = proto.getNumOutputs();
+        }
+
+        virtual ~group_dsp()
+        {
+            for (size_t i = 0; i < fInstances.size(); i++) {
+                for (int chan = 0; chan < fNumOutputs; chan++) {
+                    delete [] fOutputs[i][chan];
+                }
+                delete [] fOutputs[i];
+                delete fInstances[i];
+            }
+        }
+
+        virtual int getNumInputs() { return fNumInputs; }
+        virtual int getNumOutputs() { return fNumOutputs; }
+        virtual void buildUserInterface(UI* ui_interface) {}
+        virtual int getSampleRate() { return (fInstances.size() > 0) ? fInstances[0]->getSampleRate() : 0; }
+        virtual void init(int samplingRate) {}
+        virtual void instanceInit(int samplingRate) {}
+        virtual void instanceConstants(int samplingRate) {}
+        virtual void instanceResetUserInterface() {}
+        virtual void instanceClear() {}
+        virtual dsp* clone() { return 0; }
+        virtual void metadata(Meta* m) {}
+
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            for (size_t i = 0; i < fInstances.size(); i++) {
+                fInstances[i]->compute(count, inputs, fOutputs[i]);
+            }
+        }
+
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            compute(count, inputs, outputs);
+        }
+
+};
+
+struct capacity_test {
+
+    int fSampleRate;
+    int fBufferSize;
+    int fCount;
+    double fPercentile;
+    int fCPUs;
+    pthread_barrier_t fBarrier;
+
+    struct worker {
+        capacity_test* fTest;
+        pthread_t fThread;
+        int fCPU;
+        int fInstances;
+        double fDuration;   // percentile of the per-buffer compute time in usec
+    };
+
+    static void* run(void* arg)
+    {
+        worker* w = static_cast<worker*>(arg);
+        capacity_test* test = w->fTest;
+    #ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(w->fCPU, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+    #endif
+        // Allocated once pinned, so that the instances memory is local to the core
+        measure_dsp* mes = (w->fInstances > 0)
+            ? new measure_dsp(new group_dsp(w->fInstances, test->fSampleRate, test->fBufferSize), test->fBufferSize, test->fCount, 10)
+            : 0;
+        pthread_barrier_wait(&test->fBarrier);
+        if (mes) {
+            mes->measure();
+            w->fDuration = mes->getPercentileUsec(test->fPercentile);
+            delete mes;
+        }
+        return 0;
+    }
+
+    capacity_test(int sr, int bs, int count, double percentile)
+        :fSampleRate(sr), fBufferSize(bs), fCount(count), fPercentile(percentile)
+    {
+        fCPUs = std::max(1, int(sysconf(_SC_NPROCESSORS_ONLN)));
+    }
+
+    /**
+     * Compute 'instances' spread over 'threads' simultaneously running threads.
+     *
+     * @return the percentile of the per-buffer compute time of the slowest thread, in usec
+     */
+    double measure(int instances, int threads)
+    {
+        vector<worker> workers(threads);
+        pthread_barrier_init(&fBarrier, 0, threads);
+        for (int t = 0; t < threads; t++) {
+            workers[t].fTest = this;
+            workers[t].fCPU = t % fCPUs;
+            workers[t].fInstances = instances / threads + ((t < instances % threads) ? 1 : 0);
+            workers[t].fDuration = 0.;
+            pthread_create(&workers[t].fThread, 0, run, &workers[t]);
+        }
+        double duration = 0.;
+        for (int t = 0; t < threads; t++) {
+            pthread_join(workers[t].fThread, 0);
+            duration = std::max(duration, workers[t].fDuration);
+        }
+        pthread_barrier_destroy(&fBarrier);
+        return duration;
+    }
+
+    /**
+     * Search the number of instances (at most 'max') computed within 'deadline' usec.
+     */
+    int capacity(int threads, int max, double deadline)
+    {
+        int low = 0, high = max + 1;    // 'low' instances are sustained, 'high' are not
+        int n = threads;
+        while (low + 1 < high) {
+            double duration = measure(n, threads);
+            bool sustained = duration <= deadline;
+            printf("%d thread(s), %d instance(s) : p%g %.1f usec (%.1f%% of the deadline) : %s\n",
+                   threads, n, fPercentile, duration, duration * 100. / deadline, sustained ? "OK" : "missed");
+            if (sustained) low = n; else high = n;
+            // Double until the deadline is missed, then bisect
+            n = (high > max) ? std::min(std::max(low * 2, 1), max) : (low + high) / 2;
+        }
+        return low;
+    }
+
+};
+
+// Heap in use, in bytes
+static size_t heapSize()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+    return size_t(info.uordblks) + size_t(info.hblkhd);
+}
+
+// Heap allocated by one instance (including the object itself), averaged over a few instances
+static double heapPerInstance(int sample_rate)
+{
+    const int instances = 16;
+    vector<dsp*> dsps;
+    size_t before = heapSize();
+    for (int i = 0; i < instances; i++) {
+        dsp* dsp = new capacity_dsp();
+        dsp->init(sample_rate);
+        dsps.push_back(dsp);
+    }
+    size_t after = heapSize();
+    for (int i = 0; i < instances; i++) {
+        delete dsps[i];
+    }
+    return double(after - before) / instances;
+}
+
+int main(int argc, char* argv[])
+{
+    int cpus = std::max(1, int(sysconf(_SC_NPROCESSORS_ONLN)));
+    int threads = std::max(1, int(lopt(argv, "-threads", cpus)));
+    int sample_rate = lopt(argv, "-sr", 48000);
+    int buffer_size = lopt(argv, "-bs", 256);
+    double fraction = atof(lopts(argv, "-fraction", "0.8"));
+    double percentile = atof(lopts(argv, "-percentile", "99"));
+    int count = std::max(20, int(lopt(argv, "-count", 1000)));
+    int max = lopt(argv, "-max", 4096);
+
+    double period = double(buffer_size) * 1e6 / double(sample_rate);
+    double deadline = period * fraction;
+
+    cout << "Capacity of " << argv[0] << " compiled in C++ running with FAUSTFLOAT = " << ((sizeof(FAUSTFLOAT) == 4) ? "float" : "double") << endl;
+    printf("%d core(s), %d thread(s), %d Hz, %d frames : deadline %.1f usec (%g%% of %.1f usec) at p%g\n",
+           cpus, threads, sample_rate, buffer_size, deadline, fraction * 100., period, percentile);
+
+    capacity_test test(sample_rate, buffer_size, count, percentile);
+
+    int single = test.capacity(1, max, deadline);
+    int total = (threads > 1) ? test.capacity(threads, max, deadline) : single;
+    int cores = std::min(threads, cpus);
+
+    double heap = heapPerInstance(sample_rate);
+
+    printf("\n");
+    printf("single thread capacity : %d instance(s)\n", single);
+    printf("%d thread(s) capacity : %d instance(s), %.1f per core\n", threads, total, double(total) / cores);
+    if (single > 0) {
+        printf("scaling efficiency : %.1f%%\n", double(total) * 100. / (double(single) * cores));
+    }
+    printf("memory per instance : sizeof %d bytes, heap %.0f bytes\n", int(sizeof(capacity_dsp)), heap);
+    printf("memory at capacity : %.1f KB\n", heap * total / 1024.);
+    return 0;
+}